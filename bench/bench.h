@@ -0,0 +1,35 @@
+#ifndef BENCH_HARNESS_H
+#define BENCH_HARNESS_H
+
+#include <stddef.h>
+#include "../src/arena.h"
+#include "../src/server/server.h"
+
+// One benchmark operation. The harness calls it in calibrated batches.
+typedef void (*BenchFunction)(void *data);
+
+// Time fn and record the median ns/op under name ("group/case")
+void benchRun(const char *name, BenchFunction fn, void *data);
+
+// Scratch arena shared by benchmarks, large enough for big documents.
+// Benchmarks reset it at the start of each operation.
+Arena* benchArena(void);
+
+// Make the scratch arena the jansson allocator, as a request would
+void benchUseJsonArena(void);
+
+// Path of the app under benchmark
+const char* benchAppPath(void);
+
+// Server context for the app under benchmark (app.webdsl by default), with
+// routes, mustache and Lua initialized but no database or HTTP daemon
+ServerContext* benchServer(void);
+
+// Benchmark groups
+void run_parser_benchmarks(void);
+void run_jq_benchmarks(void);
+void run_lua_benchmarks(void);
+void run_server_benchmarks(void);
+void run_http_benchmarks(void);
+
+#endif // BENCH_HARNESS_H
@@ -0,0 +1,145 @@
+#include "bench.h"
+#include "../src/server/http_client.h"
+#include <microhttpd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STANDIN_BODY "{\"ok\":true}"
+
+typedef struct HttpBench {
+    char url[64];
+} HttpBench;
+
+// =============================================================================
+// Stand-in Upstream
+// =============================================================================
+
+static enum MHD_Result standInHandler(void *cls, struct MHD_Connection *connection,
+                                      const char *url, const char *method,
+                                      const char *version, const char *uploadData,
+                                      size_t *uploadDataSize, void **conCls) {
+    (void)cls; (void)url; (void)method; (void)version;
+    (void)uploadData; (void)uploadDataSize; (void)conCls;
+
+    struct MHD_Response *response = MHD_create_response_from_buffer(
+        strlen(STANDIN_BODY), (void *)STANDIN_BODY, MHD_RESPMEM_PERSISTENT);
+    enum MHD_Result ret = MHD_queue_response(connection, MHD_HTTP_OK, response);
+    MHD_destroy_response(response);
+    return ret;
+}
+
+static char* readPem(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (!file) return NULL;
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    char *pem = size > 0 ? malloc((size_t)size + 1) : NULL;
+    if (pem && fread(pem, 1, (size_t)size, file) == (size_t)size) {
+        pem[size] = '\0';
+    } else {
+        free(pem);
+        pem = NULL;
+    }
+    fclose(file);
+    return pem;
+}
+
+// =============================================================================
+// Requests
+// =============================================================================
+
+static size_t discardBody(void *contents, size_t size, size_t nmemb, void *userp) {
+    (void)contents; (void)userp;
+    return size * nmemb;
+}
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wdisabled-macro-expansion"
+
+static CURLcode performGet(CURL *curl, const char *url) {
+    curl_easy_setopt(curl, CURLOPT_URL, url);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, discardBody);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    // The stand-in's certificate is self-signed
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
+    return curl_easy_perform(curl);
+}
+
+#pragma clang diagnostic pop
+
+// A new handle per call, as fetch, email and GitHub used to make
+static void benchFreshHandle(void *data) {
+    HttpBench *bench = data;
+    CURL *curl = curl_easy_init();
+    if (!curl) return;
+    performGet(curl, bench->url);
+    curl_easy_cleanup(curl);
+}
+
+static void benchPooledHandle(void *data) {
+    HttpBench *bench = data;
+    CURL *curl = acquireHttpHandle();
+    if (!curl) return;
+    performGet(curl, bench->url);
+    releaseHttpHandle(curl);
+}
+
+// Runs against HTTPS when BENCH_TLS_KEY and BENCH_TLS_CERT name a PEM key and
+// certificate (make bench generates a self-signed pair), plain HTTP otherwise
+void run_http_benchmarks(void) {
+    initHttpClient();
+
+    const char *keyPath = getenv("BENCH_TLS_KEY");
+    const char *certPath = getenv("BENCH_TLS_CERT");
+    char *key = keyPath ? readPem(keyPath) : NULL;
+    char *cert = certPath ? readPem(certPath) : NULL;
+    bool tls = key && cert;
+
+    struct MHD_Daemon *daemon = NULL;
+    if (tls) {
+        daemon = MHD_start_daemon(MHD_USE_INTERNAL_POLLING_THREAD | MHD_USE_TLS, 0,
+                                  NULL, NULL, standInHandler, NULL,
+                                  MHD_OPTION_HTTPS_MEM_KEY, key,
+                                  MHD_OPTION_HTTPS_MEM_CERT, cert,
+                                  MHD_OPTION_END);
+    } else {
+        daemon = MHD_start_daemon(MHD_USE_INTERNAL_POLLING_THREAD, 0,
+                                  NULL, NULL, standInHandler, NULL,
+                                  MHD_OPTION_END);
+    }
+    if (!daemon) {
+        fprintf(stderr, "Failed to start the stand-in upstream, skipping http\n");
+        free(key);
+        free(cert);
+        return;
+    }
+
+    const union MHD_DaemonInfo *info = MHD_get_daemon_info(daemon, MHD_DAEMON_INFO_BIND_PORT);
+    HttpBench bench;
+    snprintf(bench.url, sizeof(bench.url), "%s://127.0.0.1:%u/",
+             tls ? "https" : "http", info ? (unsigned)info->port : 0u);
+
+    CURL *probe = curl_easy_init();
+    CURLcode result = probe ? performGet(probe, bench.url) : CURLE_FAILED_INIT;
+    if (probe) curl_easy_cleanup(probe);
+
+    if (result != CURLE_OK) {
+        fprintf(stderr, "Stand-in upstream unreachable (%s), skipping http\n",
+                curl_easy_strerror(result));
+    } else if (tls) {
+        benchRun("http/tlsFreshHandle", benchFreshHandle, &bench);
+        benchRun("http/tlsPooledHandle", benchPooledHandle, &bench);
+    } else {
+        benchRun("http/freshHandle", benchFreshHandle, &bench);
+        benchRun("http/pooledHandle", benchPooledHandle, &bench);
+    }
+
+    MHD_stop_daemon(daemon);
+    free(key);
+    free(cert);
+}
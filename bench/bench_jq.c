@@ -0,0 +1,81 @@
+#include "bench.h"
+#include "../src/server/jq.h"
+#include "../src/server/jq_native.h"
+#include "../src/server/handler.h"
+#include "../src/server/routing.h"
+#include <stdio.h>
+
+#define DOCUMENT_ROWS 1000
+#define DOCUMENT_ARENA_SIZE (16 * 1024 * 1024)
+
+typedef struct JqBench {
+    json_t *document;
+    jv documentJv;
+    PipelineStepNode step;
+    PipelineStepNode nativeStep;
+    ServerContext *ctx;
+} JqBench;
+
+// Shaped like a SQL step result: { rows: [ {...}, ... ] }
+static json_t* buildDocument(void) {
+    json_t *rows = json_array();
+    for (int i = 0; i < DOCUMENT_ROWS; i++) {
+        char name[32];
+        char email[64];
+        snprintf(name, sizeof(name), "user-%d", i);
+        snprintf(email, sizeof(email), "user-%d@example.com", i);
+        json_array_append_new(rows, json_pack("{s:i, s:s, s:s, s:b, s:f, s:[s,s,s], s:{s:s, s:i}}",
+            "id", i, "name", name, "email", email, "active", i % 3 != 0,
+            "score", (double)i * 1.5, "tags", "a", "b", "c",
+            "team", "name", "engineering", "size", 12));
+    }
+    return json_pack("{s:o, s:s}", "rows", rows, "query", "SELECT * FROM users");
+}
+
+static void benchJanssonToJv(void *data) {
+    JqBench *bench = data;
+    jv_free(janssonToJv(bench->document));
+}
+
+static void benchJvToJansson(void *data) {
+    JqBench *bench = data;
+    arenaReset(benchArena());
+    jvToJansson(jv_copy(bench->documentJv));
+}
+
+static void benchExecuteJqStep(void *data) {
+    JqBench *bench = data;
+    arenaReset(benchArena());
+    executeJqStep(&bench->step, bench->document, NULL, benchArena(), bench->ctx);
+}
+
+static void benchExecuteNativeJq(void *data) {
+    JqBench *bench = data;
+    arenaReset(benchArena());
+    executeJqStep(&bench->nativeStep, bench->document, NULL, benchArena(), bench->ctx);
+}
+
+void run_jq_benchmarks(void) {
+    // The document outlives the scratch arena resets
+    Arena *documentArena = createArena(DOCUMENT_ARENA_SIZE);
+    initRequestJsonArena(documentArena);
+
+    JqBench bench = {0};
+    bench.document = buildDocument();
+    bench.documentJv = janssonToJv(bench.document);
+    bench.ctx = benchServer();
+    bench.step.type = STEP_JQ;
+    bench.step.code = "{ data: (.rows | map(select(.active) | {id: .id, name: .name, team: .team.name})) }";
+    bench.nativeStep = bench.step;
+    bench.nativeStep.nativeJq = compileNativeJq(bench.step.code, documentArena);
+
+    benchUseJsonArena();
+    benchRun("jq/janssonToJv", benchJanssonToJv, &bench);
+    benchRun("jq/jvToJansson", benchJvToJansson, &bench);
+    benchRun("jq/executeJqStep", benchExecuteJqStep, &bench);
+    benchRun("jq/native", benchExecuteNativeJq, &bench);
+
+    jv_free(bench.documentJv);
+    releaseJqThread();
+    freeArena(documentArena);
+}
@@ -0,0 +1,77 @@
+#include "bench.h"
+#include "../src/server/lua.h"
+#include "../src/server/handler.h"
+
+typedef struct LuaBench {
+    json_t *input;
+    json_t *requestContext;
+    PipelineStepNode step;
+    PipelineStepNode cpuStep;
+    ServerContext *ctx;
+} LuaBench;
+
+static void benchCreateLuaState(void *data) {
+    LuaBench *bench = data;
+    arenaReset(benchArena());
+    lua_State *L = createLuaState(bench->requestContext, benchArena());
+    if (L) lua_close(L);
+}
+
+static void benchExecuteLuaStep(void *data) {
+    LuaBench *bench = data;
+    arenaReset(benchArena());
+    executeLuaStep(&bench->step, bench->input, bench->requestContext, benchArena(), bench->ctx);
+}
+
+static void benchCpuLuaStep(void *data) {
+    LuaBench *bench = data;
+    arenaReset(benchArena());
+    executeLuaStep(&bench->cpuStep, bench->input, bench->requestContext, benchArena(), bench->ctx);
+}
+
+void run_lua_benchmarks(void) {
+    LuaBench bench = {0};
+    bench.ctx = benchServer();
+    bench.step.type = STEP_LUA;
+    bench.step.code =
+        "local items = {}\n"
+        "for i = 1, tonumber(request.limit) do\n"
+        "  items[#items + 1] = { id = i, label = request.name .. '-' .. i }\n"
+        "end\n"
+        "return { items = items, team = query.team_id }\n";
+
+    // Aggregation and formatting over rows, as a report step would do
+    bench.cpuStep.type = STEP_LUA;
+    bench.cpuStep.code =
+        "local totals, lines = {}, {}\n"
+        "for i = 1, 5000 do\n"
+        "  local team = 'team-' .. (i % 16)\n"
+        "  totals[team] = (totals[team] or 0) + (i * 7) % 101\n"
+        "end\n"
+        "for team, total in pairs(totals) do\n"
+        "  lines[#lines + 1] = string.format('%s: %.2f', team, total / 5000)\n"
+        "end\n"
+        "table.sort(lines)\n"
+        "return { report = table.concat(lines, '\\n') }\n";
+
+    // Inputs outlive the scratch arena resets
+    Arena *inputArena = createArena(64 * 1024);
+    initRequestJsonArena(inputArena);
+    bench.input = json_pack("{s:s, s:i}", "name", "webdsl", "limit", 20);
+    bench.requestContext = json_pack("{s:{s:s}, s:{}, s:{s:s}}",
+        "query", "team_id", "3", "body", "headers", "Accept", "application/json");
+
+    // Steps outside the website aren't compiled by initLua
+    if (!compileLuaBytecode(bench.step.code) || !compileLuaBytecode(bench.cpuStep.code)) {
+        fprintf(stderr, "Failed to compile Lua benchmark steps\n");
+        freeArena(inputArena);
+        return;
+    }
+
+    benchUseJsonArena();
+    benchRun("lua/createLuaState", benchCreateLuaState, &bench);
+    benchRun("lua/executeLuaStep", benchExecuteLuaStep, &bench);
+    benchRun("lua/cpu", benchCpuLuaStep, &bench);
+
+    freeArena(inputArena);
+}
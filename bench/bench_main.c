@@ -0,0 +1,258 @@
+#include "bench.h"
+#include "../src/parser.h"
+#include "../src/website.h"
+#include "../src/server/handler.h"
+#include "../src/server/routing.h"
+#include "../src/server/mustache.h"
+#include "../src/server/lua.h"
+#include "../src/server/metrics.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#define BENCH_ARENA_SIZE (64 * 1024 * 1024)
+#define BENCH_SAMPLES 7
+#define BENCH_MIN_SAMPLE_NS 10000000ull  // 10ms per sample
+#define BENCH_MAX_ITERATIONS (1u << 24)
+#define BENCH_MAX_RESULTS 64
+#define BENCH_DEFAULT_THRESHOLD 10.0
+
+typedef struct BenchResult {
+    char name[64];
+    double nsPerOp;     // Median over samples
+    double minNsPerOp;
+    size_t iterations;  // Per sample
+} BenchResult;
+
+static BenchResult results[BENCH_MAX_RESULTS];
+static size_t resultCount = 0;
+
+static const char *filter = NULL;
+static const char *appPath = "app.webdsl";
+static Arena *scratch = NULL;
+static Parser appParser = {0};
+static ServerContext appServer = {0};
+static bool appReady = false;
+
+// =============================================================================
+// Harness
+// =============================================================================
+
+static uint64_t timeBatch(BenchFunction fn, void *data, size_t iterations) {
+    uint64_t start = metricsNow();
+    for (size_t i = 0; i < iterations; i++) {
+        fn(data);
+    }
+    return metricsNow() - start;
+}
+
+static int compareDouble(const void *a, const void *b) {
+    double left = *(const double *)a;
+    double right = *(const double *)b;
+    return (left > right) - (left < right);
+}
+
+void benchRun(const char *name, BenchFunction fn, void *data) {
+    if (filter && !strstr(name, filter)) return;
+    if (resultCount == BENCH_MAX_RESULTS) {
+        fprintf(stderr, "Too many benchmarks, skipping %s\n", name);
+        return;
+    }
+
+    // Warm caches, then double the batch until one sample takes long enough
+    fn(data);
+    size_t iterations = 1;
+    while (iterations < BENCH_MAX_ITERATIONS &&
+           timeBatch(fn, data, iterations) < BENCH_MIN_SAMPLE_NS) {
+        iterations *= 2;
+    }
+
+    double samples[BENCH_SAMPLES];
+    for (int i = 0; i < BENCH_SAMPLES; i++) {
+        samples[i] = (double)timeBatch(fn, data, iterations) / (double)iterations;
+    }
+    qsort(samples, BENCH_SAMPLES, sizeof(double), compareDouble);
+
+    BenchResult *result = &results[resultCount++];
+    snprintf(result->name, sizeof(result->name), "%s", name);
+    result->nsPerOp = samples[BENCH_SAMPLES / 2];
+    result->minNsPerOp = samples[0];
+    result->iterations = iterations;
+
+    printf("%-36s %14.1f ns/op  (min %.1f, %zu x %d)\n",
+           name, result->nsPerOp, result->minNsPerOp, iterations, BENCH_SAMPLES);
+    fflush(stdout);
+}
+
+Arena* benchArena(void) {
+    return scratch;
+}
+
+void benchUseJsonArena(void) {
+    initRequestJsonArena(scratch);
+}
+
+const char* benchAppPath(void) {
+    return appPath;
+}
+
+ServerContext* benchServer(void) {
+    if (appReady) return &appServer;
+
+    WebsiteNode *website = parseWebsite(&appParser, appPath);
+    if (!website) {
+        fprintf(stderr, "Failed to parse %s\n", appPath);
+        exit(1);
+    }
+    appServer.website = website;
+    appServer.arena = appParser.arena;
+    appServer.db = NULL;
+
+    buildRouteMaps(website, appParser.arena);
+    initMustache(&appServer);
+    if (!initLua(&appServer)) {
+        fprintf(stderr, "Failed to initialize Lua\n");
+        exit(1);
+    }
+    appReady = true;
+    return &appServer;
+}
+
+// =============================================================================
+// Output and Baseline
+// =============================================================================
+
+static bool writeResults(const char *path) {
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return false;
+    }
+    for (size_t i = 0; i < resultCount; i++) {
+        fprintf(file, "{\"name\":\"%s\",\"nsPerOp\":%.1f,\"minNsPerOp\":%.1f,\"iterations\":%zu,\"samples\":%d}\n",
+                results[i].name, results[i].nsPerOp, results[i].minNsPerOp,
+                results[i].iterations, BENCH_SAMPLES);
+    }
+    fclose(file);
+    return true;
+}
+
+// Baseline files are the JSON lines written above, one benchmark per line
+static bool baselineValue(FILE *file, const char *name, double *nsPerOp) {
+    char line[512];
+    char key[96];
+    snprintf(key, sizeof(key), "\"name\":\"%s\"", name);
+
+    rewind(file);
+    while (fgets(line, sizeof(line), file)) {
+        if (!strstr(line, key)) continue;
+        const char *value = strstr(line, "\"nsPerOp\":");
+        if (!value) return false;
+        *nsPerOp = strtod(value + 10, NULL);
+        return *nsPerOp > 0;
+    }
+    return false;
+}
+
+// Returns the number of benchmarks slower than the baseline by more than threshold percent
+static int compareBaseline(const char *path, double threshold) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        printf("\nNo baseline at %s (run `make bench-baseline` to record one)\n", path);
+        return 0;
+    }
+
+    int regressions = 0;
+    printf("\nCompared to %s (threshold +%.1f%%)\n", path, threshold);
+    for (size_t i = 0; i < resultCount; i++) {
+        double base;
+        if (!baselineValue(file, results[i].name, &base)) {
+            printf("%-36s %14s\n", results[i].name, "new");
+            continue;
+        }
+        double change = (results[i].nsPerOp - base) / base * 100.0;
+        bool regressed = change > threshold;
+        if (regressed) regressions++;
+        printf("%-36s %14.1f -> %.1f ns/op  %+6.1f%%%s\n", results[i].name, base,
+               results[i].nsPerOp, change, regressed ? "  REGRESSION" : "");
+    }
+    fclose(file);
+    return regressions;
+}
+
+// =============================================================================
+// Entry Point
+// =============================================================================
+
+static void printUsage(const char *program) {
+    fprintf(stderr, "Usage: %s [options]\n", program);
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  --app FILE          App to benchmark (default app.webdsl)\n");
+    fprintf(stderr, "  --filter TEXT       Only run benchmarks whose name contains TEXT\n");
+    fprintf(stderr, "  --output FILE       Write results as JSON lines\n");
+    fprintf(stderr, "  --baseline FILE     Compare against results from a previous run\n");
+    fprintf(stderr, "  --threshold PCT     Allowed slowdown before failing (default %.0f)\n",
+            BENCH_DEFAULT_THRESHOLD);
+}
+
+int main(int argc, char *argv[]) {
+    static struct option long_options[] = {
+        {"app", required_argument, 0, 'a'},
+        {"filter", required_argument, 0, 'f'},
+        {"output", required_argument, 0, 'o'},
+        {"baseline", required_argument, 0, 'b'},
+        {"threshold", required_argument, 0, 't'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    const char *output = NULL;
+    const char *baseline = NULL;
+    double threshold = BENCH_DEFAULT_THRESHOLD;
+    int c;
+
+    while ((c = getopt_long(argc, argv, "a:f:o:b:t:h", long_options, NULL)) != -1) {
+        switch (c) {
+            case 'a': appPath = optarg; break;
+            case 'f': filter = optarg; break;
+            case 'o': output = optarg; break;
+            case 'b': baseline = optarg; break;
+            case 't': threshold = strtod(optarg, NULL); break;
+            case 'h':
+                printUsage(argv[0]);
+                return 0;
+            default:
+                printUsage(argv[0]);
+                return 64;
+        }
+    }
+
+    scratch = createArena(BENCH_ARENA_SIZE);
+    if (!scratch) {
+        fputs("Failed to allocate benchmark arena\n", stderr);
+        return 1;
+    }
+    benchUseJsonArena();
+
+    run_parser_benchmarks();
+    run_jq_benchmarks();
+    run_lua_benchmarks();
+    run_server_benchmarks();
+    run_http_benchmarks();
+
+    int status = 0;
+    if (output && !writeResults(output)) {
+        status = 1;
+    }
+    if (baseline && compareBaseline(baseline, threshold) > 0) {
+        status = 1;
+    }
+
+    if (appReady) {
+        cleanupLua();
+        freeArena(appParser.arena);
+    }
+    freeArena(scratch);
+    return status;
+}
@@ -0,0 +1,40 @@
+#include "bench.h"
+#include "../src/lexer.h"
+#include "../src/parser.h"
+#include "../src/file_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+static void benchGetNextToken(void *data) {
+    const char *source = data;
+    Arena *arena = benchArena();
+    arenaReset(arena);
+
+    Parser parser = {0};
+    parser.arena = arena;
+    initLexer(&parser.lexer, source, &parser);
+    while (getNextToken(&parser.lexer).type != TOKEN_EOF) {
+    }
+}
+
+static void benchParseProgram(void *data) {
+    const char *source = data;
+    Parser parser;
+    initParser(&parser, source);
+    parseProgram(&parser);
+    freeArena(parser.arena);
+}
+
+void run_parser_benchmarks(void) {
+    char *source = readFile(benchAppPath());
+    if (!source) {
+        fprintf(stderr, "Could not read %s\n", benchAppPath());
+        return;
+    }
+
+    benchRun("lexer/getNextToken", benchGetNextToken, source);
+    // Includes are read and parsed as well, as at startup
+    benchRun("parser/parseProgram", benchParseProgram, source);
+
+    free(source);
+}
@@ -0,0 +1,175 @@
+#include "bench.h"
+#include "../src/server/routing.h"
+#include "../src/server/mustache.h"
+#include "../src/server/db.h"
+#include "../src/server/handler.h"
+#include <stdio.h>
+#include <string.h>
+
+#define SYNTHETIC_ROUTES 500
+#define RESULT_ROWS 100
+#define RESULT_COLUMNS 8
+
+// =============================================================================
+// Mustache
+// =============================================================================
+
+typedef struct PageBench {
+    PageNode *page;
+    LayoutNode *layout;
+} PageBench;
+
+static void benchGenerateFullPage(void *data) {
+    PageBench *bench = data;
+    Arena *arena = benchArena();
+    arenaReset(arena);
+
+    json_t *pipelineResult = json_pack("{s:s, s:[{s:i, s:s}, {s:i, s:s}]}",
+        "title", "Benchmark", "rows", "id", 1, "name", "alpha", "id", 2, "name", "beta");
+    generateFullPage(arena, bench->page, bench->layout, pipelineResult);
+}
+
+static void runMustacheBenchmarks(void) {
+    ServerContext *ctx = benchServer();
+    PageBench bench = {0};
+
+    // First page whose layout resolves, as handlePageRequest would render it
+    for (PageNode *page = ctx->website->pageHead; page; page = page->next) {
+        LayoutNode *layout = findLayout(page->layout);
+        if (layout && page->template) {
+            bench.page = page;
+            bench.layout = layout;
+            break;
+        }
+    }
+    if (!bench.page) {
+        fprintf(stderr, "No page with a layout in %s, skipping mustache\n", benchAppPath());
+        return;
+    }
+
+    benchRun("mustache/generateFullPage", benchGenerateFullPage, &bench);
+}
+
+// =============================================================================
+// Database Results
+// =============================================================================
+
+typedef struct ResultBench {
+    PGresult *result;
+    const char *sql;
+} ResultBench;
+
+static void benchResultToJson(void *data) {
+    ResultBench *bench = data;
+    arenaReset(benchArena());
+    resultToJson(bench->result, bench->sql);
+}
+
+// A result set as PQexec would return it, without a database connection
+static PGresult* buildResult(void) {
+    PGresult *result = PQmakeEmptyPGresult(NULL, PGRES_TUPLES_OK);
+    if (!result) return NULL;
+
+    static char *names[RESULT_COLUMNS] = {
+        "id", "name", "email", "active", "score", "team", "created_at", "notes"
+    };
+    PGresAttDesc columns[RESULT_COLUMNS];
+    memset(columns, 0, sizeof(columns));
+    for (int j = 0; j < RESULT_COLUMNS; j++) {
+        columns[j].name = names[j];
+        columns[j].typid = 25;  // TEXTOID
+        columns[j].typlen = -1;
+        columns[j].atttypmod = -1;
+    }
+    columns[3].typid = 16;  // BOOLOID
+    columns[3].typlen = 1;
+
+    if (!PQsetResultAttrs(result, RESULT_COLUMNS, columns)) {
+        PQclear(result);
+        return NULL;
+    }
+
+    for (int i = 0; i < RESULT_ROWS; i++) {
+        char values[RESULT_COLUMNS][48];
+        snprintf(values[0], sizeof(values[0]), "%d", i);
+        snprintf(values[1], sizeof(values[1]), "user-%d", i);
+        snprintf(values[2], sizeof(values[2]), "user-%d@example.com", i);
+        snprintf(values[3], sizeof(values[3]), "%s", i % 3 ? "t" : "f");
+        snprintf(values[4], sizeof(values[4]), "%.2f", (double)i * 1.5);
+        snprintf(values[5], sizeof(values[5]), "engineering");
+        snprintf(values[6], sizeof(values[6]), "2024-01-01 00:00:%02d", i % 60);
+        for (int j = 0; j < RESULT_COLUMNS; j++) {
+            // Every fifth row has a NULL notes column
+            if (j == 7 && i % 5 == 0) {
+                PQsetvalue(result, i, j, NULL, -1);
+                continue;
+            }
+            if (j == 7) snprintf(values[7], sizeof(values[7]), "note %d", i);
+            PQsetvalue(result, i, j, values[j], (int)strlen(values[j]));
+        }
+    }
+    return result;
+}
+
+static void runDbBenchmarks(void) {
+    ResultBench bench = {0};
+    bench.result = buildResult();
+    bench.sql = "SELECT * FROM users";
+    if (!bench.result) {
+        fputs("Failed to build synthetic PGresult, skipping db\n", stderr);
+        return;
+    }
+
+    benchRun("db/resultToJson", benchResultToJson, &bench);
+    PQclear(bench.result);
+}
+
+// =============================================================================
+// Routing
+// =============================================================================
+
+typedef struct RouteBench {
+    const char *url;
+} RouteBench;
+
+static void benchFindRoute(void *data) {
+    RouteBench *bench = data;
+    arenaReset(benchArena());
+    findRoute(bench->url, "GET", benchArena());
+}
+
+// Replaces the route maps built for the app, so this group runs last
+static void runRoutingBenchmarks(void) {
+    Arena *routeArena = createArena(1024 * 1024);
+    WebsiteNode website = {0};
+
+    // Prepend, so the route looked up below is the last one matched
+    for (int i = SYNTHETIC_ROUTES - 1; i >= 0; i--) {
+        ApiEndpoint *api = arenaAlloc(routeArena, sizeof(ApiEndpoint));
+        memset(api, 0, sizeof(ApiEndpoint));
+        char route[64];
+        snprintf(route, sizeof(route), "/api/v1/resource%d/:id", i);
+        api->route = arenaDupString(routeArena, route);
+        api->method = "GET";
+        api->next = website.apiHead;
+        website.apiHead = api;
+    }
+    buildRouteMaps(&website, routeArena);
+
+    char url[64];
+    snprintf(url, sizeof(url), "/api/v1/resource%d/42", SYNTHETIC_ROUTES - 1);
+    RouteBench bench = { .url = url };
+    benchRun("routing/findRoute", benchFindRoute, &bench);
+
+    bench.url = "/api/v1/missing/42";
+    benchRun("routing/findRoute-miss", benchFindRoute, &bench);
+
+    freeArena(routeArena);
+}
+
+void run_server_benchmarks(void) {
+    benchUseJsonArena();
+    runMustacheBenchmarks();
+    runDbBenchmarks();
+    runRoutingBenchmarks();
+}
@@ -17,6 +17,7 @@ Arena* createArena(size_t size) {
     
     arena->size = size;
     arena->used = 0;
+    arena->allocations = 0;
     
     // Register the arena as a memory pool with Valgrind
     VALGRIND_CREATE_MEMPOOL(arena, 0, 0);
@@ -40,6 +41,7 @@ void* arenaAlloc(Arena *arena, size_t size) {
     
     void *ptr = arena->buffer + arena->used;
     arena->used += size;
+    arena->allocations++;
     
     // Tell Valgrind this memory is now allocated and undefined
     VALGRIND_MEMPOOL_ALLOC(arena, ptr, size);
@@ -62,6 +64,15 @@ char* arenaDupString(Arena *arena, const char *str) {
     return dup;
 }
 
+void arenaReset(Arena *arena) {
+    // Recreate the pool so Valgrind forgets the old allocations
+    VALGRIND_DESTROY_MEMPOOL(arena);
+    VALGRIND_CREATE_MEMPOOL(arena, 0, 0);
+    VALGRIND_MAKE_MEM_NOACCESS(arena->buffer, arena->size);
+    arena->used = 0;
+    arena->allocations = 0;
+}
+
 void freeArena(Arena *arena) {
     // Tell Valgrind we're freeing the entire pool
     VALGRIND_DESTROY_MEMPOOL(arena);
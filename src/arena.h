@@ -19,11 +19,13 @@ typedef struct {
     char *buffer;
     size_t size;
     size_t used;
+    size_t allocations;  // arenaAlloc calls, reported per route by metrics
 } Arena;
 
 Arena* createArena(size_t size);
 void* arenaAlloc(Arena *arena, size_t size);
 char* arenaDupString(Arena *arena, const char *str);
+void arenaReset(Arena *arena);  // Drop all allocations, keep the buffer
 void freeArena(Arena *arena);
 
 #endif // ARENA_H
@@ -53,6 +53,9 @@ typedef struct PageNode {
     ResponseBlockNode *successBlock;  // New success block structure
     struct PipelineStepNode *pipeline;
     struct PipelineStepNode *referenceData;  // Reference data pipeline
+    struct LayoutNode *resolvedLayout;       // Set by linkWebsite
+    uint32_t luaBudget;      // Lua instructions per step, 0 for the default
+    uint8_t _padding[4];
     struct PageNode *next;
 } PageNode;
 
@@ -121,6 +124,14 @@ typedef struct PipelineStepNode {
     bool is_dynamic;      // For SQL steps (1 byte)
     uint8_t _padding[3];  // Explicit padding (3 bytes)
     struct PipelineStepNode *next;  // Next step in pipeline (8 bytes)
+    struct NativeJq *nativeJq;      // Native jq evaluator, set at load time (8 bytes)
+    struct json_t *constant;        // Output folded at load time, if input-independent (8 bytes)
+    // Resolved by linkWebsite so requests skip the name lookups
+    const char *resolvedCode;       // Query SQL, script or transform source (8 bytes)
+    const unsigned char *luaBytecode;  // Compiled Lua chunk (8 bytes)
+    size_t luaBytecodeLength;       // (8 bytes)
+    uint32_t jqProgram;             // Load-time jq program id, 0 if none (4 bytes)
+    uint32_t luaBudget;             // Instruction budget from the route, 0 for the default (4 bytes)
 } PipelineStepNode;
 
 typedef struct ApiEndpoint {
@@ -128,7 +139,8 @@ typedef struct ApiEndpoint {
     char *method;
     PipelineStepNode *pipeline;
     bool uses_pipeline;  // Flag to indicate which union member to use
-    uint8_t _padding[7];
+    uint8_t _padding[3];
+    uint32_t luaBudget;  // Lua instructions per step, 0 for the default
     ResponseField *fields;
     ApiField *apiFields;
     struct ApiEndpoint *next;
@@ -187,6 +199,14 @@ typedef struct PartialNode {
     struct PartialNode *next;
 } PartialNode;
 
+typedef struct StaticNode {
+    char *route;     // URL prefix, e.g. "/assets"
+    char *dir;       // Directory on disk served under route
+    int maxAge;      // Cache-Control max-age in seconds
+    uint64_t : 32;
+    struct StaticNode *next;
+} StaticNode;
+
 typedef struct GithubNode {
     Value clientId;     // Can be string or env var
     Value clientSecret; // Can be string or env var
@@ -232,6 +252,7 @@ typedef struct WebsiteNode {
     TransformNode *transformHead;
     ScriptNode *scriptHead;
     PartialNode *partialHead;
+    StaticNode *staticHead;
     RouteMap *routeMap;
     LayoutMap *layoutMap;
     IncludeNode *includeHead;
@@ -0,0 +1,327 @@
+#include "bench.h"
+#include "loadgen.h"
+#include "website.h"
+#include "server/server.h"
+#include "server/metrics.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <getopt.h>
+#include <pthread.h>
+#include "../deps/dotenv-c/dotenv.h"
+
+#define BENCH_DEFAULT_CONCURRENCY 64
+#define BENCH_MAX_CONCURRENCY 4096
+#define BENCH_DEFAULT_DURATION "10s"
+#define BENCH_STEP_TYPES 4
+
+typedef struct BenchWorker {
+    pthread_t thread;
+    const char *request;
+    size_t requestLength;
+    uint64_t deadline;
+    uint16_t port;
+    uint64_t : 48;
+    LatencySamples latencies;
+    uint64_t failures;           // Connection or protocol errors
+    uint64_t statusClasses[6];   // 1xx..5xx by index, 0 for anything else
+} BenchWorker;
+
+typedef struct StepBreakdown {
+    char type[16];
+    double count;
+    double sum;
+    double p50;
+    double p99;
+    double p999;
+} StepBreakdown;
+
+static void printBenchUsage(void) {
+    fprintf(stderr, "Usage: webdsl bench <file.webdsl> [options]\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  --route PATH        Route to request (default /)\n");
+    fprintf(stderr, "  --method METHOD     HTTP method (default GET)\n");
+    fprintf(stderr, "  --body JSON         Request body, sent as application/json\n");
+    fprintf(stderr, "  --concurrency N     Keep-alive connections, one thread each (default %d)\n",
+            BENCH_DEFAULT_CONCURRENCY);
+    fprintf(stderr, "  --duration TIME     Run time, e.g. 30s, 500ms, 2m (default %s)\n",
+            BENCH_DEFAULT_DURATION);
+    fprintf(stderr, "  --port N            Override the port from the website block\n");
+}
+
+static void* benchWorker(void *arg) {
+    BenchWorker *worker = arg;
+    LoadConnection conn = {.fd = -1};
+
+    if (!loadConnect(&conn, worker->port)) {
+        worker->failures++;
+        loadClose(&conn);
+        return NULL;
+    }
+
+    while (metricsNow() < worker->deadline) {
+        uint64_t start = metricsNow();
+        int status = loadRequest(&conn, worker->request, worker->requestLength, NULL, NULL);
+        uint64_t elapsed = metricsNow() - start;
+
+        if (status < 0) {
+            worker->failures++;
+            continue;
+        }
+        latencyAdd(&worker->latencies, elapsed);
+        int statusClass = status / 100;
+        worker->statusClasses[statusClass >= 1 && statusClass <= 5 ? statusClass : 0]++;
+    }
+
+    loadClose(&conn);
+    return NULL;
+}
+
+static char* buildRequest(const char *method, const char *route, const char *body, uint16_t port, size_t *length) {
+    size_t bodyLength = body ? strlen(body) : 0;
+    size_t capacity = strlen(method) + strlen(route) + bodyLength + 256;
+    char *request = malloc(capacity);
+    if (!request) return NULL;
+
+    int written;
+    if (body) {
+        written = snprintf(request, capacity,
+            "%s %s HTTP/1.1\r\nHost: 127.0.0.1:%u\r\nUser-Agent: webdsl-bench\r\n"
+            "Content-Type: application/json\r\nContent-Length: %zu\r\n\r\n%s",
+            method, route, port, bodyLength, body);
+    } else {
+        written = snprintf(request, capacity,
+            "%s %s HTTP/1.1\r\nHost: 127.0.0.1:%u\r\nUser-Agent: webdsl-bench\r\n\r\n",
+            method, route, port);
+    }
+    *length = (size_t)written;
+    return request;
+}
+
+// =============================================================================
+// Step Breakdown
+// =============================================================================
+
+static bool labelValue(const char *line, const char *label, char *out, size_t size) {
+    char key[32];
+    snprintf(key, sizeof(key), "%s=\"", label);
+    const char *start = strstr(line, key);
+    if (!start) return false;
+    start += strlen(key);
+    const char *end = strchr(start, '"');
+    if (!end || (size_t)(end - start) >= size) return false;
+    memcpy(out, start, (size_t)(end - start));
+    out[end - start] = '\0';
+    return true;
+}
+
+static StepBreakdown* findStep(StepBreakdown *steps, size_t *count, const char *type) {
+    for (size_t i = 0; i < *count; i++) {
+        if (strcmp(steps[i].type, type) == 0) return &steps[i];
+    }
+    if (*count == BENCH_STEP_TYPES) return NULL;
+    StepBreakdown *step = &steps[(*count)++];
+    memset(step, 0, sizeof(StepBreakdown));
+    snprintf(step->type, sizeof(step->type), "%s", type);
+    return step;
+}
+
+static void printStepBreakdown(char *metrics) {
+    StepBreakdown steps[BENCH_STEP_TYPES];
+    size_t count = 0;
+
+    for (char *line = strtok(metrics, "\n"); line; line = strtok(NULL, "\n")) {
+        bool isCount = strncmp(line, "webdsl_step_duration_seconds_count{", 35) == 0;
+        bool isSum = strncmp(line, "webdsl_step_duration_seconds_sum{", 33) == 0;
+        bool isQuantile = strncmp(line, "webdsl_step_duration_quantile_seconds{", 38) == 0;
+        if (!isCount && !isSum && !isQuantile) continue;
+
+        char type[16];
+        const char *valueStart = strrchr(line, ' ');
+        if (!labelValue(line, "type", type, sizeof(type)) || !valueStart) continue;
+        StepBreakdown *step = findStep(steps, &count, type);
+        if (!step) continue;
+        double value = strtod(valueStart + 1, NULL);
+
+        if (isCount) {
+            step->count = value;
+        } else if (isSum) {
+            step->sum = value;
+        } else {
+            char quantile[16];
+            if (!labelValue(line, "quantile", quantile, sizeof(quantile))) continue;
+            if (strcmp(quantile, "0.5") == 0) step->p50 = value;
+            else if (strcmp(quantile, "0.99") == 0) step->p99 = value;
+            else if (strcmp(quantile, "0.999") == 0) step->p999 = value;
+        }
+    }
+
+    printf("\nPipeline steps (from /metrics)\n");
+    printf("%-12s %10s %10s %10s %10s %10s\n", "type", "count", "mean ms", "p50 ms", "p99 ms", "p999 ms");
+    bool any = false;
+    for (size_t i = 0; i < count; i++) {
+        if (steps[i].count == 0) continue;
+        any = true;
+        printf("%-12s %10.0f %10.3f %10.3f %10.3f %10.3f\n", steps[i].type, steps[i].count,
+               steps[i].sum / steps[i].count * 1e3, steps[i].p50 * 1e3,
+               steps[i].p99 * 1e3, steps[i].p999 * 1e3);
+    }
+    if (!any) {
+        printf("(no pipeline steps ran)\n");
+    }
+}
+
+static void dumpMetrics(uint16_t port) {
+    LoadConnection conn = {.fd = -1};
+    size_t length;
+    char *request = buildRequest("GET", "/metrics", NULL, port, &length);
+    char *body = NULL;
+
+    if (request && loadConnect(&conn, port) &&
+        loadRequest(&conn, request, length, &body, NULL) == 200) {
+        printStepBreakdown(body);
+    } else {
+        fprintf(stderr, "Failed to read /metrics\n");
+    }
+
+    free(body);
+    free(request);
+    loadClose(&conn);
+}
+
+// =============================================================================
+// Entry Point
+// =============================================================================
+
+int runBench(int argc, char *argv[]) {
+    static struct option long_options[] = {
+        {"route", required_argument, 0, 'r'},
+        {"method", required_argument, 0, 'm'},
+        {"body", required_argument, 0, 'b'},
+        {"concurrency", required_argument, 0, 'c'},
+        {"duration", required_argument, 0, 'd'},
+        {"port", required_argument, 0, 'p'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    const char *route = "/";
+    const char *method = "GET";
+    const char *body = NULL;
+    const char *durationText = BENCH_DEFAULT_DURATION;
+    long concurrency = BENCH_DEFAULT_CONCURRENCY;
+    long portOverride = 0;
+    int c;
+
+    optind = 1;
+    while ((c = getopt_long(argc, argv, "r:m:b:c:d:p:h", long_options, NULL)) != -1) {
+        switch (c) {
+            case 'r': route = optarg; break;
+            case 'm': method = optarg; break;
+            case 'b': body = optarg; break;
+            case 'c': concurrency = strtol(optarg, NULL, 10); break;
+            case 'd': durationText = optarg; break;
+            case 'p': portOverride = strtol(optarg, NULL, 10); break;
+            case 'h':
+                printBenchUsage();
+                return 0;
+            default:
+                printBenchUsage();
+                return 64;
+        }
+    }
+
+    uint64_t durationNs = parseDuration(durationText);
+    if (optind >= argc || durationNs == 0 || concurrency < 1 || concurrency > BENCH_MAX_CONCURRENCY ||
+        portOverride < 0 || portOverride > 65535 || route[0] != '/') {
+        printBenchUsage();
+        return 64;
+    }
+    const char *webdslPath = argv[optind];
+
+    env_load(".", true);
+    // Keep per-request logging out of the measurement unless asked for
+    setenv("WEBDSL_ACCESS_LOG_SAMPLE_RATE", "0", 0);
+    signal(SIGPIPE, SIG_IGN);
+
+    Parser parser = {0};
+    WebsiteNode *website = parseWebsite(&parser, webdslPath);
+    if (!website) {
+        if (parser.arena) freeArena(parser.arena);
+        return 1;
+    }
+    if (portOverride > 0) {
+        website->port = makeNumber((int)portOverride);
+    }
+    int portNumber = 8080;
+    if (website->port.type != VALUE_NULL) {
+        resolveNumber(&website->port, &portNumber);
+    }
+    uint16_t port = (uint16_t)portNumber;
+
+    if (!startServer(website, parser.arena)) {
+        freeArena(parser.arena);
+        return 1;
+    }
+
+    size_t requestLength;
+    char *request = buildRequest(method, route, body, port, &requestLength);
+    BenchWorker *workers = calloc((size_t)concurrency, sizeof(BenchWorker));
+    if (!request || !workers) {
+        fprintf(stderr, "Failed to allocate benchmark workers\n");
+        free(request);
+        free(workers);
+        stopServer();
+        freeArena(parser.arena);
+        return 1;
+    }
+
+    printf("Benchmarking %s %s on port %u: %ld connections for %s\n",
+           method, route, port, concurrency, durationText);
+
+    uint64_t start = metricsNow();
+    uint64_t deadline = start + durationNs;
+    long started = 0;
+    for (long i = 0; i < concurrency; i++) {
+        workers[i].request = request;
+        workers[i].requestLength = requestLength;
+        workers[i].deadline = deadline;
+        workers[i].port = port;
+        if (pthread_create(&workers[i].thread, NULL, benchWorker, &workers[i]) != 0) {
+            fprintf(stderr, "Failed to start worker %ld\n", i);
+            break;
+        }
+        started++;
+    }
+
+    LatencySamples all = {0};
+    uint64_t failures = 0;
+    uint64_t statusClasses[6] = {0};
+    for (long i = 0; i < started; i++) {
+        pthread_join(workers[i].thread, NULL);
+        latencyMerge(&all, &workers[i].latencies);
+        latencyFree(&workers[i].latencies);
+        failures += workers[i].failures;
+        for (int s = 0; s < 6; s++) statusClasses[s] += workers[i].statusClasses[s];
+    }
+    double seconds = (double)(metricsNow() - start) / 1e9;
+
+    latencySort(&all);
+    printf("\n");
+    printLatencySummary(route, &all, seconds);
+    printf("status: 2xx %llu  3xx %llu  4xx %llu  5xx %llu  other %llu  failed %llu\n",
+           (unsigned long long)statusClasses[2], (unsigned long long)statusClasses[3],
+           (unsigned long long)statusClasses[4], (unsigned long long)statusClasses[5],
+           (unsigned long long)(statusClasses[0] + statusClasses[1]), (unsigned long long)failures);
+
+    dumpMetrics(port);
+
+    int exitCode = all.count > 0 ? 0 : 1;
+    latencyFree(&all);
+    free(workers);
+    free(request);
+    stopServer();
+    freeArena(parser.arena);
+    return exitCode;
+}
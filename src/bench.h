@@ -0,0 +1,9 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+// Run `webdsl bench <file> [options]`: start the app in-process, load a
+// route over loopback and report throughput, latency and step breakdown.
+// argv[0] is "bench". Returns a process exit code.
+int runBench(int argc, char *argv[]);
+
+#endif // BENCH_H
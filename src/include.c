@@ -177,6 +177,16 @@ bool processInclude(Parser *parser, WebsiteNode *website, const char *filepath,
                 current->next = included->partialHead;
             }
         }
+
+        if (included->staticHead) {
+            if (!website->staticHead) {
+                website->staticHead = included->staticHead;
+            } else {
+                StaticNode *current = website->staticHead;
+                while (current->next) current = current->next;
+                current->next = included->staticHead;
+            }
+        }
         
         return true;
     }
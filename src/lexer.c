@@ -231,6 +231,10 @@ static TokenType checkKeyword(const char *start, size_t length) {
     KW_MATCH("apiKey", TOKEN_API_KEY)
     KW_MATCH("template", TOKEN_TEMPLATE)
     KW_MATCH("subject", TOKEN_SUBJECT)
+    KW_MATCH("static", TOKEN_STATIC)
+    KW_MATCH("dir", TOKEN_DIR)
+    KW_MATCH("maxAge", TOKEN_MAX_AGE)
+    KW_MATCH("luaBudget", TOKEN_LUA_BUDGET)
 
     return TOKEN_UNKNOWN;
 #undef KW_MATCH
@@ -496,6 +500,10 @@ const char* getTokenTypeName(TokenType type) {
         case TOKEN_API_KEY: return "API_KEY";
         case TOKEN_TEMPLATE: return "TEMPLATE";
         case TOKEN_SUBJECT: return "SUBJECT";
+        case TOKEN_STATIC: return "STATIC";
+        case TOKEN_DIR: return "DIR";
+        case TOKEN_MAX_AGE: return "MAX_AGE";
+        case TOKEN_LUA_BUDGET: return "LUA_BUDGET";
     }
     return "INVALID";
 }
@@ -50,6 +50,10 @@ typedef enum {
     TOKEN_API_KEY,
     TOKEN_TEMPLATE,
     TOKEN_SUBJECT,
+    TOKEN_STATIC,
+    TOKEN_DIR,
+    TOKEN_MAX_AGE,
+    TOKEN_LUA_BUDGET,
 
     TOKEN_STRING,
     TOKEN_OPEN_BRACE,
@@ -0,0 +1,351 @@
+#include "loadgen.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#define LOAD_BUFFER_INITIAL (64 * 1024)
+#define LOAD_MAX_RESPONSE (64 * 1024 * 1024)
+
+// =============================================================================
+// Connection
+// =============================================================================
+
+bool loadConnect(LoadConnection *conn, uint16_t port) {
+    conn->port = port;
+    conn->start = 0;
+    conn->end = 0;
+    if (!conn->buffer) {
+        conn->buffer = malloc(LOAD_BUFFER_INITIAL);
+        if (!conn->buffer) return false;
+        conn->capacity = LOAD_BUFFER_INITIAL;
+    }
+
+    conn->fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (conn->fd < 0) return false;
+
+    int one = 1;
+    setsockopt(conn->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(conn->fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(conn->fd);
+        conn->fd = -1;
+        return false;
+    }
+    return true;
+}
+
+void loadClose(LoadConnection *conn) {
+    if (conn->fd >= 0) {
+        close(conn->fd);
+        conn->fd = -1;
+    }
+    free(conn->buffer);
+    conn->buffer = NULL;
+    conn->capacity = 0;
+}
+
+static bool reconnect(LoadConnection *conn) {
+    if (conn->fd >= 0) {
+        close(conn->fd);
+        conn->fd = -1;
+    }
+    return loadConnect(conn, conn->port);
+}
+
+static bool sendAll(int fd, const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t sent = send(fd, data, length, 0);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += sent;
+        length -= (size_t)sent;
+    }
+    return true;
+}
+
+// Read more bytes into the buffer. Returns false on EOF or error.
+static bool fill(LoadConnection *conn) {
+    if (conn->start > 0 && conn->start == conn->end) {
+        conn->start = conn->end = 0;
+    }
+    if (conn->end == conn->capacity) {
+        if (conn->start > 0) {
+            memmove(conn->buffer, conn->buffer + conn->start, conn->end - conn->start);
+            conn->end -= conn->start;
+            conn->start = 0;
+        } else {
+            if (conn->capacity >= LOAD_MAX_RESPONSE) return false;
+            char *grown = realloc(conn->buffer, conn->capacity * 2);
+            if (!grown) return false;
+            conn->buffer = grown;
+            conn->capacity *= 2;
+        }
+    }
+
+    for (;;) {
+        ssize_t received = recv(conn->fd, conn->buffer + conn->end, conn->capacity - conn->end, 0);
+        if (received > 0) {
+            conn->end += (size_t)received;
+            return true;
+        }
+        if (received < 0 && errno == EINTR) continue;
+        return false;
+    }
+}
+
+// Make at least `length` unread bytes available
+static bool require(LoadConnection *conn, size_t length) {
+    while (conn->end - conn->start < length) {
+        if (!fill(conn)) return false;
+    }
+    return true;
+}
+
+// Find the CR of the next CRLF-terminated line, filling as needed
+static bool readLine(LoadConnection *conn, size_t *lineEnd) {
+    size_t offset = 0;  // Unread bytes already scanned
+    for (;;) {
+        for (size_t i = conn->start + offset; i + 1 < conn->end; i++) {
+            if (conn->buffer[i] == '\r' && conn->buffer[i + 1] == '\n') {
+                *lineEnd = i;
+                return true;
+            }
+        }
+        size_t unread = conn->end - conn->start;
+        offset = unread > 0 ? unread - 1 : 0;
+        if (!fill(conn)) return false;
+    }
+}
+
+static bool appendBody(char **body, size_t *length, size_t *capacity, const char *data, size_t size) {
+    if (!body) return true;
+    if (*length + size + 1 > *capacity) {
+        size_t newCapacity = *capacity ? *capacity : 1024;
+        while (*length + size + 1 > newCapacity) newCapacity *= 2;
+        char *grown = realloc(*body, newCapacity);
+        if (!grown) return false;
+        *body = grown;
+        *capacity = newCapacity;
+    }
+    memcpy(*body + *length, data, size);
+    *length += size;
+    (*body)[*length] = '\0';
+    return true;
+}
+
+static bool readBytes(LoadConnection *conn, size_t size, char **body, size_t *length, size_t *capacity) {
+    while (size > 0) {
+        if (conn->start == conn->end && !fill(conn)) return false;
+        size_t available = conn->end - conn->start;
+        size_t take = available < size ? available : size;
+        if (!appendBody(body, length, capacity, conn->buffer + conn->start, take)) return false;
+        conn->start += take;
+        size -= take;
+    }
+    return true;
+}
+
+static int readResponse(LoadConnection *conn, bool headRequest, char **body, size_t *bodyLength) {
+    size_t lineEnd;
+    if (!readLine(conn, &lineEnd)) return -1;
+
+    // Status line: HTTP/1.1 200 OK
+    const char *line = conn->buffer + conn->start;
+    if (lineEnd - conn->start < 12 || strncmp(line, "HTTP/1.", 7) != 0) return -1;
+    int status = atoi(line + 9);
+    conn->start = lineEnd + 2;
+
+    long long contentLength = -1;
+    bool chunked = false;
+    bool closeAfter = false;
+
+    for (;;) {
+        if (!readLine(conn, &lineEnd)) return -1;
+        char *header = conn->buffer + conn->start;
+        size_t headerLength = lineEnd - conn->start;
+        conn->start = lineEnd + 2;
+        if (headerLength == 0) break;
+
+        header[headerLength] = '\0';  // Overwrites the consumed CR
+        if (strncasecmp(header, "Content-Length:", 15) == 0) {
+            contentLength = strtoll(header + 15, NULL, 10);
+        } else if (strncasecmp(header, "Transfer-Encoding:", 18) == 0) {
+            chunked = strstr(header + 18, "chunked") != NULL;
+        } else if (strncasecmp(header, "Connection:", 11) == 0) {
+            const char *value = header + 11;
+            while (*value == ' ') value++;
+            closeAfter = strncasecmp(value, "close", 5) == 0;
+        }
+    }
+
+    char *data = NULL;
+    size_t length = 0;
+    size_t capacity = 0;
+    char **out = body ? &data : NULL;
+    bool ok = true;
+
+    if (headRequest || status == 204 || status == 304 || (status >= 100 && status < 200)) {
+        // No body
+    } else if (chunked) {
+        for (;;) {
+            if (!readLine(conn, &lineEnd)) { ok = false; break; }
+            size_t chunkSize = strtoul(conn->buffer + conn->start, NULL, 16);
+            conn->start = lineEnd + 2;
+            if (chunkSize == 0) {
+                // Skip trailers up to the terminating empty line
+                for (;;) {
+                    if (!readLine(conn, &lineEnd)) { ok = false; break; }
+                    bool empty = lineEnd == conn->start;
+                    conn->start = lineEnd + 2;
+                    if (empty) break;
+                }
+                break;
+            }
+            if (!readBytes(conn, chunkSize, out, &length, &capacity) || !require(conn, 2)) {
+                ok = false;
+                break;
+            }
+            conn->start += 2;
+        }
+    } else if (contentLength >= 0) {
+        ok = readBytes(conn, (size_t)contentLength, out, &length, &capacity);
+    } else {
+        // Body runs to connection close
+        for (;;) {
+            if (conn->start < conn->end) {
+                ok = appendBody(out, &length, &capacity, conn->buffer + conn->start, conn->end - conn->start);
+                conn->start = conn->end;
+                if (!ok) break;
+            }
+            if (!fill(conn)) break;
+        }
+        closeAfter = true;
+    }
+
+    if (!ok) {
+        free(data);
+        return -1;
+    }
+    if (body) {
+        *body = data ? data : calloc(1, 1);
+    }
+    if (bodyLength) {
+        *bodyLength = length;
+    }
+    if (closeAfter) {
+        close(conn->fd);
+        conn->fd = -1;
+    }
+    return status;
+}
+
+int loadRequest(LoadConnection *conn, const char *request, size_t length,
+                char **body, size_t *bodyLength) {
+    bool headRequest = strncmp(request, "HEAD ", 5) == 0;
+
+    for (int attempt = 0; attempt < 2; attempt++) {
+        if (conn->fd < 0 && !reconnect(conn)) {
+            return -1;
+        }
+        if (sendAll(conn->fd, request, length)) {
+            size_t before = conn->end - conn->start;
+            int status = readResponse(conn, headRequest, body, bodyLength);
+            // Only retry when nothing came back, i.e. the server dropped an idle connection
+            if (status >= 0 || before > 0 || conn->end > conn->start) {
+                if (status < 0) reconnect(conn);
+                return status;
+            }
+        }
+        if (!reconnect(conn)) {
+            return -1;
+        }
+    }
+    return -1;
+}
+
+// =============================================================================
+// Latency Samples
+// =============================================================================
+
+uint64_t parseDuration(const char *text) {
+    char *end;
+    double value = strtod(text, &end);
+    if (end == text || value <= 0) return 0;
+
+    double scale = 1e9;
+    if (*end == '\0' || strcmp(end, "s") == 0) {
+        scale = 1e9;
+    } else if (strcmp(end, "ms") == 0) {
+        scale = 1e6;
+    } else if (strcmp(end, "m") == 0) {
+        scale = 60e9;
+    } else {
+        return 0;
+    }
+    return (uint64_t)(value * scale);
+}
+
+void latencyAdd(LatencySamples *samples, uint64_t ns) {
+    if (samples->count == samples->capacity) {
+        size_t capacity = samples->capacity ? samples->capacity * 2 : 4096;
+        uint64_t *grown = realloc(samples->values, capacity * sizeof(uint64_t));
+        if (!grown) return;
+        samples->values = grown;
+        samples->capacity = capacity;
+    }
+    samples->values[samples->count++] = ns;
+}
+
+void latencyMerge(LatencySamples *into, const LatencySamples *from) {
+    for (size_t i = 0; i < from->count; i++) {
+        latencyAdd(into, from->values[i]);
+    }
+}
+
+void latencyFree(LatencySamples *samples) {
+    free(samples->values);
+    samples->values = NULL;
+    samples->count = 0;
+    samples->capacity = 0;
+}
+
+static int compareLatency(const void *a, const void *b) {
+    uint64_t left = *(const uint64_t *)a;
+    uint64_t right = *(const uint64_t *)b;
+    return (left > right) - (left < right);
+}
+
+void latencySort(LatencySamples *samples) {
+    if (samples->count > 1) {
+        qsort(samples->values, samples->count, sizeof(uint64_t), compareLatency);
+    }
+}
+
+uint64_t latencyPercentile(const LatencySamples *samples, double quantile) {
+    if (samples->count == 0) return 0;
+    size_t rank = (size_t)(quantile * (double)samples->count);
+    if (rank >= samples->count) rank = samples->count - 1;
+    return samples->values[rank];
+}
+
+void printLatencySummary(const char *label, const LatencySamples *samples, double seconds) {
+    printf("%-24s %8zu req %10.1f req/s  p50 %8.3fms  p99 %8.3fms  p999 %8.3fms  max %8.3fms\n",
+           label, samples->count, seconds > 0 ? (double)samples->count / seconds : 0.0,
+           (double)latencyPercentile(samples, 0.5) / 1e6,
+           (double)latencyPercentile(samples, 0.99) / 1e6,
+           (double)latencyPercentile(samples, 0.999) / 1e6,
+           samples->count ? (double)samples->values[samples->count - 1] / 1e6 : 0.0);
+}
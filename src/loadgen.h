@@ -0,0 +1,50 @@
+#ifndef LOADGEN_H
+#define LOADGEN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Minimal HTTP/1.1 keep-alive client for driving a local server
+typedef struct LoadConnection {
+    int fd;
+    uint16_t port;
+    uint64_t : 16;
+    char *buffer;
+    size_t capacity;
+    size_t start;   // First unread byte in buffer
+    size_t end;     // One past the last buffered byte
+} LoadConnection;
+
+// Latency samples in nanoseconds
+typedef struct LatencySamples {
+    uint64_t *values;
+    size_t count;
+    size_t capacity;
+} LatencySamples;
+
+bool loadConnect(LoadConnection *conn, uint16_t port);
+void loadClose(LoadConnection *conn);
+
+// Send a complete request and read the full response. Reconnects once if the
+// server closed an idle keep-alive connection. Returns the HTTP status, or -1
+// on a connection or protocol error. When body is non-NULL it receives a
+// malloc'd, NUL-terminated copy of the response body.
+int loadRequest(LoadConnection *conn, const char *request, size_t length,
+                char **body, size_t *bodyLength);
+
+// Parse "30s", "500ms", "2m" or a plain number of seconds. Returns 0 when invalid.
+uint64_t parseDuration(const char *text);
+
+void latencyAdd(LatencySamples *samples, uint64_t ns);
+void latencyMerge(LatencySamples *into, const LatencySamples *from);
+void latencyFree(LatencySamples *samples);
+
+// Sort once, then read any number of percentiles (0..1)
+void latencySort(LatencySamples *samples);
+uint64_t latencyPercentile(const LatencySamples *samples, double quantile);
+
+// Print count, rate and p50/p99/p999/max on one line
+void printLatencySummary(const char *label, const LatencySamples *samples, double seconds);
+
+#endif // LOADGEN_H
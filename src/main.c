@@ -12,6 +12,9 @@
 #include "website.h"
 #include "../deps/dotenv-c/dotenv.h"
 #include "migration.h"
+#include "bench.h"
+#include "replay.h"
+#include "server/artifact_cache.h"
 
 #define MAX_PATH_LENGTH 4096
 #define MAX_INCLUDES 100  // Maximum number of files to track
@@ -81,17 +84,22 @@ static void printUsage(const char* program) {
     fprintf(stderr, "Usage: %s [options] [path to .webdsl file]\n", program);
     fprintf(stderr, "Options:\n");
     fprintf(stderr, "  --json              Parse the .webdsl file and output AST as JSON\n");
+    fprintf(stderr, "  --no-cache          Compile Lua and jq without the on-disk artifact cache\n");
     fprintf(stderr, "  --help              Show this help message\n");
     fprintf(stderr, "\nMigration Commands:\n");
     fprintf(stderr, "  migrate up          Run all pending migrations\n");
     fprintf(stderr, "  migrate down        Roll back last migration\n");
     fprintf(stderr, "  migrate create NAME Create a new migration\n");
     fprintf(stderr, "  migrate status      Show migration status\n");
+    fprintf(stderr, "\nBenchmark:\n");
+    fprintf(stderr, "  bench FILE [options] Load a route in-process (see bench --help)\n");
+    fprintf(stderr, "  replay FILE [options] Replay captured requests (see replay --help)\n");
 }
 
 int main(int argc, char* argv[]) {
     static struct option long_options[] = {
         {"json", no_argument, 0, 'j'},
+        {"no-cache", no_argument, 0, 'n'},
         {"help", no_argument, 0, 'h'},
         {0, 0, 0, 0}
     };
@@ -100,11 +108,22 @@ int main(int argc, char* argv[]) {
     int option_index = 0;
     int c;
 
-    while ((c = getopt_long(argc, argv, "jh", long_options, &option_index)) != -1) {
+    // Subcommands with their own options are dispatched before global parsing
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        return runBench(argc - 1, argv + 1);
+    }
+    if (argc > 1 && strcmp(argv[1], "replay") == 0) {
+        return runReplay(argc - 1, argv + 1);
+    }
+
+    while ((c = getopt_long(argc, argv, "jnh", long_options, &option_index)) != -1) {
         switch (c) {
             case 'j':
                 json_output = true;
                 break;
+            case 'n':
+                disableArtifactCache();
+                break;
             case 'h':
                 printUsage(argv[0]);
                 return 0;
@@ -4,6 +4,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <limits.h>
 
 // Forward declarations
 static void advanceParser(Parser *parser);
@@ -29,6 +30,8 @@ static AuthNode* parseAuth(Parser *parser);
 static EmailNode* parseEmail(Parser *parser);
 static SendGridNode* parseSendGrid(Parser *parser);
 static EmailTemplateNode* parseEmailTemplate(Parser *parser);
+static StaticNode* parseStatic(Parser *parser);
+static uint32_t parseLuaBudget(Parser *parser);
 
 // Forward declaration of setupStepExecutor from api.c
 void setupStepExecutor(PipelineStepNode *step);
@@ -63,6 +66,27 @@ static char *copyString(Parser *parser, const char *source) {
     return arenaDupString(parser->arena, source);
 }
 
+// Parse the instruction count after 'luaBudget'
+static uint32_t parseLuaBudget(Parser *parser) {
+    advanceParser(parser);
+    consume(parser, TOKEN_NUMBER, "Expected number after 'luaBudget'");
+    if (parser->hadError) return 0;
+
+    char *end;
+    errno = 0;
+    unsigned long long budget = strtoull(parser->previous.lexeme, &end, 10);
+    if (*end != '\0' || errno != 0 || budget == 0 || budget > UINT32_MAX) {
+        char buffer[256] = {0};
+        snprintf(buffer, sizeof(buffer),
+                "Invalid luaBudget at line %d\n",
+                parser->previous.line);
+        fputs(buffer, stderr);
+        parser->hadError = 1;
+        return 0;
+    }
+    return (uint32_t)budget;
+}
+
 static TemplateNode *parseTemplate(Parser *parser, TokenType templateType) {
     TemplateNode *node = arenaAlloc(parser->arena, sizeof(TemplateNode));
     memset(node, 0, sizeof(TemplateNode));
@@ -222,6 +246,10 @@ static PageNode *parsePage(Parser *parser) {
                 page->referenceData = parsePipeline(parser);  // Reuse pipeline parser since structure is the same
                 break;
             }
+            case TOKEN_LUA_BUDGET: {
+                page->luaBudget = parseLuaBudget(parser);
+                break;
+            }
             default: {
                 char buffer[256] = {0};
                 snprintf(buffer, sizeof(buffer),
@@ -511,6 +539,10 @@ static ApiEndpoint *parseApi(Parser *parser) {
                 consume(parser, TOKEN_OPEN_BRACE, "Expected '{' after 'fields'.");
                 endpoint->apiFields = parseApiFields(parser);
                 break;
+
+            case TOKEN_LUA_BUDGET:
+                endpoint->luaBudget = parseLuaBudget(parser);
+                break;
                 
             default: {
                 char buffer[256] = {0};
@@ -1165,6 +1197,74 @@ static EmailNode* parseEmail(Parser *parser) {
     return email;
 }
 
+static StaticNode* parseStatic(Parser *parser) {
+    StaticNode *staticNode = arenaAlloc(parser->arena, sizeof(StaticNode));
+    memset(staticNode, 0, sizeof(StaticNode));
+    
+    consume(parser, TOKEN_OPEN_BRACE, "Expected '{' after 'static'");
+    
+    while (parser->current.type != TOKEN_CLOSE_BRACE && 
+           parser->current.type != TOKEN_EOF && 
+           !parser->hadError) {
+        #pragma clang diagnostic push
+        #pragma clang diagnostic ignored "-Wswitch-enum"
+        switch (parser->current.type) {
+            case TOKEN_ROUTE: {
+                advanceParser(parser);
+                consume(parser, TOKEN_STRING, "Expected string after 'route'");
+                staticNode->route = copyString(parser, parser->previous.lexeme);
+                break;
+            }
+            case TOKEN_DIR: {
+                advanceParser(parser);
+                consume(parser, TOKEN_STRING, "Expected string after 'dir'");
+                staticNode->dir = copyString(parser, parser->previous.lexeme);
+                break;
+            }
+            case TOKEN_MAX_AGE: {
+                advanceParser(parser);
+                consume(parser, TOKEN_NUMBER, "Expected number after 'maxAge'");
+                char *end;
+                long maxAge = strtol(parser->previous.lexeme, &end, 10);
+                if (*end != '\0' || maxAge < 0 || maxAge > INT_MAX) {
+                    char buffer[256] = {0};
+                    snprintf(buffer, sizeof(buffer),
+                            "Invalid maxAge at line %d\n",
+                            parser->previous.line);
+                    fputs(buffer, stderr);
+                    parser->hadError = 1;
+                    break;
+                }
+                staticNode->maxAge = (int)maxAge;
+                break;
+            }
+            default: {
+                char buffer[256] = {0};
+                snprintf(buffer, sizeof(buffer),
+                        "Unexpected token in static block at line %d\n",
+                        parser->current.line);
+                fputs(buffer, stderr);
+                parser->hadError = 1;
+                break;
+            }
+        }
+        #pragma clang diagnostic pop
+    }
+    
+    // Validate required fields
+    if (!staticNode->route || staticNode->route[0] != '/') {
+        fputs("Static block must have a route starting with '/'\n", stderr);
+        parser->hadError = 1;
+    }
+    if (!staticNode->dir) {
+        fputs("Static block must have a dir\n", stderr);
+        parser->hadError = 1;
+    }
+    
+    consume(parser, TOKEN_CLOSE_BRACE, "Expected '}' after static block");
+    return staticNode;
+}
+
 static void parseWebsiteNode(Parser *parser, WebsiteNode *website) {
     while (parser->current.type != TOKEN_EOF && 
            parser->current.type != TOKEN_CLOSE_BRACE && 
@@ -1344,6 +1444,20 @@ static void parseWebsiteNode(Parser *parser, WebsiteNode *website) {
                 website->email = parseEmail(parser);
                 break;
             }
+            case TOKEN_STATIC: {
+                advanceParser(parser);
+                StaticNode *staticNode = parseStatic(parser);
+                if (!website->staticHead) {
+                    website->staticHead = staticNode;
+                } else {
+                    StaticNode *current = website->staticHead;
+                    while (current->next) {
+                        current = current->next;
+                    }
+                    current->next = staticNode;
+                }
+                break;
+            }
             default: {
                 char buffer[256] = {0};
                 snprintf(buffer, sizeof(buffer),
@@ -0,0 +1,516 @@
+#include "replay.h"
+#include "loadgen.h"
+#include "website.h"
+#include "server/server.h"
+#include "server/metrics.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <signal.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <jansson.h>
+#include "../deps/dotenv-c/dotenv.h"
+
+#define REPLAY_DEFAULT_CONCURRENCY 16
+#define REPLAY_MAX_CONCURRENCY 4096
+#define REPLAY_MAX_MISMATCHES_SHOWN 10
+#define REPLAY_MAX_ROUTES 64
+
+typedef struct ReplayWorker {
+    pthread_t thread;
+    ReplayEntry *entries;
+    size_t count;
+    _Atomic size_t *next;
+    uint64_t begin;
+    double rate;
+    uint16_t port;
+    uint64_t : 48;
+} ReplayWorker;
+
+typedef struct RouteLatency {
+    const char *label;
+    LatencySamples captured;
+    LatencySamples replayed;
+} RouteLatency;
+
+static void printReplayUsage(void) {
+    fprintf(stderr, "Usage: webdsl replay <requests.jsonl> [options]\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  --rate X            Replay speed relative to capture (default 1, 0 = as fast as possible)\n");
+    fprintf(stderr, "  --concurrency N     Keep-alive connections, one thread each (default %d)\n",
+            REPLAY_DEFAULT_CONCURRENCY);
+    fprintf(stderr, "  --port N            Port of the local instance (default 8080)\n");
+    fprintf(stderr, "  --app FILE          Start FILE in-process instead of using a running instance\n");
+}
+
+// =============================================================================
+// Parsing
+// =============================================================================
+
+static int base64Value(char c) {
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '+') return 62;
+    if (c == '/') return 63;
+    return -1;
+}
+
+// Decodes in place. Returns the decoded length, or -1 when invalid.
+static long base64Decode(char *data) {
+    size_t out = 0;
+    unsigned int bits = 0;
+    int bitCount = 0;
+    for (const char *p = data; *p && *p != '='; p++) {
+        int value = base64Value(*p);
+        if (value < 0) return -1;
+        bits = (bits << 6) | (unsigned int)value;
+        bitCount += 6;
+        if (bitCount >= 8) {
+            bitCount -= 8;
+            data[out++] = (char)((bits >> bitCount) & 0xff);
+        }
+    }
+    return (long)out;
+}
+
+// Headers the replay sets itself or that would break keep-alive framing
+static bool isSkippedHeader(const char *name) {
+    static const char *skipped[] = {
+        "Host", "Content-Length", "Transfer-Encoding", "Connection", "Keep-Alive", "Expect", "Upgrade"
+    };
+    for (size_t i = 0; i < sizeof(skipped) / sizeof(skipped[0]); i++) {
+        if (strcasecmp(name, skipped[i]) == 0) return true;
+    }
+    return false;
+}
+
+static bool appendRequest(char **request, size_t *length, size_t *capacity, const char *data, size_t size) {
+    if (*length + size > *capacity) {
+        size_t grown = *capacity ? *capacity * 2 : 1024;
+        while (grown < *length + size) grown *= 2;
+        char *buffer = realloc(*request, grown);
+        if (!buffer) return false;
+        *request = buffer;
+        *capacity = grown;
+    }
+    memcpy(*request + *length, data, size);
+    *length += size;
+    return true;
+}
+
+static bool appendText(char **request, size_t *length, size_t *capacity, const char *text) {
+    return appendRequest(request, length, capacity, text, strlen(text));
+}
+
+bool parseReplayEntry(const char *line, uint16_t port, ReplayEntry *entry) {
+    memset(entry, 0, sizeof(ReplayEntry));
+
+    json_error_t error;
+    json_t *root = json_loads(line, 0, &error);
+    if (!json_is_object(root)) {
+        json_decref(root);
+        return false;
+    }
+
+    const char *method = json_string_value(json_object_get(root, "method"));
+    const char *url = json_string_value(json_object_get(root, "url"));
+    const char *route = json_string_value(json_object_get(root, "route"));
+    json_t *headers = json_object_get(root, "headers");
+    json_t *body = json_object_get(root, "body");
+    json_t *bodyBase64 = json_object_get(root, "bodyBase64");
+    if (!method || !url || url[0] != '/' || json_is_true(json_object_get(root, "bodyTruncated")) ||
+        strpbrk(method, " \r\n") || strpbrk(url, " \r\n")) {
+        json_decref(root);
+        return false;
+    }
+
+    char *bodyData = NULL;
+    size_t bodyLength = 0;
+    if (json_is_string(body)) {
+        bodyLength = json_string_length(body);
+        bodyData = malloc(bodyLength + 1);
+        if (!bodyData) {
+            json_decref(root);
+            return false;
+        }
+        memcpy(bodyData, json_string_value(body), bodyLength + 1);
+    } else if (json_is_string(bodyBase64)) {
+        bodyData = strdup(json_string_value(bodyBase64));
+        long decoded = bodyData ? base64Decode(bodyData) : -1;
+        if (decoded < 0) {
+            free(bodyData);
+            json_decref(root);
+            return false;
+        }
+        bodyLength = (size_t)decoded;
+    }
+
+    char *request = NULL;
+    size_t length = 0;
+    size_t capacity = 0;
+    char startLine[128];
+    snprintf(startLine, sizeof(startLine), "\r\nHost: 127.0.0.1:%u\r\n", port);
+    bool ok = appendText(&request, &length, &capacity, method) &&
+              appendText(&request, &length, &capacity, " ") &&
+              appendText(&request, &length, &capacity, url) &&
+              appendText(&request, &length, &capacity, " HTTP/1.1") &&
+              appendText(&request, &length, &capacity, startLine);
+
+    const char *name;
+    json_t *value;
+    json_object_foreach(headers, name, value) {
+        const char *text = json_string_value(value);
+        if (!ok || !text || isSkippedHeader(name) || strpbrk(name, ":\r\n") || strpbrk(text, "\r\n")) {
+            continue;
+        }
+        ok = appendText(&request, &length, &capacity, name) &&
+             appendText(&request, &length, &capacity, ": ") &&
+             appendText(&request, &length, &capacity, text) &&
+             appendText(&request, &length, &capacity, "\r\n");
+    }
+
+    if (ok && bodyData) {
+        char contentLength[64];
+        snprintf(contentLength, sizeof(contentLength), "Content-Length: %zu\r\n", bodyLength);
+        ok = appendText(&request, &length, &capacity, contentLength);
+    }
+    ok = ok && appendText(&request, &length, &capacity, "\r\n");
+    if (ok && bodyData) {
+        ok = appendRequest(&request, &length, &capacity, bodyData, bodyLength);
+    }
+    free(bodyData);
+
+    size_t targetLength = strlen(method) + strlen(url) + 2;
+    entry->target = malloc(targetLength);
+    if (entry->target) snprintf(entry->target, targetLength, "%s %s", method, url);
+    entry->label = route ? strdup(route) : (entry->target ? strdup(entry->target) : NULL);
+    entry->request = request;
+    entry->requestLength = length;
+    entry->startMs = (int64_t)json_integer_value(json_object_get(root, "startMs"));
+    entry->capturedNs = (uint64_t)(json_number_value(json_object_get(root, "durationMs")) * 1e6);
+    entry->capturedStatus = (int)json_integer_value(json_object_get(root, "status"));
+    entry->status = -1;
+    json_decref(root);
+
+    if (!ok || !entry->target || !entry->label) {
+        freeReplayEntry(entry);
+        return false;
+    }
+    return true;
+}
+
+void freeReplayEntry(ReplayEntry *entry) {
+    free(entry->request);
+    free(entry->label);
+    free(entry->target);
+    entry->request = NULL;
+    entry->label = NULL;
+    entry->target = NULL;
+}
+
+static int compareStart(const void *a, const void *b) {
+    const ReplayEntry *left = a;
+    const ReplayEntry *right = b;
+    return (left->startMs > right->startMs) - (left->startMs < right->startMs);
+}
+
+static ReplayEntry* loadEntries(const char *path, uint16_t port, size_t *count) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return NULL;
+    }
+
+    ReplayEntry *entries = NULL;
+    size_t capacity = 0;
+    size_t skipped = 0;
+    char *line = NULL;
+    size_t lineCapacity = 0;
+    *count = 0;
+
+    while (getline(&line, &lineCapacity, file) > 0) {
+        if (*count == capacity) {
+            capacity = capacity ? capacity * 2 : 1024;
+            ReplayEntry *grown = realloc(entries, capacity * sizeof(ReplayEntry));
+            if (!grown) break;
+            entries = grown;
+        }
+        if (parseReplayEntry(line, port, &entries[*count])) {
+            (*count)++;
+        } else if (line[0] != '\n') {
+            skipped++;
+        }
+    }
+    free(line);
+    fclose(file);
+
+    if (skipped > 0) {
+        fprintf(stderr, "Skipped %zu invalid or truncated entries\n", skipped);
+    }
+    if (*count == 0) {
+        free(entries);
+        return NULL;
+    }
+
+    // Writer threads may record requests slightly out of order
+    qsort(entries, *count, sizeof(ReplayEntry), compareStart);
+    for (size_t i = 0; i < *count; i++) {
+        entries[i].offsetNs = (uint64_t)(entries[i].startMs - entries[0].startMs) * 1000000ull;
+    }
+    return entries;
+}
+
+// =============================================================================
+// Replay
+// =============================================================================
+
+static void sleepUntil(uint64_t target) {
+    uint64_t now = metricsNow();
+    if (now >= target) return;
+    uint64_t wait = target - now;
+    struct timespec duration = {(time_t)(wait / 1000000000ull), (long)(wait % 1000000000ull)};
+    nanosleep(&duration, NULL);
+}
+
+// Workers take entries in capture order and wait for each one's scheduled
+// time, so the request mix and pacing follow the capture
+static void* replayWorker(void *arg) {
+    ReplayWorker *worker = arg;
+    LoadConnection conn = {.fd = -1};
+    bool connected = loadConnect(&conn, worker->port);
+
+    for (;;) {
+        size_t i = atomic_fetch_add(worker->next, 1);
+        if (i >= worker->count) break;
+        ReplayEntry *entry = &worker->entries[i];
+
+        if (worker->rate > 0) {
+            sleepUntil(worker->begin + (uint64_t)((double)entry->offsetNs / worker->rate));
+        }
+        if (!connected) {
+            connected = loadConnect(&conn, worker->port);
+            if (!connected) continue;
+        }
+
+        uint64_t start = metricsNow();
+        entry->status = loadRequest(&conn, entry->request, entry->requestLength, NULL, NULL);
+        entry->latencyNs = metricsNow() - start;
+    }
+
+    loadClose(&conn);
+    return NULL;
+}
+
+static RouteLatency* findRouteLatency(RouteLatency *routes, size_t *count, const char *label) {
+    for (size_t i = 0; i < *count; i++) {
+        if (strcmp(routes[i].label, label) == 0) return &routes[i];
+    }
+    if (*count == REPLAY_MAX_ROUTES) return NULL;
+    RouteLatency *route = &routes[(*count)++];
+    memset(route, 0, sizeof(RouteLatency));
+    route->label = label;
+    return route;
+}
+
+static size_t printReport(ReplayEntry *entries, size_t count, double seconds, double rate) {
+    LatencySamples captured = {0};
+    LatencySamples replayed = {0};
+    RouteLatency routes[REPLAY_MAX_ROUTES];
+    size_t routeCount = 0;
+    size_t mismatches = 0;
+    size_t failures = 0;
+
+    printf("\nStatus differences\n");
+    for (size_t i = 0; i < count; i++) {
+        ReplayEntry *entry = &entries[i];
+        if (entry->status < 0) {
+            failures++;
+            continue;
+        }
+        latencyAdd(&captured, entry->capturedNs);
+        latencyAdd(&replayed, entry->latencyNs);
+        RouteLatency *route = findRouteLatency(routes, &routeCount, entry->label);
+        if (route) {
+            latencyAdd(&route->captured, entry->capturedNs);
+            latencyAdd(&route->replayed, entry->latencyNs);
+        }
+
+        if (entry->status != entry->capturedStatus) {
+            if (mismatches < REPLAY_MAX_MISMATCHES_SHOWN) {
+                printf("  %s: %d -> %d\n", entry->target, entry->capturedStatus, entry->status);
+            }
+            mismatches++;
+        }
+    }
+    if (mismatches > REPLAY_MAX_MISMATCHES_SHOWN) {
+        printf("  ... %zu more\n", mismatches - REPLAY_MAX_MISMATCHES_SHOWN);
+    }
+    printf("%zu of %zu responses matched the captured status, %zu failed\n",
+           count - failures - mismatches, count, failures);
+
+    double capturedSeconds = count > 1 ? (double)entries[count - 1].offsetNs / 1e9 : 0.0;
+    latencySort(&captured);
+    latencySort(&replayed);
+    printf("\n");
+    printLatencySummary("captured", &captured, capturedSeconds);
+    printLatencySummary(rate > 0 ? "replayed" : "replayed (max rate)", &replayed, seconds);
+
+    printf("\n%-40s %8s %12s %12s %12s %12s\n", "route", "count",
+           "cap p50 ms", "cap p99 ms", "rep p50 ms", "rep p99 ms");
+    for (size_t i = 0; i < routeCount; i++) {
+        latencySort(&routes[i].captured);
+        latencySort(&routes[i].replayed);
+        printf("%-40.40s %8zu %12.3f %12.3f %12.3f %12.3f\n", routes[i].label, routes[i].replayed.count,
+               (double)latencyPercentile(&routes[i].captured, 0.5) / 1e6,
+               (double)latencyPercentile(&routes[i].captured, 0.99) / 1e6,
+               (double)latencyPercentile(&routes[i].replayed, 0.5) / 1e6,
+               (double)latencyPercentile(&routes[i].replayed, 0.99) / 1e6);
+        latencyFree(&routes[i].captured);
+        latencyFree(&routes[i].replayed);
+    }
+
+    latencyFree(&captured);
+    latencyFree(&replayed);
+    return mismatches + failures;
+}
+
+static int replayAll(ReplayEntry *entries, size_t count, ReplayWorker *workers, long concurrency,
+                     double rate, uint16_t port, const char *capturePath) {
+    printf("Replaying %zu requests from %s on port %u", count, capturePath, port);
+    if (rate > 0) {
+        printf(" at %gx the captured rate (%ld connections)\n", rate, concurrency);
+    } else {
+        printf(" as fast as possible (%ld connections)\n", concurrency);
+    }
+
+    _Atomic size_t next = 0;
+    uint64_t begin = metricsNow();
+    long started = 0;
+    for (long i = 0; i < concurrency; i++) {
+        workers[i].entries = entries;
+        workers[i].count = count;
+        workers[i].next = &next;
+        workers[i].begin = begin;
+        workers[i].rate = rate;
+        workers[i].port = port;
+        if (pthread_create(&workers[i].thread, NULL, replayWorker, &workers[i]) != 0) {
+            fprintf(stderr, "Failed to start worker %ld\n", i);
+            break;
+        }
+        started++;
+    }
+    for (long i = 0; i < started; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+    double seconds = (double)(metricsNow() - begin) / 1e9;
+
+    if (started == 0) return 1;
+    return printReport(entries, count, seconds, rate) == 0 ? 0 : 1;
+}
+
+// =============================================================================
+// Entry Point
+// =============================================================================
+
+int runReplay(int argc, char *argv[]) {
+    static struct option long_options[] = {
+        {"rate", required_argument, 0, 'r'},
+        {"concurrency", required_argument, 0, 'c'},
+        {"port", required_argument, 0, 'p'},
+        {"app", required_argument, 0, 'a'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    double rate = 1.0;
+    long concurrency = REPLAY_DEFAULT_CONCURRENCY;
+    long portOption = 0;
+    const char *appPath = NULL;
+    int c;
+
+    optind = 1;
+    while ((c = getopt_long(argc, argv, "r:c:p:a:h", long_options, NULL)) != -1) {
+        switch (c) {
+            case 'r': rate = strtod(optarg, NULL); break;
+            case 'c': concurrency = strtol(optarg, NULL, 10); break;
+            case 'p': portOption = strtol(optarg, NULL, 10); break;
+            case 'a': appPath = optarg; break;
+            case 'h':
+                printReplayUsage();
+                return 0;
+            default:
+                printReplayUsage();
+                return 64;
+        }
+    }
+
+    if (optind >= argc || rate < 0 || concurrency < 1 || concurrency > REPLAY_MAX_CONCURRENCY ||
+        portOption < 0 || portOption > 65535) {
+        printReplayUsage();
+        return 64;
+    }
+    const char *capturePath = argv[optind];
+
+    signal(SIGPIPE, SIG_IGN);
+
+    Parser parser = {0};
+    WebsiteNode *website = NULL;
+    uint16_t port = portOption > 0 ? (uint16_t)portOption : 8080;
+    if (appPath) {
+        env_load(".", true);
+        setenv("WEBDSL_ACCESS_LOG_SAMPLE_RATE", "0", 0);
+        // Don't capture the replay into the file being replayed
+        unsetenv("WEBDSL_CAPTURE_FILE");
+
+        website = parseWebsite(&parser, appPath);
+        if (!website) {
+            if (parser.arena) freeArena(parser.arena);
+            return 1;
+        }
+        if (portOption > 0) {
+            website->port = makeNumber((int)portOption);
+        } else if (website->port.type != VALUE_NULL) {
+            int portNumber = 8080;
+            resolveNumber(&website->port, &portNumber);
+            port = (uint16_t)portNumber;
+        }
+    }
+
+    // Parsed before the server starts: request handling swaps jansson's allocator
+    size_t count = 0;
+    ReplayEntry *entries = loadEntries(capturePath, port, &count);
+    if (!entries) {
+        fprintf(stderr, "No requests to replay in %s\n", capturePath);
+        if (parser.arena) freeArena(parser.arena);
+        return 1;
+    }
+
+    if (appPath && !startServer(website, parser.arena)) {
+        for (size_t i = 0; i < count; i++) freeReplayEntry(&entries[i]);
+        free(entries);
+        freeArena(parser.arena);
+        return 1;
+    }
+
+    ReplayWorker *workers = calloc((size_t)concurrency, sizeof(ReplayWorker));
+    int exitCode = 1;
+    if (workers) {
+        exitCode = replayAll(entries, count, workers, concurrency, rate, port, capturePath);
+    } else {
+        fprintf(stderr, "Failed to allocate replay workers\n");
+    }
+
+    free(workers);
+    for (size_t i = 0; i < count; i++) freeReplayEntry(&entries[i]);
+    free(entries);
+    if (appPath) {
+        stopServer();
+        freeArena(parser.arena);
+    }
+    return exitCode;
+}
@@ -0,0 +1,32 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// One captured request, ready to send
+typedef struct ReplayEntry {
+    char *request;          // Complete HTTP/1.1 request
+    size_t requestLength;
+    char *label;            // Route when recorded, otherwise "METHOD url"
+    char *target;           // "METHOD url", for status diffs
+    int64_t startMs;        // Wall clock at capture
+    uint64_t offsetNs;      // Since the first captured request
+    uint64_t capturedNs;    // Duration at capture
+    int capturedStatus;
+    int status;             // Replayed status, -1 on failure
+    uint64_t latencyNs;
+} ReplayEntry;
+
+// Parse one line written by WEBDSL_CAPTURE_FILE into a request for
+// 127.0.0.1:port. Returns false for invalid lines and truncated bodies.
+bool parseReplayEntry(const char *line, uint16_t port, ReplayEntry *entry);
+void freeReplayEntry(ReplayEntry *entry);
+
+// Run `webdsl replay <requests.jsonl> [options]`: re-issue captured requests
+// at their original (or scaled) rate, diff status codes and report latency.
+// argv[0] is "replay". Returns a process exit code.
+int runReplay(int argc, char *argv[]);
+
+#endif // REPLAY_H
@@ -0,0 +1,292 @@
+#include "anonymous_session.h"
+#include "hmac.h"
+#include "db.h"
+#include "logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+
+#define NONCE_SIZE 12
+#define PAYLOAD_SIZE (NONCE_SIZE + 4)           // Nonce, then the expiry as big-endian seconds
+#define MAC_SIZE 16                             // Truncated HMAC-SHA256
+#define TOKEN_BYTES (PAYLOAD_SIZE + MAC_SIZE)
+#define TOKEN_LENGTH (TOKEN_BYTES * 2)          // Hex, the width of anonymous_sessions.token
+#define SECRET_MAX 64                           // Longer secrets are hashed, as HMAC does
+#define DEFAULT_FLUSH_MS 1000
+#define QUEUE_CAPACITY 8192
+
+typedef char TokenText[TOKEN_LENGTH + 1];
+
+static pthread_once_t keyOnce = PTHREAD_ONCE_INIT;
+static uint8_t secret[SECRET_MAX];
+static size_t secretLength = 0;
+static FILE *urandom = NULL;
+
+static Database *database = NULL;
+static long flushIntervalMs = DEFAULT_FLUSH_MS;
+
+static pthread_mutex_t queueLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queueReady = PTHREAD_COND_INITIALIZER;
+static TokenText *queue = NULL;    // Filled by worker threads
+static TokenText *spare = NULL;    // Being inserted by the writer thread
+static size_t queued = 0;
+static bool writerStopping = false;
+
+static pthread_t writerThread;
+static _Atomic bool writerRunning = false;
+
+// =============================================================================
+// Signing
+// =============================================================================
+
+static void loadKey(void) {
+    urandom = fopen("/dev/urandom", "rb");
+
+    const char *configured = getenv("WEBDSL_SESSION_SECRET");
+    if (configured && *configured) {
+        size_t length = strlen(configured);
+        if (length > SECRET_MAX) {
+            sha256((const uint8_t *)configured, length, secret);
+            secretLength = SHA256_DIGEST_SIZE;
+        } else {
+            memcpy(secret, configured, length);
+            secretLength = length;
+        }
+        return;
+    }
+
+    if (urandom && fread(secret, 1, SHA256_DIGEST_SIZE, urandom) == SHA256_DIGEST_SIZE) {
+        secretLength = SHA256_DIGEST_SIZE;
+    } else {
+        logError("Failed to generate an anonymous session secret");
+    }
+}
+
+static void sign(const uint8_t payload[PAYLOAD_SIZE], uint8_t mac[SHA256_DIGEST_SIZE]) {
+    hmacSha256(secret, secretLength, payload, PAYLOAD_SIZE, mac);
+}
+
+static int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+// =============================================================================
+// Batch Writer
+// =============================================================================
+
+static void insertBatch(TokenText *tokens, size_t count) {
+    // One text[] parameter keeps this a single prepared statement whatever
+    // the batch size
+    char *array = malloc(count * (TOKEN_LENGTH + 1) + 2);
+    if (!array) return;
+
+    char *cursor = array;
+    *cursor++ = '{';
+    for (size_t i = 0; i < count; i++) {
+        if (i > 0) *cursor++ = ',';
+        memcpy(cursor, tokens[i], TOKEN_LENGTH);
+        cursor += TOKEN_LENGTH;
+    }
+    *cursor++ = '}';
+    *cursor = '\0';
+
+    const char *values[] = {array};
+    PGresult *result = executeParameterizedQuery(database,
+        "INSERT INTO anonymous_sessions (token) SELECT unnest($1::text[]) "
+        "ON CONFLICT (token) DO NOTHING",
+        values, 1);
+
+    if (!result || PQresultStatus(result) != PGRES_COMMAND_OK) {
+        logError("Failed to insert %zu anonymous sessions: %s", count,
+                 result ? PQresultErrorMessage(result) : "no connection");
+    }
+    if (result) PQclear(result);
+    free(array);
+}
+
+static struct timespec flushDeadline(void) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += flushIntervalMs / 1000;
+    deadline.tv_nsec += (flushIntervalMs % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+    return deadline;
+}
+
+static void* writerLoop(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&queueLock);
+    for (;;) {
+        if (!writerStopping && queued < QUEUE_CAPACITY / 2) {
+            struct timespec deadline = flushDeadline();
+            pthread_cond_timedwait(&queueReady, &queueLock, &deadline);
+        }
+
+        TokenText *batch = queue;
+        size_t count = queued;
+        bool stopping = writerStopping;
+        queue = spare;
+        spare = batch;
+        queued = 0;
+        pthread_mutex_unlock(&queueLock);
+
+        if (count > 0) insertBatch(batch, count);
+
+        pthread_mutex_lock(&queueLock);
+        if (stopping && queued == 0) break;
+    }
+    pthread_mutex_unlock(&queueLock);
+    return NULL;
+}
+
+// Tokens that don't fit are not inserted up front. They still verify, and
+// the row is created by the upsert if the session ever stores a return path.
+static void queueToken(const char *token) {
+    if (!atomic_load_explicit(&writerRunning, memory_order_acquire)) return;
+
+    pthread_mutex_lock(&queueLock);
+    if (!writerStopping && queued < QUEUE_CAPACITY) {
+        memcpy(queue[queued], token, TOKEN_LENGTH + 1);
+        queued++;
+        if (queued == QUEUE_CAPACITY / 2) pthread_cond_signal(&queueReady);
+    }
+    pthread_mutex_unlock(&queueLock);
+}
+
+void initAnonymousSessions(ServerContext *ctx) {
+    pthread_once(&keyOnce, loadKey);
+    const char *configured = getenv("WEBDSL_SESSION_SECRET");
+    if (!configured || !*configured) {
+        logInfo("WEBDSL_SESSION_SECRET is not set, anonymous sessions will not survive a restart");
+    }
+
+    if (!ctx || !ctx->db) {
+        return;
+    }
+
+    const char *interval = getenv("WEBDSL_ANON_SESSION_FLUSH_MS");
+    if (interval) {
+        char *end;
+        long value = strtol(interval, &end, 10);
+        if (end != interval && *end == '\0' && value > 0) {
+            flushIntervalMs = value;
+        } else {
+            logError("Invalid WEBDSL_ANON_SESSION_FLUSH_MS '%s', using %ld",
+                     interval, flushIntervalMs);
+        }
+    }
+
+    queue = malloc(sizeof(TokenText) * QUEUE_CAPACITY);
+    spare = malloc(sizeof(TokenText) * QUEUE_CAPACITY);
+    if (!queue || !spare) {
+        logError("Failed to allocate the anonymous session queue");
+        free(queue);
+        free(spare);
+        queue = spare = NULL;
+        return;
+    }
+
+    database = ctx->db;
+    queued = 0;
+    writerStopping = false;
+    if (pthread_create(&writerThread, NULL, writerLoop, NULL) != 0) {
+        logError("Failed to start anonymous session writer thread");
+        free(queue);
+        free(spare);
+        queue = spare = NULL;
+        return;
+    }
+    atomic_store_explicit(&writerRunning, true, memory_order_release);
+}
+
+void cleanupAnonymousSessions(void) {
+    if (!atomic_load(&writerRunning)) {
+        return;
+    }
+    atomic_store_explicit(&writerRunning, false, memory_order_release);
+
+    pthread_mutex_lock(&queueLock);
+    writerStopping = true;
+    pthread_cond_signal(&queueReady);
+    pthread_mutex_unlock(&queueLock);
+    pthread_join(writerThread, NULL);
+
+    free(queue);
+    free(spare);
+    queue = spare = NULL;
+    database = NULL;
+}
+
+// =============================================================================
+// Tokens
+// =============================================================================
+
+char* createAnonymousSession(Arena *arena) {
+    pthread_once(&keyOnce, loadKey);
+    if (!urandom || secretLength == 0) {
+        return NULL;
+    }
+
+    uint8_t token[TOKEN_BYTES];
+    if (fread(token, 1, NONCE_SIZE, urandom) != NONCE_SIZE) {
+        logError("Failed to read random bytes for an anonymous session");
+        return NULL;
+    }
+
+    uint32_t expires = (uint32_t)time(NULL) + ANONYMOUS_SESSION_MAX_AGE;
+    token[NONCE_SIZE] = (uint8_t)(expires >> 24);
+    token[NONCE_SIZE + 1] = (uint8_t)(expires >> 16);
+    token[NONCE_SIZE + 2] = (uint8_t)(expires >> 8);
+    token[NONCE_SIZE + 3] = (uint8_t)expires;
+
+    uint8_t mac[SHA256_DIGEST_SIZE];
+    sign(token, mac);
+    memcpy(token + PAYLOAD_SIZE, mac, MAC_SIZE);
+
+    static const char hex[] = "0123456789abcdef";
+    char *text = arenaAlloc(arena, TOKEN_LENGTH + 1);
+    if (!text) {
+        return NULL;
+    }
+    for (size_t i = 0; i < TOKEN_BYTES; i++) {
+        text[i * 2] = hex[token[i] >> 4];
+        text[i * 2 + 1] = hex[token[i] & 0x0f];
+    }
+    text[TOKEN_LENGTH] = '\0';
+
+    queueToken(text);
+    return text;
+}
+
+bool verifyAnonymousSession(const char *token) {
+    pthread_once(&keyOnce, loadKey);
+    if (!token || secretLength == 0 || strlen(token) != TOKEN_LENGTH) {
+        return false;
+    }
+
+    uint8_t bytes[TOKEN_BYTES];
+    for (size_t i = 0; i < TOKEN_BYTES; i++) {
+        int high = hexValue(token[i * 2]);
+        int low = hexValue(token[i * 2 + 1]);
+        if (high < 0 || low < 0) return false;
+        bytes[i] = (uint8_t)(high << 4 | low);
+    }
+
+    uint8_t mac[SHA256_DIGEST_SIZE];
+    sign(bytes, mac);
+    if (!hmacEqual(mac, bytes + PAYLOAD_SIZE, MAC_SIZE)) {
+        return false;
+    }
+
+    uint32_t expires = (uint32_t)bytes[NONCE_SIZE] << 24 | (uint32_t)bytes[NONCE_SIZE + 1] << 16 |
+                       (uint32_t)bytes[NONCE_SIZE + 2] << 8 | (uint32_t)bytes[NONCE_SIZE + 3];
+    return (uint32_t)time(NULL) < expires;
+}
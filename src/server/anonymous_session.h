@@ -0,0 +1,27 @@
+#ifndef SERVER_ANONYMOUS_SESSION_H
+#define SERVER_ANONYMOUS_SESSION_H
+
+#include <stdbool.h>
+#include "../arena.h"
+#include "server.h"
+
+// Lifetime of an anonymous session token and its cookie, in seconds
+#define ANONYMOUS_SESSION_MAX_AGE 86400
+
+// Anonymous session tokens carry their own expiry and an HMAC-SHA256 under
+// WEBDSL_SESSION_SECRET (random per process when unset), so checking one
+// needs no database read and issuing one needs no write on the render path.
+// New tokens are inserted into anonymous_sessions by a background thread in
+// batches, every WEBDSL_ANON_SESSION_FLUSH_MS milliseconds (default 1000).
+void initAnonymousSessions(ServerContext *ctx);
+
+// Insert the tokens still queued and stop the writer thread
+void cleanupAnonymousSessions(void);
+
+// A new signed token, queued for insertion. NULL if there is no randomness.
+char* createAnonymousSession(Arena *arena);
+
+// Whether token was signed with the current secret and has not expired
+bool verifyAnonymousSession(const char *token);
+
+#endif // SERVER_ANONYMOUS_SESSION_H
@@ -1,4 +1,6 @@
 #include "api.h"
+#include "trace.h"
+#include "logger.h"
 
 #include <jansson.h>
 #include <jq.h>
@@ -29,7 +31,7 @@ static struct MHD_Response* createErrorResponse(const char *error_msg, int statu
 
 enum MHD_Result handleApiRequest(struct MHD_Connection *connection,
                                  ApiEndpoint *api, const char *method,
-                                 json_t *pipelineResult) {
+                                 PipelineValue *pipelineResult, Arena *arena) {
   // Handle OPTIONS requests for CORS
   if (strcmp(method, "OPTIONS") == 0) {
     struct MHD_Response *response =
@@ -59,8 +61,7 @@ enum MHD_Result handleApiRequest(struct MHD_Connection *connection,
   }
 
   // Use the passed-in pipeline result
-  json_t *apiResponse = pipelineResult;
-  if (!apiResponse) {
+  if (!pipelineResult || pipelineValueIsEmpty(pipelineResult)) {
     const char *error_msg =
         "{ \"error\": \"Internal server error processing pipeline\" }";
     struct MHD_Response *response =
@@ -72,8 +73,8 @@ enum MHD_Result handleApiRequest(struct MHD_Connection *connection,
   }
 
   // check if apiResponse is an error
-  json_t *error = json_object_get(apiResponse, "error");
-  if (error) {
+  if (pipelineValueHasKey(pipelineResult, "error")) {
+    json_t *apiResponse = pipelineValueJson(pipelineResult);
     json_t *statusCodeJson = json_object_get(apiResponse, "statusCode");
     unsigned int statusCode = MHD_HTTP_BAD_REQUEST;
     if (json_is_number(statusCodeJson)) {
@@ -84,15 +85,18 @@ enum MHD_Result handleApiRequest(struct MHD_Connection *connection,
     struct MHD_Response *response = MHD_create_response_from_buffer(strlen(error_str), error_str, MHD_RESPMEM_PERSISTENT);
     MHD_add_response_header(response, "Content-Type", "application/json");
     MHD_add_response_header(response, "Access-Control-Allow-Origin", "*");
+    addServerTimingHeader(response);
+    requestLogAddBytesOut(strlen(error_str));
     enum MHD_Result ret = MHD_queue_response(connection, statusCode, response);
     MHD_destroy_response(response);
     return ret;
   }
 
-  char *json = json_dumps(apiResponse, 0);
+  size_t length = 0;
+  char *json = pipelineValueDump(pipelineResult, arena, &length);
 
   struct MHD_Response *response =
-      MHD_create_response_from_buffer(strlen(json), json, MHD_RESPMEM_PERSISTENT);
+      MHD_create_response_from_buffer(length, json, MHD_RESPMEM_PERSISTENT);
   MHD_add_response_header(response, "Content-Type", "application/json");
 
   // Add CORS headers for API endpoints
@@ -101,6 +105,8 @@ enum MHD_Result handleApiRequest(struct MHD_Connection *connection,
                           "GET, POST, PUT, DELETE, PATCH, OPTIONS");
   MHD_add_response_header(response, "Access-Control-Allow-Headers",
                           "Content-Type");
+  addServerTimingHeader(response);
+  requestLogAddBytesOut(length);
 
   enum MHD_Result ret = MHD_queue_response(connection, MHD_HTTP_OK, response);
   MHD_destroy_response(response);
@@ -9,10 +9,12 @@
 #include <jq.h>
 #include <microhttpd.h>
 #include <pthread.h>
+#include "pipeline_value.h"
 
-// API request handling
+// API request handling. A pipeline result still in jv form is serialized
+// directly, without converting it to jansson.
 enum MHD_Result handleApiRequest(struct MHD_Connection *connection,
                                  ApiEndpoint *api, const char *method,
-                                 json_t *pipelineResult);
+                                 PipelineValue *pipelineResult, Arena *arena);
 
 #endif // SERVER_API_H
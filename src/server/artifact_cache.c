@@ -0,0 +1,214 @@
+#include "artifact_cache.h"
+#include "hmac.h"
+#include "metrics.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define DEFAULT_CACHE_DIR ".webdsl-cache"
+#define ARTIFACT_MAGIC "WDSLART1"
+#define ARTIFACT_MAGIC_SIZE 8
+
+typedef struct ArtifactHeader {
+    char magic[ARTIFACT_MAGIC_SIZE];
+    uint64_t size;                       // Payload bytes after the header
+    uint8_t digest[SHA256_DIGEST_SIZE];  // SHA-256 of the payload
+} ArtifactHeader;
+
+static bool disabled = false;
+static char cacheDir[PATH_MAX];
+
+static _Atomic uint64_t hits = 0;
+static _Atomic uint64_t misses = 0;
+static _Atomic uint64_t writes = 0;
+static _Atomic uint64_t errors = 0;
+
+void initArtifactCache(void) {
+    atomic_store(&hits, 0);
+    atomic_store(&misses, 0);
+    atomic_store(&writes, 0);
+    atomic_store(&errors, 0);
+
+    const char *dir = getenv("WEBDSL_CACHE_DIR");
+    if (!dir) dir = DEFAULT_CACHE_DIR;
+    if (strlen(dir) >= sizeof(cacheDir) - 128) {
+        fprintf(stderr, "WEBDSL_CACHE_DIR is too long, artifact cache disabled\n");
+        dir = "";
+    }
+    // An empty WEBDSL_CACHE_DIR turns the cache off
+    snprintf(cacheDir, sizeof(cacheDir), "%s", dir);
+}
+
+void disableArtifactCache(void) {
+    disabled = true;
+}
+
+bool artifactCacheEnabled(void) {
+    return !disabled && cacheDir[0] != '\0';
+}
+
+// <dir>/<kind>/<hex key>, where the key covers everything that shapes the artifact
+static void artifactPath(char *path, size_t pathSize, const char *kind, const char *version,
+                         const char *input, size_t length) {
+    Sha256 hash;
+    uint8_t key[SHA256_DIGEST_SIZE];
+    sha256Init(&hash);
+    sha256Update(&hash, (const uint8_t *)kind, strlen(kind) + 1);
+    sha256Update(&hash, (const uint8_t *)version, strlen(version) + 1);
+    sha256Update(&hash, (const uint8_t *)input, length);
+    sha256Final(&hash, key);
+
+    static const char hex[] = "0123456789abcdef";
+    char name[SHA256_DIGEST_SIZE * 2 + 1];
+    for (size_t i = 0; i < SHA256_DIGEST_SIZE; i++) {
+        name[i * 2] = hex[key[i] >> 4];
+        name[i * 2 + 1] = hex[key[i] & 0x0f];
+    }
+    name[SHA256_DIGEST_SIZE * 2] = '\0';
+
+    snprintf(path, pathSize, "%s/%s/%s", cacheDir, kind, name);
+}
+
+static void countMiss(void) {
+    atomic_fetch_add_explicit(&misses, 1, memory_order_relaxed);
+    metricsCacheMiss(METRICS_CACHE_ARTIFACT);
+}
+
+bool artifactCacheGet(const char *kind, const char *version,
+                      const char *input, size_t length, Artifact *artifact) {
+    memset(artifact, 0, sizeof(Artifact));
+    if (!artifactCacheEnabled()) return false;
+
+    char path[PATH_MAX];
+    artifactPath(path, sizeof(path), kind, version, input, length);
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        countMiss();
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(ArtifactHeader)) {
+        close(fd);
+        countMiss();
+        return false;
+    }
+    size_t fileSize = (size_t)st.st_size;
+    void *mapping = mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        countMiss();
+        return false;
+    }
+
+    // A torn or damaged entry is dropped, and rewritten after the recompile
+    const ArtifactHeader *header = mapping;
+    const uint8_t *payload = (const uint8_t *)mapping + sizeof(ArtifactHeader);
+    uint8_t digest[SHA256_DIGEST_SIZE];
+    bool valid = memcmp(header->magic, ARTIFACT_MAGIC, ARTIFACT_MAGIC_SIZE) == 0 &&
+                 header->size == fileSize - sizeof(ArtifactHeader);
+    if (valid) {
+        sha256(payload, (size_t)header->size, digest);
+        valid = memcmp(digest, header->digest, SHA256_DIGEST_SIZE) == 0;
+    }
+    if (!valid) {
+        munmap(mapping, fileSize);
+        unlink(path);
+        atomic_fetch_add_explicit(&errors, 1, memory_order_relaxed);
+        countMiss();
+        return false;
+    }
+
+    artifact->data = payload;
+    artifact->size = (size_t)header->size;
+    artifact->mapping = mapping;
+    artifact->mappingSize = fileSize;
+    atomic_fetch_add_explicit(&hits, 1, memory_order_relaxed);
+    metricsCacheHit(METRICS_CACHE_ARTIFACT);
+    return true;
+}
+
+bool artifactCacheHas(const char *kind, const char *version, const char *input, size_t length) {
+    Artifact artifact;
+    if (!artifactCacheGet(kind, version, input, length, &artifact)) return false;
+    releaseArtifact(&artifact);
+    return true;
+}
+
+void releaseArtifact(Artifact *artifact) {
+    if (artifact->mapping) {
+        munmap(artifact->mapping, artifact->mappingSize);
+    }
+    memset(artifact, 0, sizeof(Artifact));
+}
+
+static bool makeDirectory(const char *path) {
+    return mkdir(path, 0755) == 0 || errno == EEXIST;
+}
+
+static bool writeAll(int fd, const void *data, size_t size) {
+    const uint8_t *cursor = data;
+    while (size > 0) {
+        ssize_t written = write(fd, cursor, size);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) return false;
+        cursor += written;
+        size -= (size_t)written;
+    }
+    return true;
+}
+
+void artifactCachePut(const char *kind, const char *version,
+                      const char *input, size_t length,
+                      const void *data, size_t size) {
+    if (!artifactCacheEnabled()) return;
+
+    char kindDir[PATH_MAX];
+    snprintf(kindDir, sizeof(kindDir), "%s/%s", cacheDir, kind);
+    if (!makeDirectory(cacheDir) || !makeDirectory(kindDir)) {
+        atomic_fetch_add_explicit(&errors, 1, memory_order_relaxed);
+        return;
+    }
+
+    char path[PATH_MAX];
+    char temporary[PATH_MAX + 32];
+    artifactPath(path, sizeof(path), kind, version, input, length);
+    snprintf(temporary, sizeof(temporary), "%s.%ld.tmp", path, (long)getpid());
+
+    ArtifactHeader header;
+    memset(&header, 0, sizeof(ArtifactHeader));
+    memcpy(header.magic, ARTIFACT_MAGIC, ARTIFACT_MAGIC_SIZE);
+    header.size = size;
+    sha256(data, size, header.digest);
+
+    // Written aside and renamed into place, so instances starting together
+    // never map a partial entry
+    int fd = open(temporary, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        atomic_fetch_add_explicit(&errors, 1, memory_order_relaxed);
+        return;
+    }
+    bool written = writeAll(fd, &header, sizeof(ArtifactHeader)) && writeAll(fd, data, size);
+    if (close(fd) != 0) written = false;
+    if (!written || rename(temporary, path) != 0) {
+        unlink(temporary);
+        atomic_fetch_add_explicit(&errors, 1, memory_order_relaxed);
+        return;
+    }
+    atomic_fetch_add_explicit(&writes, 1, memory_order_relaxed);
+}
+
+void artifactCacheStats(ArtifactCacheStats *stats) {
+    stats->hits = atomic_load_explicit(&hits, memory_order_relaxed);
+    stats->misses = atomic_load_explicit(&misses, memory_order_relaxed);
+    stats->writes = atomic_load_explicit(&writes, memory_order_relaxed);
+    stats->errors = atomic_load_explicit(&errors, memory_order_relaxed);
+}
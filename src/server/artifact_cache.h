@@ -0,0 +1,52 @@
+#ifndef SERVER_ARTIFACT_CACHE_H
+#define SERVER_ARTIFACT_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Compiled artifacts kept on disk between starts, so inputs that haven't
+// changed skip the compiler. Entries live under WEBDSL_CACHE_DIR (default
+// .webdsl-cache) at <kind>/<SHA-256 of kind, version and input>, carry a
+// checksum of their contents and are memory-mapped when read back.
+
+typedef struct Artifact {
+    const void *data;
+    size_t size;
+    void *mapping;
+    size_t mappingSize;
+} Artifact;
+
+typedef struct ArtifactCacheStats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t writes;
+    uint64_t errors;  // Entries that failed their checksum or couldn't be written
+} ArtifactCacheStats;
+
+// Read WEBDSL_CACHE_DIR and reset the stats, once per start
+void initArtifactCache(void);
+
+// Turn the cache off for the rest of the process (--no-cache)
+void disableArtifactCache(void);
+
+bool artifactCacheEnabled(void);
+
+// Map the artifact stored for input. Returns false on a miss.
+bool artifactCacheGet(const char *kind, const char *version,
+                      const char *input, size_t length, Artifact *artifact);
+
+// Whether an artifact is stored for input, for results with no payload
+bool artifactCacheHas(const char *kind, const char *version, const char *input, size_t length);
+
+void releaseArtifact(Artifact *artifact);
+
+// Store data as the artifact for input. Failures only cost the next start
+// a recompile, so they are counted rather than reported.
+void artifactCachePut(const char *kind, const char *version,
+                      const char *input, size_t length,
+                      const void *data, size_t size);
+
+void artifactCacheStats(ArtifactCacheStats *stats);
+
+#endif // SERVER_ARTIFACT_CACHE_H
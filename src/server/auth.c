@@ -10,6 +10,7 @@
 #include "server.h"
 #include "db.h"
 #include "auth.h"
+#include "anonymous_session.h"
 #include "email.h"
 #include <microhttpd.h>
 #include <jansson.h>
@@ -376,7 +377,7 @@ enum MHD_Result handleLoginRequest(ServerContext *ctx, struct MHD_Connection *co
     // Use return path from anonymous session
     const char *anonymous_session = MHD_lookup_connection_value(
         connection, MHD_COOKIE_KIND, "anonymous_session");
-    if (anonymous_session) {
+    if (verifyAnonymousSession(anonymous_session)) {
         const char *valuesSession[] = {anonymous_session};
         PGresult *resultSession = executeParameterizedQuery(ctx->db,
             "SELECT return_path FROM anonymous_sessions WHERE token = $1",
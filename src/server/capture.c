@@ -0,0 +1,451 @@
+#include "capture.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include "logger.h"
+
+#define DEFAULT_SAMPLE_RATE 0.01
+#define CAPTURE_MAX_BODY (256 * 1024)
+#define CAPTURE_MAX_QUEUED (8 * 1024 * 1024)
+#define CAPTURE_INITIAL_LINE 1024
+
+// One JSON line, built in place and handed to the writer thread as is
+typedef struct CaptureLine {
+    struct CaptureLine *next;
+    size_t length;
+    size_t capacity;
+    char data[];
+} CaptureLine;
+
+struct CaptureRecord {
+    CaptureLine *line;   // Everything up to and including the headers
+    char *body;
+    size_t bodyLength;
+    size_t bodyCapacity;
+    bool bodyTruncated;
+    uint64_t : 56;
+};
+
+static double sampleRate = DEFAULT_SAMPLE_RATE;
+static FILE *captureFile = NULL;
+
+static pthread_mutex_t queueLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queueReady = PTHREAD_COND_INITIALIZER;
+static CaptureLine *queueHead = NULL;
+static CaptureLine *queueTail = NULL;
+static size_t queuedBytes = 0;
+static bool writerStopping = false;
+
+static pthread_t writerThread;
+static _Atomic bool captureRunning = false;
+static _Atomic uint64_t droppedTotal = 0;
+
+// =============================================================================
+// Line Building
+// =============================================================================
+
+// On allocation failure the line is freed and set to NULL; later appends are no-ops
+static void lineReserve(CaptureLine **line, size_t extra) {
+    if (!*line || (*line)->length + extra <= (*line)->capacity) return;
+
+    size_t capacity = (*line)->capacity * 2;
+    while (capacity < (*line)->length + extra) capacity *= 2;
+    CaptureLine *grown = realloc(*line, sizeof(CaptureLine) + capacity);
+    if (!grown) {
+        free(*line);
+        *line = NULL;
+        return;
+    }
+    grown->capacity = capacity;
+    *line = grown;
+}
+
+static void lineAppend(CaptureLine **line, const char *data, size_t length) {
+    lineReserve(line, length);
+    if (!*line) return;
+    memcpy((*line)->data + (*line)->length, data, length);
+    (*line)->length += length;
+}
+
+static void lineAppendLiteral(CaptureLine **line, const char *text) {
+    lineAppend(line, text, strlen(text));
+}
+
+static void lineAppendString(CaptureLine **line, const char *value, size_t length) {
+    // Worst case every byte becomes \u00XX
+    lineReserve(line, length * 6 + 3);
+    if (!*line) return;
+
+    char *out = (*line)->data + (*line)->length;
+    *out++ = '"';
+    for (size_t i = 0; i < length; i++) {
+        unsigned char c = (unsigned char)value[i];
+        if (c == '"' || c == '\\') {
+            *out++ = '\\';
+            *out++ = (char)c;
+        } else if (c == '\n') {
+            *out++ = '\\';
+            *out++ = 'n';
+        } else if (c == '\r') {
+            *out++ = '\\';
+            *out++ = 'r';
+        } else if (c == '\t') {
+            *out++ = '\\';
+            *out++ = 't';
+        } else if (c < 0x20) {
+            out += snprintf(out, 7, "\\u%04x", c);
+        } else {
+            *out++ = (char)c;
+        }
+    }
+    *out++ = '"';
+    (*line)->length = (size_t)(out - (*line)->data);
+}
+
+static void lineAppendField(CaptureLine **line, const char *key, const char *value) {
+    if (!value) return;
+    lineAppendLiteral(line, ",\"");
+    lineAppendLiteral(line, key);
+    lineAppendLiteral(line, "\":");
+    lineAppendString(line, value, strlen(value));
+}
+
+static void lineAppendBase64(CaptureLine **line, const char *data, size_t length) {
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    lineReserve(line, (length + 2) / 3 * 4 + 2);
+    if (!*line) return;
+
+    const unsigned char *in = (const unsigned char *)data;
+    char *out = (*line)->data + (*line)->length;
+    *out++ = '"';
+    size_t i = 0;
+    for (; i + 2 < length; i += 3) {
+        *out++ = alphabet[in[i] >> 2];
+        *out++ = alphabet[((in[i] & 0x03) << 4) | (in[i + 1] >> 4)];
+        *out++ = alphabet[((in[i + 1] & 0x0f) << 2) | (in[i + 2] >> 6)];
+        *out++ = alphabet[in[i + 2] & 0x3f];
+    }
+    if (i < length) {
+        *out++ = alphabet[in[i] >> 2];
+        if (i + 1 < length) {
+            *out++ = alphabet[((in[i] & 0x03) << 4) | (in[i + 1] >> 4)];
+            *out++ = alphabet[(in[i + 1] & 0x0f) << 2];
+        } else {
+            *out++ = alphabet[(in[i] & 0x03) << 4];
+            *out++ = '=';
+        }
+        *out++ = '=';
+    }
+    *out++ = '"';
+    (*line)->length = (size_t)(out - (*line)->data);
+}
+
+// Bodies that are valid UTF-8 without NULs are stored as JSON strings
+static bool isTextBody(const char *data, size_t length) {
+    const unsigned char *p = (const unsigned char *)data;
+    size_t i = 0;
+    while (i < length) {
+        unsigned char c = p[i];
+        size_t extra;
+        if (c == 0) return false;
+        if (c < 0x80) extra = 0;
+        else if (c >= 0xc2 && c <= 0xdf) extra = 1;
+        else if (c >= 0xe0 && c <= 0xef) extra = 2;
+        else if (c >= 0xf0 && c <= 0xf4) extra = 3;
+        else return false;
+
+        if (i + extra >= length && extra > 0) return false;
+        for (size_t j = 1; j <= extra; j++) {
+            if ((p[i + j] & 0xc0) != 0x80) return false;
+        }
+        i += extra + 1;
+    }
+    return true;
+}
+
+// Percent-encode a query component; the result never needs JSON escaping
+static void lineAppendQueryComponent(CaptureLine **line, const char *value) {
+    static const char hex[] = "0123456789ABCDEF";
+    lineReserve(line, strlen(value) * 3);
+    if (!*line) return;
+
+    char *out = (*line)->data + (*line)->length;
+    for (const unsigned char *p = (const unsigned char *)value; *p; p++) {
+        unsigned char c = *p;
+        bool unreserved = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+                          (c >= '0' && c <= '9') || c == '-' || c == '_' || c == '.' || c == '~';
+        if (unreserved) {
+            *out++ = (char)c;
+        } else {
+            *out++ = '%';
+            *out++ = hex[c >> 4];
+            *out++ = hex[c & 0x0f];
+        }
+    }
+    (*line)->length = (size_t)(out - (*line)->data);
+}
+
+// =============================================================================
+// Writer Thread
+// =============================================================================
+
+static void* writerLoop(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&queueLock);
+    for (;;) {
+        while (!queueHead && !writerStopping) {
+            pthread_cond_wait(&queueReady, &queueLock);
+        }
+        CaptureLine *batch = queueHead;
+        bool stopping = writerStopping;
+        queueHead = queueTail = NULL;
+        queuedBytes = 0;
+        pthread_mutex_unlock(&queueLock);
+
+        while (batch) {
+            CaptureLine *next = batch->next;
+            fwrite(batch->data, 1, batch->length, captureFile);
+            fputc('\n', captureFile);
+            free(batch);
+            batch = next;
+        }
+        fflush(captureFile);
+
+        pthread_mutex_lock(&queueLock);
+        if (stopping && !queueHead) break;
+    }
+    pthread_mutex_unlock(&queueLock);
+    return NULL;
+}
+
+static void queueLine(CaptureLine *line) {
+    pthread_mutex_lock(&queueLock);
+    if (writerStopping || queuedBytes + line->length > CAPTURE_MAX_QUEUED) {
+        pthread_mutex_unlock(&queueLock);
+        free(line);
+        atomic_fetch_add_explicit(&droppedTotal, 1, memory_order_relaxed);
+        return;
+    }
+
+    line->next = NULL;
+    if (queueTail) {
+        queueTail->next = line;
+    } else {
+        queueHead = line;
+    }
+    queueTail = line;
+    queuedBytes += line->length;
+    pthread_cond_signal(&queueReady);
+    pthread_mutex_unlock(&queueLock);
+}
+
+void initCapture(void) {
+    const char *path = getenv("WEBDSL_CAPTURE_FILE");
+    if (!path || !*path) {
+        return;
+    }
+
+    const char *rate = getenv("WEBDSL_CAPTURE_SAMPLE_RATE");
+    if (rate) {
+        char *end;
+        double value = strtod(rate, &end);
+        if (end != rate && value >= 0.0 && value <= 1.0) {
+            sampleRate = value;
+        } else {
+            fprintf(stderr, "Invalid WEBDSL_CAPTURE_SAMPLE_RATE '%s', using %g\n", rate, sampleRate);
+        }
+    }
+
+    captureFile = fopen(path, "a");
+    if (!captureFile) {
+        fprintf(stderr, "Failed to open capture file %s, capture disabled\n", path);
+        return;
+    }
+
+    writerStopping = false;
+    if (pthread_create(&writerThread, NULL, writerLoop, NULL) != 0) {
+        fprintf(stderr, "Failed to start capture writer thread, capture disabled\n");
+        fclose(captureFile);
+        captureFile = NULL;
+        return;
+    }
+    atomic_store_explicit(&captureRunning, true, memory_order_release);
+    logInfo("Capturing %g of requests to %s", sampleRate, path);
+}
+
+void cleanupCapture(void) {
+    if (!atomic_load(&captureRunning)) {
+        return;
+    }
+    atomic_store_explicit(&captureRunning, false, memory_order_release);
+
+    pthread_mutex_lock(&queueLock);
+    writerStopping = true;
+    pthread_cond_signal(&queueReady);
+    pthread_mutex_unlock(&queueLock);
+    pthread_join(writerThread, NULL);
+
+    fclose(captureFile);
+    captureFile = NULL;
+}
+
+uint64_t captureDroppedTotal(void) {
+    return atomic_load_explicit(&droppedTotal, memory_order_relaxed);
+}
+
+// =============================================================================
+// Records
+// =============================================================================
+
+static enum MHD_Result appendHeader(void *cls, enum MHD_ValueKind kind,
+                                    const char *key, const char *value) {
+    (void)kind;
+    CaptureLine **line = cls;
+    // Credentials stay out of the capture file
+    if (!key || !value || strcasecmp(key, "Cookie") == 0 || strcasecmp(key, "Authorization") == 0) {
+        return MHD_YES;
+    }
+    if (*line && (*line)->data[(*line)->length - 1] != '{') {
+        lineAppendLiteral(line, ",");
+    }
+    lineAppendString(line, key, strlen(key));
+    lineAppendLiteral(line, ":");
+    lineAppendString(line, value, strlen(value));
+    return MHD_YES;
+}
+
+// MHD hands handlers the path and decoded arguments; re-encode the query
+static enum MHD_Result appendArgument(void *cls, enum MHD_ValueKind kind,
+                                      const char *key, const char *value) {
+    (void)kind;
+    CaptureLine **line = cls;
+    if (!key) return MHD_YES;
+    if (*line) {
+        bool first = memchr((*line)->data, '?', (*line)->length) == NULL;
+        lineAppendLiteral(line, first ? "?" : "&");
+    }
+    lineAppendQueryComponent(line, key);
+    if (value) {
+        lineAppendLiteral(line, "=");
+        lineAppendQueryComponent(line, value);
+    }
+    return MHD_YES;
+}
+
+CaptureRecord* beginCapture(Arena *arena, struct MHD_Connection *connection,
+                            const char *method, const char *url) {
+    if (!atomic_load_explicit(&captureRunning, memory_order_acquire) || !loggerSample(sampleRate)) {
+        return NULL;
+    }
+
+    CaptureRecord *record = arenaAlloc(arena, sizeof(CaptureRecord));
+    if (!record) return NULL;
+    memset(record, 0, sizeof(CaptureRecord));
+
+    record->line = malloc(sizeof(CaptureLine) + CAPTURE_INITIAL_LINE);
+    if (!record->line) return NULL;
+    record->line->length = 0;
+    record->line->capacity = CAPTURE_INITIAL_LINE;
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    char start[64];
+    snprintf(start, sizeof(start), "{\"startMs\":%lld",
+             (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000);
+    lineAppendLiteral(&record->line, start);
+    lineAppendField(&record->line, "method", method);
+
+    // Path plus the re-encoded query string
+    size_t urlLength = strlen(url);
+    CaptureLine *fullUrl = malloc(sizeof(CaptureLine) + urlLength + 256);
+    if (fullUrl) {
+        fullUrl->length = 0;
+        fullUrl->capacity = urlLength + 256;
+        lineAppend(&fullUrl, url, urlLength);
+        MHD_get_connection_values(connection, MHD_GET_ARGUMENT_KIND, appendArgument, &fullUrl);
+    }
+    if (fullUrl) {
+        lineAppendLiteral(&record->line, ",\"url\":");
+        lineAppendString(&record->line, fullUrl->data, fullUrl->length);
+        free(fullUrl);
+    } else {
+        free(record->line);
+        record->line = NULL;
+    }
+
+    lineAppendLiteral(&record->line, ",\"headers\":{");
+    MHD_get_connection_values(connection, MHD_HEADER_KIND, appendHeader, &record->line);
+    lineAppendLiteral(&record->line, "}");
+
+    if (!record->line) {
+        atomic_fetch_add_explicit(&droppedTotal, 1, memory_order_relaxed);
+        return NULL;
+    }
+    return record;
+}
+
+void captureAppendBody(CaptureRecord *record, const char *data, size_t size) {
+    if (!record || size == 0) return;
+
+    size_t room = CAPTURE_MAX_BODY - record->bodyLength;
+    if (size > room) {
+        record->bodyTruncated = true;
+        size = room;
+    }
+    if (size == 0) return;
+
+    if (record->bodyLength + size > record->bodyCapacity) {
+        size_t capacity = record->bodyCapacity ? record->bodyCapacity * 2 : 4096;
+        while (capacity < record->bodyLength + size) capacity *= 2;
+        if (capacity > CAPTURE_MAX_BODY) capacity = CAPTURE_MAX_BODY;
+        char *body = realloc(record->body, capacity);
+        if (!body) {
+            record->bodyTruncated = true;
+            return;
+        }
+        record->body = body;
+        record->bodyCapacity = capacity;
+    }
+    memcpy(record->body + record->bodyLength, data, size);
+    record->bodyLength += size;
+}
+
+void endCapture(CaptureRecord *record, const char *route, unsigned int status, uint64_t durationNs) {
+    if (!record) return;
+
+    CaptureLine *line = record->line;
+    record->line = NULL;
+
+    if (line && status > 0) {
+        if (record->bodyLength > 0 && isTextBody(record->body, record->bodyLength)) {
+            lineAppendLiteral(&line, ",\"body\":");
+            lineAppendString(&line, record->body, record->bodyLength);
+        } else if (record->bodyLength > 0) {
+            lineAppendLiteral(&line, ",\"bodyBase64\":");
+            lineAppendBase64(&line, record->body, record->bodyLength);
+        }
+        if (record->bodyTruncated) {
+            lineAppendLiteral(&line, ",\"bodyTruncated\":true");
+        }
+        lineAppendField(&line, "route", route);
+
+        char tail[64];
+        snprintf(tail, sizeof(tail), ",\"status\":%u,\"durationMs\":%.3f}", status, (double)durationNs / 1e6);
+        lineAppendLiteral(&line, tail);
+
+        if (line) {
+            queueLine(line);
+        } else {
+            atomic_fetch_add_explicit(&droppedTotal, 1, memory_order_relaxed);
+        }
+    } else {
+        free(line);
+    }
+
+    free(record->body);
+    record->body = NULL;
+}
@@ -0,0 +1,33 @@
+#ifndef SERVER_CAPTURE_H
+#define SERVER_CAPTURE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <microhttpd.h>
+#include "../arena.h"
+
+typedef struct CaptureRecord CaptureRecord;
+
+// Capture is enabled by WEBDSL_CAPTURE_FILE. WEBDSL_CAPTURE_SAMPLE_RATE
+// (default 0.01) picks the requests appended to it, one JSON line each, for
+// `webdsl replay`. Cookie and Authorization headers are never recorded.
+void initCapture(void);
+
+// Write everything queued and close the capture file
+void cleanupCapture(void);
+
+// Captured requests dropped because the write queue was full
+uint64_t captureDroppedTotal(void);
+
+// Start capturing a new request, on the first call for its connection.
+// Returns NULL when capture is off or the request is not sampled.
+CaptureRecord* beginCapture(Arena *arena, struct MHD_Connection *connection,
+                            const char *method, const char *url);
+
+// Record upload data as it arrives, before the post processor consumes it
+void captureAppendBody(CaptureRecord *record, const char *data, size_t size);
+
+// Queue the completed request. Requests that never got a response are dropped.
+void endCapture(CaptureRecord *record, const char *route, unsigned int status, uint64_t durationNs);
+
+#endif // SERVER_CAPTURE_H
@@ -9,6 +9,8 @@
 #include <stdatomic.h>
 #include "server/utils.h"
 #include "routing.h"
+#include "metrics.h"
+#include "logger.h"
 
 static struct ServerContext *ctx = NULL;
 
@@ -31,7 +33,9 @@ static DbConnection getDbConnection(Database *db) {
         return conn;
     }
     
+    uint64_t start = metricsNow();
     conn.pooled = getConnection(db->pool);
+    metricsRecordPoolAcquire(metricsNow() - start, conn.pooled != NULL);
     if (conn.pooled) {
         conn.conn = conn.pooled->conn;
     }
@@ -70,8 +74,10 @@ static PreparedStmt* prepareSqlStatement(Database *db, PGconn *conn, const char
     stmt = findPreparedStmt(db, conn, sql);
     if (stmt) {
         pthread_mutex_unlock(&db->stmt_lock);
+        metricsCacheHit(METRICS_CACHE_STMT);
         return stmt;
     }
+    metricsCacheMiss(METRICS_CACHE_STMT);
     
     // Generate unique name for this statement
     char buf[32];
@@ -81,7 +87,7 @@ static PreparedStmt* prepareSqlStatement(Database *db, PGconn *conn, const char
     // Prepare the statement
     PGresult *res = PQprepare(conn, stmt_name, sql, 0, NULL);
     if (PQresultStatus(res) != PGRES_COMMAND_OK) {
-        fprintf(stderr, "Failed to prepare statement: %s\n", PQerrorMessage(conn));
+        logError("Failed to prepare statement: %s", PQerrorMessage(conn));
         PQclear(res);
         pthread_mutex_unlock(&db->stmt_lock);
         return NULL;
@@ -461,10 +467,10 @@ json_t *executeSqlStep(PipelineStepNode *step, json_t *input,
             return createErrorResponse("No SQL query provided");
         }
     } else {
-        sql = step->code;
-        if (step->name) {
+        sql = step->resolvedCode ? step->resolvedCode : step->code;
+        if (step->name && !step->resolvedCode) {
             QueryNode *query = findQuery(step->name);
-            sql = query->sql;
+            sql = query ? query->sql : NULL;
         }
         if (!sql) {
             return createErrorResponse("No SQL query found");
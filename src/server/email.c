@@ -1,5 +1,5 @@
 #include "email.h"
-#include <curl/curl.h>
+#include "http_client.h"
 #include <string.h>
 #include <stdio.h>
 #include "../value.h"
@@ -79,8 +79,8 @@ static int sendEmail(Arena *arena, const char *to, const char *subject, const ch
     char *requestStr = json_dumps(request, JSON_COMPACT);
     json_decref(request);
 
-    // Initialize curl
-    CURL *curl = curl_easy_init();
+    // Pooled handle, so consecutive emails reuse the SendGrid connection
+    CURL *curl = acquireHttpHandle();
     if (!curl) {
         free(requestStr);
         fprintf(stderr, "Failed to initialize curl\n");
@@ -103,7 +103,7 @@ static int sendEmail(Arena *arena, const char *to, const char *subject, const ch
 
     // Cleanup
     curl_slist_free_all(headers);
-    curl_easy_cleanup(curl);
+    releaseHttpHandle(curl);
     free(requestStr);
 
     if (res != CURLE_OK) {
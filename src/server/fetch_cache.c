@@ -0,0 +1,320 @@
+#include "fetch_cache.h"
+#include "metrics.h"
+#include "utils.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+
+#define FETCH_CACHE_SHARDS 16     // Should be power of 2
+#define FETCH_CACHE_BUCKETS 256   // Per shard, should be power of 2
+#define DEFAULT_FETCH_CACHE_SIZE (16 * 1024 * 1024)
+#define NS_PER_SECOND 1000000000ull
+
+typedef struct CacheEntry {
+    char *key;
+    char *body;
+    size_t size;
+    size_t cost;               // Bytes charged against the shard
+    uint64_t expiresNs;        // metricsNow() after which it must be revalidated
+    char etag[128];
+    char lastModified[64];
+    struct CacheEntry *next;   // Bucket chain
+    struct CacheEntry *newer;  // LRU order
+    struct CacheEntry *older;
+} CacheEntry;
+
+// Lock-striped so fetches on different worker threads rarely contend
+typedef struct CacheShard {
+    pthread_mutex_t lock;
+    CacheEntry *buckets[FETCH_CACHE_BUCKETS];
+    CacheEntry *newest;
+    CacheEntry *oldest;
+    size_t bytes;
+} CacheShard;
+
+static CacheShard shards[FETCH_CACHE_SHARDS];
+static size_t shardLimit = 0;
+static bool cacheReady = false;
+
+void initFetchCache(void) {
+    cleanupFetchCache();
+
+    size_t size = DEFAULT_FETCH_CACHE_SIZE;
+    const char *setting = getenv("WEBDSL_FETCH_CACHE_SIZE");
+    if (setting && *setting) {
+        long value = atol(setting);
+        size = value > 0 ? (size_t)value : 0;
+    }
+    if (size == 0) return;
+
+    shardLimit = size / FETCH_CACHE_SHARDS;
+    for (size_t i = 0; i < FETCH_CACHE_SHARDS; i++) {
+        memset(&shards[i], 0, sizeof(CacheShard));
+        pthread_mutex_init(&shards[i].lock, NULL);
+    }
+    cacheReady = true;
+}
+
+static void freeEntry(CacheEntry *entry) {
+    free(entry->key);
+    free(entry->body);
+    free(entry);
+}
+
+void cleanupFetchCache(void) {
+    if (!cacheReady) return;
+
+    for (size_t i = 0; i < FETCH_CACHE_SHARDS; i++) {
+        CacheEntry *entry = shards[i].newest;
+        while (entry) {
+            CacheEntry *older = entry->older;
+            freeEntry(entry);
+            entry = older;
+        }
+        pthread_mutex_destroy(&shards[i].lock);
+    }
+    cacheReady = false;
+}
+
+bool fetchCacheEnabled(void) {
+    return cacheReady;
+}
+
+// =============================================================================
+// Response Headers
+// =============================================================================
+
+void fetchCacheResetHeaders(FetchCacheHeaders *headers) {
+    memset(headers, 0, sizeof(FetchCacheHeaders));
+    headers->maxAge = -1;
+}
+
+static void parseCacheControl(FetchCacheHeaders *headers, const char *value) {
+    const char *directive = value;
+    while (*directive) {
+        while (*directive == ' ' || *directive == ',') directive++;
+        if (strncasecmp(directive, "max-age=", 8) == 0) {
+            headers->maxAge = atol(directive + 8);
+        } else if (strncasecmp(directive, "no-store", 8) == 0) {
+            headers->noStore = true;
+        } else if (strncasecmp(directive, "no-cache", 8) == 0) {
+            headers->noCache = true;
+        }
+        while (*directive && *directive != ',') directive++;
+    }
+}
+
+static void copyValue(char *dest, size_t destSize, const char *value) {
+    // Truncated validators would never match, so drop them instead
+    size_t length = strlen(value);
+    if (length < destSize) memcpy(dest, value, length + 1);
+}
+
+void fetchCacheParseHeader(FetchCacheHeaders *headers, const char *line, size_t length) {
+    // Each response (after a 100 Continue, say) starts with its status line
+    if (length >= 5 && strncmp(line, "HTTP/", 5) == 0) {
+        fetchCacheResetHeaders(headers);
+        return;
+    }
+
+    const char *colon = memchr(line, ':', length);
+    if (!colon) return;
+
+    size_t nameLength = (size_t)(colon - line);
+    const char *start = colon + 1;
+    const char *end = line + length;
+    while (start < end && isspace((unsigned char)*start)) start++;
+    while (end > start && isspace((unsigned char)end[-1])) end--;
+
+    char value[256];
+    size_t valueLength = (size_t)(end - start);
+    if (valueLength >= sizeof(value)) valueLength = sizeof(value) - 1;
+    memcpy(value, start, valueLength);
+    value[valueLength] = '\0';
+
+    if (nameLength == 13 && strncasecmp(line, "Cache-Control", 13) == 0) {
+        parseCacheControl(headers, value);
+    } else if (nameLength == 4 && strncasecmp(line, "ETag", 4) == 0) {
+        copyValue(headers->etag, sizeof(headers->etag), value);
+    } else if (nameLength == 13 && strncasecmp(line, "Last-Modified", 13) == 0) {
+        copyValue(headers->lastModified, sizeof(headers->lastModified), value);
+    }
+}
+
+// =============================================================================
+// Entries
+// =============================================================================
+
+static CacheShard* shardFor(uint32_t hash) {
+    return &shards[hash & (FETCH_CACHE_SHARDS - 1)];
+}
+
+static CacheEntry** bucketFor(CacheShard *shard, uint32_t hash) {
+    return &shard->buckets[(hash / FETCH_CACHE_SHARDS) & (FETCH_CACHE_BUCKETS - 1)];
+}
+
+static void unlinkLru(CacheShard *shard, CacheEntry *entry) {
+    if (entry->newer) entry->newer->older = entry->older;
+    else shard->newest = entry->older;
+    if (entry->older) entry->older->newer = entry->newer;
+    else shard->oldest = entry->newer;
+    entry->newer = NULL;
+    entry->older = NULL;
+}
+
+static void pushNewest(CacheShard *shard, CacheEntry *entry) {
+    entry->older = shard->newest;
+    entry->newer = NULL;
+    if (shard->newest) shard->newest->newer = entry;
+    shard->newest = entry;
+    if (!shard->oldest) shard->oldest = entry;
+}
+
+static CacheEntry* findEntry(CacheEntry *bucket, const char *key) {
+    for (CacheEntry *entry = bucket; entry; entry = entry->next) {
+        if (strcmp(entry->key, key) == 0) return entry;
+    }
+    return NULL;
+}
+
+static void removeEntry(CacheShard *shard, CacheEntry *entry) {
+    CacheEntry **link = bucketFor(shard, hashString(entry->key));
+    while (*link && *link != entry) link = &(*link)->next;
+    if (*link) *link = entry->next;
+
+    unlinkLru(shard, entry);
+    shard->bytes -= entry->cost;
+    freeEntry(entry);
+}
+
+static long freshLifetime(const FetchCacheHeaders *headers, long ttl) {
+    if (ttl >= 0) return ttl;
+    if (headers->noCache || headers->maxAge < 0) return 0;
+    return headers->maxAge;
+}
+
+static uint64_t expiresAt(long lifetime) {
+    return metricsNow() + (uint64_t)lifetime * NS_PER_SECOND;
+}
+
+static bool copyBody(const CacheEntry *entry, char **body, size_t *size) {
+    *body = malloc(entry->size + 1);
+    if (!*body) return false;
+    memcpy(*body, entry->body, entry->size);
+    (*body)[entry->size] = '\0';
+    *size = entry->size;
+    return true;
+}
+
+// =============================================================================
+// Lookup and Store
+// =============================================================================
+
+FetchCacheResult fetchCacheLookup(const char *key, char **body, size_t *size,
+                                  FetchCacheHeaders *validators) {
+    if (!cacheReady) return FETCH_CACHE_MISS;
+
+    uint32_t hash = hashString(key);
+    CacheShard *shard = shardFor(hash);
+    FetchCacheResult result = FETCH_CACHE_MISS;
+
+    pthread_mutex_lock(&shard->lock);
+    CacheEntry *entry = findEntry(*bucketFor(shard, hash), key);
+    if (entry && metricsNow() < entry->expiresNs) {
+        if (copyBody(entry, body, size)) {
+            unlinkLru(shard, entry);
+            pushNewest(shard, entry);
+            result = FETCH_CACHE_FRESH;
+        }
+    } else if (entry && (entry->etag[0] || entry->lastModified[0])) {
+        fetchCacheResetHeaders(validators);
+        memcpy(validators->etag, entry->etag, sizeof(entry->etag));
+        memcpy(validators->lastModified, entry->lastModified, sizeof(entry->lastModified));
+        result = FETCH_CACHE_STALE;
+    } else if (entry) {
+        removeEntry(shard, entry);
+    }
+    pthread_mutex_unlock(&shard->lock);
+
+    return result;
+}
+
+void fetchCacheStore(const char *key, const char *body, size_t size,
+                     const FetchCacheHeaders *headers, long ttl) {
+    if (!cacheReady) return;
+    if (ttl < 0 && headers->noStore) return;
+
+    long lifetime = freshLifetime(headers, ttl);
+    if (lifetime == 0 && !headers->etag[0] && !headers->lastModified[0]) return;
+
+    size_t keyLength = strlen(key);
+    size_t cost = sizeof(CacheEntry) + keyLength + 1 + size + 1;
+    if (cost > shardLimit) return;
+
+    // Copied outside the lock
+    CacheEntry *entry = calloc(1, sizeof(CacheEntry));
+    if (!entry) return;
+    entry->key = malloc(keyLength + 1);
+    entry->body = malloc(size + 1);
+    if (!entry->key || !entry->body) {
+        freeEntry(entry);
+        return;
+    }
+    memcpy(entry->key, key, keyLength + 1);
+    memcpy(entry->body, body, size);
+    entry->body[size] = '\0';
+    entry->size = size;
+    entry->cost = cost;
+    entry->expiresNs = expiresAt(lifetime);
+    memcpy(entry->etag, headers->etag, sizeof(entry->etag));
+    memcpy(entry->lastModified, headers->lastModified, sizeof(entry->lastModified));
+
+    uint32_t hash = hashString(key);
+    CacheShard *shard = shardFor(hash);
+
+    pthread_mutex_lock(&shard->lock);
+    CacheEntry **bucket = bucketFor(shard, hash);
+    CacheEntry *existing = findEntry(*bucket, key);
+    if (existing) removeEntry(shard, existing);
+
+    entry->next = *bucket;
+    *bucket = entry;
+    pushNewest(shard, entry);
+    shard->bytes += cost;
+
+    while (shard->bytes > shardLimit && shard->oldest != entry) {
+        removeEntry(shard, shard->oldest);
+    }
+    pthread_mutex_unlock(&shard->lock);
+}
+
+bool fetchCacheRevalidated(const char *key, const FetchCacheHeaders *headers, long ttl,
+                           char **body, size_t *size) {
+    if (!cacheReady) return false;
+
+    uint32_t hash = hashString(key);
+    CacheShard *shard = shardFor(hash);
+    bool found = false;
+
+    pthread_mutex_lock(&shard->lock);
+    CacheEntry *entry = findEntry(*bucketFor(shard, hash), key);
+    if (entry && copyBody(entry, body, size)) {
+        // A 304 carries the headers the full response would have had
+        entry->expiresNs = expiresAt(freshLifetime(headers, ttl));
+        if (headers->etag[0]) {
+            memcpy(entry->etag, headers->etag, sizeof(entry->etag));
+        }
+        if (headers->lastModified[0]) {
+            memcpy(entry->lastModified, headers->lastModified, sizeof(entry->lastModified));
+        }
+        unlinkLru(shard, entry);
+        pushNewest(shard, entry);
+        found = true;
+    }
+    pthread_mutex_unlock(&shard->lock);
+
+    return found;
+}
@@ -0,0 +1,48 @@
+#ifndef SERVER_FETCH_CACHE_H
+#define SERVER_FETCH_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Caching headers of an upstream response, or the validators of a stale entry
+typedef struct FetchCacheHeaders {
+    char etag[128];
+    char lastModified[64];
+    long maxAge;        // Cache-Control max-age in seconds, -1 if absent
+    bool noStore;
+    bool noCache;
+    uint8_t _padding[6];
+} FetchCacheHeaders;
+
+typedef enum {
+    FETCH_CACHE_MISS,
+    FETCH_CACHE_FRESH,  // Serve the cached body without a request
+    FETCH_CACHE_STALE   // Revalidate with the validators in headers
+} FetchCacheResult;
+
+// Size the cache from WEBDSL_FETCH_CACHE_SIZE (bytes, 0 disables it).
+// Entries live across requests until evicted or the server reloads.
+void initFetchCache(void);
+void cleanupFetchCache(void);
+bool fetchCacheEnabled(void);
+
+// Reset headers and feed it response header lines as curl delivers them
+void fetchCacheResetHeaders(FetchCacheHeaders *headers);
+void fetchCacheParseHeader(FetchCacheHeaders *headers, const char *line, size_t length);
+
+// Look up key. A fresh entry's body is copied into *body (malloc'd, NUL
+// terminated); a stale one's validators are copied into validators.
+FetchCacheResult fetchCacheLookup(const char *key, char **body, size_t *size,
+                                  FetchCacheHeaders *validators);
+
+// Store a 200 response. ttl overrides the response's own freshness when >= 0.
+void fetchCacheStore(const char *key, const char *body, size_t size,
+                     const FetchCacheHeaders *headers, long ttl);
+
+// Refresh an entry after a 304, copying its body like a fresh lookup.
+// Returns false if the entry was evicted in the meantime.
+bool fetchCacheRevalidated(const char *key, const FetchCacheHeaders *headers, long ttl,
+                           char **body, size_t *size);
+
+#endif // SERVER_FETCH_CACHE_H
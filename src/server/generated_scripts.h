@@ -8,6 +8,8 @@ typedef struct {
     const char* name;
     const char** chunks;
     size_t num_chunks;
+    const unsigned char* bytecode;  /* Precompiled chunk, NULL when generated without luac */
+    size_t bytecode_len;
 } EmbeddedScript;
 
 /* Table of all embedded scripts */
@@ -7,6 +7,8 @@
 #include <ctype.h>
 #include "github.h"
 #include "auth.h"
+#include "anonymous_session.h"
+#include "http_client.h"
 
 // Helper function for CURL write callback
 static size_t write_callback(char *ptr, size_t size, size_t nmemb, void *userdata) {
@@ -50,7 +52,7 @@ enum MHD_Result handleGithubAuthRequest(ServerContext *ctx, struct MHD_Connectio
     // Get returnTo from anonymous session if it exists
     char *returnTo = NULL;
     const char *anonymous_session = MHD_lookup_connection_value(connection, MHD_COOKIE_KIND, "anonymous_session");
-    if (anonymous_session) {
+    if (verifyAnonymousSession(anonymous_session)) {
         const char *valuesSession[] = {anonymous_session};
         PGresult *resultSession = executeParameterizedQuery(ctx->db,
             "SELECT return_path FROM anonymous_sessions WHERE token = $1",
@@ -174,8 +176,8 @@ enum MHD_Result handleGithubCallback(ServerContext *ctx, struct MHD_Connection *
         return redirectWithError(connection, "/login", "github-not-configured");
     }
     
-    // Initialize CURL
-    CURL *curl = curl_easy_init();
+    // Pooled handle, reusing connections to GitHub across logins
+    CURL *curl = acquireHttpHandle();
     if (!curl) {
         printf("Error: Failed to initialize CURL\n");
         return redirectWithError(connection, "/login", "server-error");
@@ -214,7 +216,7 @@ enum MHD_Result handleGithubCallback(ServerContext *ctx, struct MHD_Connection *
     
     if (res != CURLE_OK) {
         printf("Error: Failed to exchange code for token: %s\n", curl_easy_strerror(res));
-        curl_easy_cleanup(curl);
+        releaseHttpHandle(curl);
         return redirectWithError(connection, "/login", "github-token-error");
     }
     
@@ -223,7 +225,7 @@ enum MHD_Result handleGithubCallback(ServerContext *ctx, struct MHD_Connection *
     json_t *token_response = json_loads(token_resp.buffer, 0, &error);
     if (!token_response) {
         printf("Error: Failed to parse token response: %s\n", error.text);
-        curl_easy_cleanup(curl);
+        releaseHttpHandle(curl);
         return redirectWithError(connection, "/login", "github-token-error");
     }
     
@@ -231,7 +233,7 @@ enum MHD_Result handleGithubCallback(ServerContext *ctx, struct MHD_Connection *
     if (!access_token) {
         printf("Error: No access token in response\n");
         json_decref(token_response);
-        curl_easy_cleanup(curl);
+        releaseHttpHandle(curl);
         return redirectWithError(connection, "/login", "github-token-error");
     }
     
@@ -263,7 +265,7 @@ enum MHD_Result handleGithubCallback(ServerContext *ctx, struct MHD_Connection *
     
     res = curl_easy_perform(curl);
     curl_slist_free_all(headers);
-    curl_easy_cleanup(curl);
+    releaseHttpHandle(curl);
     
     if (res != CURLE_OK) {
         printf("Error: Failed to fetch user info: %s\n", curl_easy_strerror(res));
@@ -382,7 +384,7 @@ enum MHD_Result handleGithubCallback(ServerContext *ctx, struct MHD_Connection *
     // Use returnTo path if present, otherwise redirect to home
     const char *redirectPath = "/";
     if (returnTo) {
-        CURL *curlInit = curl_easy_init();
+        CURL *curlInit = acquireHttpHandle();
         if (curlInit) {
             int decodedLength = 0;
             char *decodedPath = curl_easy_unescape(curlInit, returnTo, 0, &decodedLength);
@@ -390,7 +392,7 @@ enum MHD_Result handleGithubCallback(ServerContext *ctx, struct MHD_Connection *
                 redirectPath = arenaDupString(ctx->arena, decodedPath);
                 curl_free(decodedPath);
             }
-            curl_easy_cleanup(curlInit);
+            releaseHttpHandle(curlInit);
         }
     }
     
@@ -4,6 +4,11 @@
 #include "github.h"
 #include "api.h"
 #include "css.h"
+#include "static.h"
+#include "metrics.h"
+#include "trace.h"
+#include "capture.h"
+#include "session_store.h"
 #include "mustache.h"
 #include "pipeline_executor.h"
 #include "validation.h"
@@ -587,6 +592,19 @@ static enum MHD_Result handleSpecialEndpoints(ServerContext *ctx, struct MHD_Con
         return handleCssRequest(connection, requestArena);
     }
     
+    // Handle static file mounts
+    enum MHD_Result staticResult = handleStaticRequest(connection, url, method);
+    if (staticResult != MHD_NO) {
+        ((struct RequestContext *)con_cls)->routeId = METRICS_ROUTE_STATIC;
+        return staticResult;
+    }
+    
+    // Handle metrics endpoint, unless the website has its own route there
+    if (strcmp(method, "GET") == 0 && isMetricsPath(url) &&
+        findRoute(url, method, requestArena).type == ROUTE_TYPE_NONE) {
+        return handleMetricsRequest(connection, requestArena);
+    }
+    
     // Handle auth endpoints
     if (isBodyMethod(method)) {
         struct PostContext *post = con_cls;
@@ -635,8 +653,8 @@ static json_t* executeRouteValidation(ServerContext *ctx, RouteMatch *match,
     return NULL;
 }
 
-static json_t* executePipelineIfExists(ServerContext *ctx, RouteMatch *match, 
-                                     json_t *requestContext, Arena *requestArena) {
+static PipelineValue executePipelineIfExists(ServerContext *ctx, RouteMatch *match, 
+                                           json_t *requestContext, Arena *requestArena) {
     PipelineStepNode *pipeline = NULL;
     
     // Get pipeline from either API or page
@@ -647,11 +665,11 @@ static json_t* executePipelineIfExists(ServerContext *ctx, RouteMatch *match,
     }
     
     if (pipeline) {
-        return executePipeline(ctx, pipeline, requestContext, requestArena);
+        return executePipelineValue(ctx, pipeline, requestContext, requestArena);
     } else {
         json_t *context = json_object();
         json_object_set_new(context, "request", json_deep_copy(requestContext));
-        return context;
+        return pipelineValueFromJson(context);
     }
 }
 
@@ -670,16 +688,19 @@ static enum MHD_Result handlePipelineRedirect(struct MHD_Connection *connection,
 }
 
 static enum MHD_Result handleRouteResponse(struct MHD_Connection *connection, RouteMatch *match, 
-                                         const char *method, json_t *pipelineResult, 
+                                         const char *method, PipelineValue *pipelineResult, 
                                          json_t *requestContext, Arena *requestArena) {
     switch (match->type) {
         case ROUTE_TYPE_API:
-            return handleApiRequest(connection, match->endpoint.api, method, pipelineResult);
+            return handleApiRequest(connection, match->endpoint.api, method, pipelineResult, requestArena);
 
-        case ROUTE_TYPE_PAGE:
+        case ROUTE_TYPE_PAGE: {
+            // Templates read jansson values
+            json_t *pageData = pipelineValueJson(pipelineResult);
             // Add requestContext to pipelineResult
-            json_object_set_new(pipelineResult, "request", json_deep_copy(requestContext));
-            return handlePageRequest(connection, match->endpoint.page, requestArena, pipelineResult);
+            json_object_set_new(pageData, "request", json_deep_copy(requestContext));
+            return handlePageRequest(connection, match->endpoint.page, requestArena, pageData);
+        }
 
         case ROUTE_TYPE_NONE:
             break;
@@ -694,6 +715,57 @@ static enum MHD_Result handleRouteResponse(struct MHD_Connection *connection, Ro
     return ret;
 }
 
+// Route, validate and run the pipeline for a request whose body is complete
+static enum MHD_Result handleRoutedRequest(ServerContext *ctx,
+                                           struct MHD_Connection *connection,
+                                           const char *url,
+                                           const char *method,
+                                           const char *version,
+                                           Arena *requestArena,
+                                           void **con_cls) {
+    // Find route using unified routing
+    RouteMatch match = findRoute(url, method, requestArena);
+    ((struct RequestContext *)*con_cls)->routeId = metricsRouteId(&match);
+
+    // Build request context once - AFTER all POST data is processed
+    json_t *requestContext = buildRequestContextJson(ctx, connection, requestArena, *con_cls, 
+                                                   method, url, version, &match.params);
+    requestLogSetUser(json_string_value(json_object_get(json_object_get(requestContext, "user"), "id")));
+
+    // Handle validation for requests with body
+    if (isBodyMethod(method)) {
+        struct PostContext *post = *con_cls;
+        json_t *validation_errors = executeRouteValidation(ctx, &match, post, requestContext, requestArena);
+        
+        if (validation_errors) {
+            if (match.type == ROUTE_TYPE_API) {
+                return handleValidationErrors(connection, validation_errors);
+            } else if (match.type == ROUTE_TYPE_PAGE) {
+                json_object_update(requestContext, validation_errors);
+                return handlePageRequest(connection, match.endpoint.page, requestArena, requestContext);
+            }
+        }
+    }
+    
+    // Execute pipeline if exists
+    PipelineValue pipelineResult = executePipelineIfExists(ctx, &match, requestContext, requestArena);
+
+    // Session store writes land before the response, so the next request sees them
+    flushSessionStore();
+    
+    // Check if there's a redirect in the pipeline result
+    if (pipelineValueHasKey(&pipelineResult, "redirect")) {
+        // There's a redirect, handle it
+        enum MHD_Result redirectResult = handlePipelineRedirect(connection, pipelineValueJson(&pipelineResult));
+        return redirectResult;
+    }
+
+    // Handle based on route type
+    enum MHD_Result ret = handleRouteResponse(connection, &match, method, &pipelineResult, requestContext, requestArena);
+    pipelineValueFree(&pipelineResult);
+    return ret;
+}
+
 // =============================================================================
 // Main Request Handler
 // =============================================================================
@@ -710,6 +782,7 @@ enum MHD_Result handleRequest(ServerContext *ctx,
 
     // First call for this connection
     if (*con_cls == NULL) {
+        uint64_t startNs = metricsNow();
         Arena *arena = createArena(1024 * 1024); // 1MB initial size
         
         if (isBodyMethod(method)) {
@@ -718,11 +791,20 @@ enum MHD_Result handleRequest(ServerContext *ctx,
             if (result != MHD_YES) {
                 return result;
             }
+            post->routeId = METRICS_ROUTE_INTERNAL;
+            post->startNs = startNs;
+            post->capture = beginCapture(arena, connection, method, url);
             *con_cls = post;
             return MHD_YES;
         }
         
-        *con_cls = initializeGetContext(arena);
+        struct RequestContext *reqctx = initializeGetContext(arena);
+        reqctx->routeId = METRICS_ROUTE_INTERNAL;
+        reqctx->startNs = startNs;
+        reqctx->trace = NULL;
+        memset(&reqctx->log, 0, sizeof(reqctx->log));
+        reqctx->capture = beginCapture(arena, connection, method, url);
+        *con_cls = reqctx;
         return MHD_YES;
     }
 
@@ -744,6 +826,7 @@ enum MHD_Result handleRequest(ServerContext *ctx,
         struct PostContext *post = *con_cls;
         
         if (*upload_data_size != 0) {
+            captureAppendBody(post->capture, upload_data, *upload_data_size);
             if (post->type == REQUEST_TYPE_JSON_POST) {
                 if (handleJsonPostData(post, upload_data, upload_data_size) != MHD_YES) {
                     return MHD_NO;
@@ -762,49 +845,23 @@ enum MHD_Result handleRequest(ServerContext *ctx,
         }
     }
 
+    struct RequestContext *tracectx = *con_cls;
+    tracectx->trace = beginRequestTrace(requestArena, method, url, tracectx->startNs);
+    beginRequestLog(&tracectx->log, requestArena, connection, method, url);
+
     // Handle special endpoints (auth, CSS, etc.)
     enum MHD_Result specialResult = handleSpecialEndpoints(ctx, connection, url, method, requestArena, *con_cls);
     if (specialResult != MHD_NO) {
         return specialResult;
     }
 
-    // Find route using unified routing
-    RouteMatch match = findRoute(url, method, requestArena);
-
-    // Build request context once - AFTER all POST data is processed
-    json_t *requestContext = buildRequestContextJson(ctx, connection, requestArena, *con_cls, 
-                                                   method, url, version, &match.params);
-
-    // Handle validation for requests with body
-    if (isBodyMethod(method)) {
-        struct PostContext *post = *con_cls;
-        json_t *validation_errors = executeRouteValidation(ctx, &match, post, requestContext, requestArena);
-        
-        if (validation_errors) {
-            if (match.type == ROUTE_TYPE_API) {
-                return handleValidationErrors(connection, validation_errors);
-            } else if (match.type == ROUTE_TYPE_PAGE) {
-                json_object_update(requestContext, validation_errors);
-                return handlePageRequest(connection, match.endpoint.page, requestArena, requestContext);
-            }
-        }
-    }
-    
-    // Execute pipeline if exists
-    json_t *pipelineResult = executePipelineIfExists(ctx, &match, requestContext, requestArena);
-    
-    if (pipelineResult) {
-        // Check if there's a redirect in the pipeline result
-        json_t *redirect = json_object_get(pipelineResult, "redirect");
-        if (redirect) {
-            // There's a redirect, handle it
-            enum MHD_Result redirectResult = handlePipelineRedirect(connection, pipelineResult);
-            return redirectResult;
-        }
-    }
-
-    // Handle based on route type
-    return handleRouteResponse(connection, &match, method, pipelineResult, requestContext, requestArena);
+    // The session store lives on this request's context and is released
+    // before this call returns, on every path
+    beginSessionStore(&tracectx->session, ctx);
+    enum MHD_Result ret = handleRoutedRequest(ctx, connection, url, method, version,
+                                              requestArena, con_cls);
+    endSessionStore();
+    return ret;
 }
 
 // =============================================================================
@@ -825,6 +882,19 @@ void handleRequestCompleted(ServerContext *ctx,
             return;
         }
         
+        uint64_t durationNs = metricsNow() - reqctx->startNs;
+        metricsRecordRequest(reqctx->routeId, durationNs);
+        endRequestTrace(reqctx->trace);
+
+        unsigned int status = 0;
+#if MHD_VERSION >= 0x00097600
+        const union MHD_ConnectionInfo *info =
+            MHD_get_connection_info(connection, MHD_CONNECTION_INFO_HTTP_STATUS);
+        if (info) status = info->http_status;
+#endif
+        endRequestLog(&reqctx->log, metricsRouteName(reqctx->routeId), status, durationNs);
+        endCapture(reqctx->capture, metricsRouteName(reqctx->routeId), status, durationNs);
+        
         if (reqctx->type == REQUEST_TYPE_POST || 
             reqctx->type == REQUEST_TYPE_JSON_POST ||
             reqctx->type == REQUEST_TYPE_MULTIPART) {
@@ -837,8 +907,10 @@ void handleRequestCompleted(ServerContext *ctx,
                 MHD_destroy_post_processor(post->pp);
             }
             
+            metricsRecordArena(reqctx->routeId, post->arena);
             freeArena(post->arena);
         } else {
+            metricsRecordArena(reqctx->routeId, reqctx->arena);
             freeArena(reqctx->arena);
         }
         *con_cls = NULL;
@@ -4,6 +4,8 @@
 #include <microhttpd.h>
 #include "../arena.h"
 #include "server.h"
+#include "logger.h"
+#include "session_store.h"
 
 // Add thread-local storage for JSON arena
 extern _Thread_local Arena* currentJsonArena;
@@ -41,9 +43,17 @@ struct PostData {
     Arena *arena;  // Add arena field for form data allocation
 };
 
+// PostContext and RequestContext share their first fields (type, routeId,
+// startNs, trace, log, capture, session) so the completion handler can read
+// them from either.
 struct PostContext {
     enum RequestType type;
-    uint32_t : 32;
+    int routeId;         // Metrics route id
+    uint64_t startNs;    // Request start, monotonic
+    struct RequestTrace *trace;  // NULL unless this request is traced
+    RequestLog log;              // Access log fields
+    struct CaptureRecord *capture;  // NULL unless this request is captured
+    SessionStore session;           // getStore/setStore state for this request
     struct MHD_PostProcessor *pp;
     char *data;
     char *raw_json;
@@ -58,7 +68,12 @@ struct PostContext {
 
 struct RequestContext {
     enum RequestType type;
-    uint32_t : 32;
+    int routeId;
+    uint64_t startNs;
+    struct RequestTrace *trace;
+    RequestLog log;
+    struct CaptureRecord *capture;
+    SessionStore session;
     Arena *arena;
 };
 
@@ -0,0 +1,168 @@
+#include "hmac.h"
+#include <string.h>
+
+static const uint32_t roundConstants[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+// SHA-256 is defined on 32-bit words that wrap, so these opt out of the
+// integer sanitizer like hashString does
+static uint32_t rotateRight(uint32_t value, unsigned int bits)
+    __attribute__((no_sanitize("unsigned-integer-overflow", "unsigned-shift-base")));
+static void sha256Compress(Sha256 *hash, const uint8_t *block)
+    __attribute__((no_sanitize("unsigned-integer-overflow", "unsigned-shift-base")));
+
+static uint32_t rotateRight(uint32_t value, unsigned int bits) {
+    return (value >> bits) | (value << (32 - bits));
+}
+
+static void sha256Compress(Sha256 *hash, const uint8_t *block) {
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++) {
+        w[i] = (uint32_t)block[i * 4] << 24 | (uint32_t)block[i * 4 + 1] << 16 |
+               (uint32_t)block[i * 4 + 2] << 8 | (uint32_t)block[i * 4 + 3];
+    }
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = rotateRight(w[i - 15], 7) ^ rotateRight(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = rotateRight(w[i - 2], 17) ^ rotateRight(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = hash->state[0], b = hash->state[1], c = hash->state[2], d = hash->state[3];
+    uint32_t e = hash->state[4], f = hash->state[5], g = hash->state[6], h = hash->state[7];
+
+    for (int i = 0; i < 64; i++) {
+        uint32_t s1 = rotateRight(e, 6) ^ rotateRight(e, 11) ^ rotateRight(e, 25);
+        uint32_t choose = (e & f) ^ (~e & g);
+        uint32_t t1 = h + s1 + choose + roundConstants[i] + w[i];
+        uint32_t s0 = rotateRight(a, 2) ^ rotateRight(a, 13) ^ rotateRight(a, 22);
+        uint32_t majority = (a & b) ^ (a & c) ^ (b & c);
+        uint32_t t2 = s0 + majority;
+
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+
+    hash->state[0] += a;
+    hash->state[1] += b;
+    hash->state[2] += c;
+    hash->state[3] += d;
+    hash->state[4] += e;
+    hash->state[5] += f;
+    hash->state[6] += g;
+    hash->state[7] += h;
+}
+
+void sha256Init(Sha256 *hash) {
+    static const uint32_t initial[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+    memcpy(hash->state, initial, sizeof(initial));
+    hash->length = 0;
+    hash->used = 0;
+}
+
+void sha256Update(Sha256 *hash, const uint8_t *data, size_t length) {
+    hash->length += length;
+
+    if (hash->used > 0) {
+        size_t take = SHA256_BLOCK_SIZE - hash->used;
+        if (take > length) take = length;
+        memcpy(hash->block + hash->used, data, take);
+        hash->used += take;
+        data += take;
+        length -= take;
+        if (hash->used < SHA256_BLOCK_SIZE) return;
+        sha256Compress(hash, hash->block);
+        hash->used = 0;
+    }
+
+    while (length >= SHA256_BLOCK_SIZE) {
+        sha256Compress(hash, data);
+        data += SHA256_BLOCK_SIZE;
+        length -= SHA256_BLOCK_SIZE;
+    }
+
+    memcpy(hash->block, data, length);
+    hash->used = length;
+}
+
+void sha256Final(Sha256 *hash, uint8_t digest[SHA256_DIGEST_SIZE]) {
+    uint64_t bits = hash->length * 8;
+
+    hash->block[hash->used++] = 0x80;
+    if (hash->used > SHA256_BLOCK_SIZE - 8) {
+        memset(hash->block + hash->used, 0, SHA256_BLOCK_SIZE - hash->used);
+        sha256Compress(hash, hash->block);
+        hash->used = 0;
+    }
+    memset(hash->block + hash->used, 0, SHA256_BLOCK_SIZE - 8 - hash->used);
+    for (int i = 0; i < 8; i++) {
+        hash->block[SHA256_BLOCK_SIZE - 1 - i] = (uint8_t)(bits >> (i * 8));
+    }
+    sha256Compress(hash, hash->block);
+
+    for (int i = 0; i < 8; i++) {
+        digest[i * 4] = (uint8_t)(hash->state[i] >> 24);
+        digest[i * 4 + 1] = (uint8_t)(hash->state[i] >> 16);
+        digest[i * 4 + 2] = (uint8_t)(hash->state[i] >> 8);
+        digest[i * 4 + 3] = (uint8_t)hash->state[i];
+    }
+}
+
+void sha256(const uint8_t *data, size_t length, uint8_t digest[SHA256_DIGEST_SIZE]) {
+    Sha256 hash;
+    sha256Init(&hash);
+    sha256Update(&hash, data, length);
+    sha256Final(&hash, digest);
+}
+
+void hmacSha256(const uint8_t *key, size_t keyLength,
+                const uint8_t *data, size_t length,
+                uint8_t digest[SHA256_DIGEST_SIZE]) {
+    uint8_t block[SHA256_BLOCK_SIZE];
+    memset(block, 0, sizeof(block));
+    if (keyLength > SHA256_BLOCK_SIZE) {
+        sha256(key, keyLength, block);
+    } else {
+        memcpy(block, key, keyLength);
+    }
+
+    uint8_t pad[SHA256_BLOCK_SIZE];
+    uint8_t inner[SHA256_DIGEST_SIZE];
+    Sha256 hash;
+
+    for (int i = 0; i < SHA256_BLOCK_SIZE; i++) pad[i] = block[i] ^ 0x36;
+    sha256Init(&hash);
+    sha256Update(&hash, pad, sizeof(pad));
+    sha256Update(&hash, data, length);
+    sha256Final(&hash, inner);
+
+    for (int i = 0; i < SHA256_BLOCK_SIZE; i++) pad[i] = block[i] ^ 0x5c;
+    sha256Init(&hash);
+    sha256Update(&hash, pad, sizeof(pad));
+    sha256Update(&hash, inner, sizeof(inner));
+    sha256Final(&hash, digest);
+}
+
+bool hmacEqual(const uint8_t *a, const uint8_t *b, size_t length) {
+    uint8_t difference = 0;
+    for (size_t i = 0; i < length; i++) {
+        difference |= a[i] ^ b[i];
+    }
+    return difference == 0;
+}
@@ -0,0 +1,36 @@
+#ifndef SERVER_HMAC_H
+#define SERVER_HMAC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SHA256_DIGEST_SIZE 32
+#define SHA256_BLOCK_SIZE 64
+
+typedef struct Sha256 {
+    uint32_t state[8];
+    uint64_t length;                  // Bytes hashed so far
+    uint8_t block[SHA256_BLOCK_SIZE];
+    size_t used;                      // Bytes waiting in block
+} Sha256;
+
+// Incremental SHA-256, for input that arrives in pieces
+void sha256Init(Sha256 *hash);
+void sha256Update(Sha256 *hash, const uint8_t *data, size_t length)
+    __attribute__((no_sanitize("unsigned-integer-overflow", "unsigned-shift-base")));
+void sha256Final(Sha256 *hash, uint8_t digest[SHA256_DIGEST_SIZE])
+    __attribute__((no_sanitize("unsigned-integer-overflow", "unsigned-shift-base")));
+
+// SHA-256 of data
+void sha256(const uint8_t *data, size_t length, uint8_t digest[SHA256_DIGEST_SIZE]);
+
+// HMAC-SHA256 (RFC 2104) of data under key
+void hmacSha256(const uint8_t *key, size_t keyLength,
+                const uint8_t *data, size_t length,
+                uint8_t digest[SHA256_DIGEST_SIZE]);
+
+// Compare two MACs without leaking where they differ through timing
+bool hmacEqual(const uint8_t *a, const uint8_t *b, size_t length);
+
+#endif // SERVER_HMAC_H
@@ -0,0 +1,143 @@
+#include "http_client.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define DEFAULT_POOL_SIZE 16
+#define MAX_POOL_SIZE 256
+#define DEFAULT_KEEPALIVE_SECONDS 60L
+#define DEFAULT_MAX_IDLE_SECONDS 60L
+
+// curl doesn't support sharing a connection cache between threads that use
+// it concurrently, so each thread gets its own share and handle pool
+typedef struct HttpClientThread {
+    CURLSH *share;
+    size_t idleCount;
+    CURL *idle[MAX_POOL_SIZE];
+} HttpClientThread;
+
+static size_t poolSize = DEFAULT_POOL_SIZE;
+static long keepAliveSeconds = DEFAULT_KEEPALIVE_SECONDS;
+static long maxIdleSeconds = DEFAULT_MAX_IDLE_SECONDS;
+
+static _Thread_local HttpClientThread *threadClient = NULL;
+static pthread_key_t clientKey;
+static pthread_once_t clientKeyOnce = PTHREAD_ONCE_INIT;
+
+static long envSeconds(const char *name, long fallback) {
+    const char *value = getenv(name);
+    if (!value || !*value) return fallback;
+    long seconds = atol(value);
+    return seconds >= 0 ? seconds : fallback;
+}
+
+void initHttpClient(void) {
+    const char *size = getenv("WEBDSL_HTTP_POOL_SIZE");
+    poolSize = DEFAULT_POOL_SIZE;
+    if (size && atol(size) >= 0) {
+        poolSize = (size_t)atol(size);
+        if (poolSize > MAX_POOL_SIZE) poolSize = MAX_POOL_SIZE;
+    }
+
+    keepAliveSeconds = envSeconds("WEBDSL_HTTP_KEEPALIVE", DEFAULT_KEEPALIVE_SECONDS);
+    maxIdleSeconds = envSeconds("WEBDSL_HTTP_MAX_IDLE", DEFAULT_MAX_IDLE_SECONDS);
+}
+
+// =============================================================================
+// Thread State
+// =============================================================================
+
+static void freeThreadClient(void *ptr) {
+    HttpClientThread *client = ptr;
+    if (!client) return;
+
+    for (size_t i = 0; i < client->idleCount; i++) {
+        curl_easy_cleanup(client->idle[i]);
+    }
+    if (client->share) curl_share_cleanup(client->share);
+    free(client);
+}
+
+static void createClientKey(void) {
+    pthread_key_create(&clientKey, freeThreadClient);
+}
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wdisabled-macro-expansion"
+
+static CURLSH* createShare(void) {
+    CURLSH *share = curl_share_init();
+    if (!share) return NULL;
+
+    if (curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS) != CURLSHE_OK ||
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION) != CURLSHE_OK) {
+        curl_share_cleanup(share);
+        return NULL;
+    }
+    // Older libcurl keeps connections per handle, which the pool still reuses
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+    return share;
+}
+
+static HttpClientThread* getThreadClient(void) {
+    if (threadClient) return threadClient;
+
+    pthread_once(&clientKeyOnce, createClientKey);
+    HttpClientThread *client = calloc(1, sizeof(HttpClientThread));
+    if (!client) return NULL;
+
+    client->share = createShare();
+    if (!client->share) {
+        fprintf(stderr, "Failed to create curl share, outbound connections won't be reused\n");
+    }
+    threadClient = client;
+    pthread_setspecific(clientKey, client);
+    return client;
+}
+
+static void applyDefaults(CURL *curl, CURLSH *share) {
+    if (share) curl_easy_setopt(curl, CURLOPT_SHARE, share);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl, CURLOPT_MAXAGE_CONN, maxIdleSeconds);
+    if (keepAliveSeconds > 0) {
+        curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+        curl_easy_setopt(curl, CURLOPT_TCP_KEEPIDLE, keepAliveSeconds);
+        curl_easy_setopt(curl, CURLOPT_TCP_KEEPINTVL, keepAliveSeconds);
+    }
+}
+
+#pragma clang diagnostic pop
+
+// =============================================================================
+// Handle Pool
+// =============================================================================
+
+CURL* acquireHttpHandle(void) {
+    HttpClientThread *client = getThreadClient();
+
+    CURL *curl = NULL;
+    if (client && client->idleCount > 0) {
+        curl = client->idle[--client->idleCount];
+    } else {
+        curl = curl_easy_init();
+    }
+    if (!curl) return NULL;
+
+    applyDefaults(curl, client ? client->share : NULL);
+    return curl;
+}
+
+void releaseHttpHandle(CURL *curl) {
+    if (!curl) return;
+
+    // Drops the options but keeps the handle's caches and share
+    curl_easy_reset(curl);
+
+    HttpClientThread *client = threadClient;
+    if (client && client->idleCount < poolSize) {
+        client->idle[client->idleCount++] = curl;
+    } else {
+        curl_easy_cleanup(curl);
+    }
+}
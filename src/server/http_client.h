@@ -0,0 +1,18 @@
+#ifndef SERVER_HTTP_CLIENT_H
+#define SERVER_HTTP_CLIENT_H
+
+#include <curl/curl.h>
+
+// Read the outbound HTTP settings from the environment
+void initHttpClient(void);
+
+// A curl easy handle from this thread's pool. Handles on a thread share one
+// DNS cache, TLS session cache and connection cache, so repeated calls to
+// the same upstream skip the lookup and handshakes. Options are at their
+// defaults apart from the shared caches, keep-alive and NOSIGNAL.
+CURL* acquireHttpHandle(void);
+
+// Return a handle from acquireHttpHandle to this thread's pool
+void releaseHttpHandle(CURL *curl);
+
+#endif // SERVER_HTTP_CLIENT_H
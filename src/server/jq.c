@@ -1,11 +1,77 @@
+#define _GNU_SOURCE  // dladdr on glibc
+
 #include "jq.h"
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <dlfcn.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include <jv.h>
+#if defined(__APPLE__)
+#include <malloc/malloc.h>
+#elif defined(__GLIBC__)
+#include <malloc.h>
+#endif
+#include "jq_native.h"
 #include "routing.h"
+#include "logger.h"
+#include "metrics.h"
+#include "utils.h"
+#include "artifact_cache.h"
+
+#define DEFAULT_CACHE_SIZE 64
+
+// A filter found in the website at load time
+typedef struct JqProgram {
+    char *filter;
+    uint32_t hash;
+    uint64_t : 32;
+} JqProgram;
+
+typedef struct JqCacheEntry {
+    char *filter;
+    jq_state *jq;
+    uint64_t lastUsed;
+    size_t bytes;      // Heap growth measured while compiling
+    uint32_t hash;
+    uint32_t program;  // Load-time program id, 0 for other filters
+} JqCacheEntry;
+
+// jq_state is not thread-safe, so each worker thread compiles its own
+typedef struct JqThreadCache {
+    JqCacheEntry *entries;
+    JqCacheEntry **slots;  // Cached entry by program id - 1, NULL if not cached
+    size_t slotCount;
+    size_t count;
+    uint64_t clock;
+    bool prewarmed;
+    uint64_t : 56;
+} JqThreadCache;
+
+// Written by initJq before the daemon starts, read-only afterwards
+static JqProgram *programs = NULL;
+static size_t programCount = 0;
+static size_t cacheCapacity = DEFAULT_CACHE_SIZE;
 
-static jv janssonToJv(json_t *json) {
+static _Thread_local JqThreadCache *threadCache = NULL;
+static pthread_key_t cacheKey;
+static pthread_once_t cacheKeyOnce = PTHREAD_ONCE_INIT;
+
+static _Atomic uint64_t compilesTotal = 0;
+static _Atomic uint64_t evictionsTotal = 0;
+static _Atomic uint64_t cachedStates = 0;
+static _Atomic uint64_t cachedBytes = 0;
+static size_t nativePrograms = 0;
+static size_t constantSteps = 0;
+static size_t fusedSteps = 0;
+static size_t mergedSteps = 0;
+static _Atomic uint64_t nativeFallbacks = 0;
+
+jv janssonToJv(json_t *json) {
   switch (json_typeof(json)) {
   case JSON_OBJECT: {
     jv obj = jv_object();
@@ -54,7 +120,7 @@ static jv janssonToJv(json_t *json) {
   }
 }
 
-static json_t *jvToJansson(jv value) {
+json_t *jvToJansson(jv value) {
   if (!jv_is_valid(value)) {
     jv_free(value);
     return NULL;
@@ -94,7 +160,7 @@ static json_t *jvToJansson(jv value) {
     result = json_string(jv_string_value(value));
     break;
   case JV_KIND_NUMBER:
-    result = json_real(jv_number_value(value));
+    result = jqNumberToJson(jv_number_value(value));
     break;
   case JV_KIND_TRUE:
     result = json_true();
@@ -113,17 +179,18 @@ static json_t *jvToJansson(jv value) {
   return result;
 }
 
-static jv processJqFilter(jq_state *jq, json_t *input_json) {
-    if (!jq || !input_json) return jv_invalid();
+static jv processJqFilter(jq_state *jq, jv input) {
+    if (!jq) {
+        jv_free(input);
+        return jv_invalid();
+    }
 
-    jv input = janssonToJv(input_json);
-    
     if (!jv_is_valid(input)) {
         jv jv_error = jv_invalid_get_msg(input);
         if (jv_is_valid(jv_error)) {
-            fprintf(stderr, "JSON conversion error: %s\n", jv_string_value(jv_error));
-            jv_free(jv_error);
+            logError("JSON conversion error: %s", jv_string_value(jv_error));
         }
+        jv_free(jv_error);
         return jv_invalid();
     }
 
@@ -134,7 +201,7 @@ static jv processJqFilter(jq_state *jq, json_t *input_json) {
     if (!jv_is_valid(filtered_result)) {
         jv jv_error = jv_invalid_get_msg(filtered_result);
         if (jv_is_valid(jv_error)) {
-            fprintf(stderr, "JQ execution error: %s\n", jv_string_value(jv_error));
+            logError("JQ execution error: %s", jv_string_value(jv_error));
             jv_free(jv_error);
         }
         return filtered_result;  // Already invalid and freed
@@ -150,43 +217,72 @@ static jv processJqFilter(jq_state *jq, json_t *input_json) {
     return filtered_result;
 }
 
-json_t* executeJqStep(PipelineStepNode *step, json_t *input, json_t *requestContext, Arena *arena, ServerContext *ctx) {
-    (void)requestContext;
-    (void)arena;
-    
+static jv jqError(const char *message) {
+    return jv_object_set(jv_object(), jv_string("error"), jv_string(message));
+}
+
+jv executeJqStepJv(PipelineStepNode *step, jv input, ServerContext *ctx) {
+    (void)ctx;
+
     // Get code from named transform if specified
-    const char* code = step->code;
-    if (step->name) {
+    const char* code = step->resolvedCode ? step->resolvedCode : step->code;
+    if (step->name && !step->resolvedCode) {
         TransformNode* namedTransform = findTransform(step->name);
         if (!namedTransform) {
-            json_t *result = json_object();
-            json_object_set_new(result, "error", json_string("Transform not found"));
-            return result;
+            jv_free(input);
+            return jqError("Transform not found");
         }
         code = namedTransform->code;
     }
 
     if (!code) {
-        json_t *result = json_object();
-        json_object_set_new(result, "error", json_string("No transform code found"));
-        return result;
+        jv_free(input);
+        return jqError("No transform code found");
     }
     
-    jq_state *jq = findOrCreateJQ(code, ctx->arena);
+    jq_state *jq = step->jqProgram ? jqStateForProgram(step->jqProgram) : findOrCreateJQ(code);
     if (!jq) {
-        json_t *result = json_object();
-        json_object_set_new(result, "error", json_string("Failed to create JQ state"));
-        return result;
+        jv_free(input);
+        return jqError("Failed to create JQ state");
     }
     
     jv filtered_jv = processJqFilter(jq, input);
     if (!jv_is_valid(filtered_jv)) {
+        jv_free(filtered_jv);
+        return jqError("Failed to process JQ filter");
+    }
+    
+    return filtered_jv;
+}
+
+json_t* executeNativeJq(PipelineStepNode *step, json_t *input) {
+    // Copied so later steps can't change the shared value
+    if (step->constant) return json_deep_copy(step->constant);
+    if (!step->nativeJq || !input) return NULL;
+
+    json_t *result = evaluateNativeJq(step->nativeJq, input);
+    if (!result) {
+        atomic_fetch_add_explicit(&nativeFallbacks, 1, memory_order_relaxed);
+    }
+    return result;
+}
+
+json_t* executeJqStep(PipelineStepNode *step, json_t *input, json_t *requestContext, Arena *arena, ServerContext *ctx) {
+    (void)requestContext;
+    (void)arena;
+
+    if (!input) {
         json_t *result = json_object();
         json_object_set_new(result, "error", json_string("Failed to process JQ filter"));
         return result;
     }
-    
-    json_t *result = jvToJansson(filtered_jv);  // This frees filtered_jv
+
+    json_t *native = executeNativeJq(step, input);
+    if (native) {
+        return native;
+    }
+
+    json_t *result = jvToJansson(executeJqStepJv(step, janssonToJv(input), ctx));  // This frees the jv
     
     if (!result) {
         json_t *error_result = json_object();
@@ -196,3 +292,517 @@ json_t* executeJqStep(PipelineStepNode *step, json_t *input, json_t *requestCont
     
     return result;
 }
+
+// =============================================================================
+// Compiled Filter Cache
+// =============================================================================
+
+// Heap in use, for estimating what a compiled filter costs
+static size_t heapInUse(void) {
+#if defined(__APPLE__)
+    malloc_statistics_t stats;
+    malloc_zone_statistics(NULL, &stats);
+    return stats.size_in_use;
+#elif defined(__GLIBC__)
+    return mallinfo2().uordblks;
+#else
+    return 0;
+#endif
+}
+
+// Keep the first compile error instead of letting jq print it
+static void collectCompileError(void *data, jv message) {
+    char *error = data;
+    if (!error[0] && jv_get_kind(message) == JV_KIND_STRING) {
+        snprintf(error, 512, "%s", jv_string_value(message));
+    }
+    jv_free(message);
+}
+
+static jq_state* compileFilter(const char *filter, const char *where, size_t *bytes) {
+    size_t before = heapInUse();
+    jq_state *jq = jq_init();
+    if (!jq) {
+        fprintf(stderr, "Failed to create JQ state\n");
+        return NULL;
+    }
+
+    char error[512] = {0};
+    jq_set_error_cb(jq, collectCompileError, error);
+    int compiled = jq_compile(jq, filter);
+    jq_set_error_cb(jq, NULL, NULL);
+    if (!compiled) {
+        if (where) fprintf(stderr, "JQ compilation error in %s: %s\n", where, error[0] ? error : filter);
+        jq_teardown(&jq);
+        return NULL;
+    }
+
+    size_t after = heapInUse();
+    if (bytes) *bytes = after > before ? after - before : 0;
+    atomic_fetch_add_explicit(&compilesTotal, 1, memory_order_relaxed);
+    return jq;
+}
+
+static void evictEntry(JqThreadCache *cache, JqCacheEntry *entry) {
+    if (entry->program) cache->slots[entry->program - 1] = NULL;
+    jq_teardown(&entry->jq);
+    free(entry->filter);
+    atomic_fetch_sub_explicit(&cachedStates, 1, memory_order_relaxed);
+    atomic_fetch_sub_explicit(&cachedBytes, entry->bytes, memory_order_relaxed);
+    memset(entry, 0, sizeof(JqCacheEntry));
+}
+
+static void freeThreadCache(void *ptr) {
+    JqThreadCache *cache = ptr;
+    if (!cache) return;
+    for (size_t i = 0; i < cache->count; i++) {
+        evictEntry(cache, &cache->entries[i]);
+    }
+    free(cache->entries);
+    free(cache->slots);
+    free(cache);
+}
+
+static void createCacheKey(void) {
+    pthread_key_create(&cacheKey, freeThreadCache);
+}
+
+static JqThreadCache* getThreadCache(void) {
+    if (threadCache) return threadCache;
+
+    pthread_once(&cacheKeyOnce, createCacheKey);
+    JqThreadCache *cache = calloc(1, sizeof(JqThreadCache));
+    if (!cache) return NULL;
+    cache->entries = calloc(cacheCapacity, sizeof(JqCacheEntry));
+    cache->slots = calloc(programCount ? programCount : 1, sizeof(JqCacheEntry*));
+    if (!cache->entries || !cache->slots) {
+        free(cache->entries);
+        free(cache->slots);
+        free(cache);
+        return NULL;
+    }
+    cache->slotCount = programCount;
+
+    // Freed when the worker thread exits
+    pthread_setspecific(cacheKey, cache);
+    threadCache = cache;
+    return cache;
+}
+
+static jq_state* insertFilter(JqThreadCache *cache, const char *filter, uint32_t hash, uint32_t program) {
+    size_t bytes = 0;
+    jq_state *jq = compileFilter(filter, "jq step", &bytes);
+    if (!jq) return NULL;
+
+    char *copy = strdup(filter);
+    if (!copy) {
+        jq_teardown(&jq);
+        return NULL;
+    }
+
+    // Replace the least recently used state once the cache is full
+    JqCacheEntry *entry;
+    if (cache->count < cacheCapacity) {
+        entry = &cache->entries[cache->count++];
+    } else {
+        entry = &cache->entries[0];
+        for (size_t i = 1; i < cache->count; i++) {
+            if (cache->entries[i].lastUsed < entry->lastUsed) entry = &cache->entries[i];
+        }
+        evictEntry(cache, entry);
+        atomic_fetch_add_explicit(&evictionsTotal, 1, memory_order_relaxed);
+    }
+
+    entry->filter = copy;
+    entry->jq = jq;
+    entry->hash = hash;
+    entry->bytes = bytes;
+    entry->lastUsed = ++cache->clock;
+    if (program && program <= cache->slotCount) {
+        entry->program = program;
+        cache->slots[program - 1] = entry;
+    }
+    atomic_fetch_add_explicit(&cachedStates, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&cachedBytes, bytes, memory_order_relaxed);
+    return jq;
+}
+
+static JqCacheEntry* findEntry(JqThreadCache *cache, const char *filter, uint32_t hash) {
+    for (size_t i = 0; i < cache->count; i++) {
+        JqCacheEntry *entry = &cache->entries[i];
+        if (entry->hash == hash && strcmp(entry->filter, filter) == 0) return entry;
+    }
+    return NULL;
+}
+
+jq_state* findOrCreateJQ(const char *filter) {
+    JqThreadCache *cache = getThreadCache();
+    if (!cache) return NULL;
+
+    uint32_t hash = hashString(filter);
+    JqCacheEntry *entry = findEntry(cache, filter, hash);
+    if (entry) {
+        entry->lastUsed = ++cache->clock;
+        metricsCacheHit(METRICS_CACHE_JQ);
+        return entry->jq;
+    }
+
+    metricsCacheMiss(METRICS_CACHE_JQ);
+    return insertFilter(cache, filter, hash, 0);
+}
+
+uint32_t findJqProgram(const char *filter) {
+    for (size_t i = 0; filter && i < programCount; i++) {
+        if (strcmp(programs[i].filter, filter) == 0) return (uint32_t)i + 1;
+    }
+    return 0;
+}
+
+jq_state* jqStateForProgram(uint32_t program) {
+    JqThreadCache *cache = getThreadCache();
+    if (!cache || program == 0 || program > cache->slotCount) return NULL;
+
+    JqCacheEntry *entry = cache->slots[program - 1];
+    if (!entry) {
+        // Compiled through findOrCreateJQ before the slot was filled
+        const JqProgram *source = &programs[program - 1];
+        entry = findEntry(cache, source->filter, source->hash);
+        if (!entry) {
+            metricsCacheMiss(METRICS_CACHE_JQ);
+            return insertFilter(cache, source->filter, source->hash, program);
+        }
+        entry->program = program;
+        cache->slots[program - 1] = entry;
+    }
+
+    entry->lastUsed = ++cache->clock;
+    metricsCacheHit(METRICS_CACHE_JQ);
+    return entry->jq;
+}
+
+void prewarmJqThread(void) {
+    JqThreadCache *cache = getThreadCache();
+    if (!cache || cache->prewarmed) return;
+    cache->prewarmed = true;
+
+    for (size_t i = 0; i < programCount && cache->count < cacheCapacity; i++) {
+        insertFilter(cache, programs[i].filter, programs[i].hash, (uint32_t)i + 1);
+    }
+}
+
+void releaseJqThread(void) {
+    if (!threadCache) return;
+    freeThreadCache(threadCache);
+    pthread_setspecific(cacheKey, NULL);
+    threadCache = NULL;
+}
+
+void jqCacheStats(JqCacheStats *stats) {
+    stats->programs = programCount;
+    stats->compiles = atomic_load_explicit(&compilesTotal, memory_order_relaxed);
+    stats->evictions = atomic_load_explicit(&evictionsTotal, memory_order_relaxed);
+    stats->cachedStates = atomic_load_explicit(&cachedStates, memory_order_relaxed);
+    stats->cachedBytes = atomic_load_explicit(&cachedBytes, memory_order_relaxed);
+    stats->nativePrograms = nativePrograms;
+    stats->nativeFallbacks = atomic_load_explicit(&nativeFallbacks, memory_order_relaxed);
+    stats->constantSteps = constantSteps;
+    stats->fusedSteps = fusedSteps;
+    stats->mergedSteps = mergedSteps;
+}
+
+// =============================================================================
+// Load-Time Compilation
+// =============================================================================
+
+// Artifact cache key for the linked libjq, so an upgrade rechecks every filter
+static char artifactVersion[PATH_MAX + 64];
+
+// Not every libjq exports jq_version(), so the loaded library is identified by
+// its file instead. A statically linked libjq is keyed by the executable.
+static void identifyLibjq(void) {
+    Dl_info info;
+    struct stat st;
+    if (dladdr((void *)jq_init, &info) && info.dli_fname && stat(info.dli_fname, &st) == 0) {
+        snprintf(artifactVersion, sizeof(artifactVersion), "%s %lld %lld",
+                 info.dli_fname, (long long)st.st_size, (long long)st.st_mtime);
+    } else {
+        // Without an identity nothing is shared between starts
+        snprintf(artifactVersion, sizeof(artifactVersion), "pid %ld", (long)getpid());
+    }
+}
+
+// Whether filter compiles. Successes are remembered in the artifact cache,
+// so unchanged filters skip the check on the next start. Failures are
+// always rechecked, to report them.
+static bool filterCompiles(const char *filter, const char *where) {
+    size_t length = strlen(filter);
+    if (artifactCacheHas("jq", artifactVersion, filter, length)) return true;
+
+    jq_state *jq = compileFilter(filter, where, NULL);
+    if (!jq) return false;
+    jq_teardown(&jq);
+    artifactCachePut("jq", artifactVersion, filter, length, "", 0);
+    return true;
+}
+
+static bool addProgram(const char *filter, const char *where) {
+    uint32_t hash = hashString(filter);
+    for (size_t i = 0; i < programCount; i++) {
+        if (programs[i].hash == hash && strcmp(programs[i].filter, filter) == 0) return true;
+    }
+
+    // Compile once to report errors before any request arrives
+    if (!filterCompiles(filter, where)) return false;
+
+    JqProgram *grown = realloc(programs, (programCount + 1) * sizeof(JqProgram));
+    if (!grown) return false;
+    programs = grown;
+    programs[programCount].filter = strdup(filter);
+    programs[programCount].hash = hash;
+    if (!programs[programCount].filter) return false;
+    programCount++;
+    return true;
+}
+
+// The filter a step runs, looking up named transforms
+static const char* stepFilter(PipelineStepNode *step) {
+    if (!step->name) return step->code;
+    TransformNode *transform = findTransform(step->name);
+    return transform ? transform->code : NULL;
+}
+
+static bool addPipelinePrograms(PipelineStepNode *step, const char *method, const char *route, Arena *arena) {
+    char where[256];
+    snprintf(where, sizeof(where), "%s %s", method, route);
+
+    for (; step; step = step->next) {
+        if (step->type != STEP_JQ) continue;
+
+        const char *code = step->code;
+        if (step->name) {
+            TransformNode *transform = findTransform(step->name);
+            if (!transform) {
+                fprintf(stderr, "Transform not found in %s: %s\n", where, step->name);
+                return false;
+            }
+            code = transform->code;
+        }
+        if (!code) continue;
+        if (!addProgram(code, where)) return false;
+
+        // Steps within the native subset skip libjq altogether
+        step->nativeJq = compileNativeJq(code, arena);
+        if (step->nativeJq) nativePrograms++;
+    }
+    return true;
+}
+
+// =============================================================================
+// Constant Folding
+// =============================================================================
+
+// Folded values live as long as the website they came from
+static Arena *constantArena = NULL;
+
+static void* constantMalloc(size_t size) {
+    return arenaAlloc(constantArena, size);
+}
+
+static void constantFree(void *ptr) {
+    (void)ptr;
+}
+
+static bool stopsPipeline(json_t *value) {
+    return json_object_get(value, "error") || json_object_get(value, "redirect");
+}
+
+// Evaluate steps that ignore their input once, then fold the native steps
+// that follow them into the same value
+static void foldPipeline(PipelineStepNode *step) {
+    for (; step; step = step->next) {
+        if (step->type != STEP_JQ || !nativeJqIsConstant(step->nativeJq)) continue;
+
+        json_t *input = json_null();
+        json_t *value = evaluateNativeJq(step->nativeJq, input);
+        json_decref(input);
+        if (!value) continue;
+
+        while (step->next && step->next->type == STEP_JQ && step->next->nativeJq && !stopsPipeline(value)) {
+            json_t *folded = evaluateNativeJq(step->next->nativeJq, value);
+            if (!folded) break;
+            json_decref(value);
+            value = folded;
+            step->next = step->next->next;
+            fusedSteps++;
+        }
+
+        step->constant = value;
+        constantSteps++;
+    }
+}
+
+// Workers aren't running yet, so the allocator can be swapped briefly
+static void foldConstants(ServerContext *ctx) {
+    json_malloc_t previousMalloc;
+    json_free_t previousFree;
+    json_get_alloc_funcs(&previousMalloc, &previousFree);
+    constantArena = ctx->arena;
+    json_set_alloc_funcs(constantMalloc, constantFree);
+
+    for (ApiEndpoint *api = ctx->website->apiHead; api; api = api->next) {
+        foldPipeline(api->pipeline);
+    }
+    for (PageNode *page = ctx->website->pageHead; page; page = page->next) {
+        foldPipeline(page->pipeline);
+        foldPipeline(page->referenceData);
+    }
+
+    json_set_alloc_funcs(previousMalloc, previousFree);
+    constantArena = NULL;
+}
+
+// =============================================================================
+// Step Fusion
+// =============================================================================
+
+// Runs a then b, but hands over a's first output only and leaves b out when
+// that output carries an error or redirect, as separate steps would. The
+// newlines end any comment inside a or b.
+static char* fuseFilters(const char *a, const char *b, Arena *arena) {
+    static const char *format =
+        "first(\n%s\n) | if type == \"object\" and (has(\"error\") or has(\"redirect\")) "
+        "then . else (\n%s\n) end";
+    int length = snprintf(NULL, 0, format, a, b);
+    if (length < 0) return NULL;
+    char *fused = arenaAlloc(arena, (size_t)length + 1);
+    if (fused) snprintf(fused, (size_t)length + 1, format, a, b);
+    return fused;
+}
+
+// Whether a step would get its input as a jv and run through libjq anyway
+static bool needsLibjq(PipelineStepNode *step) {
+    return step->type == STEP_JQ && !step->constant && !step->nativeJq;
+}
+
+// Merge each run of jq steps that starts with a libjq step into one program,
+// saving the per-step setup and checks. Runs starting with native or
+// constant steps are left alone, as those skip libjq entirely.
+static bool fusePipeline(PipelineStepNode *step, const char *method, const char *route, Arena *arena) {
+    char where[256];
+    snprintf(where, sizeof(where), "%s %s", method, route);
+
+    for (; step; step = step->next) {
+        if (!needsLibjq(step)) continue;
+
+        while (step->next && step->next->type == STEP_JQ && !step->next->constant) {
+            const char *first = stepFilter(step);
+            const char *second = stepFilter(step->next);
+            if (!first || !second) break;
+
+            // Fall back to separate steps if the pair won't compile together
+            char *fused = fuseFilters(first, second, arena);
+            if (!fused || !filterCompiles(fused, NULL)) break;
+
+            step->code = fused;
+            step->name = NULL;
+            step->next = step->next->next;
+            mergedSteps++;
+        }
+        const char *filter = stepFilter(step);
+        if (filter && !addProgram(filter, where)) return false;
+    }
+    return true;
+}
+
+// Drop load-time programs that folding and fusion left without a step, so
+// threads don't prewarm them
+static void pruneProgram(PipelineStepNode *step, bool *used) {
+    for (; step; step = step->next) {
+        if (step->type != STEP_JQ || step->constant) continue;
+        const char *filter = stepFilter(step);
+        for (size_t i = 0; filter && i < programCount; i++) {
+            if (strcmp(programs[i].filter, filter) == 0) used[i] = true;
+        }
+    }
+}
+
+static void pruneUnusedPrograms(ServerContext *ctx) {
+    bool *used = calloc(programCount ? programCount : 1, sizeof(bool));
+    if (!used) return;
+
+    for (ApiEndpoint *api = ctx->website->apiHead; api; api = api->next) {
+        pruneProgram(api->pipeline, used);
+    }
+    for (PageNode *page = ctx->website->pageHead; page; page = page->next) {
+        pruneProgram(page->pipeline, used);
+        pruneProgram(page->referenceData, used);
+    }
+
+    size_t kept = 0;
+    for (size_t i = 0; i < programCount; i++) {
+        if (used[i]) {
+            programs[kept++] = programs[i];
+        } else {
+            free(programs[i].filter);
+        }
+    }
+    programCount = kept;
+    free(used);
+}
+
+bool initJq(ServerContext *ctx) {
+    if (!ctx || !ctx->website) return false;
+    cleanupJq();
+
+    const char *size = getenv("WEBDSL_JQ_CACHE_SIZE");
+    cacheCapacity = DEFAULT_CACHE_SIZE;
+    if (size && atoi(size) > 0) {
+        cacheCapacity = (size_t)atoi(size);
+    }
+    identifyLibjq();
+
+    for (TransformNode *transform = ctx->website->transformHead; transform; transform = transform->next) {
+        if (transform->type != FILTER_JQ || !transform->code) continue;
+        char where[256];
+        snprintf(where, sizeof(where), "transform %s", transform->name ? transform->name : "(unnamed)");
+        if (!addProgram(transform->code, where)) return false;
+    }
+
+    for (ApiEndpoint *api = ctx->website->apiHead; api; api = api->next) {
+        if (!addPipelinePrograms(api->pipeline, api->method ? api->method : "GET", api->route, ctx->arena)) return false;
+    }
+
+    for (PageNode *page = ctx->website->pageHead; page; page = page->next) {
+        if (!addPipelinePrograms(page->pipeline, "page", page->route, ctx->arena)) return false;
+        if (!addPipelinePrograms(page->referenceData, "referenceData", page->route, ctx->arena)) return false;
+    }
+
+    foldConstants(ctx);
+
+    for (ApiEndpoint *api = ctx->website->apiHead; api; api = api->next) {
+        if (!fusePipeline(api->pipeline, api->method ? api->method : "GET", api->route, ctx->arena)) return false;
+    }
+
+    for (PageNode *page = ctx->website->pageHead; page; page = page->next) {
+        if (!fusePipeline(page->pipeline, "page", page->route, ctx->arena)) return false;
+        if (!fusePipeline(page->referenceData, "referenceData", page->route, ctx->arena)) return false;
+    }
+
+    pruneUnusedPrograms(ctx);
+
+    return true;
+}
+
+void cleanupJq(void) {
+    releaseJqThread();
+    for (size_t i = 0; i < programCount; i++) {
+        free(programs[i].filter);
+    }
+    free(programs);
+    programs = NULL;
+    programCount = 0;
+    nativePrograms = 0;
+    constantSteps = 0;
+    fusedSteps = 0;
+    mergedSteps = 0;
+}
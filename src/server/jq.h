@@ -10,6 +10,57 @@
 #include "../ast.h"
 #include "server.h"
 
+typedef struct JqCacheStats {
+    size_t programs;        // Distinct filters compiled at load time
+    uint64_t compiles;      // jq_compile calls, across all threads
+    uint64_t evictions;     // States dropped from full per-thread caches
+    uint64_t cachedStates;  // States currently cached, across all threads
+    uint64_t cachedBytes;   // Estimated heap held by those states
+    size_t nativePrograms;  // Steps compiled to the native evaluator
+    uint64_t nativeFallbacks;  // Native runs handed back to libjq
+    size_t constantSteps;   // Steps answered with a value folded at load time
+    size_t fusedSteps;      // Steps merged into a preceding constant
+    size_t mergedSteps;     // Steps merged into a fused libjq program
+} JqCacheStats;
+
+// Compile every jq step and jq transform once at load time, reporting the
+// first invalid filter. Steps that don't depend on their input are
+// evaluated here too, along with the native steps right after them, and
+// consecutive libjq steps are fused into one program per route.
+// jq_state is not thread-safe, so each worker thread keeps its own states
+// in an LRU cache of WEBDSL_JQ_CACHE_SIZE (default 64).
+bool initJq(ServerContext *ctx);
+void cleanupJq(void);
+
+// Compile the load-time filters into this thread's cache, once per thread
+void prewarmJqThread(void);
+
+// This thread's state for filter, compiled on a miss
+jq_state* findOrCreateJQ(const char *filter);
+
+// Id of a load-time program for linking steps to it, 0 if filter isn't one
+uint32_t findJqProgram(const char *filter);
+
+// This thread's state for a load-time program, found without hashing
+jq_state* jqStateForProgram(uint32_t program);
+
+// Free this thread's cache. Worker threads free theirs on exit.
+void releaseJqThread(void);
+
+void jqCacheStats(JqCacheStats *stats);
+
+// Convert between jansson and jq values. jvToJansson consumes its argument.
+jv janssonToJv(json_t *json);
+json_t *jvToJansson(jv value);
+
+// Run a JQ step on a jv input, which is consumed. Failures return an object
+// with an "error" key, as executeJqStep does.
+jv executeJqStepJv(PipelineStepNode *step, jv input, ServerContext *ctx);
+
+// Run a step without libjq: a copy of its load-time constant, or its native
+// evaluator. NULL when the step has neither or the input needs libjq.
+json_t* executeNativeJq(PipelineStepNode *step, json_t *input);
+
 // Execute a JQ pipeline step
 json_t* executeJqStep(PipelineStepNode *step, json_t *input, json_t *requestContext, Arena *arena, ServerContext *ctx);
 
@@ -0,0 +1,996 @@
+#include "jq_native.h"
+#include <ctype.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef enum {
+    NODE_IDENTITY,  // .
+    NODE_FIELD,     // .name, ."name", .["name"]
+    NODE_INDEX,     // .[n]
+    NODE_ITERATE,   // .[]
+    NODE_PIPE,      // left | right
+    NODE_COMMA,     // left, right
+    NODE_LITERAL,
+    NODE_OBJECT,    // { key: value, ... }
+    NODE_ARRAY,     // [ left ]
+    NODE_MAP,       // map(left)
+    NODE_SELECT,    // select(left)
+    NODE_NOT,
+    NODE_AND,
+    NODE_OR,
+    NODE_COMPARE
+} NodeKind;
+
+typedef enum {
+    LITERAL_NULL,
+    LITERAL_TRUE,
+    LITERAL_FALSE,
+    LITERAL_NUMBER,
+    LITERAL_STRING
+} LiteralKind;
+
+typedef enum {
+    COMPARE_EQ,
+    COMPARE_NEQ,
+    COMPARE_LT,
+    COMPARE_LE,
+    COMPARE_GT,
+    COMPARE_GE
+} CompareOp;
+
+typedef struct ObjectEntry {
+    const char *key;
+    struct Node *value;
+    struct ObjectEntry *next;
+} ObjectEntry;
+
+typedef struct Node {
+    const char *name;       // Field name or string literal
+    struct Node *left;
+    struct Node *right;
+    ObjectEntry *entries;
+    double number;          // Number literal
+    long long index;        // Array index, negative counts from the end
+    NodeKind kind;
+    int op;                 // LiteralKind or CompareOp
+    bool multi;             // May produce more than one output
+    uint64_t : 56;
+} Node;
+
+struct NativeJq {
+    Node *root;
+};
+
+// =============================================================================
+// Lexer
+// =============================================================================
+
+typedef enum {
+    TOK_END,
+    TOK_INVALID,
+    TOK_DOT,
+    TOK_FIELD,      // .name
+    TOK_IDENT,
+    TOK_STRING,
+    TOK_NUMBER,
+    TOK_LBRACE,
+    TOK_RBRACE,
+    TOK_LBRACKET,
+    TOK_RBRACKET,
+    TOK_LPAREN,
+    TOK_RPAREN,
+    TOK_COMMA,
+    TOK_COLON,
+    TOK_PIPE,
+    TOK_MINUS,
+    TOK_EQ,
+    TOK_NEQ,
+    TOK_LT,
+    TOK_LE,
+    TOK_GT,
+    TOK_GE
+} TokenType;
+
+typedef struct Token {
+    const char *text;   // Identifier, field or decoded string
+    double number;
+    TokenType type;
+    uint64_t : 32;
+} Token;
+
+typedef struct NativeParser {
+    const char *p;
+    Arena *arena;
+    Token token;
+} NativeParser;
+
+static bool isIdentStart(char c) {
+    return isalpha((unsigned char)c) || c == '_';
+}
+
+static bool isIdentChar(char c) {
+    return isalnum((unsigned char)c) || c == '_';
+}
+
+static char* dupRange(Arena *arena, const char *start, size_t length) {
+    char *copy = arenaAlloc(arena, length + 1);
+    if (!copy) return NULL;
+    memcpy(copy, start, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+static const char* lexIdent(NativeParser *parser) {
+    const char *start = parser->p;
+    while (isIdentChar(*parser->p)) parser->p++;
+    // Module paths (a::b) are not supported
+    if (parser->p[0] == ':' && parser->p[1] == ':') return NULL;
+    return dupRange(parser->arena, start, (size_t)(parser->p - start));
+}
+
+static size_t encodeUtf8(uint32_t codepoint, char *out) {
+    if (codepoint < 0x80) {
+        out[0] = (char)codepoint;
+        return 1;
+    }
+    if (codepoint < 0x800) {
+        out[0] = (char)(0xC0 | (codepoint >> 6));
+        out[1] = (char)(0x80 | (codepoint & 0x3F));
+        return 2;
+    }
+    out[0] = (char)(0xE0 | (codepoint >> 12));
+    out[1] = (char)(0x80 | ((codepoint >> 6) & 0x3F));
+    out[2] = (char)(0x80 | (codepoint & 0x3F));
+    return 3;
+}
+
+// Decode a string literal. Interpolation and surrogate pairs are left to libjq.
+static const char* lexString(NativeParser *parser) {
+    const char *p = parser->p + 1;
+    size_t capacity = strlen(p) + 1;
+    char *out = arenaAlloc(parser->arena, capacity);
+    if (!out) return NULL;
+    size_t length = 0;
+
+    while (*p && *p != '"') {
+        if (*p != '\\') {
+            out[length++] = *p++;
+            continue;
+        }
+        p++;
+        switch (*p) {
+            case '"': out[length++] = '"'; break;
+            case '\\': out[length++] = '\\'; break;
+            case '/': out[length++] = '/'; break;
+            case 'b': out[length++] = '\b'; break;
+            case 'f': out[length++] = '\f'; break;
+            case 'n': out[length++] = '\n'; break;
+            case 'r': out[length++] = '\r'; break;
+            case 't': out[length++] = '\t'; break;
+            case 'u': {
+                char hex[5] = {0};
+                for (int i = 0; i < 4; i++) {
+                    if (!isxdigit((unsigned char)p[1 + i])) return NULL;
+                    hex[i] = p[1 + i];
+                }
+                uint32_t codepoint = (uint32_t)strtoul(hex, NULL, 16);
+                if (codepoint == 0 || (codepoint >= 0xD800 && codepoint <= 0xDFFF)) return NULL;
+                length += encodeUtf8(codepoint, out + length);
+                p += 4;
+                break;
+            }
+            default:
+                return NULL;
+        }
+        p++;
+    }
+    if (*p != '"') return NULL;
+
+    out[length] = '\0';
+    parser->p = p + 1;
+    return out;
+}
+
+static void nextToken(NativeParser *parser) {
+    while (isspace((unsigned char)*parser->p)) parser->p++;
+
+    Token *token = &parser->token;
+    token->text = NULL;
+    token->type = TOK_INVALID;
+
+    char c = *parser->p;
+    if (c == '\0') {
+        token->type = TOK_END;
+        return;
+    }
+
+    if (c == '.') {
+        parser->p++;
+        if (isIdentStart(*parser->p)) {
+            token->text = lexIdent(parser);
+            token->type = token->text ? TOK_FIELD : TOK_INVALID;
+        } else if (*parser->p != '.') {  // .. is recursive descent
+            token->type = TOK_DOT;
+        }
+        return;
+    }
+
+    if (isIdentStart(c)) {
+        token->text = lexIdent(parser);
+        token->type = token->text ? TOK_IDENT : TOK_INVALID;
+        return;
+    }
+
+    if (c == '"') {
+        token->text = lexString(parser);
+        token->type = token->text ? TOK_STRING : TOK_INVALID;
+        return;
+    }
+
+    if (isdigit((unsigned char)c)) {
+        char *end = NULL;
+        token->number = strtod(parser->p, &end);
+        parser->p = end;
+        token->type = TOK_NUMBER;
+        return;
+    }
+
+    char next = parser->p[1];
+    parser->p++;
+    switch (c) {
+        case '{': token->type = TOK_LBRACE; break;
+        case '}': token->type = TOK_RBRACE; break;
+        case '[': token->type = TOK_LBRACKET; break;
+        case ']': token->type = TOK_RBRACKET; break;
+        case '(': token->type = TOK_LPAREN; break;
+        case ')': token->type = TOK_RPAREN; break;
+        case ',': token->type = TOK_COMMA; break;
+        case ':': token->type = TOK_COLON; break;
+        case '|':
+            // |= is an update assignment
+            if (next != '=') token->type = TOK_PIPE;
+            break;
+        case '-':
+            if (next != '=') token->type = TOK_MINUS;
+            break;
+        case '=':
+            if (next == '=') {
+                parser->p++;
+                token->type = TOK_EQ;
+            }
+            break;
+        case '!':
+            if (next == '=') {
+                parser->p++;
+                token->type = TOK_NEQ;
+            }
+            break;
+        case '<':
+            if (next == '=') parser->p++;
+            token->type = next == '=' ? TOK_LE : TOK_LT;
+            break;
+        case '>':
+            if (next == '=') parser->p++;
+            token->type = next == '=' ? TOK_GE : TOK_GT;
+            break;
+        default:
+            break;
+    }
+}
+
+// =============================================================================
+// Parser
+// =============================================================================
+
+static Node* parsePipe(NativeParser *parser);
+static Node* parsePostfix(NativeParser *parser);
+
+static Node* newNode(NativeParser *parser, NodeKind kind) {
+    Node *node = arenaAlloc(parser->arena, sizeof(Node));
+    if (!node) return NULL;
+    memset(node, 0, sizeof(Node));
+    node->kind = kind;
+    return node;
+}
+
+static Node* newBinary(NativeParser *parser, NodeKind kind, Node *left, Node *right) {
+    if (!left || !right) return NULL;
+    Node *node = newNode(parser, kind);
+    if (!node) return NULL;
+    node->left = left;
+    node->right = right;
+    node->multi = kind == NODE_COMMA || left->multi || right->multi;
+    return node;
+}
+
+static bool expect(NativeParser *parser, TokenType type) {
+    if (parser->token.type != type) return false;
+    nextToken(parser);
+    return true;
+}
+
+static Node* fieldNode(NativeParser *parser, const char *name) {
+    Node *node = newNode(parser, NODE_FIELD);
+    if (node) node->name = name;
+    return node;
+}
+
+static Node* literalNode(NativeParser *parser, LiteralKind kind) {
+    Node *node = newNode(parser, NODE_LITERAL);
+    if (node) node->op = kind;
+    return node;
+}
+
+// After '[' following a term: ], a number or a string
+static Node* parseBracket(NativeParser *parser) {
+    if (expect(parser, TOK_RBRACKET)) {
+        Node *node = newNode(parser, NODE_ITERATE);
+        if (node) node->multi = true;
+        return node;
+    }
+
+    if (parser->token.type == TOK_STRING) {
+        Node *node = fieldNode(parser, parser->token.text);
+        nextToken(parser);
+        return expect(parser, TOK_RBRACKET) ? node : NULL;
+    }
+
+    bool negative = expect(parser, TOK_MINUS);
+    if (parser->token.type != TOK_NUMBER) return NULL;
+    double number = parser->token.number;
+    nextToken(parser);
+    if (number != floor(number) || number > 1e15 || !expect(parser, TOK_RBRACKET)) return NULL;
+
+    Node *node = newNode(parser, NODE_INDEX);
+    if (node) node->index = negative ? -(long long)number : (long long)number;
+    return node;
+}
+
+static Node* parseObject(NativeParser *parser) {
+    Node *object = newNode(parser, NODE_OBJECT);
+    if (!object) return NULL;
+    ObjectEntry **tail = &object->entries;
+
+    while (parser->token.type != TOK_RBRACE) {
+        if (parser->token.type != TOK_IDENT && parser->token.type != TOK_STRING) return NULL;
+        const char *key = parser->token.text;
+        nextToken(parser);
+
+        Node *value;
+        if (expect(parser, TOK_COLON)) {
+            // Object values are a pipe of terms; commas separate entries
+            value = parsePostfix(parser);
+            while (value && expect(parser, TOK_PIPE)) {
+                value = newBinary(parser, NODE_PIPE, value, parsePostfix(parser));
+            }
+        } else {
+            // {id} is {id: .id}
+            value = fieldNode(parser, key);
+        }
+        if (!value) return NULL;
+
+        ObjectEntry *entry = arenaAlloc(parser->arena, sizeof(ObjectEntry));
+        if (!entry) return NULL;
+        entry->key = key;
+        entry->value = value;
+        entry->next = NULL;
+        *tail = entry;
+        tail = &entry->next;
+        object->multi = object->multi || value->multi;
+
+        if (!expect(parser, TOK_COMMA)) break;
+    }
+    return expect(parser, TOK_RBRACE) ? object : NULL;
+}
+
+// map(f) and select(f)
+static Node* parseCall(NativeParser *parser, NodeKind kind) {
+    if (!expect(parser, TOK_LPAREN)) return NULL;
+    Node *body = parsePipe(parser);
+    if (!body || !expect(parser, TOK_RPAREN)) return NULL;
+    // A condition with several outputs selects several times
+    if (kind == NODE_SELECT && body->multi) return NULL;
+
+    Node *node = newNode(parser, kind);
+    if (node) node->left = body;
+    return node;
+}
+
+static Node* parseTerm(NativeParser *parser) {
+    Token token = parser->token;
+    nextToken(parser);
+
+    switch (token.type) {
+        case TOK_DOT:
+            if (parser->token.type == TOK_STRING) {
+                Node *node = fieldNode(parser, parser->token.text);
+                nextToken(parser);
+                return node;
+            }
+            if (expect(parser, TOK_LBRACKET)) return parseBracket(parser);
+            return newNode(parser, NODE_IDENTITY);
+
+        case TOK_FIELD:
+            return fieldNode(parser, token.text);
+
+        case TOK_MINUS:
+            if (parser->token.type != TOK_NUMBER) return NULL;
+            parser->token.number = -parser->token.number;
+            return parseTerm(parser);
+
+        case TOK_NUMBER: {
+            Node *node = literalNode(parser, LITERAL_NUMBER);
+            if (node) node->number = token.number;
+            return node;
+        }
+
+        case TOK_STRING: {
+            Node *node = literalNode(parser, LITERAL_STRING);
+            if (node) node->name = token.text;
+            return node;
+        }
+
+        case TOK_IDENT:
+            if (strcmp(token.text, "null") == 0) return literalNode(parser, LITERAL_NULL);
+            if (strcmp(token.text, "true") == 0) return literalNode(parser, LITERAL_TRUE);
+            if (strcmp(token.text, "false") == 0) return literalNode(parser, LITERAL_FALSE);
+            if (strcmp(token.text, "not") == 0) return newNode(parser, NODE_NOT);
+            if (strcmp(token.text, "map") == 0) return parseCall(parser, NODE_MAP);
+            if (strcmp(token.text, "select") == 0) return parseCall(parser, NODE_SELECT);
+            return NULL;
+
+        case TOK_LBRACE:
+            return parseObject(parser);
+
+        case TOK_LBRACKET: {
+            Node *node = newNode(parser, NODE_ARRAY);
+            if (!node || expect(parser, TOK_RBRACKET)) return node;
+            node->left = parsePipe(parser);
+            return node->left && expect(parser, TOK_RBRACKET) ? node : NULL;
+        }
+
+        case TOK_LPAREN: {
+            Node *node = parsePipe(parser);
+            return node && expect(parser, TOK_RPAREN) ? node : NULL;
+        }
+
+        default:
+            return NULL;
+    }
+}
+
+// A term followed by .name, ."name", [n], ["name"] or []
+static Node* parsePostfix(NativeParser *parser) {
+    Node *node = parseTerm(parser);
+    while (node) {
+        Node *suffix;
+        if (parser->token.type == TOK_FIELD) {
+            suffix = fieldNode(parser, parser->token.text);
+            nextToken(parser);
+        } else if (parser->token.type == TOK_DOT) {
+            nextToken(parser);
+            if (parser->token.type != TOK_STRING) return NULL;
+            suffix = fieldNode(parser, parser->token.text);
+            nextToken(parser);
+        } else if (expect(parser, TOK_LBRACKET)) {
+            suffix = parseBracket(parser);
+        } else {
+            break;
+        }
+        node = newBinary(parser, NODE_PIPE, node, suffix);
+    }
+    return node;
+}
+
+static Node* parseComparison(NativeParser *parser) {
+    Node *left = parsePostfix(parser);
+    if (!left) return NULL;
+
+    CompareOp op;
+    switch (parser->token.type) {
+        case TOK_EQ: op = COMPARE_EQ; break;
+        case TOK_NEQ: op = COMPARE_NEQ; break;
+        case TOK_LT: op = COMPARE_LT; break;
+        case TOK_LE: op = COMPARE_LE; break;
+        case TOK_GT: op = COMPARE_GT; break;
+        case TOK_GE: op = COMPARE_GE; break;
+        default: return left;
+    }
+    nextToken(parser);
+
+    Node *node = newBinary(parser, NODE_COMPARE, left, parsePostfix(parser));
+    if (!node || node->multi) return NULL;
+    node->op = op;
+    return node;
+}
+
+static bool isKeyword(NativeParser *parser, const char *keyword) {
+    return parser->token.type == TOK_IDENT && strcmp(parser->token.text, keyword) == 0;
+}
+
+static Node* parseAnd(NativeParser *parser) {
+    Node *node = parseComparison(parser);
+    while (node && isKeyword(parser, "and")) {
+        nextToken(parser);
+        node = newBinary(parser, NODE_AND, node, parseComparison(parser));
+        if (node && node->multi) return NULL;
+    }
+    return node;
+}
+
+static Node* parseOr(NativeParser *parser) {
+    Node *node = parseAnd(parser);
+    while (node && isKeyword(parser, "or")) {
+        nextToken(parser);
+        node = newBinary(parser, NODE_OR, node, parseAnd(parser));
+        if (node && node->multi) return NULL;
+    }
+    return node;
+}
+
+static Node* parseComma(NativeParser *parser) {
+    Node *node = parseOr(parser);
+    while (node && expect(parser, TOK_COMMA)) {
+        node = newBinary(parser, NODE_COMMA, node, parseOr(parser));
+    }
+    return node;
+}
+
+static Node* parsePipe(NativeParser *parser) {
+    Node *node = parseComma(parser);
+    if (node && expect(parser, TOK_PIPE)) {
+        node = newBinary(parser, NODE_PIPE, node, parsePipe(parser));
+    }
+    return node;
+}
+
+NativeJq* compileNativeJq(const char *filter, Arena *arena) {
+    if (!filter || !arena) return NULL;
+
+    NativeParser parser = {0};
+    parser.p = filter;
+    parser.arena = arena;
+    nextToken(&parser);
+
+    Node *root = parsePipe(&parser);
+    if (!root || parser.token.type != TOK_END) return NULL;
+
+    NativeJq *program = arenaAlloc(arena, sizeof(NativeJq));
+    if (program) program->root = root;
+    return program;
+}
+
+// =============================================================================
+// Evaluator
+// =============================================================================
+
+typedef enum {
+    EVAL_OK,
+    EVAL_EMPTY,     // No output
+    EVAL_FALLBACK   // Outside the subset, run libjq instead
+} EvalStatus;
+
+static EvalStatus evalAll(const Node *node, json_t *input, json_t *outputs);
+
+static bool isTruthy(const json_t *value) {
+    return !json_is_null(value) && !json_is_false(value);
+}
+
+// jq's ordering: null < false < true < numbers < strings < arrays < objects
+static int kindRank(const json_t *value) {
+    switch (json_typeof(value)) {
+        case JSON_NULL: return 0;
+        case JSON_FALSE: return 1;
+        case JSON_TRUE: return 2;
+        case JSON_INTEGER:
+        case JSON_REAL: return 3;
+        case JSON_STRING: return 4;
+        case JSON_ARRAY: return 5;
+        case JSON_OBJECT: return 6;
+    }
+    return 7;
+}
+
+// Arrays and objects compare element by element in jq; those go to libjq
+static bool compareValues(const json_t *a, const json_t *b, int *result) {
+    int rankA = kindRank(a);
+    int rankB = kindRank(b);
+    if (rankA != rankB) {
+        *result = rankA < rankB ? -1 : 1;
+        return true;
+    }
+
+    switch (rankA) {
+        case 3: {
+            double x = json_number_value(a);
+            double y = json_number_value(b);
+            *result = x < y ? -1 : x > y ? 1 : 0;
+            return true;
+        }
+        case 4: {
+            size_t lengthA = json_string_length(a);
+            size_t lengthB = json_string_length(b);
+            int cmp = memcmp(json_string_value(a), json_string_value(b), lengthA < lengthB ? lengthA : lengthB);
+            *result = cmp != 0 ? cmp : lengthA < lengthB ? -1 : lengthA > lengthB ? 1 : 0;
+            return true;
+        }
+        case 5:
+        case 6:
+            return false;
+        default:
+            *result = 0;
+            return true;
+    }
+}
+
+// jq prints integral numbers without a fraction
+static bool isIntegral(double number) {
+    return number == floor(number) && fabs(number) < 9007199254740992.0;
+}
+
+json_t* jqNumberToJson(double number) {
+    if (isIntegral(number)) {
+        return json_integer((json_int_t)number);
+    }
+    return json_real(number);
+}
+
+static json_t* literalValue(const Node *node) {
+    switch ((LiteralKind)node->op) {
+        case LITERAL_NULL: return json_null();
+        case LITERAL_TRUE: return json_true();
+        case LITERAL_FALSE: return json_false();
+        case LITERAL_STRING: return json_string(node->name);
+        case LITERAL_NUMBER: return jqNumberToJson(node->number);
+    }
+    return NULL;
+}
+
+static EvalStatus evalOne(const Node *node, json_t *input, json_t **out) {
+    *out = NULL;
+
+    // Streams must turn out to have exactly one value
+    if (node->multi) {
+        json_t *outputs = json_array();
+        if (!outputs) return EVAL_FALLBACK;
+        EvalStatus status = evalAll(node, input, outputs);
+        size_t count = json_array_size(outputs);
+        if (status == EVAL_OK && count == 1) {
+            *out = json_incref(json_array_get(outputs, 0));
+        } else if (status == EVAL_OK && count == 0) {
+            status = EVAL_EMPTY;
+        } else {
+            status = EVAL_FALLBACK;
+        }
+        json_decref(outputs);
+        return status;
+    }
+
+    switch (node->kind) {
+        case NODE_IDENTITY:
+            *out = json_incref(input);
+            return EVAL_OK;
+
+        case NODE_FIELD:
+            if (json_is_object(input)) {
+                json_t *value = json_object_get(input, node->name);
+                *out = value ? json_incref(value) : json_null();
+                return EVAL_OK;
+            }
+            if (json_is_null(input)) {
+                *out = json_null();
+                return EVAL_OK;
+            }
+            return EVAL_FALLBACK;  // jq raises "Cannot index ..."
+
+        case NODE_INDEX:
+            if (json_is_array(input)) {
+                long long size = (long long)json_array_size(input);
+                long long index = node->index < 0 ? size + node->index : node->index;
+                json_t *value = index >= 0 && index < size ? json_array_get(input, (size_t)index) : NULL;
+                *out = value ? json_incref(value) : json_null();
+                return EVAL_OK;
+            }
+            if (json_is_null(input)) {
+                *out = json_null();
+                return EVAL_OK;
+            }
+            return EVAL_FALLBACK;
+
+        case NODE_LITERAL:
+            *out = literalValue(node);
+            return *out ? EVAL_OK : EVAL_FALLBACK;
+
+        case NODE_PIPE: {
+            json_t *middle = NULL;
+            EvalStatus status = evalOne(node->left, input, &middle);
+            if (status != EVAL_OK) return status;
+            status = evalOne(node->right, middle, out);
+            json_decref(middle);
+            return status;
+        }
+
+        case NODE_OBJECT: {
+            json_t *object = json_object();
+            if (!object) return EVAL_FALLBACK;
+            for (ObjectEntry *entry = node->entries; entry; entry = entry->next) {
+                json_t *value = NULL;
+                EvalStatus status = evalOne(entry->value, input, &value);
+                if (status != EVAL_OK || json_object_set_new(object, entry->key, value) != 0) {
+                    json_decref(object);
+                    return status != EVAL_OK ? status : EVAL_FALLBACK;
+                }
+            }
+            *out = object;
+            return EVAL_OK;
+        }
+
+        case NODE_ARRAY: {
+            json_t *array = json_array();
+            if (!array) return EVAL_FALLBACK;
+            if (node->left && evalAll(node->left, input, array) != EVAL_OK) {
+                json_decref(array);
+                return EVAL_FALLBACK;
+            }
+            *out = array;
+            return EVAL_OK;
+        }
+
+        case NODE_MAP: {
+            // map over an object iterates its values; leave that to libjq
+            if (!json_is_array(input)) return EVAL_FALLBACK;
+            json_t *array = json_array();
+            if (!array) return EVAL_FALLBACK;
+            size_t i;
+            json_t *element;
+            json_array_foreach(input, i, element) {
+                if (evalAll(node->left, element, array) != EVAL_OK) {
+                    json_decref(array);
+                    return EVAL_FALLBACK;
+                }
+            }
+            *out = array;
+            return EVAL_OK;
+        }
+
+        case NODE_SELECT: {
+            json_t *condition = NULL;
+            EvalStatus status = evalOne(node->left, input, &condition);
+            if (status != EVAL_OK) return status;
+            bool keep = isTruthy(condition);
+            json_decref(condition);
+            if (!keep) return EVAL_EMPTY;
+            *out = json_incref(input);
+            return EVAL_OK;
+        }
+
+        case NODE_NOT:
+            *out = json_boolean(!isTruthy(input));
+            return EVAL_OK;
+
+        case NODE_AND:
+        case NODE_OR: {
+            json_t *left = NULL;
+            EvalStatus status = evalOne(node->left, input, &left);
+            if (status != EVAL_OK) return status;
+            bool truthy = isTruthy(left);
+            json_decref(left);
+
+            // Short-circuits like jq
+            if (truthy == (node->kind == NODE_OR)) {
+                *out = json_boolean(truthy);
+                return EVAL_OK;
+            }
+
+            json_t *right = NULL;
+            status = evalOne(node->right, input, &right);
+            if (status != EVAL_OK) return status;
+            *out = json_boolean(isTruthy(right));
+            json_decref(right);
+            return EVAL_OK;
+        }
+
+        case NODE_COMPARE: {
+            json_t *left = NULL;
+            json_t *right = NULL;
+            EvalStatus status = evalOne(node->left, input, &left);
+            if (status == EVAL_OK) {
+                status = evalOne(node->right, input, &right);
+            }
+            int cmp = 0;
+            if (status == EVAL_OK && !compareValues(left, right, &cmp)) {
+                status = EVAL_FALLBACK;
+            }
+            json_decref(left);
+            json_decref(right);
+            if (status != EVAL_OK) return status;
+
+            bool result = false;
+            switch ((CompareOp)node->op) {
+                case COMPARE_EQ: result = cmp == 0; break;
+                case COMPARE_NEQ: result = cmp != 0; break;
+                case COMPARE_LT: result = cmp < 0; break;
+                case COMPARE_LE: result = cmp <= 0; break;
+                case COMPARE_GT: result = cmp > 0; break;
+                case COMPARE_GE: result = cmp >= 0; break;
+            }
+            *out = json_boolean(result);
+            return EVAL_OK;
+        }
+
+        case NODE_ITERATE:
+        case NODE_COMMA:
+            break;
+    }
+    return EVAL_FALLBACK;
+}
+
+// Append every output of node to outputs. Never returns EVAL_EMPTY.
+static EvalStatus evalAll(const Node *node, json_t *input, json_t *outputs) {
+    if (!node->multi) {
+        json_t *value = NULL;
+        EvalStatus status = evalOne(node, input, &value);
+        if (status == EVAL_OK) {
+            return json_array_append_new(outputs, value) == 0 ? EVAL_OK : EVAL_FALLBACK;
+        }
+        return status == EVAL_EMPTY ? EVAL_OK : EVAL_FALLBACK;
+    }
+
+    switch (node->kind) {
+        case NODE_ITERATE:
+            // Object iteration order and errors on scalars are libjq's
+            if (!json_is_array(input)) return EVAL_FALLBACK;
+            return json_array_extend(outputs, input) == 0 ? EVAL_OK : EVAL_FALLBACK;
+
+        case NODE_COMMA: {
+            EvalStatus status = evalAll(node->left, input, outputs);
+            return status == EVAL_OK ? evalAll(node->right, input, outputs) : status;
+        }
+
+        case NODE_PIPE: {
+            if (!node->left->multi) {
+                json_t *middle = NULL;
+                EvalStatus status = evalOne(node->left, input, &middle);
+                if (status != EVAL_OK) return status == EVAL_EMPTY ? EVAL_OK : status;
+                status = evalAll(node->right, middle, outputs);
+                json_decref(middle);
+                return status;
+            }
+
+            json_t *middle = json_array();
+            if (!middle) return EVAL_FALLBACK;
+            EvalStatus status = evalAll(node->left, input, middle);
+            size_t i;
+            json_t *value;
+            json_array_foreach(middle, i, value) {
+                if (status != EVAL_OK) break;
+                status = evalAll(node->right, value, outputs);
+            }
+            json_decref(middle);
+            return status;
+        }
+
+        default:
+            // Objects built from streams multiply out; not worth mirroring
+            return EVAL_FALLBACK;
+    }
+}
+
+// Whether the result is always a fresh value rather than part of the input
+static bool constructsResult(const Node *node) {
+    switch (node->kind) {
+        case NODE_OBJECT:
+        case NODE_ARRAY:
+        case NODE_MAP:
+            return true;
+        case NODE_PIPE:
+            return constructsResult(node->right);
+        default:
+            return false;
+    }
+}
+
+// Literals and anything built only from literals
+static bool isConstantNode(const Node *node) {
+    switch (node->kind) {
+        case NODE_LITERAL:
+            return true;
+        case NODE_OBJECT:
+            for (ObjectEntry *entry = node->entries; entry; entry = entry->next) {
+                if (!isConstantNode(entry->value)) return false;
+            }
+            return true;
+        case NODE_ARRAY:
+            return !node->left || isConstantNode(node->left);
+        case NODE_PIPE:
+            // The right side only sees the left side's output
+            return isConstantNode(node->left);
+        case NODE_COMMA:
+        case NODE_AND:
+        case NODE_OR:
+        case NODE_COMPARE:
+            return isConstantNode(node->left) && isConstantNode(node->right);
+        default:
+            return false;
+    }
+}
+
+bool nativeJqIsConstant(const NativeJq *program) {
+    return program && isConstantNode(program->root);
+}
+
+static bool isIntegralReal(json_t *value) {
+    return json_is_real(value) && isIntegral(json_real_value(value));
+}
+
+static bool containsIntegralReal(json_t *value) {
+    if (isIntegralReal(value)) return true;
+
+    const char *key;
+    json_t *child;
+    size_t index;
+    if (json_is_object(value)) {
+        json_object_foreach(value, key, child) {
+            if (containsIntegralReal(child)) return true;
+        }
+    } else if (json_is_array(value)) {
+        json_array_foreach(value, index, child) {
+            if (containsIntegralReal(child)) return true;
+        }
+    }
+    return false;
+}
+
+// Copy of value with integral reals made integers, as if it had been
+// through libjq. Untouched scalars are shared.
+static json_t* integralRealsToIntegers(json_t *value) {
+    if (json_is_real(value)) return jqNumberToJson(json_real_value(value));
+
+    const char *key;
+    json_t *child;
+    size_t index;
+    if (json_is_object(value)) {
+        json_t *copy = json_object();
+        json_object_foreach(value, key, child) {
+            json_object_set_new(copy, key, integralRealsToIntegers(child));
+        }
+        return copy;
+    }
+    if (json_is_array(value)) {
+        json_t *copy = json_array();
+        json_array_foreach(value, index, child) {
+            json_array_append_new(copy, integralRealsToIntegers(child));
+        }
+        return copy;
+    }
+    return json_incref(value);
+}
+
+json_t* evaluateNativeJq(const NativeJq *program, json_t *input) {
+    if (!program || !input) return NULL;
+
+    json_t *result = NULL;
+    if (evalOne(program->root, input, &result) != EVAL_OK) {
+        return NULL;
+    }
+
+    // Callers may modify the top level of the result, so don't hand back
+    // a container that is still part of the input
+    if ((json_is_object(result) || json_is_array(result)) && !constructsResult(program->root)) {
+        json_t *copy = json_copy(result);
+        json_decref(result);
+        result = copy;
+    }
+
+    // libjq hands every number back as a double. Values passed through
+    // untouched get the same integers it would give.
+    if (containsIntegralReal(result)) {
+        json_t *converted = integralRealsToIntegers(result);
+        json_decref(result);
+        result = converted;
+    }
+    return result;
+}
@@ -0,0 +1,35 @@
+#ifndef SERVER_JQ_NATIVE_H
+#define SERVER_JQ_NATIVE_H
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wpadded"
+#include <jansson.h>
+#pragma clang diagnostic pop
+#include <stdbool.h>
+#include "../arena.h"
+
+// Native evaluator for the subset of jq most steps use: paths (.a, ."a",
+// .[0], .[]), object and array construction, literals, pipes, commas, map,
+// select, not, and/or and comparisons. It runs directly on jansson values,
+// skipping libjq and both conversions.
+typedef struct NativeJq NativeJq;
+
+// Compile filter if it lies entirely within the subset, otherwise NULL.
+// filter must already have compiled with libjq.
+NativeJq* compileNativeJq(const char *filter, Arena *arena);
+
+// Run program on input. Returns a new reference, or NULL when the result
+// depends on behaviour outside the subset (type errors, no output, deep
+// comparisons) and libjq has to run the filter instead.
+json_t* evaluateNativeJq(const NativeJq *program, json_t *input);
+
+// A jq number as jansson: integral values within 2^53 become integers, the
+// way jq prints them. Both the native and the libjq paths use this, so a
+// step's output doesn't depend on which one ran it.
+json_t* jqNumberToJson(double number);
+
+// Whether program ignores its input. The subset has no side effects, so
+// such a program always produces the same value.
+bool nativeJqIsConstant(const NativeJq *program);
+
+#endif // SERVER_JQ_NATIVE_H
@@ -0,0 +1,97 @@
+#include "linker.h"
+#include "routing.h"
+#include "jq.h"
+#include "lua.h"
+#include <stdio.h>
+#include <string.h>
+
+static bool linkStep(PipelineStepNode *step, const char *where) {
+    switch (step->type) {
+        case STEP_SQL:
+        case STEP_DYNAMIC_SQL: {
+            if (step->is_dynamic || !step->name) {
+                step->resolvedCode = step->code;
+                return true;
+            }
+            QueryNode *query = findQuery(step->name);
+            if (!query) {
+                fprintf(stderr, "Query not found in %s: %s\n", where, step->name);
+                return false;
+            }
+            step->resolvedCode = query->sql;
+            return true;
+        }
+
+        case STEP_JQ: {
+            step->resolvedCode = step->code;
+            if (step->name) {
+                TransformNode *transform = findTransform(step->name);
+                if (!transform) {
+                    fprintf(stderr, "Transform not found in %s: %s\n", where, step->name);
+                    return false;
+                }
+                step->resolvedCode = transform->code;
+            }
+            // Steps folded to a constant have no program
+            step->jqProgram = findJqProgram(step->resolvedCode);
+            return true;
+        }
+
+        case STEP_LUA: {
+            step->resolvedCode = step->code;
+            if (step->name) {
+                ScriptNode *script = findScript(step->name);
+                if (!script) {
+                    fprintf(stderr, "Script not found in %s: %s\n", where, step->name);
+                    return false;
+                }
+                step->resolvedCode = script->code;
+            }
+            if (!step->resolvedCode) return true;
+            const LuaBytecode *bytecode = findLuaBytecode(step->resolvedCode);
+            if (!bytecode) {
+                fprintf(stderr, "Lua step not compiled in %s\n", where);
+                return false;
+            }
+            step->luaBytecode = bytecode->bytecode;
+            step->luaBytecodeLength = bytecode->bytecode_len;
+            return true;
+        }
+    }
+    return true;
+}
+
+static bool linkPipeline(PipelineStepNode *step, const char *method, const char *route, uint32_t luaBudget) {
+    char where[256];
+    snprintf(where, sizeof(where), "%s %s", method, route);
+
+    for (; step; step = step->next) {
+        if (!linkStep(step, where)) return false;
+        step->luaBudget = luaBudget;
+    }
+    return true;
+}
+
+bool linkWebsite(ServerContext *ctx) {
+    if (!ctx || !ctx->website) return false;
+
+    for (ApiEndpoint *api = ctx->website->apiHead; api; api = api->next) {
+        if (!linkPipeline(api->pipeline, api->method ? api->method : "GET", api->route, api->luaBudget)) return false;
+    }
+
+    for (PageNode *page = ctx->website->pageHead; page; page = page->next) {
+        if (!linkPipeline(page->pipeline, "page", page->route, page->luaBudget)) return false;
+        if (!linkPipeline(page->referenceData, "referenceData", page->route, page->luaBudget)) return false;
+
+        // layout "none" renders the page template on its own
+        if (page->layout && strcmp(page->layout, "none") != 0) {
+            page->resolvedLayout = findLayout(page->layout);
+            if (!page->resolvedLayout) {
+                fprintf(stderr, "Layout not found for page %s: %s\n", page->route, page->layout);
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
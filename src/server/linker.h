@@ -0,0 +1,11 @@
+#ifndef SERVER_LINKER_H
+#define SERVER_LINKER_H
+
+#include "server.h"
+
+// Resolve every named query, transform, script and layout in the website to
+// the pointers requests use, after the route maps, Lua chunks and jq
+// programs are built. Reports the first missing name and returns false.
+bool linkWebsite(ServerContext *ctx);
+
+#endif // SERVER_LINKER_H
@@ -0,0 +1,466 @@
+#include "logger.h"
+#include "metrics.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+// Each thread owns a single-producer/single-consumer byte ring. Records are
+// a 32-bit length followed by the line, wrapping around the end of the buffer.
+#define LOG_RING_SIZE (64 * 1024)
+#define LOG_RING_MASK (LOG_RING_SIZE - 1)
+#define LOG_MAX_RECORD (LOG_RING_SIZE / 4)
+#define LOG_MAX_LINE 4096
+#define LOG_WRITER_IDLE_NS 5000000  // 5ms
+#define LOG_REQUEST_ID_MAX 64
+
+typedef struct LogRing {
+    _Atomic uint64_t head;     // Only written by the owning thread
+    _Atomic uint64_t tail;     // Only written by the writer thread
+    _Atomic uint64_t dropped;  // Only written by the owning thread
+    struct LogRing *next;
+    char buffer[LOG_RING_SIZE];
+} LogRing;
+
+typedef struct LineBuffer {
+    char data[LOG_MAX_LINE];
+    size_t length;
+} LineBuffer;
+
+static LogRing *rings = NULL;
+static pthread_mutex_t ringsLock = PTHREAD_MUTEX_INITIALIZER;
+
+// Bumped on init and cleanup so threads drop rings from a previous server
+static _Atomic uint64_t generation = 0;
+static _Thread_local LogRing *threadRing = NULL;
+static _Thread_local uint64_t threadGeneration = 0;
+
+static pthread_t writerThread;
+static _Atomic bool writerRunning = false;
+static _Atomic bool writerStopping = false;
+static uint64_t reportedDrops = 0;
+static char writerBuffer[LOG_RING_SIZE];
+static size_t writerLength = 0;
+
+static double accessSampleRate = 1.0;
+static _Atomic uint64_t requestCounter = 0;
+static uint64_t requestIdSeed = 0;
+
+static _Thread_local RequestLog *currentLog = NULL;
+static _Thread_local uint64_t sampleState = 0;
+
+// =============================================================================
+// Line Formatting
+// =============================================================================
+
+static void lineAppend(LineBuffer *line, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+static void lineAppend(LineBuffer *line, const char *format, ...) {
+    if (line->length >= LOG_MAX_LINE) return;
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(line->data + line->length, LOG_MAX_LINE - line->length, format, args);
+    va_end(args);
+    if (written < 0) return;
+    line->length += (size_t)written;
+    if (line->length >= LOG_MAX_LINE) {
+        line->length = LOG_MAX_LINE - 1;
+    }
+}
+
+// Escaped values stop short of the end so the closing fields always fit
+static void lineAppendEscaped(LineBuffer *line, const char *value) {
+    const size_t limit = LOG_MAX_LINE - 256;
+    for (const char *p = value; *p && line->length < limit; p++) {
+        unsigned char c = (unsigned char)*p;
+        if (c == '"' || c == '\\') {
+            line->data[line->length++] = '\\';
+            line->data[line->length++] = (char)c;
+        } else if (c == '\n') {
+            line->data[line->length++] = '\\';
+            line->data[line->length++] = 'n';
+        } else if (c < 0x20) {
+            lineAppend(line, "\\u%04x", c);
+        } else {
+            line->data[line->length++] = (char)c;
+        }
+    }
+}
+
+static void lineAppendField(LineBuffer *line, const char *key, const char *value) {
+    if (!value) return;
+    lineAppend(line, ",\"%s\":\"", key);
+    lineAppendEscaped(line, value);
+    lineAppend(line, "\"");
+}
+
+static void lineStart(LineBuffer *line, const char *level) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    struct tm tm;
+    gmtime_r(&now.tv_sec, &tm);
+    char timestamp[32];
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%S", &tm);
+
+    line->length = 0;
+    lineAppend(line, "{\"ts\":\"%s.%03ldZ\",\"level\":\"%s\"", timestamp, now.tv_nsec / 1000000, level);
+}
+
+// =============================================================================
+// Rings
+// =============================================================================
+
+static LogRing* getRing(void) {
+    uint64_t current = atomic_load_explicit(&generation, memory_order_acquire);
+    if (threadRing && threadGeneration == current) {
+        return threadRing;
+    }
+    if (!atomic_load_explicit(&writerRunning, memory_order_acquire)) {
+        return NULL;
+    }
+
+    LogRing *ring = calloc(1, sizeof(LogRing));
+    if (!ring) return NULL;
+
+    pthread_mutex_lock(&ringsLock);
+    ring->next = rings;
+    rings = ring;
+    pthread_mutex_unlock(&ringsLock);
+
+    threadRing = ring;
+    threadGeneration = current;
+    return ring;
+}
+
+static void ringWrite(LogRing *ring, uint64_t position, const void *data, size_t length) {
+    size_t offset = position & LOG_RING_MASK;
+    size_t first = LOG_RING_SIZE - offset;
+    if (first >= length) {
+        memcpy(ring->buffer + offset, data, length);
+    } else {
+        memcpy(ring->buffer + offset, data, first);
+        memcpy(ring->buffer, (const char *)data + first, length - first);
+    }
+}
+
+static void ringRead(LogRing *ring, uint64_t position, void *data, size_t length) {
+    size_t offset = position & LOG_RING_MASK;
+    size_t first = LOG_RING_SIZE - offset;
+    if (first >= length) {
+        memcpy(data, ring->buffer + offset, length);
+    } else {
+        memcpy(data, ring->buffer + offset, first);
+        memcpy((char *)data + first, ring->buffer, length - first);
+    }
+}
+
+void logLine(const char *line, size_t length) {
+    LogRing *ring = getRing();
+    if (!ring) {
+        // Writer not running (startup, shutdown, tests): write directly
+        fwrite(line, 1, length, stderr);
+        fputc('\n', stderr);
+        return;
+    }
+
+    uint32_t recordLength = (uint32_t)length;
+    size_t needed = sizeof(recordLength) + length;
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (length > LOG_MAX_RECORD || LOG_RING_SIZE - (head - tail) < needed) {
+        atomic_store_explicit(&ring->dropped,
+            atomic_load_explicit(&ring->dropped, memory_order_relaxed) + 1,
+            memory_order_relaxed);
+        return;
+    }
+
+    ringWrite(ring, head, &recordLength, sizeof(recordLength));
+    ringWrite(ring, head + sizeof(recordLength), line, length);
+    atomic_store_explicit(&ring->head, head + needed, memory_order_release);
+}
+
+// =============================================================================
+// Writer Thread
+// =============================================================================
+
+static void flushWriter(void) {
+    if (writerLength > 0) {
+        fwrite(writerBuffer, 1, writerLength, stderr);
+        writerLength = 0;
+    }
+}
+
+static void writerAppend(const char *data, size_t length) {
+    if (writerLength + length > sizeof(writerBuffer)) {
+        flushWriter();
+    }
+    memcpy(writerBuffer + writerLength, data, length);
+    writerLength += length;
+}
+
+static size_t drainRing(LogRing *ring) {
+    uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    size_t records = 0;
+
+    while (tail < head) {
+        uint32_t length;
+        ringRead(ring, tail, &length, sizeof(length));
+        if (writerLength + length + 1 > sizeof(writerBuffer)) {
+            flushWriter();
+        }
+        ringRead(ring, tail + sizeof(length), writerBuffer + writerLength, length);
+        writerLength += length;
+        writerBuffer[writerLength++] = '\n';
+        tail += sizeof(length) + length;
+        records++;
+    }
+
+    atomic_store_explicit(&ring->tail, tail, memory_order_release);
+    return records;
+}
+
+static size_t drainRings(void) {
+    size_t records = 0;
+    uint64_t dropped = 0;
+
+    pthread_mutex_lock(&ringsLock);
+    for (LogRing *ring = rings; ring; ring = ring->next) {
+        records += drainRing(ring);
+        dropped += atomic_load_explicit(&ring->dropped, memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&ringsLock);
+
+    if (dropped > reportedDrops) {
+        LineBuffer line;
+        lineStart(&line, "warn");
+        lineAppend(&line, ",\"msg\":\"log buffer full\",\"dropped\":%llu,\"droppedTotal\":%llu}\n",
+                   (unsigned long long)(dropped - reportedDrops), (unsigned long long)dropped);
+        writerAppend(line.data, line.length);
+        reportedDrops = dropped;
+    }
+
+    if (records > 0 || writerLength > 0) {
+        flushWriter();
+        fflush(stderr);
+    }
+    return records;
+}
+
+static void* writerLoop(void *arg) {
+    (void)arg;
+    struct timespec idle = {0, LOG_WRITER_IDLE_NS};
+
+    while (!atomic_load_explicit(&writerStopping, memory_order_acquire)) {
+        if (drainRings() == 0) {
+            nanosleep(&idle, NULL);
+        }
+    }
+    drainRings();
+    return NULL;
+}
+
+static void freeRingsLocked(void) {
+    while (rings) {
+        LogRing *next = rings->next;
+        free(rings);
+        rings = next;
+    }
+}
+
+void initLogger(void) {
+    const char *rate = getenv("WEBDSL_ACCESS_LOG_SAMPLE_RATE");
+    if (rate) {
+        char *end;
+        double value = strtod(rate, &end);
+        if (end != rate && value >= 0.0 && value <= 1.0) {
+            accessSampleRate = value;
+        } else {
+            fprintf(stderr, "Invalid WEBDSL_ACCESS_LOG_SAMPLE_RATE '%s', using %g\n", rate, accessSampleRate);
+        }
+    }
+
+    requestIdSeed = metricsNow() ^ ((uint64_t)getpid() << 32);
+    reportedDrops = 0;
+    writerLength = 0;
+    atomic_store(&writerStopping, false);
+
+    if (pthread_create(&writerThread, NULL, writerLoop, NULL) != 0) {
+        fprintf(stderr, "Failed to start log writer thread, logging synchronously\n");
+        return;
+    }
+    atomic_store_explicit(&writerRunning, true, memory_order_release);
+    atomic_fetch_add(&generation, 1);
+}
+
+void cleanupLogger(void) {
+    if (!atomic_load(&writerRunning)) {
+        return;
+    }
+
+    // New lines fall back to stderr while the writer drains what is queued
+    atomic_store_explicit(&writerRunning, false, memory_order_release);
+    atomic_fetch_add(&generation, 1);
+    atomic_store_explicit(&writerStopping, true, memory_order_release);
+    pthread_join(writerThread, NULL);
+
+    pthread_mutex_lock(&ringsLock);
+    freeRingsLocked();
+    pthread_mutex_unlock(&ringsLock);
+}
+
+uint64_t loggerDroppedTotal(void) {
+    uint64_t dropped = 0;
+    pthread_mutex_lock(&ringsLock);
+    for (LogRing *ring = rings; ring; ring = ring->next) {
+        dropped += atomic_load_explicit(&ring->dropped, memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&ringsLock);
+    return dropped;
+}
+
+// =============================================================================
+// Messages
+// =============================================================================
+
+static void logMessage(const char *level, const char *format, va_list args) {
+    char message[LOG_MAX_LINE / 2];
+    vsnprintf(message, sizeof(message), format, args);
+
+    // Callers pass fprintf-style messages; drop the trailing newline
+    size_t length = strlen(message);
+    if (length > 0 && message[length - 1] == '\n') {
+        message[length - 1] = '\0';
+    }
+
+    LineBuffer line;
+    lineStart(&line, level);
+    if (currentLog) {
+        lineAppendField(&line, "requestId", currentLog->requestId);
+    }
+    lineAppendField(&line, "msg", message);
+    lineAppend(&line, "}");
+    logLine(line.data, line.length);
+}
+
+void logError(const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    logMessage("error", format, args);
+    va_end(args);
+}
+
+void logInfo(const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    logMessage("info", format, args);
+    va_end(args);
+}
+
+// =============================================================================
+// Access Log
+// =============================================================================
+
+// xorshift64* - only used to pick sampled requests. The shifts and the
+// multiply wrap by design.
+bool loggerSample(double rate) {
+    if (rate <= 0.0) return false;
+    if (rate >= 1.0) return true;
+
+    if (sampleState == 0) {
+        sampleState = metricsNow() ^ (uint64_t)(uintptr_t)&sampleState;
+        if (sampleState == 0) sampleState = 0x9E3779B97F4A7C15ull;
+    }
+    sampleState ^= sampleState >> 12;
+    sampleState ^= sampleState << 25;
+    sampleState ^= sampleState >> 27;
+    uint64_t value = sampleState * 0x2545F4914F6CDD1Dull;
+    return (double)(value >> 11) * (1.0 / 9007199254740992.0) < rate;
+}
+
+// Multiplying by an odd constant is a bijection, so ids never repeat. The
+// product wraps by design.
+static uint64_t generatedRequestId(uint64_t counter)
+    __attribute__((no_sanitize("unsigned-integer-overflow")));
+
+static uint64_t generatedRequestId(uint64_t counter) {
+    return requestIdSeed ^ (counter * 0x9E3779B97F4A7C15ull);
+}
+
+static bool isValidRequestId(const char *id) {
+    size_t length = 0;
+    for (const char *p = id; *p; p++, length++) {
+        char c = *p;
+        bool allowed = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+                       (c >= '0' && c <= '9') || c == '-' || c == '_' || c == '.';
+        if (!allowed || length >= LOG_REQUEST_ID_MAX) return false;
+    }
+    return length > 0;
+}
+
+void beginRequestLog(RequestLog *log, Arena *arena, struct MHD_Connection *connection,
+                     const char *method, const char *url) {
+    log->arena = arena;
+    log->method = arenaDupString(arena, method);
+    log->url = arenaDupString(arena, url);
+    log->userId = NULL;
+    log->bytesOut = 0;
+
+    const char *contentLength = MHD_lookup_connection_value(connection, MHD_HEADER_KIND,
+                                                            MHD_HTTP_HEADER_CONTENT_LENGTH);
+    log->bytesIn = contentLength ? strtoull(contentLength, NULL, 10) : 0;
+
+    const char *requestId = MHD_lookup_connection_value(connection, MHD_HEADER_KIND, "X-Request-Id");
+    if (requestId && isValidRequestId(requestId)) {
+        log->requestId = arenaDupString(arena, requestId);
+    } else {
+        uint64_t counter = atomic_fetch_add_explicit(&requestCounter, 1, memory_order_relaxed);
+        char id[17];
+        snprintf(id, sizeof(id), "%016llx", (unsigned long long)generatedRequestId(counter));
+        log->requestId = arenaDupString(arena, id);
+    }
+
+    currentLog = log;
+}
+
+void requestLogSetUser(const char *userId) {
+    if (currentLog && userId) {
+        currentLog->userId = arenaDupString(currentLog->arena, userId);
+    }
+}
+
+void requestLogAddBytesOut(size_t bytes) {
+    if (currentLog) {
+        currentLog->bytesOut += bytes;
+    }
+}
+
+void endRequestLog(RequestLog *log, const char *route, unsigned int status, uint64_t durationNs) {
+    // The thread may have started another connection's request since
+    if (currentLog == log) {
+        currentLog = NULL;
+    }
+    if (!log->method) {
+        return;  // Never reached the handler, e.g. the client went away mid-upload
+    }
+    if (status < 400 && !loggerSample(accessSampleRate)) {
+        return;
+    }
+
+    LineBuffer line;
+    lineStart(&line, status >= 500 ? "error" : "info");
+    lineAppendField(&line, "type", "access");
+    lineAppendField(&line, "requestId", log->requestId);
+    lineAppendField(&line, "method", log->method);
+    lineAppendField(&line, "url", log->url);
+    lineAppendField(&line, "route", route);
+    lineAppend(&line, ",\"status\":%u,\"durationMs\":%.3f,\"bytesIn\":%zu,\"bytesOut\":%zu",
+               status, (double)durationNs / 1e6, log->bytesIn, log->bytesOut);
+    lineAppendField(&line, "userId", log->userId);
+    lineAppend(&line, "}");
+    logLine(line.data, line.length);
+}
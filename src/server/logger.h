@@ -0,0 +1,53 @@
+#ifndef SERVER_LOGGER_H
+#define SERVER_LOGGER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <microhttpd.h>
+#include "../arena.h"
+
+// Per-request fields for the access log, filled in while the request is
+// handled and written once it completes.
+typedef struct RequestLog {
+    Arena *arena;
+    const char *method;
+    const char *url;
+    const char *requestId;
+    const char *userId;
+    size_t bytesIn;
+    size_t bytesOut;
+} RequestLog;
+
+// Start the writer thread. Until it runs, lines go straight to stderr.
+// WEBDSL_ACCESS_LOG_SAMPLE_RATE (default 1) samples access lines for
+// successful requests; 4xx/5xx requests and error lines are always kept.
+void initLogger(void);
+
+// Drain all buffered lines and stop the writer thread
+void cleanupLogger(void);
+
+// Entries dropped because a thread's ring buffer was full
+uint64_t loggerDroppedTotal(void);
+
+// Returns true for roughly `rate` of calls (0..1)
+bool loggerSample(double rate)
+    __attribute__((no_sanitize("unsigned-integer-overflow", "unsigned-shift-base")));
+
+// Queue one complete JSON line (without trailing newline)
+void logLine(const char *line, size_t length);
+
+// Structured error/info lines, tagged with the current request id
+void logError(const char *format, ...) __attribute__((format(printf, 1, 2)));
+void logInfo(const char *format, ...) __attribute__((format(printf, 1, 2)));
+
+// Track the request being handled on this thread. Uses the client's
+// X-Request-Id when present, otherwise generates one.
+void beginRequestLog(RequestLog *log, Arena *arena, struct MHD_Connection *connection,
+                     const char *method, const char *url);
+void requestLogSetUser(const char *userId);
+void requestLogAddBytesOut(size_t bytes);
+
+// Write the access line for a completed request
+void endRequestLog(RequestLog *log, const char *route, unsigned int status, uint64_t durationNs);
+
+#endif // SERVER_LOGGER_H
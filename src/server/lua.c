@@ -1,4 +1,10 @@
 #include "lua.h"
+#include "lua_json.h"
+#include "lua_fetch.h"
+#include "lua_shared.h"
+#include "session_store.h"
+#include "artifact_cache.h"
+#include "anonymous_session.h"
 #include "../arena.h"
 #include <string.h>
 #include <stdlib.h>
@@ -11,16 +17,30 @@
 #include "routing.h"
 #include "db.h"
 #include "generated_scripts.h"
+#include "metrics.h"
+#include "logger.h"
 
 #define LUA_HASH_TABLE_SIZE 64  // Should be power of 2
 #define LUA_HASH_MASK (LUA_HASH_TABLE_SIZE - 1)
 #define INITIAL_REGISTRY_CAPACITY 16
 #define SCRIPTS_DIR "scripts"
+#define DEFAULT_LUA_MEMORY_LIMIT (64 * 1024 * 1024)
+#ifdef WEBDSL_LUAJIT
+// A count hook keeps LuaJIT in the interpreter, so only routes that ask
+// for a budget get one
+#define DEFAULT_LUA_BUDGET 0u
+#else
+#define DEFAULT_LUA_BUDGET 100000000u  // Instructions per step
+#endif
+#define LUA_HOOK_INTERVAL 1000          // Instructions between budget checks
+#ifdef WEBDSL_LUAJIT
+#define LUA_ARTIFACT_VERSION LUAJIT_VERSION  // Bytecode only loads on the runtime that wrote it
+#else
+#define LUA_ARTIFACT_VERSION LUA_RELEASE
+#endif
 
 // Forward declarations
-static void pushJsonToLua(lua_State *L, json_t *json);
-static json_t* luaToJson(lua_State *L, int index);
-static bool loadEmbeddedScripts(lua_State *L);
+static bool registerEmbeddedScripts(lua_State *L);
 static int bytecodeWriter(lua_State *L __attribute__((unused)), const void* p, size_t sz, void* ud);
 
 typedef struct LuaChunkEntry {
@@ -33,6 +53,51 @@ static LuaFileRegistry fileRegistry = {0};
 static LuaChunkEntry* chunkTable[LUA_HASH_TABLE_SIZE] = {0};
 
 static struct ServerContext *g_ctx = NULL;  // Rename global ctx to g_ctx
+static size_t memoryLimit = DEFAULT_LUA_MEMORY_LIMIT;
+static uint32_t defaultBudget = DEFAULT_LUA_BUDGET;
+static char quotaKey;  // Registry key for a request state's LuaQuota
+
+// Compile code into bytecode. Only the compiler runs, so no libraries are opened.
+static bool compileChunk(LuaBytecode *bytecode, const char *code, const char *name) {
+    lua_State *L = luaL_newstate();
+    if (!L) {
+        return false;
+    }
+    
+    if (luaL_loadstring(L, code) != 0) {
+        fprintf(stderr, "Failed to load %s: %s\n", name ? name : "unnamed", lua_tostring(L, -1));
+        lua_close(L);
+        return false;
+    }
+    
+#ifdef WEBDSL_LUAJIT
+    int dumpStatus = lua_dump(L, bytecodeWriter, bytecode);
+#else
+    int dumpStatus = lua_dump(L, bytecodeWriter, bytecode, 0);
+#endif
+    lua_close(L);
+    if (dumpStatus != 0) {
+        fprintf(stderr, "Failed to compile %s\n", name ? name : "unnamed");
+        free(bytecode->bytecode);
+        bytecode->bytecode = NULL;
+        bytecode->bytecode_len = 0;
+        return false;
+    }
+    return true;
+}
+
+// Whether bytecode loads on this runtime. Artifacts are keyed by the Lua
+// release, which a rebuild against another build of it doesn't change.
+static bool bytecodeLoads(const LuaBytecode *bytecode, const char *name) {
+    lua_State *L = luaL_newstate();
+    if (!L) {
+        return false;
+    }
+    bool loads = luaL_loadbuffer(L, (const char*)bytecode->bytecode, bytecode->bytecode_len,
+                                 name ? name : "unnamed") == 0;
+    lua_close(L);
+    return loads;
+}
 
 // Helper function to compile and cache Lua code
 static LuaChunkEntry* compileAndCacheLuaCode(const char* code, const char* name, Arena *arena) {
@@ -70,36 +135,36 @@ static LuaChunkEntry* compileAndCacheLuaCode(const char* code, const char* name,
     
     entry->bytecode.bytecode = NULL;
     entry->bytecode.bytecode_len = 0;
-    
-    lua_State *L = luaL_newstate();
-    if (!L) {
-        free(entry);
-        return NULL;
-    }
-    
-    luaL_openlibs(L);
-    
-    if (luaL_loadstring(L, code) != 0) {
-        fprintf(stderr, "Failed to load %s: %s\n", name ? name : "unnamed", lua_tostring(L, -1));
-        lua_close(L);
-        if (arena && entry->code != code) {
-            // free((void*)entry->code);
-        }
-        free(entry);
-        return NULL;
-    }
-    
-    if (lua_dump(L, bytecodeWriter, &entry->bytecode, 0) != 0) {
-        fprintf(stderr, "Failed to compile %s\n", name ? name : "unnamed");
-        lua_close(L);
+
+    // Chunks compiled by an earlier start come from the artifact cache
+    size_t codeLength = strlen(code);
+    Artifact artifact;
+    if (artifactCacheGet("lua", LUA_ARTIFACT_VERSION, code, codeLength, &artifact)) {
+        entry->bytecode.bytecode = malloc(artifact.size);
         if (entry->bytecode.bytecode) {
+            memcpy(entry->bytecode.bytecode, artifact.data, artifact.size);
+            entry->bytecode.bytecode_len = artifact.size;
+        }
+        releaseArtifact(&artifact);
+
+        if (entry->bytecode.bytecode && !bytecodeLoads(&entry->bytecode, name)) {
+            fprintf(stderr, "Cached bytecode for %s does not load, compiling its source\n",
+                    name ? name : "unnamed");
             free(entry->bytecode.bytecode);
+            entry->bytecode.bytecode = NULL;
+            entry->bytecode.bytecode_len = 0;
         }
-        free(entry);
-        return NULL;
     }
-    
-    lua_close(L);
+
+    // Compiling again replaces an artifact that didn't load
+    if (!entry->bytecode.bytecode) {
+        if (!compileChunk(&entry->bytecode, code, name)) {
+            free(entry);
+            return NULL;
+        }
+        artifactCachePut("lua", LUA_ARTIFACT_VERSION, code, codeLength,
+                         entry->bytecode.bytecode, entry->bytecode.bytecode_len);
+    }
     
     // Add to hash table
     entry->next = chunkTable[hash];
@@ -108,205 +173,19 @@ static LuaChunkEntry* compileAndCacheLuaCode(const char* code, const char* name,
     return entry;
 }
 
-// Add arena wrapper struct
+// Memory and instruction accounting for a request Lua state
 typedef struct {
-    Arena *arena;
-    size_t total_allocated;
-} LuaArenaWrapper;
+    size_t allocated;
+    size_t limit;
+    uint64_t instructions;  // Executed by the current step, in LUA_HOOK_INTERVAL steps
+    uint32_t budget;        // Instructions the current step may execute
+    bool exceededMemory;
+    uint8_t _padding[3];
+} LuaQuota;
 
 // Add typedef for Page
 typedef struct PageNode Page;
 
-// Write callback for curl
-static size_t writeCallback(void *contents, size_t size, size_t nmemb, void *userp) {
-    size_t realsize = size * nmemb;
-    ResponseBuffer *mem = (ResponseBuffer *)userp;
-    
-    char *ptr = realloc(mem->data, mem->size + realsize + 1);
-    if (!ptr) {
-        return 0;  // Out of memory
-    }
-    
-    mem->data = ptr;
-    memcpy(&(mem->data[mem->size]), contents, realsize);
-    mem->size += realsize;
-    mem->data[mem->size] = 0;
-    
-    return realsize;
-}
-
-// Lua function to make HTTP requests
-#pragma clang diagnostic push
-#pragma clang diagnostic ignored "-Wdisabled-macro-expansion"
-static int lua_fetch(lua_State *L) {
-    // Get URL from first argument
-    const char *url = luaL_checkstring(L, 1);
-    
-    // Get options table from second argument (optional)
-    const char *method = "GET";
-    const char *body = NULL;
-    struct curl_slist *headers = NULL;
-    
-    if (lua_gettop(L) >= 2) {
-        luaL_checktype(L, 2, LUA_TTABLE);
-        
-        // Get method
-        lua_getfield(L, 2, "method");
-        if (!lua_isnil(L, -1)) {
-            method = lua_tostring(L, -1);
-        }
-        lua_pop(L, 1);
-        
-        // Get body
-        lua_getfield(L, 2, "body");
-        if (!lua_isnil(L, -1)) {
-            if (lua_istable(L, -1)) {
-                // Convert table to JSON string
-                json_t *json_body = luaToJson(L, -1);
-                body = json_dumps(json_body, 0);
-                json_decref(json_body);
-            } else {
-                body = lua_tostring(L, -1);
-            }
-        }
-        lua_pop(L, 1);
-        
-        // Get headers
-        lua_getfield(L, 2, "headers");
-        if (lua_istable(L, -1)) {
-            lua_pushnil(L);
-            while (lua_next(L, -2) != 0) {
-                const char *key = lua_tostring(L, -2);
-                const char *value = lua_tostring(L, -1);
-                char *header = malloc(strlen(key) + strlen(value) + 3);
-                if (!header) {
-                    // Clean up existing headers
-                    if (headers) {
-                        curl_slist_free_all(headers);
-                    }
-                    lua_pushnil(L);
-                    lua_pushstring(L, "Failed to allocate memory for headers");
-                    return 2;
-                }
-                snprintf(header, strlen(key) + strlen(value) + 3, "%s: %s", key, value);
-                headers = curl_slist_append(headers, header);
-                free(header);
-                lua_pop(L, 1);
-            }
-        }
-        lua_pop(L, 1);
-    }
-    
-    // Initialize CURL
-    CURL *curl = curl_easy_init();
-    if (!curl) {
-        lua_pushnil(L);
-        lua_pushstring(L, "Failed to initialize CURL");
-        return 2;
-    }
-    
-    // Set up response buffer
-    ResponseBuffer response = {0};
-    response.data = malloc(1);
-    response.size = 0;
-    
-    // Set up request
-    curl_easy_setopt(curl, CURLOPT_URL, url);
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writeCallback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)&response);
-    
-    // Set method and body
-    if (strcmp(method, "POST") == 0) {
-        curl_easy_setopt(curl, CURLOPT_POST, 1L);
-        if (body) {
-            curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body);
-        }
-    } else if (strcmp(method, "PUT") == 0) {
-        curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "PUT");
-        if (body) {
-            curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body);
-        }
-    } else if (strcmp(method, "DELETE") == 0) {
-        curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "DELETE");
-    } else if (strcmp(method, "PATCH") == 0) {
-        curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "PATCH");
-        if (body) {
-            curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body);
-        }
-    }
-    
-    // Set headers
-    if (headers) {
-        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-    }
-    
-    // Perform request
-    CURLcode res = curl_easy_perform(curl);
-    
-    // Clean up
-    if (headers) {
-        curl_slist_free_all(headers);
-    }
-    if (body) {
-        #pragma clang diagnostic push
-        #pragma clang diagnostic ignored "-Wcast-qual"
-        free((void*)body);
-        #pragma clang diagnostic pop
-    }
-    
-    if (res != CURLE_OK) {
-        const char *error_msg = curl_easy_strerror(res);
-        lua_pushnil(L);
-        lua_pushstring(L, error_msg);
-        free(response.data);
-        curl_easy_cleanup(curl);
-        return 2;
-    }
-    
-    // Get status code
-    long status_code;
-    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status_code);
-    
-    // Clean up curl
-    curl_easy_cleanup(curl);
-    
-    // Try to parse response as JSON
-    json_error_t error;
-    json_t *json = json_loads(response.data, 0, &error);
-    
-    // Create response table
-    lua_createtable(L, 0, 3);
-    
-    // Add status
-    lua_pushinteger(L, status_code);
-    lua_setfield(L, -2, "status");
-    
-    // Add ok
-    lua_pushboolean(L, status_code >= 200 && status_code < 300);
-    lua_setfield(L, -2, "ok");
-    
-    // Add body
-    if (json) {
-        // If JSON parsing succeeded, convert to Lua table
-        pushJsonToLua(L, json);
-        json_decref(json);
-    } else {
-        // If not JSON, return as string
-        lua_pushstring(L, response.data);
-    }
-    lua_setfield(L, -2, "body");
-    
-    free(response.data);
-    return 1;
-}
-#pragma clang diagnostic pop
-
-// Register HTTP functions with Lua state
-void registerHttpFunctions(lua_State *L) {
-    lua_pushcfunction(L, lua_fetch);
-    lua_setglobal(L, "fetch");
-}
-
 // Modify bytecodeWriter to handle both cases
 static int bytecodeWriter(lua_State *L __attribute__((unused)), 
                          const void* p, 
@@ -517,58 +396,49 @@ static bool loadAllScripts(lua_State *L) {
     return success;
 }
 
-// Add custom allocator function
-static void* luaArenaAlloc(void *ud, void *ptr, size_t osize, size_t nsize) {
-    LuaArenaWrapper *wrapper = (LuaArenaWrapper*)ud;
-    Arena *arena = wrapper->arena;
+// Allocator for request states, failing allocations past the memory limit
+static void* luaQuotaAlloc(void *ud, void *ptr, size_t osize, size_t nsize) {
+    LuaQuota *quota = (LuaQuota*)ud;
+    // Without a block, osize is the type of object being created
+    size_t oldSize = ptr ? osize : 0;
 
-    // Free case
     if (nsize == 0) {
-        // Avoid underflow when subtracting from total_allocated
-        if (wrapper->total_allocated >= osize) {
-            wrapper->total_allocated -= osize;
-        } else {
-            wrapper->total_allocated = 0;
-        }
+        free(ptr);
+        quota->allocated -= oldSize;
         return NULL;
     }
 
-    // Allocation case
-    if (ptr == NULL) {
-        // Check for overflow before adding to total_allocated
-        size_t new_total = wrapper->total_allocated;
-        if (__builtin_add_overflow(new_total, nsize, &new_total)) {
-            return NULL;  // Allocation would overflow
-        }
-        wrapper->total_allocated = new_total;
-        return arenaAlloc(arena, nsize);
+    // Shrinking must not fail. Setup may already have gone past the limit.
+    if (nsize > oldSize &&
+        (quota->allocated > quota->limit || nsize - oldSize > quota->limit - quota->allocated)) {
+        quota->exceededMemory = true;
+        return NULL;
     }
 
-    // Reallocation case
-    void *new_ptr = arenaAlloc(arena, nsize);
-    if (new_ptr) {
-        // Copy the minimum of old and new sizes
-        size_t copy_size = (osize < nsize) ? osize : nsize;
-        if (ptr && copy_size > 0) {
-            memcpy(new_ptr, ptr, copy_size);
-        }
-        
-        // Update total allocated size
-        if (nsize > osize) {
-            size_t diff = nsize - osize;
-            if (__builtin_add_overflow(wrapper->total_allocated, diff, &wrapper->total_allocated)) {
-                wrapper->total_allocated = SIZE_MAX;  // Cap at maximum
-            }
-        } else if (osize > nsize) {
-            size_t diff = osize - nsize;
-            if (wrapper->total_allocated >= diff) {
-                wrapper->total_allocated -= diff;
-            } else {
-                wrapper->total_allocated = 0;
-            }
-        }
+    void *block = realloc(ptr, nsize);
+    if (!block) return NULL;
+    quota->allocated = quota->allocated - oldSize + nsize;
+    return block;
+}
+
+static LuaQuota* getQuota(lua_State *L) {
+    lua_pushlightuserdata(L, &quotaKey);
+    lua_rawget(L, LUA_REGISTRYINDEX);
+    LuaQuota *quota = lua_touserdata(L, -1);
+    lua_pop(L, 1);
+    return quota;
+}
+
+// Stop a step once it has run its instruction budget
+static void luaBudgetHook(lua_State *L, lua_Debug *ar __attribute__((unused))) {
+    LuaQuota *quota = getQuota(L);
+    quota->instructions += LUA_HOOK_INTERVAL;
+    if (quota->instructions >= quota->budget) {
+        // lua_pushfstring has no %u
+        char message[96];
+        snprintf(message, sizeof(message), "Lua step exceeded its budget of %u instructions", quota->budget);
+        luaL_error(L, "%s", message);
     }
-    return new_ptr;
 }
 
 // Helper function to compile pipeline steps
@@ -652,7 +522,7 @@ static int lua_sqlQuery(lua_State *L) {
     const char **params = NULL;
     
     if (lua_gettop(L) >= 2 && !lua_isnil(L, 2)) {
-        luaL_checktype(L, 2, LUA_TTABLE);
+        luaL_argexpected(L, luaIsTableLike(L, 2), 2, "table");
         
         // Count params
         lua_len(L, 2);
@@ -672,7 +542,7 @@ static int lua_sqlQuery(lua_State *L) {
             
             // Extract params from table
             for (lua_Integer i = 0; i < (lua_Integer)param_count; i++) {
-                lua_rawgeti(L, 2, i + 1);
+                lua_geti(L, 2, i + 1);
                 if (lua_isnil(L, -1)) {
                     params[i] = NULL;
                 } else {
@@ -715,151 +585,50 @@ static int lua_findQuery(lua_State *L) {
     return 1;
 }
 
-// Get session store data
-static int lua_getStore(lua_State *L) {
-    // Get key from first argument
-    const char *key = luaL_checkstring(L, 1);
-    
-    // Get session_id from cookies global table
+// Session id from the cookies global, or NULL
+static const char* sessionIdFromCookies(lua_State *L) {
     lua_getglobal(L, "cookies");
     lua_getfield(L, -1, "session");
     const char *session_id = lua_tostring(L, -1);
     lua_pop(L, 2);  // Pop session and cookies table
-    
-    if (!session_id) {
-        lua_pushnil(L);
-        return 1;
-    }
-    
-    // Build query to get session store data
-    const char *sql = "SELECT data::text FROM session_store WHERE session_id = $1 LIMIT 1";
-    const char *params[] = {session_id};
-    
-    // Execute query
-    json_t *result = executeSqlWithParams(g_ctx->db, sql, params, 1);
-    if (!result) {
-        lua_pushnil(L);
-        return 1;
-    }
-    
-    // Get the first row if it exists
-    json_t *rows = json_object_get(result, "rows");
-    if (!rows || !json_array_size(rows)) {
-        json_decref(result);
-        lua_pushnil(L);
-        return 1;
-    }
+    return session_id;
+}
 
-    // Get the first row
-    json_t *row = json_array_get(rows, 0);
-    
-    // Parse the data field as JSON
-    json_t *data_str = json_object_get(row, "data");
-    if (!data_str || !json_is_string(data_str)) {
-        json_decref(result);
-        lua_pushnil(L);
-        return 1;
-    }
-    
-    json_error_t error;
-    json_t *data = json_loads(json_string_value(data_str), 0, &error);
-    json_decref(result);
-    
-    if (!data) {
-        lua_pushnil(L);
-        return 1;
-    }
+// Get session store data. The store is read once per request.
+static int lua_getStore(lua_State *L) {
+    const char *key = luaL_checkstring(L, 1);
+    const char *session_id = sessionIdFromCookies(L);
     
-    // Get the specific key from the data
-    json_t *value = json_object_get(data, key);
+    json_t *value = session_id ? sessionStoreGet(session_id, key) : NULL;
     if (!value) {
-        json_decref(data);
         lua_pushnil(L);
         return 1;
     }
     
-    // Convert just that value to Lua
     pushJsonToLua(L, value);
-    json_decref(data);
-    
     return 1;
 }
 
-// Set a value in session store
+// Set a value in session store. Writes are collected and flushed as one
+// patch when the pipeline finishes.
 static int lua_setStore(lua_State *L) {
-    // Check arguments
     const char *key = luaL_checkstring(L, 1);
     if (lua_isnone(L, 2)) {
         return luaL_error(L, "Missing value argument");
     }
     
-    // Get session_id from cookies global table
-    lua_getglobal(L, "cookies");
-    lua_getfield(L, -1, "session");
-    const char *session_id = lua_tostring(L, -1);
-    lua_pop(L, 2);  // Pop session and cookies table
-    
+    const char *session_id = sessionIdFromCookies(L);
     if (!session_id) {
         lua_pushboolean(L, 0);  // Return false if no session
         return 1;
     }
     
-    // First get existing data
-    const char *get_sql = "SELECT data::text FROM session_store WHERE session_id = $1 LIMIT 1";
-    const char *get_params[] = {session_id};
-    json_t *get_result = executeSqlWithParams(g_ctx->db, get_sql, get_params, 1);
-    
-    // Initialize data object
-    json_t *data = json_object();
-    
-    // If we got existing data, parse it
-    if (get_result) {
-        json_t *rows = json_object_get(get_result, "rows");
-        if (rows && json_array_size(rows)) {
-            json_t *row = json_array_get(rows, 0);
-            json_t *data_str = json_object_get(row, "data");
-            if (data_str && json_is_string(data_str)) {
-                json_error_t error;
-                json_t *parsed_data = json_loads(json_string_value(data_str), 0, &error);
-                if (parsed_data) {
-                    json_decref(data);
-                    data = parsed_data;
-                }
-            }
-        }
-        json_decref(get_result);
-    }
-    
-    // Convert Lua value to JSON and set it in data object
     json_t *value = luaToJson(L, 2);
     if (!value) {
-        json_decref(data);
         return luaL_error(L, "Failed to convert value to JSON");
     }
-    json_object_set_new(data, key, value);
-    
-    // Convert data object to string
-    char *data_str = json_dumps(data, JSON_COMPACT);
-    if (!data_str) {
-        json_decref(data);
-        return luaL_error(L, "Failed to convert data to string");
-    }
-    
-    // Update session store
-    const char *update_sql = "INSERT INTO session_store (session_id, data) VALUES ($1, $2::jsonb) "
-                           "ON CONFLICT (session_id) DO UPDATE SET data = $2::jsonb, updated_at = CURRENT_TIMESTAMP";
-    const char *update_params[] = {session_id, data_str};
-    json_t *sqlResult = executeSqlWithParams(g_ctx->db, update_sql, update_params, 2);
-    
-    json_decref(data);
-    
-    if (!sqlResult) {
-        lua_pushboolean(L, 0);  // Return false if update failed
-        return 1;
-    }
     
-    json_decref(sqlResult);
-    lua_pushboolean(L, 1);  // Return true for success
+    lua_pushboolean(L, sessionStoreSet(session_id, key, value));
     return 1;
 }
 
@@ -872,12 +641,14 @@ static int lua_redirectLogin(lua_State *L) {
     lua_getfield(L, -1, "anonymous_session");
     const char *anonymous_session = lua_tostring(L, -1);
 
-    // Add database update for return path
-    if (returnPath && anonymous_session) {
+    // Store the return path. The session's row may still be waiting in the
+    // batch writer's queue, so this creates it if needed.
+    if (returnPath && verifyAnonymousSession(anonymous_session)) {
         const char *values[] = {returnPath, anonymous_session};
         PGresult *result = executeParameterizedQuery(
             g_ctx->db,
-            "UPDATE anonymous_sessions SET return_path = $1, updated_at = NOW() WHERE token = $2",
+            "INSERT INTO anonymous_sessions (token, return_path) VALUES ($2, $1) "
+            "ON CONFLICT (token) DO UPDATE SET return_path = $1, updated_at = NOW()",
             values,
             2
         );
@@ -936,135 +707,192 @@ void registerDbFunctions(lua_State *L) {
     lua_setglobal(L, "getenv");
 }
 
-// Add global cache for embedded scripts
+// Embedded scripts, each ready to load into any state
+typedef struct EmbeddedModule {
+    const char *name;
+    const unsigned char *bytecode;  // Precompiled by the generator, or compiled here
+    size_t bytecodeLength;
+    char *source;                   // Joined source, when the precompiled chunk was unusable
+} EmbeddedModule;
+
 static struct {
-    char **script_buffers;  // Array of script buffers
-    size_t script_count;
-    const char **script_names;  // Array of script names
+    EmbeddedModule *modules;
+    size_t count;
+    bool ready;
+    uint8_t _padding[7];
 } g_embedded_scripts = {0};
 
-static bool loadEmbeddedScripts(lua_State *L) {
-    // If scripts are already loaded, just set them as globals
-    if (g_embedded_scripts.script_buffers) {
-        for (size_t i = 0; i < g_embedded_scripts.script_count; i++) {
-            const char *name = g_embedded_scripts.script_names[i];
-            const char *buffer = g_embedded_scripts.script_buffers[i];
-            
-            // Get cached bytecode
-            LuaChunkEntry* entry = compileAndCacheLuaCode(buffer, name, g_ctx->arena);
-            if (!entry) {
-                fprintf(stderr, "Failed to find cached bytecode for embedded script %s\n", name);
-                return false;
-            }
+// Join a script's source chunks into one string
+static char* joinEmbeddedSource(const EmbeddedScript *script) {
+    size_t total_len = 0;
+    for (size_t i = 0; i < script->num_chunks; i++) {
+        total_len += strlen(script->chunks[i]);
+    }
 
-            // Load and execute using cached bytecode
-            if (luaL_loadbuffer(L, (const char*)entry->bytecode.bytecode, 
-                              entry->bytecode.bytecode_len, name) != 0) {
-                fprintf(stderr, "Failed to load embedded script %s: %s\n", 
-                        name, lua_tostring(L, -1));
-                return false;
-            }
+    char *buffer = malloc(total_len + 1);
+    if (!buffer) {
+        return NULL;
+    }
 
-            // Execute the chunk to get the module table
-            if (lua_pcall(L, 0, 1, 0) != 0) {
-                fprintf(stderr, "Failed to execute embedded script %s: %s\n",
-                        name, lua_tostring(L, -1));
-                return false;
-            }
+    char *ptr = buffer;
+    for (size_t i = 0; i < script->num_chunks; i++) {
+        size_t len = strlen(script->chunks[i]);
+        memcpy(ptr, script->chunks[i], len);
+        ptr += len;
+    }
+    *ptr = '\0';
+    return buffer;
+}
 
-            // Set the module table as a global with the script name
-            lua_setglobal(L, name);
-        }
+// Pick each embedded script's bytecode once, at startup. The generator's
+// luac output is used as is; scripts generated without luac, or for another
+// Lua version, are compiled from their embedded source instead.
+static bool prepareEmbeddedScripts(void) {
+    if (g_embedded_scripts.ready) {
         return true;
     }
 
-    // First time loading - count scripts
     size_t script_count = 0;
     for (const EmbeddedScript *script = EMBEDDED_SCRIPTS; script->name != NULL; script++) {
         script_count++;
     }
-
-    // If no scripts found, that's fine - return success
     if (script_count == 0) {
+        g_embedded_scripts.ready = true;
         return true;
     }
 
-    // Allocate arrays
-    g_embedded_scripts.script_buffers = malloc(script_count * sizeof(char*));
-    g_embedded_scripts.script_names = malloc(script_count * sizeof(char*));
-    if (!g_embedded_scripts.script_buffers || !g_embedded_scripts.script_names) {
-        // Clean up if one allocation succeeded but the other failed
-        free(g_embedded_scripts.script_buffers);
-        free(g_embedded_scripts.script_names);
-        g_embedded_scripts.script_buffers = NULL;
-        g_embedded_scripts.script_names = NULL;
+    g_embedded_scripts.modules = calloc(script_count, sizeof(EmbeddedModule));
+    if (!g_embedded_scripts.modules) {
         fprintf(stderr, "Failed to allocate script arrays\n");
         return false;
     }
-    g_embedded_scripts.script_count = script_count;
 
-    // Load each script
-    size_t script_idx = 0;
+    lua_State *L = luaL_newstate();
+    if (!L) {
+        return false;
+    }
+
     for (const EmbeddedScript *script = EMBEDDED_SCRIPTS; script->name != NULL; script++) {
-        // Calculate total length
-        size_t total_len = 0;
-        for (size_t i = 0; i < script->num_chunks; i++) {
-            total_len += strlen(script->chunks[i]);
+        EmbeddedModule *module = &g_embedded_scripts.modules[g_embedded_scripts.count++];
+        module->name = script->name;
+
+        if (script->bytecode) {
+            if (luaL_loadbuffer(L, (const char*)script->bytecode, script->bytecode_len, script->name) == 0) {
+                lua_pop(L, 1);
+                module->bytecode = script->bytecode;
+                module->bytecodeLength = script->bytecode_len;
+                continue;
+            }
+            fprintf(stderr, "Precompiled embedded script %s does not load (%s), compiling its source\n",
+                    script->name, lua_tostring(L, -1));
+            lua_pop(L, 1);
         }
 
-        // Allocate buffer
-        char *buffer = malloc(total_len + 1);
-        if (!buffer) {
+        module->source = joinEmbeddedSource(script);
+        if (!module->source) {
             fprintf(stderr, "Failed to allocate buffer for embedded script %s\n", script->name);
+            lua_close(L);
             return false;
         }
 
-        // Concatenate chunks
-        char *ptr = buffer;
-        for (size_t i = 0; i < script->num_chunks; i++) {
-            size_t len = strlen(script->chunks[i]);
-            memcpy(ptr, script->chunks[i], len);
-            ptr += len;
-        }
-        *ptr = '\0';
-
-        // Store in global cache
-        g_embedded_scripts.script_buffers[script_idx] = buffer;
-        g_embedded_scripts.script_names[script_idx] = script->name;
-
-        // Compile and cache bytecode
-        LuaChunkEntry* entry = compileAndCacheLuaCode(buffer, script->name, g_ctx->arena);
+        LuaChunkEntry* entry = compileAndCacheLuaCode(module->source, script->name, NULL);
         if (!entry) {
             fprintf(stderr, "Failed to compile embedded script %s\n", script->name);
+            lua_close(L);
             return false;
         }
+        module->bytecode = entry->bytecode.bytecode;
+        module->bytecodeLength = entry->bytecode.bytecode_len;
+    }
 
-        // Load and execute using cached bytecode
-        if (luaL_loadbuffer(L, (const char*)entry->bytecode.bytecode, 
-                          entry->bytecode.bytecode_len, script->name) != 0) {
-            fprintf(stderr, "Failed to load embedded script %s: %s\n", 
-                    script->name, lua_tostring(L, -1));
-            return false;
+    lua_close(L);
+    g_embedded_scripts.ready = true;
+    return true;
+}
+
+// package.preload loader for the embedded module in upvalue 1
+static int loadEmbeddedModule(lua_State *L) {
+    const EmbeddedModule *module = lua_touserdata(L, lua_upvalueindex(1));
+    if (luaL_loadbuffer(L, (const char*)module->bytecode, module->bytecodeLength, module->name) != 0) {
+        return lua_error(L);
+    }
+    lua_call(L, 0, 1);
+    return 1;
+}
+
+// __index for _G, so scripts can keep using an embedded module as a global
+// (querybuilder.new()) without requiring it. The first lookup requires the
+// module and stores it in _G.
+static int lazyEmbeddedGlobal(lua_State *L) {
+    if (lua_type(L, 2) != LUA_TSTRING) {
+        return 0;
+    }
+
+    const char *name = lua_tostring(L, 2);
+    for (size_t i = 0; i < g_embedded_scripts.count; i++) {
+        if (strcmp(g_embedded_scripts.modules[i].name, name) == 0) {
+            lua_getglobal(L, "require");
+            lua_pushvalue(L, 2);
+            lua_call(L, 1, 1);
+            lua_pushvalue(L, 2);
+            lua_pushvalue(L, -2);
+            lua_rawset(L, 1);
+            return 1;
         }
+    }
+    return 0;
+}
+
+// Register the embedded scripts in package.preload. Nothing runs until a
+// script requires a module or uses its global.
+static bool registerEmbeddedScripts(lua_State *L) {
+    if (!prepareEmbeddedScripts()) {
+        return false;
+    }
+    if (g_embedded_scripts.count == 0) {
+        return true;
+    }
+
+    lua_getglobal(L, "package");
+    lua_getfield(L, -1, "preload");
+    for (size_t i = 0; i < g_embedded_scripts.count; i++) {
+        EmbeddedModule *module = &g_embedded_scripts.modules[i];
+        lua_pushlightuserdata(L, module);
+        lua_pushcclosure(L, loadEmbeddedModule, 1);
+        lua_setfield(L, -2, module->name);
+    }
+    lua_pop(L, 2);
+
+    lua_pushglobaltable(L);
+    lua_createtable(L, 0, 1);
+    lua_pushcfunction(L, lazyEmbeddedGlobal);
+    lua_setfield(L, -2, "__index");
+    lua_setmetatable(L, -2);
+    lua_pop(L, 1);
+    return true;
+}
 
-        // Execute the chunk to get the module table
-        if (lua_pcall(L, 0, 1, 0) != 0) {
+// Run every embedded module once, so a broken one stops startup
+static bool checkEmbeddedScripts(lua_State *L) {
+    for (size_t i = 0; i < g_embedded_scripts.count; i++) {
+        const char *name = g_embedded_scripts.modules[i].name;
+        lua_getglobal(L, "require");
+        lua_pushstring(L, name);
+        if (lua_pcall(L, 1, 1, 0) != 0) {
             fprintf(stderr, "Failed to execute embedded script %s: %s\n",
-                    script->name, lua_tostring(L, -1));
+                    name, lua_tostring(L, -1));
+            lua_pop(L, 1);
             return false;
         }
-
-        // Set the module table as a global with the script name
-        lua_setglobal(L, script->name);
-        
-        script_idx++;
+        lua_setglobal(L, name);
     }
-
     return true;
 }
 
 // Modify cleanupLua to cleanup embedded scripts:
 void cleanupLua(void) {
+    cleanupLuaFetch();
+
     // Cleanup file registry
     for (size_t i = 0; i < fileRegistry.count; i++) {
         free(fileRegistry.entries[i].filename);
@@ -1076,16 +904,13 @@ void cleanupLua(void) {
     fileRegistry.capacity = 0;
 
     // Cleanup embedded scripts
-    if (g_embedded_scripts.script_buffers) {
-        for (size_t i = 0; i < g_embedded_scripts.script_count; i++) {
-            free(g_embedded_scripts.script_buffers[i]);
-        }
-        free(g_embedded_scripts.script_buffers);
-        free((void*)g_embedded_scripts.script_names);
-        g_embedded_scripts.script_buffers = NULL;
-        g_embedded_scripts.script_names = NULL;
-        g_embedded_scripts.script_count = 0;
+    for (size_t i = 0; i < g_embedded_scripts.count; i++) {
+        free(g_embedded_scripts.modules[i].source);
     }
+    free(g_embedded_scripts.modules);
+    g_embedded_scripts.modules = NULL;
+    g_embedded_scripts.count = 0;
+    g_embedded_scripts.ready = false;
 
     // Cleanup chunk table
     for (int i = 0; i < LUA_HASH_TABLE_SIZE; i++) {
@@ -1101,253 +926,97 @@ void cleanupLua(void) {
     }
 }
 
-static lua_State* createLuaState(json_t *requestContext, Arena *arena) {
-    // Create and initialize arena wrapper
-    LuaArenaWrapper *wrapper = arenaAlloc(arena, sizeof(LuaArenaWrapper));
-    if (!wrapper) {
-        fprintf(stderr, "Failed to allocate arena wrapper\n");
+// Expose a request context field as a global, proxied rather than copied
+static void setContextGlobal(lua_State *L, json_t *requestContext, const char *name) {
+    json_t *value = json_object_get(requestContext, name);
+    if (json_is_object(value) || json_is_array(value)) {
+        pushJsonToLua(L, value);
+    } else {
+        lua_newtable(L);
+    }
+    lua_setglobal(L, name);
+}
+
+lua_State* createLuaState(json_t *requestContext, Arena *arena) {
+    LuaQuota *quota = arenaAlloc(arena, sizeof(LuaQuota));
+    if (!quota) {
+        fprintf(stderr, "Failed to allocate Lua quota\n");
         return NULL;
     }
-    wrapper->arena = arena;
-    wrapper->total_allocated = 0;
+    memset(quota, 0, sizeof(LuaQuota));
+    // Setup runs unprotected, where a failed allocation panics, so the limit
+    // only applies once the step itself runs
+    quota->limit = SIZE_MAX;
 
     // Create Lua state with custom allocator
-    lua_State *L = lua_newstate(luaArenaAlloc, wrapper);
+    lua_State *L = lua_newstate(luaQuotaAlloc, quota);
+#ifdef WEBDSL_LUAJIT
+    // LuaJIT without GC64 only runs on its own allocator, without a limit
+    if (!L) L = luaL_newstate();
+#endif
     if (!L) {
         fprintf(stderr, "Failed to create new Lua state\n");
         return NULL;
     }
 
-    // Disable GC since we're using arena allocation and states are short-lived
-    lua_gc(L, LUA_GCSTOP, 0);
+    lua_pushlightuserdata(L, &quotaKey);
+    lua_pushlightuserdata(L, quota);
+    lua_rawset(L, LUA_REGISTRYINDEX);
+
+#ifndef WEBDSL_LUAJIT
+    // Loops that build temporary strings and tables get collected as they go
+    lua_gc(L, LUA_GCGEN, 0, 0);
+#endif
 
     luaL_openlibs(L);
     
     // Register our functions
+    registerJsonFunctions(L);
     registerHttpFunctions(L);
+    registerSharedFunctions(L);
     registerDbFunctions(L);
     registerS3Functions(L);  // Add this line to register S3 functions
     
-    // Load embedded scripts into this state
-    if (!loadEmbeddedScripts(L)) {
+    // Make embedded scripts available to require
+    if (!registerEmbeddedScripts(L)) {
         fprintf(stderr, "Failed to load embedded scripts\n");
         lua_close(L);
         return NULL;
     }
     
-    // Create tables for request context
-    lua_newtable(L);  // Main request context table
-    
     // Set up globals from the original request context
-    json_t *query = json_object_get(requestContext, "query");
-    json_t *body = json_object_get(requestContext, "body");
-    json_t *headers = json_object_get(requestContext, "headers");
-    json_t *cookies = json_object_get(requestContext, "cookies");
-    json_t *params = json_object_get(requestContext, "params");
-    json_t *files = json_object_get(requestContext, "files");  // Add files to context
-    
-    // Create query table
-    lua_newtable(L);
-    const char *key;
-    json_t *value;
-    if (query) {
-        json_object_foreach(query, key, value) {
-            lua_pushstring(L, key);
-            lua_pushstring(L, json_string_value(value));
-            lua_settable(L, -3);
-        }
-    }
-    lua_setglobal(L, "query");
-    
-    // Create body table
-    lua_newtable(L);
-    if (body) {
-        json_object_foreach(body, key, value) {
-            lua_pushstring(L, key);
-            lua_pushstring(L, json_string_value(value));
-            lua_settable(L, -3);
-        }
-    }
-    lua_setglobal(L, "body");
-    
-    // Create headers table
-    lua_newtable(L);
-    if (headers) {
-        json_object_foreach(headers, key, value) {
-            lua_pushstring(L, key);
-            lua_pushstring(L, json_string_value(value));
-            lua_settable(L, -3);
-        }
-    }
-    lua_setglobal(L, "headers");
-    
-    // Create cookies table
-    lua_newtable(L);
-    if (cookies) {
-        json_object_foreach(cookies, key, value) {
-            lua_pushstring(L, key);
-            lua_pushstring(L, json_string_value(value));
-            lua_settable(L, -3);
-        }
-    }
-    lua_setglobal(L, "cookies");
-
-    // Create params table
-    lua_newtable(L);
-    json_object_foreach(params, key, value) {
-        lua_pushstring(L, key);
-        lua_pushstring(L, json_string_value(value));
-        lua_settable(L, -3);
-    }
-    lua_setglobal(L, "params");
-
-    // Create files table
-    lua_newtable(L);
-    json_object_foreach(files, key, value) {
-        lua_pushstring(L, key);
-        pushJsonToLua(L, value);  // Use pushJsonToLua since files contain nested objects
-        lua_settable(L, -3);
-    }
-    lua_setglobal(L, "files");
+    setContextGlobal(L, requestContext, "query");
+    setContextGlobal(L, requestContext, "body");
+    setContextGlobal(L, requestContext, "headers");
+    setContextGlobal(L, requestContext, "cookies");
+    setContextGlobal(L, requestContext, "params");
+    setContextGlobal(L, requestContext, "files");
     
     return L;
 }
 
-static void pushJsonToLua(lua_State *L, json_t *json) {
-    if (!json) {
-        lua_pushnil(L);
-        return;
-    }
-
-    switch (json_typeof(json)) {
-        case JSON_OBJECT: {
-            lua_newtable(L);
-            const char *key;
-            json_t *value;
-            json_object_foreach(json, key, value) {
-                lua_pushstring(L, key);
-                pushJsonToLua(L, value);
-                lua_settable(L, -3);
-            }
-            break;
-        }
-        case JSON_ARRAY: {
-            lua_newtable(L);
-            size_t index;
-            json_t *value;
-            json_array_foreach(json, index, value) {
-                lua_Integer lua_index = (lua_Integer)(index + 1);
-                if (lua_index > 0) {
-                    lua_pushinteger(L, lua_index);
-                    pushJsonToLua(L, value);
-                    lua_settable(L, -3);
-                }
-            }
-            break;
+const LuaBytecode* findLuaBytecode(const char *code) {
+    if (!code) return NULL;
+    uint32_t hash = hashString(code) & LUA_HASH_MASK;
+    for (LuaChunkEntry *entry = chunkTable[hash]; entry; entry = entry->next) {
+        if (strcmp(entry->code, code) == 0) {
+            return &entry->bytecode;
         }
-        case JSON_STRING:
-            lua_pushstring(L, json_string_value(json));
-            break;
-        case JSON_INTEGER:
-            lua_pushinteger(L, json_integer_value(json));
-            break;
-        case JSON_REAL:
-            lua_pushnumber(L, json_real_value(json));
-            break;
-        case JSON_TRUE:
-            lua_pushboolean(L, 1);
-            break;
-        case JSON_FALSE:
-            lua_pushboolean(L, 0);
-            break;
-        case JSON_NULL:
-            lua_pushnil(L);
-            break;
     }
+    return NULL;
 }
 
-static json_t* luaToJson(lua_State *L, int index) {
-    switch (lua_type(L, index)) {
-        case LUA_TTABLE: {
-            // Normalize the index to be positive if it was negative
-            if (index < 0) {
-                index = lua_gettop(L) + index + 1;
-            }
-            
-            // First pass: determine if it's an array
-            bool isArray = true;
-            size_t arrayLen = 0;
-            
-            lua_pushnil(L);  // First key
-            while (lua_next(L, index) != 0) {
-                if (!lua_isnumber(L, -2) || lua_tointeger(L, -2) != (lua_Integer)(arrayLen + 1)) {
-                    isArray = false;
-                }
-                arrayLen++;
-                lua_pop(L, 1);  // Remove value, keep key for next iteration
-            }
-            
-            if (isArray) {
-                // Create JSON array
-                json_t *arr = json_array();
-                for (size_t i = 1; i <= arrayLen; i++) {
-                    lua_rawgeti(L, index, (lua_Integer)i);
-                    json_t *value = luaToJson(L, -1);
-                    if (value) {
-                        json_array_append_new(arr, value);
-                    }
-                    lua_pop(L, 1);
-                }
-                return arr;
-            } else {
-                // Create JSON object
-                json_t *obj = json_object();
-                lua_pushnil(L);  // First key
-                while (lua_next(L, index) != 0) {
-                    // Convert key to string
-                    const char *key;
-                    if (lua_type(L, -2) == LUA_TSTRING) {
-                        key = lua_tostring(L, -2);
-                    } else {
-                        // Convert non-string key to string
-                        lua_pushvalue(L, -2);  // Copy key
-                        key = lua_tostring(L, -1);
-                        lua_pop(L, 1);  // Remove key copy
-                    }
-                    
-                    if (key) {
-                        json_t *value = luaToJson(L, -1);
-                        if (value) {
-                            json_object_set_new(obj, key, value);
-                        }
-                    }
-                    lua_pop(L, 1);  // Remove value, keep key for next iteration
-                }
-                return obj;
-            }
-        }
-        case LUA_TSTRING:
-            return json_string(lua_tostring(L, index));
-        case LUA_TNUMBER:
-            if (lua_isinteger(L, index)) {
-                return json_integer(lua_tointeger(L, index));
-            }
-            return json_real(lua_tonumber(L, index));
-        case LUA_TBOOLEAN:
-            return lua_toboolean(L, index) ? json_true() : json_false();
-        case LUA_TNIL:
-            return json_null();
-        default:
-            return json_null();
-    }
+const LuaBytecode* compileLuaBytecode(const char *code) {
+    LuaChunkEntry *entry = compileAndCacheLuaCode(code, "step", NULL);
+    return entry ? &entry->bytecode : NULL;
 }
 
 json_t* executeLuaStep(PipelineStepNode *step, json_t *input, json_t *requestContext, Arena *arena, ServerContext *serverCtx) {
     (void)serverCtx;
 
     // Get code from named script if specified
-    const char* code = step->code;
-    if (step->name) {
+    const char* code = step->resolvedCode ? step->resolvedCode : step->code;
+    if (step->name && !step->resolvedCode) {
         ScriptNode* namedScript = findScript(step->name);
         if (!namedScript) {
             json_t *result = json_object();
@@ -1363,96 +1032,71 @@ json_t* executeLuaStep(PipelineStepNode *step, json_t *input, json_t *requestCon
         return result;
     }
 
-    lua_State *L = createLuaState(input, arena);
+    lua_State *L = createLuaState(requestContext, arena);
     if (!L) {
         json_t *result = json_object();
         json_object_set_new(result, "error", json_string("Failed to create Lua state"));
         return result;
     }
-    
-    // Register all our functions
-    registerHttpFunctions(L);
-    registerDbFunctions(L);
-    registerS3Functions(L);  // Add this line to register S3 functions
-    
+
     // Set up input from previous step
     pushJsonToLua(L, input);
     lua_setglobal(L, "request");
     
-    // Set up globals from the original request context
-    json_t *query = json_object_get(requestContext, "query");
-    json_t *body = json_object_get(requestContext, "body");
-    json_t *headers = json_object_get(requestContext, "headers");
-    
-    // Create query table
-    lua_newtable(L);
-    const char *key;
-    json_t *value;
-    json_object_foreach(query, key, value) {
-        lua_pushstring(L, key);
-        lua_pushstring(L, json_string_value(value));
-        lua_settable(L, -3);
-    }
-    lua_setglobal(L, "query");
-    
-    // Create body table
-    lua_newtable(L);
-    if (body) {
-        json_object_foreach(body, key, value) {
-            lua_pushstring(L, key);
-            lua_pushstring(L, json_string_value(value));
-            lua_settable(L, -3);
-        }
-    }
-    lua_setglobal(L, "body");
-    
-    // Create headers table
-    lua_newtable(L);
-    if (headers) {
-        json_object_foreach(headers, key, value) {
-            lua_pushstring(L, key);
-            lua_pushstring(L, json_string_value(value));
-            lua_settable(L, -3);
-        }
-    }
-    lua_setglobal(L, "headers");
-    
-    // Find cached bytecode using the actual code
-    uint32_t hash = hashString(code) & LUA_HASH_MASK;
-    LuaChunkEntry* entry = chunkTable[hash];
-    while (entry) {
-        if (strcmp(entry->code, code) == 0) {
-            break;
+    // Linked steps carry their bytecode, others look it up by code
+    const unsigned char *bytecode = step->luaBytecode;
+    size_t bytecodeLength = step->luaBytecodeLength;
+    if (!bytecode) {
+        const LuaBytecode *cached = findLuaBytecode(code);
+        if (!cached) {
+            metricsCacheMiss(METRICS_CACHE_LUA);
+            lua_close(L);
+            json_t *result = json_object();
+            json_object_set_new(result, "error", json_string("Failed to find cached Lua bytecode"));
+            return result;
         }
-        entry = entry->next;
-    }
-    
-    if (!entry) {
-        lua_close(L);
-        json_t *result = json_object();
-        json_object_set_new(result, "error", json_string("Failed to find cached Lua bytecode"));
-        return result;
+        bytecode = cached->bytecode;
+        bytecodeLength = cached->bytecode_len;
     }
+    metricsCacheHit(METRICS_CACHE_LUA);
     
     // Load and execute
-    if (luaL_loadbuffer(L, (const char*)entry->bytecode.bytecode, 
-                       entry->bytecode.bytecode_len, "step") != 0) {
-        const char *error_msg = lua_tostring(L, -1);
-        lua_close(L);
+    if (luaL_loadbuffer(L, (const char*)bytecode, bytecodeLength, "step") != 0) {
         json_t *result = json_object();
-        json_object_set_new(result, "error", json_string(error_msg));
+        json_object_set_new(result, "error", json_string(lua_tostring(L, -1)));
+        lua_close(L);
         return result;
     }
     
-    if (lua_pcall(L, 0, 1, 0) != 0) {
-        const char *error_msg = lua_tostring(L, -1);
-        lua_close(L);
+    // The route's budget, or the server default
+    LuaQuota *quota = getQuota(L);
+    quota->budget = step->luaBudget ? step->luaBudget : defaultBudget;
+    quota->instructions = 0;
+    if (quota->budget) {
+        lua_sethook(L, luaBudgetHook, LUA_MASKCOUNT, LUA_HOOK_INTERVAL);
+    }
+
+    quota->limit = memoryLimit;
+    int status = lua_pcall(L, 0, 1, 0);
+    lua_sethook(L, NULL, 0, 0);
+    // Converting the result isn't protected, so it mustn't run out of memory
+    quota->limit = SIZE_MAX;
+
+    if (status != LUA_OK) {
         json_t *result = json_object();
-        json_object_set_new(result, "error", json_string(error_msg));
+        if (status == LUA_ERRMEM && quota->exceededMemory) {
+            char message[128];
+            snprintf(message, sizeof(message), "Lua step exceeded its memory limit of %zu bytes", memoryLimit);
+            json_object_set_new(result, "error", json_string(message));
+        } else {
+            json_object_set_new(result, "error", json_string(lua_tostring(L, -1)));
+        }
+        lua_close(L);
         return result;
     }
     
     json_t *result = luaToJson(L, -1);
+    bool shared = luaJsonIsShared(L, -1);
     lua_close(L);
     
     if (!result) {
@@ -1461,6 +1105,13 @@ json_t* executeLuaStep(PipelineStepNode *step, json_t *input, json_t *requestCon
         return error_result;
     }
     
+    // Returned unchanged from the input, so copy before merging into it
+    if (shared) {
+        json_t *copy = json_copy(result);
+        json_decref(result);
+        result = copy;
+    }
+    
     // Merge input properties into result
     if (input) {
         json_object_update(result, input);
@@ -1472,7 +1123,7 @@ json_t* executeLuaStep(PipelineStepNode *step, json_t *input, json_t *requestCon
 // Mock S3 upload function
 static int lua_s3Upload(lua_State *L) {
     // Get upload parameters
-    luaL_checktype(L, 1, LUA_TTABLE);
+    luaL_argexpected(L, luaIsTableLike(L, 1), 1, "table");
     
     // Get bucket
     lua_getfield(L, 1, "bucket");
@@ -1484,7 +1135,9 @@ static int lua_s3Upload(lua_State *L) {
     
     // Get file info
     lua_getfield(L, 1, "file");
-    luaL_checktype(L, -1, LUA_TTABLE);
+    if (!luaIsTableLike(L, -1)) {
+        return luaL_error(L, "file must be a table");
+    }
     
     lua_getfield(L, -1, "tempPath");
     const char *tempPath = luaL_checkstring(L, -1);
@@ -1506,12 +1159,8 @@ static int lua_s3Upload(lua_State *L) {
     lua_setfield(L, -2, "url");
     
     // Log the mock upload
-    fprintf(stderr, "Mock S3 Upload:\n");
-    fprintf(stderr, "  Bucket: %s\n", bucket);
-    fprintf(stderr, "  Key: %s\n", key);
-    fprintf(stderr, "  Content-Type: %s\n", contentType);
-    fprintf(stderr, "  Source: %s\n", tempPath);
-    fprintf(stderr, "  URL: %s\n", url);
+    logInfo("Mock S3 upload: bucket=%s key=%s contentType=%s source=%s url=%s",
+            bucket, key, contentType ? contentType : "", tempPath, url);
     
     return 1;
 }
@@ -1525,6 +1174,20 @@ void registerS3Functions(lua_State *L) {
 // Modify initLua to register S3 functions
 bool initLua(ServerContext *server_ctx) {
     g_ctx = server_ctx;  // Store in global
+
+    const char *limit = getenv("WEBDSL_LUA_MEMORY_LIMIT");
+    memoryLimit = DEFAULT_LUA_MEMORY_LIMIT;
+    if (limit && atol(limit) > 0) {
+        memoryLimit = (size_t)atol(limit);
+    }
+
+    initLuaFetch();
+
+    const char *budget = getenv("WEBDSL_LUA_BUDGET");
+    defaultBudget = DEFAULT_LUA_BUDGET;
+    if (budget && atol(budget) > 0 && (unsigned long)atol(budget) <= UINT32_MAX) {
+        defaultBudget = (uint32_t)atol(budget);
+    }
     
     if (!initFileRegistry()) {
         return false;
@@ -1537,11 +1200,12 @@ bool initLua(ServerContext *server_ctx) {
     
     // Register our functions
     registerHttpFunctions(L);
+    registerSharedFunctions(L);
     registerDbFunctions(L);
     registerS3Functions(L);  // Add S3 functions
     
     // First load embedded scripts
-    if (!loadEmbeddedScripts(L)) {
+    if (!registerEmbeddedScripts(L) || !checkEmbeddedScripts(L)) {
         lua_close(L);
         cleanupLua();
         return false;
@@ -1,9 +1,7 @@
 #ifndef LUA_H
 #define LUA_H
 
-#include <lua.h>
-#include <lauxlib.h>
-#include <lualib.h>
+#include "lua_compat.h"
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wpadded"
 #include <jansson.h>
@@ -47,12 +45,21 @@ bool initLua(ServerContext *ctx);
 // Clean up Lua subsystem
 void cleanupLua(void);
 
+// Create a request Lua state with the embedded scripts and server functions
+// loaded. The accounting for its memory is allocated from arena, and
+// executeLuaStep limits it to WEBDSL_LUA_MEMORY_LIMIT bytes while a step runs.
+lua_State* createLuaState(json_t *requestContext, Arena *arena);
+
+// Bytecode compiled at load time for code, or NULL
+const LuaBytecode* findLuaBytecode(const char *code);
+
+// Compile code and cache its bytecode for steps that weren't loaded with the
+// website, returning NULL if it doesn't compile
+const LuaBytecode* compileLuaBytecode(const char *code);
+
 // Execute a Lua pipeline step
 json_t* executeLuaStep(PipelineStepNode *step, json_t *input, json_t *requestContext, Arena *arena, ServerContext *ctx);
 
-// Register HTTP functions with Lua state
-void registerHttpFunctions(lua_State *L);
-
 // Register database functions with Lua state
 void registerDbFunctions(lua_State *L);
 
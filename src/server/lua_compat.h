@@ -0,0 +1,83 @@
+#ifndef SERVER_LUA_COMPAT_H
+#define SERVER_LUA_COMPAT_H
+
+#include <lua.h>
+#include <lauxlib.h>
+#include <lualib.h>
+
+// The server is written against the Lua 5.4 API. Building with LUA=luajit
+// defines WEBDSL_LUAJIT and fills in the parts LuaJIT's 5.1 API lacks.
+#ifdef WEBDSL_LUAJIT
+#include <luajit.h>
+#include <stdint.h>
+
+#ifndef LUA_OK
+#define LUA_OK 0
+#endif
+
+typedef uint64_t lua_Unsigned;
+
+#ifndef lua_pushglobaltable
+#define lua_pushglobaltable(L) lua_pushvalue(L, LUA_GLOBALSINDEX)
+#endif
+
+#define luaL_typeerror(L, arg, tname) luaL_typerror(L, (arg), (tname))
+#define luaL_argexpected(L, cond, arg, tname) \
+    ((void)((cond) || luaL_typerror(L, (arg), (tname))))
+
+static inline int lua_absindex(lua_State *L, int index) {
+    return (index > 0 || index <= LUA_REGISTRYINDEX) ? index : lua_gettop(L) + index + 1;
+}
+
+// Numbers are doubles, so integral ones stand in for integers
+static inline int lua_isinteger(lua_State *L, int index) {
+    if (lua_type(L, index) != LUA_TNUMBER) return 0;
+    lua_Number number = lua_tonumber(L, index);
+    #pragma clang diagnostic push
+    #pragma clang diagnostic ignored "-Wfloat-equal"
+    return number >= -9007199254740992.0 && number <= 9007199254740992.0 &&
+           (lua_Number)(lua_Integer)number == number;
+    #pragma clang diagnostic pop
+}
+
+static inline int lua_geti(lua_State *L, int index, lua_Integer i) {
+    index = lua_absindex(L, index);
+    lua_pushinteger(L, i);
+    lua_gettable(L, index);
+    return lua_type(L, -1);
+}
+
+// Honors __len on userdata, which lua_objlen doesn't
+static inline void lua_len(lua_State *L, int index) {
+    if (!luaL_callmeta(L, index, "__len")) {
+        lua_pushinteger(L, (lua_Integer)lua_objlen(L, index));
+    }
+}
+
+// User values live in the userdata's environment table
+static inline void* lua_newuserdatauv(lua_State *L, size_t size, int nuvalue) {
+    void *block = lua_newuserdata(L, size);
+    lua_createtable(L, nuvalue, 0);
+    lua_setfenv(L, -2);
+    return block;
+}
+
+static inline int lua_getiuservalue(lua_State *L, int index, int n) {
+    index = lua_absindex(L, index);
+    lua_getfenv(L, index);
+    lua_rawgeti(L, -1, n);
+    lua_remove(L, -2);
+    return lua_type(L, -1);
+}
+
+static inline int lua_setiuservalue(lua_State *L, int index, int n) {
+    index = lua_absindex(L, index);
+    lua_getfenv(L, index);
+    lua_insert(L, -2);
+    lua_rawseti(L, -2, n);
+    lua_pop(L, 1);
+    return 1;
+}
+#endif // WEBDSL_LUAJIT
+
+#endif // SERVER_LUA_COMPAT_H
@@ -0,0 +1,605 @@
+#include "lua_fetch.h"
+#include "lua_json.h"
+#include "lua.h"
+#include "http_client.h"
+#include "fetch_cache.h"
+#include "metrics.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_FETCH_TIMEOUT_MS 30000L
+#define MAX_FETCH_BATCH 256
+#define POLL_TIMEOUT_MS 1000
+#define FETCH_BATCH_META "webdsl.fetch.batch"
+
+typedef struct FetchRequest {
+    CURL *curl;               // NULL when served from the cache
+    struct curl_slist *headers;
+    char *body;               // Request body, owned
+    ResponseBuffer response;
+    const char *error;        // Why the request couldn't be made, if it couldn't
+    char *cacheKey;           // Set when the response can come from or go to the cache
+    long cacheTtl;            // cache = { ttl = N } override, -1 for none
+    long status;
+    FetchCacheHeaders cacheHeaders;
+    CURLcode result;
+    bool done;
+    bool revalidating;        // A stale entry's validators were sent
+    uint8_t validators;       // Validator headers at the end of headers
+    uint8_t _padding[1];
+} FetchRequest;
+
+// The requests of one fetch or fetchAll call, held in a userdata whose __gc
+// releases anything still attached if a Lua error unwinds the call
+typedef struct FetchBatch {
+    size_t count;
+    FetchRequest requests[];
+} FetchBatch;
+
+static long fetchTimeoutMs = DEFAULT_FETCH_TIMEOUT_MS;
+
+static _Thread_local CURLM *threadMulti = NULL;
+static pthread_key_t multiKey;
+static pthread_once_t multiKeyOnce = PTHREAD_ONCE_INIT;
+
+void initLuaFetch(void) {
+    const char *timeout = getenv("WEBDSL_FETCH_TIMEOUT_MS");
+    fetchTimeoutMs = DEFAULT_FETCH_TIMEOUT_MS;
+    if (timeout && atol(timeout) > 0) {
+        fetchTimeoutMs = atol(timeout);
+    }
+    initFetchCache();
+}
+
+void cleanupLuaFetch(void) {
+    cleanupFetchCache();
+}
+
+// =============================================================================
+// Thread Multi Handle
+// =============================================================================
+
+static void freeThreadMulti(void *ptr) {
+    if (ptr) curl_multi_cleanup(ptr);
+}
+
+static void createMultiKey(void) {
+    pthread_key_create(&multiKey, freeThreadMulti);
+}
+
+// Handles from the pool bring this thread's connection cache with them
+static CURLM* getThreadMulti(void) {
+    if (threadMulti) return threadMulti;
+
+    pthread_once(&multiKeyOnce, createMultiKey);
+    threadMulti = curl_multi_init();
+    if (threadMulti) pthread_setspecific(multiKey, threadMulti);
+    return threadMulti;
+}
+
+// =============================================================================
+// Transfers
+// =============================================================================
+
+// Write callback for curl
+static size_t writeCallback(void *contents, size_t size, size_t nmemb, void *userp) {
+    size_t realsize = size * nmemb;
+    ResponseBuffer *mem = (ResponseBuffer *)userp;
+
+    char *ptr = realloc(mem->data, mem->size + realsize + 1);
+    if (!ptr) {
+        return 0;  // Out of memory
+    }
+
+    mem->data = ptr;
+    memcpy(&(mem->data[mem->size]), contents, realsize);
+    mem->size += realsize;
+    mem->data[mem->size] = 0;
+
+    return realsize;
+}
+
+static size_t headerCallback(char *buffer, size_t size, size_t nitems, void *userp) {
+    fetchCacheParseHeader(userp, buffer, size * nitems);
+    return size * nitems;
+}
+
+// =============================================================================
+// Response Cache
+// =============================================================================
+
+// The url and request headers, since headers like Authorization change the response
+static char* cacheKeyFor(const char *url, const struct curl_slist *headers) {
+    size_t length = strlen(url) + 1;
+    for (const struct curl_slist *header = headers; header; header = header->next) {
+        length += strlen(header->data) + 1;
+    }
+
+    char *key = malloc(length);
+    if (!key) return NULL;
+
+    size_t offset = strlen(url);
+    memcpy(key, url, offset);
+    for (const struct curl_slist *header = headers; header; header = header->next) {
+        size_t headerLength = strlen(header->data);
+        key[offset++] = '\n';
+        memcpy(key + offset, header->data, headerLength);
+        offset += headerLength;
+    }
+    key[offset] = '\0';
+    return key;
+}
+
+static bool addValidator(FetchRequest *request, const char *name, const char *value) {
+    char header[256];
+    snprintf(header, sizeof(header), "%s: %s", name, value);
+    struct curl_slist *headers = curl_slist_append(request->headers, header);
+    if (!headers) return false;
+    request->headers = headers;
+    request->validators++;
+    return true;
+}
+
+// Drop the validators addValidator appended, keeping the caller's headers
+static bool removeValidators(FetchRequest *request) {
+    size_t keep = 0;
+    for (struct curl_slist *header = request->headers; header; header = header->next) keep++;
+    keep -= request->validators;
+
+    struct curl_slist *headers = NULL;
+    struct curl_slist *header = request->headers;
+    for (size_t i = 0; i < keep; i++, header = header->next) {
+        struct curl_slist *appended = curl_slist_append(headers, header->data);
+        if (!appended) {
+            curl_slist_free_all(headers);
+            return false;
+        }
+        headers = appended;
+    }
+    curl_slist_free_all(request->headers);
+    request->headers = headers;
+    request->validators = 0;
+    return true;
+}
+
+// Look up a GET in the cache. Returns true if it was answered from there;
+// otherwise a stale entry's validators are added to the request headers.
+static bool startCachedFetch(FetchRequest *request, const char *url, const char *method) {
+    if (!fetchCacheEnabled() || strcmp(method, "GET") != 0 || request->body) return false;
+
+    request->cacheKey = cacheKeyFor(url, request->headers);
+    if (!request->cacheKey) return false;
+    fetchCacheResetHeaders(&request->cacheHeaders);
+
+    FetchCacheHeaders validators;
+    FetchCacheResult result = fetchCacheLookup(request->cacheKey, &request->response.data,
+                                               &request->response.size, &validators);
+    if (result == FETCH_CACHE_FRESH) {
+        metricsCacheHit(METRICS_CACHE_FETCH);
+        request->status = 200;
+        request->done = true;
+        return true;
+    }
+    if (result == FETCH_CACHE_STALE) {
+        request->revalidating =
+            (!validators.etag[0] || addValidator(request, "If-None-Match", validators.etag)) &&
+            (!validators.lastModified[0] || addValidator(request, "If-Modified-Since", validators.lastModified));
+    }
+    if (!request->revalidating) {
+        metricsCacheMiss(METRICS_CACHE_FETCH);
+    }
+    return false;
+}
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wdisabled-macro-expansion"
+
+// Repeat a revalidation without its validators, on the handle that made it
+static void refetchInFull(FetchRequest *request) {
+    if (!removeValidators(request)) {
+        request->error = "Failed to allocate memory for headers";
+        return;
+    }
+    free(request->response.data);
+    request->response.data = NULL;
+    request->response.size = 0;
+    fetchCacheResetHeaders(&request->cacheHeaders);
+    request->revalidating = false;
+
+    curl_easy_setopt(request->curl, CURLOPT_HTTPHEADER, request->headers);
+    request->result = curl_easy_perform(request->curl);
+    if (request->result == CURLE_OK) {
+        curl_easy_getinfo(request->curl, CURLINFO_RESPONSE_CODE, &request->status);
+    }
+}
+
+#pragma clang diagnostic pop
+
+// Serve a 304 from the cache, or store a cacheable 200
+static void finishCachedFetch(FetchRequest *request) {
+    if (!request->cacheKey || request->result != CURLE_OK) return;
+
+    if (request->revalidating && request->status == 304) {
+        char *body = NULL;
+        size_t size = 0;
+        if (fetchCacheRevalidated(request->cacheKey, &request->cacheHeaders, request->cacheTtl,
+                                  &body, &size)) {
+            free(request->response.data);
+            request->response.data = body;
+            request->response.size = size;
+            request->status = 200;
+            metricsCacheHit(METRICS_CACHE_FETCH);
+            return;
+        }
+        // Evicted since the lookup, so there is no body to go with the 304,
+        // which the script never asked for. This is rare enough to refetch
+        // on its own rather than on the multi handle.
+        metricsCacheMiss(METRICS_CACHE_FETCH);
+        refetchInFull(request);
+        if (request->error || request->result != CURLE_OK) return;
+    } else if (request->revalidating) {
+        metricsCacheMiss(METRICS_CACHE_FETCH);
+    }
+    if (request->status == 200) {
+        fetchCacheStore(request->cacheKey, request->response.data ? request->response.data : "",
+                        request->response.size, &request->cacheHeaders, request->cacheTtl);
+    }
+}
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wdisabled-macro-expansion"
+
+// Add the "name: value" pairs of the headers table on top of the stack
+static bool addHeaders(lua_State *L, FetchRequest *request) {
+    lua_pushnil(L);
+    while (lua_next(L, -2) != 0) {
+        const char *key = lua_tostring(L, -2);
+        const char *value = lua_tostring(L, -1);
+        if (key && value) {
+            size_t length = strlen(key) + strlen(value) + 3;
+            char *header = malloc(length);
+            if (!header) {
+                lua_pop(L, 2);
+                return false;
+            }
+            snprintf(header, length, "%s: %s", key, value);
+            struct curl_slist *headers = curl_slist_append(request->headers, header);
+            free(header);
+            if (!headers) {
+                lua_pop(L, 2);
+                return false;
+            }
+            request->headers = headers;
+        }
+        lua_pop(L, 1);
+    }
+    return true;
+}
+
+// Set up request for url with the options table at index (0 for none).
+// Failures are left in request->error.
+static void prepareFetch(lua_State *L, const char *url, int options, FetchRequest *request) {
+    const char *method = "GET";
+    long timeout = fetchTimeoutMs;
+    bool useCache = true;
+    request->cacheTtl = -1;
+
+    if (options) {
+        options = lua_absindex(L, options);
+
+        lua_getfield(L, options, "method");
+        if (lua_type(L, -1) == LUA_TSTRING) {
+            method = lua_tostring(L, -1);
+        }
+        // Kept on the stack while method is in use
+
+        lua_getfield(L, options, "body");
+        if (luaIsTableLike(L, -1)) {
+            // Convert table to JSON string. Dumped into our own buffer, as
+            // json_dumps allocates from the request arena.
+            json_t *json = luaToJson(L, -1);
+            size_t length = json ? json_dumpb(json, NULL, 0, 0) : 0;
+            request->body = length ? malloc(length + 1) : NULL;
+            if (request->body) {
+                json_dumpb(json, request->body, length, 0);
+                request->body[length] = '\0';
+            }
+            json_decref(json);
+        } else if (!lua_isnil(L, -1)) {
+            const char *body = lua_tostring(L, -1);
+            request->body = body ? strdup(body) : NULL;
+        }
+        lua_pop(L, 1);
+
+        lua_getfield(L, options, "timeout");
+        if (lua_type(L, -1) == LUA_TNUMBER && lua_tointeger(L, -1) > 0) {
+            timeout = (long)lua_tointeger(L, -1);
+        }
+        lua_pop(L, 1);
+
+        // cache = false skips the cache, cache = { ttl = N } overrides freshness
+        lua_getfield(L, options, "cache");
+        if (lua_type(L, -1) == LUA_TBOOLEAN) {
+            useCache = lua_toboolean(L, -1);
+        } else if (luaIsTableLike(L, -1)) {
+            lua_getfield(L, -1, "ttl");
+            if (lua_type(L, -1) == LUA_TNUMBER && lua_tointeger(L, -1) >= 0) {
+                request->cacheTtl = (long)lua_tointeger(L, -1);
+            }
+            lua_pop(L, 1);
+        }
+        lua_pop(L, 1);
+
+        lua_getfield(L, options, "headers");
+        if (!lua_istable(L, -1) && luaIsTableLike(L, -1)) {
+            // Headers passed through from the request, as a plain table
+            json_t *json = luaToJson(L, -1);
+            lua_pop(L, 1);
+            pushJsonTable(L, json);
+            json_decref(json);
+        }
+        bool headersAdded = !lua_istable(L, -1) || addHeaders(L, request);
+        lua_pop(L, 1);
+        if (!headersAdded) {
+            lua_pop(L, 1);
+            request->error = "Failed to allocate memory for headers";
+            return;
+        }
+    }
+
+    if (useCache && startCachedFetch(request, url, method)) {
+        if (options) lua_pop(L, 1);
+        return;
+    }
+
+    request->curl = acquireHttpHandle();
+    if (!request->curl) {
+        if (options) lua_pop(L, 1);
+        request->error = "Failed to initialize CURL";
+        return;
+    }
+
+    curl_easy_setopt(request->curl, CURLOPT_URL, url);
+    curl_easy_setopt(request->curl, CURLOPT_WRITEFUNCTION, writeCallback);
+    curl_easy_setopt(request->curl, CURLOPT_WRITEDATA, (void *)&request->response);
+    curl_easy_setopt(request->curl, CURLOPT_TIMEOUT_MS, timeout);
+
+    // Set method and body
+    if (strcmp(method, "POST") == 0) {
+        curl_easy_setopt(request->curl, CURLOPT_POST, 1L);
+    } else if (strcmp(method, "GET") != 0) {
+        curl_easy_setopt(request->curl, CURLOPT_CUSTOMREQUEST, method);
+    }
+    if (request->body && strcmp(method, "GET") != 0 && strcmp(method, "DELETE") != 0) {
+        curl_easy_setopt(request->curl, CURLOPT_POSTFIELDS, request->body);
+    }
+
+    if (request->headers) {
+        curl_easy_setopt(request->curl, CURLOPT_HTTPHEADER, request->headers);
+    }
+    if (request->cacheKey) {
+        curl_easy_setopt(request->curl, CURLOPT_HEADERFUNCTION, headerCallback);
+        curl_easy_setopt(request->curl, CURLOPT_HEADERDATA, (void *)&request->cacheHeaders);
+    }
+
+    // curl copied the method, so it can leave the stack
+    if (options) lua_pop(L, 1);
+}
+
+#pragma clang diagnostic pop
+
+// Run the requests on this thread's multi handle until all have finished
+static void performFetches(FetchRequest *requests, size_t count) {
+    CURLM *multi = getThreadMulti();
+    size_t pending = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        FetchRequest *request = &requests[i];
+        if (request->error || request->done) continue;
+        if (!multi) {
+            // Without a multi handle they run one after another
+            request->result = curl_easy_perform(request->curl);
+            request->done = true;
+        } else if (curl_multi_add_handle(multi, request->curl) == CURLM_OK) {
+            pending++;
+        } else {
+            request->error = "Failed to start request";
+        }
+    }
+
+    while (pending > 0) {
+        int running = 0;
+        if (curl_multi_perform(multi, &running) != CURLM_OK) break;
+
+        CURLMsg *message;
+        int queued;
+        while ((message = curl_multi_info_read(multi, &queued))) {
+            if (message->msg != CURLMSG_DONE) continue;
+            for (size_t i = 0; i < count; i++) {
+                if (requests[i].curl != message->easy_handle || requests[i].error) continue;
+                requests[i].result = message->data.result;
+                requests[i].done = true;
+                curl_multi_remove_handle(multi, requests[i].curl);
+                pending--;
+                break;
+            }
+        }
+
+        if (pending > 0 && curl_multi_poll(multi, NULL, 0, POLL_TIMEOUT_MS, NULL) != CURLM_OK) break;
+    }
+
+    // Anything left failed with the multi handle
+    for (size_t i = 0; i < count; i++) {
+        FetchRequest *request = &requests[i];
+        if (request->error || request->done) continue;
+        curl_multi_remove_handle(multi, request->curl);
+        request->error = "Request failed";
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        FetchRequest *request = &requests[i];
+        if (request->error || !request->curl) continue;
+        curl_easy_getinfo(request->curl, CURLINFO_RESPONSE_CODE, &request->status);
+        finishCachedFetch(request);
+    }
+}
+
+static void releaseFetch(FetchRequest *request) {
+    if (request->curl) releaseHttpHandle(request->curl);
+    if (request->headers) curl_slist_free_all(request->headers);
+    free(request->body);
+    free(request->cacheKey);
+    free(request->response.data);
+    memset(request, 0, sizeof(FetchRequest));
+}
+
+static int fetchBatchGc(lua_State *L) {
+    FetchBatch *batch = luaL_checkudata(L, 1, FETCH_BATCH_META);
+    for (size_t i = 0; i < batch->count; i++) {
+        releaseFetch(&batch->requests[i]);
+    }
+    batch->count = 0;
+    return 0;
+}
+
+// Pushes a batch of count zeroed requests
+static FetchBatch* newFetchBatch(lua_State *L, size_t count) {
+    size_t size = sizeof(FetchBatch) + sizeof(FetchRequest) * count;
+    FetchBatch *batch = lua_newuserdatauv(L, size, 0);
+    memset(batch, 0, size);
+    batch->count = count;
+    luaL_getmetatable(L, FETCH_BATCH_META);
+    lua_setmetatable(L, -2);
+    return batch;
+}
+
+// Push the response table for request, or nil and the error. Returns the
+// number of values pushed.
+static int pushFetchResponse(lua_State *L, FetchRequest *request) {
+    const char *error = request->error;
+    if (!error && request->result != CURLE_OK) {
+        error = curl_easy_strerror(request->result);
+    }
+    if (error) {
+        lua_pushnil(L);
+        lua_pushstring(L, error);
+        return 2;
+    }
+
+    long status = request->status;
+    const char *data = request->response.data ? request->response.data : "";
+
+    lua_createtable(L, 0, 3);
+
+    lua_pushinteger(L, status);
+    lua_setfield(L, -2, "status");
+
+    lua_pushboolean(L, status >= 200 && status < 300);
+    lua_setfield(L, -2, "ok");
+
+    // JSON bodies are proxied, anything else is returned as a string
+    json_error_t jsonError;
+    json_t *json = json_loads(data, 0, &jsonError);
+    if (json) {
+        pushJsonToLua(L, json);
+        json_decref(json);
+    } else {
+        lua_pushlstring(L, data, request->response.size);
+    }
+    lua_setfield(L, -2, "body");
+    return 1;
+}
+
+// =============================================================================
+// Lua Functions
+// =============================================================================
+
+// fetch(url, options) returns { status, ok, body }, or nil and an error
+static int lua_fetch(lua_State *L) {
+    const char *url = luaL_checkstring(L, 1);
+    bool hasOptions = lua_gettop(L) >= 2 && !lua_isnil(L, 2);
+    if (hasOptions) {
+        luaL_argexpected(L, luaIsTableLike(L, 2), 2, "table");
+    }
+
+    FetchBatch *batch = newFetchBatch(L, 1);
+    FetchRequest *request = &batch->requests[0];
+    prepareFetch(L, url, hasOptions ? 2 : 0, request);
+    performFetches(request, 1);
+
+    int results = pushFetchResponse(L, request);
+    releaseFetch(request);
+    return results;
+}
+
+// fetchAll({ url or options with url, ... }) runs the requests concurrently,
+// returning their responses in order. A request that fails gets
+// { ok = false, status = 0, error = message } in its place.
+static int lua_fetchAll(lua_State *L) {
+    luaL_argexpected(L, luaIsTableLike(L, 1), 1, "table");
+    lua_len(L, 1);
+    lua_Integer count = lua_tointeger(L, -1);
+    lua_pop(L, 1);
+    luaL_argcheck(L, count <= MAX_FETCH_BATCH, 1, "too many requests");
+    if (count <= 0) {
+        lua_newtable(L);
+        return 1;
+    }
+
+    size_t total = (size_t)count;
+    FetchRequest *requests = newFetchBatch(L, total)->requests;
+
+    for (size_t i = 0; i < total; i++) {
+        lua_geti(L, 1, (lua_Integer)i + 1);
+        if (lua_type(L, -1) == LUA_TSTRING) {
+            prepareFetch(L, lua_tostring(L, -1), 0, &requests[i]);
+        } else if (luaIsTableLike(L, -1)) {
+            lua_getfield(L, -1, "url");
+            if (lua_type(L, -1) == LUA_TSTRING) {
+                prepareFetch(L, lua_tostring(L, -1), -2, &requests[i]);
+            } else {
+                requests[i].error = "Request has no url";
+            }
+            lua_pop(L, 1);
+        } else {
+            requests[i].error = "Expected a url or options table";
+        }
+        lua_pop(L, 1);
+    }
+
+    performFetches(requests, total);
+
+    lua_createtable(L, (int)total, 0);
+    for (size_t i = 0; i < total; i++) {
+        if (pushFetchResponse(L, &requests[i]) == 2) {
+            lua_createtable(L, 0, 3);
+            lua_pushboolean(L, 0);
+            lua_setfield(L, -2, "ok");
+            lua_pushinteger(L, 0);
+            lua_setfield(L, -2, "status");
+            lua_pushvalue(L, -2);
+            lua_setfield(L, -2, "error");
+            lua_replace(L, -3);
+            lua_pop(L, 1);
+        }
+        lua_rawseti(L, -2, (lua_Integer)i + 1);
+        releaseFetch(&requests[i]);
+    }
+    return 1;
+}
+
+// Register HTTP functions with Lua state
+void registerHttpFunctions(lua_State *L) {
+    if (luaL_newmetatable(L, FETCH_BATCH_META)) {
+        lua_pushcfunction(L, fetchBatchGc);
+        lua_setfield(L, -2, "__gc");
+    }
+    lua_pop(L, 1);
+
+    lua_pushcfunction(L, lua_fetch);
+    lua_setglobal(L, "fetch");
+    lua_pushcfunction(L, lua_fetchAll);
+    lua_setglobal(L, "fetchAll");
+}
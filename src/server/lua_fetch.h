@@ -0,0 +1,15 @@
+#ifndef SERVER_LUA_FETCH_H
+#define SERVER_LUA_FETCH_H
+
+#include "lua_compat.h"
+
+// Read the fetch settings from the environment and size the response cache
+void initLuaFetch(void);
+void cleanupLuaFetch(void);
+
+// Register fetch and fetchAll. Transfers use pooled handles on a curl multi
+// handle kept per thread, so connections to upstreams are reused across
+// requests and the requests given to fetchAll run concurrently.
+void registerHttpFunctions(lua_State *L);
+
+#endif // SERVER_LUA_FETCH_H
@@ -0,0 +1,507 @@
+#include "lua_json.h"
+#include <stdint.h>
+
+#define JSON_PROXY "webdsl.json"
+
+// User values of a proxy, each a table created on first use
+#define PROXY_CHILDREN 1  // Proxies handed out for nested values, by key
+#define PROXY_WRITES 2    // Fields the script assigned, by key
+
+typedef struct JsonProxy {
+    json_t *json;
+    bool dirty;   // Assigned to since it was created
+    uint64_t : 56;
+} JsonProxy;
+
+// Stands in for nil in the writes table, marking a removed field
+static char removedField;
+
+static void pushProxy(lua_State *L, json_t *json);
+
+static JsonProxy* toProxy(lua_State *L, int index) {
+    return luaL_testudata(L, index, JSON_PROXY);
+}
+
+// =============================================================================
+// Field Access
+// =============================================================================
+
+// The json value for the key at index, NULL if there isn't one
+static json_t* jsonField(const JsonProxy *proxy, lua_State *L, int key) {
+    if (json_is_object(proxy->json)) {
+        if (lua_type(L, key) != LUA_TSTRING) return NULL;
+        return json_object_get(proxy->json, lua_tostring(L, key));
+    }
+
+    if (lua_type(L, key) != LUA_TNUMBER) return NULL;
+    int isInteger = 0;
+    lua_Integer index = lua_tointegerx(L, key, &isInteger);
+    if (!isInteger || index < 1 || (size_t)index > json_array_size(proxy->json)) return NULL;
+    return json_array_get(proxy->json, (size_t)index - 1);
+}
+
+static void pushUserTable(lua_State *L, int proxyIndex, int n) {
+    if (lua_getiuservalue(L, proxyIndex, n) == LUA_TTABLE) return;
+    lua_pop(L, 1);
+    lua_newtable(L);
+    lua_pushvalue(L, -1);
+    lua_setiuservalue(L, proxyIndex, n);
+}
+
+// Push the user table entry for key, returning false (and pushing nothing)
+// when there is none
+static bool pushUserEntry(lua_State *L, int proxyIndex, int n, int key) {
+    if (lua_getiuservalue(L, proxyIndex, n) != LUA_TTABLE) {
+        lua_pop(L, 1);
+        return false;
+    }
+    lua_pushvalue(L, key);
+    lua_rawget(L, -2);
+    if (lua_isnil(L, -1)) {
+        lua_pop(L, 2);
+        return false;
+    }
+    lua_remove(L, -2);
+    return true;
+}
+
+// Push the field for the key at index, as a script would see it
+static void pushField(lua_State *L, int proxyIndex, int key) {
+    if (pushUserEntry(L, proxyIndex, PROXY_WRITES, key)) {
+        if (lua_touserdata(L, -1) == &removedField) {
+            lua_pop(L, 1);
+            lua_pushnil(L);
+        }
+        return;
+    }
+    if (pushUserEntry(L, proxyIndex, PROXY_CHILDREN, key)) return;
+
+    json_t *value = jsonField(lua_touserdata(L, proxyIndex), L, key);
+    if (!json_is_object(value) && !json_is_array(value)) {
+        pushJsonToLua(L, value);
+        return;
+    }
+
+    // Keep the child so writes through it are seen later
+    pushProxy(L, value);
+    pushUserTable(L, proxyIndex, PROXY_CHILDREN);
+    lua_pushvalue(L, key);
+    lua_pushvalue(L, -3);
+    lua_rawset(L, -3);
+    lua_pop(L, 1);
+}
+
+static bool fieldIsNil(lua_State *L, int proxyIndex, lua_Integer index) {
+    lua_pushinteger(L, index);
+    pushField(L, proxyIndex, lua_gettop(L));
+    bool isNil = lua_isnil(L, -1);
+    lua_pop(L, 2);
+    return isNil;
+}
+
+static lua_Integer proxyLength(lua_State *L, int proxyIndex) {
+    JsonProxy *proxy = lua_touserdata(L, proxyIndex);
+    lua_Integer length = json_is_array(proxy->json) ? (lua_Integer)json_array_size(proxy->json) : 0;
+    if (!proxy->dirty) return length;
+
+    // Writes can shorten or extend the sequence
+    while (length > 0 && fieldIsNil(L, proxyIndex, length)) length--;
+    while (!fieldIsNil(L, proxyIndex, length + 1)) length++;
+    return length;
+}
+
+// =============================================================================
+// Metamethods
+// =============================================================================
+
+static int jsonProxyIndex(lua_State *L) {
+    pushField(L, 1, 2);
+    return 1;
+}
+
+static int jsonProxyNewIndex(lua_State *L) {
+    JsonProxy *proxy = lua_touserdata(L, 1);
+    luaL_argcheck(L, !lua_isnil(L, 2), 2, "index is nil");
+
+    pushUserTable(L, 1, PROXY_WRITES);
+    lua_pushvalue(L, 2);
+    if (lua_isnil(L, 3)) {
+        lua_pushlightuserdata(L, &removedField);
+    } else {
+        lua_pushvalue(L, 3);
+    }
+    lua_rawset(L, -3);
+    lua_pop(L, 1);
+
+    // The new value replaces any proxy handed out for the old one
+    if (lua_getiuservalue(L, 1, PROXY_CHILDREN) == LUA_TTABLE) {
+        lua_pushvalue(L, 2);
+        lua_pushnil(L);
+        lua_rawset(L, -3);
+    }
+    lua_pop(L, 1);
+
+    proxy->dirty = true;
+    return 0;
+}
+
+static int jsonProxyLen(lua_State *L) {
+    lua_pushinteger(L, proxyLength(L, 1));
+    return 1;
+}
+
+// Iterator for pairs: the json fields in order, then fields the script added.
+// Upvalues: proxy, array position, object iterator, json done, last added key.
+static int jsonProxyNext(lua_State *L) {
+    lua_settop(L, 0);
+    lua_pushvalue(L, lua_upvalueindex(1));
+    JsonProxy *proxy = lua_touserdata(L, 1);
+
+    if (!lua_toboolean(L, lua_upvalueindex(4))) {
+        if (json_is_array(proxy->json)) {
+            lua_Integer position = lua_tointeger(L, lua_upvalueindex(2));
+            while ((size_t)position < json_array_size(proxy->json)) {
+                position++;
+                lua_pushinteger(L, position);
+                lua_replace(L, lua_upvalueindex(2));
+                lua_pushinteger(L, position);
+                pushField(L, 1, 2);
+                if (!lua_isnil(L, -1)) return 2;
+                lua_settop(L, 1);
+            }
+        } else {
+            void *iter = lua_touserdata(L, lua_upvalueindex(3));
+            iter = iter ? json_object_iter_next(proxy->json, iter) : json_object_iter(proxy->json);
+            for (; iter; iter = json_object_iter_next(proxy->json, iter)) {
+                lua_pushlightuserdata(L, iter);
+                lua_replace(L, lua_upvalueindex(3));
+                lua_pushstring(L, json_object_iter_key(iter));
+                pushField(L, 1, 2);
+                if (!lua_isnil(L, -1)) return 2;
+                lua_settop(L, 1);
+            }
+        }
+        lua_pushboolean(L, 1);
+        lua_replace(L, lua_upvalueindex(4));
+    }
+
+    if (lua_getiuservalue(L, 1, PROXY_WRITES) != LUA_TTABLE) return 0;
+    lua_pushvalue(L, lua_upvalueindex(5));
+    while (lua_next(L, 2) != 0) {
+        lua_pushvalue(L, 3);
+        lua_replace(L, lua_upvalueindex(5));
+        // Fields already in the json were returned with their new values
+        if (lua_touserdata(L, 4) != &removedField && !jsonField(proxy, L, 3)) return 2;
+        lua_pop(L, 1);
+    }
+    return 0;
+}
+
+static int jsonProxyPairs(lua_State *L) {
+    luaL_checkudata(L, 1, JSON_PROXY);
+    lua_pushvalue(L, 1);
+    lua_pushinteger(L, 0);
+    lua_pushlightuserdata(L, NULL);
+    lua_pushboolean(L, 0);
+    lua_pushnil(L);
+    lua_pushcclosure(L, jsonProxyNext, 5);
+    lua_pushnil(L);
+    lua_pushnil(L);
+    return 3;
+}
+
+static int jsonProxyGc(lua_State *L) {
+    JsonProxy *proxy = lua_touserdata(L, 1);
+    json_decref(proxy->json);
+    proxy->json = NULL;
+    return 0;
+}
+
+static const luaL_Reg proxyMethods[] = {
+    {"__index", jsonProxyIndex},
+    {"__newindex", jsonProxyNewIndex},
+    {"__len", jsonProxyLen},
+    {"__pairs", jsonProxyPairs},
+    {"__gc", jsonProxyGc},
+    {NULL, NULL}
+};
+
+static void pushProxy(lua_State *L, json_t *json) {
+    JsonProxy *proxy = lua_newuserdatauv(L, sizeof(JsonProxy), 2);
+    proxy->json = json_incref(json);
+    proxy->dirty = false;
+    if (luaL_newmetatable(L, JSON_PROXY)) {
+        luaL_setfuncs(L, proxyMethods, 0);
+    }
+    lua_setmetatable(L, -2);
+}
+
+#ifdef WEBDSL_LUAJIT
+// pairs that honors __pairs, falling back to the builtin in upvalue 1
+static int compatPairs(lua_State *L) {
+    if (luaL_getmetafield(L, 1, "__pairs")) {
+        lua_pushvalue(L, 1);
+        lua_call(L, 1, 3);
+        return 3;
+    }
+    lua_pushvalue(L, lua_upvalueindex(1));
+    lua_insert(L, 1);
+    lua_call(L, lua_gettop(L) - 1, 3);
+    return 3;
+}
+
+static int compatIpairsNext(lua_State *L) {
+    lua_Integer index = luaL_checkinteger(L, 2) + 1;
+    lua_pushinteger(L, index);
+    lua_pushinteger(L, index);
+    lua_gettable(L, 1);
+    return lua_isnil(L, -1) ? 1 : 2;
+}
+
+// ipairs that reads proxies through __index, keeping the builtin for tables
+static int compatIpairs(lua_State *L) {
+    if (!toProxy(L, 1)) {
+        lua_pushvalue(L, lua_upvalueindex(1));
+        lua_insert(L, 1);
+        lua_call(L, lua_gettop(L) - 1, 3);
+        return 3;
+    }
+    lua_pushcfunction(L, compatIpairsNext);
+    lua_pushvalue(L, 1);
+    lua_pushinteger(L, 0);
+    return 3;
+}
+#endif
+
+void registerJsonFunctions(lua_State *L) {
+#ifdef WEBDSL_LUAJIT
+    lua_getglobal(L, "pairs");
+    lua_pushcclosure(L, compatPairs, 1);
+    lua_setglobal(L, "pairs");
+    lua_getglobal(L, "ipairs");
+    lua_pushcclosure(L, compatIpairs, 1);
+    lua_setglobal(L, "ipairs");
+#else
+    (void)L;
+#endif
+}
+
+// =============================================================================
+// Conversion
+// =============================================================================
+
+static void pushScalar(lua_State *L, json_t *json) {
+    switch (json_typeof(json)) {
+        case JSON_STRING:
+            lua_pushlstring(L, json_string_value(json), json_string_length(json));
+            break;
+        case JSON_INTEGER:
+            lua_pushinteger(L, json_integer_value(json));
+            break;
+        case JSON_REAL:
+            lua_pushnumber(L, json_real_value(json));
+            break;
+        case JSON_TRUE:
+            lua_pushboolean(L, 1);
+            break;
+        case JSON_FALSE:
+            lua_pushboolean(L, 0);
+            break;
+        case JSON_NULL:
+        case JSON_OBJECT:
+        case JSON_ARRAY:
+            lua_pushnil(L);
+            break;
+    }
+}
+
+void pushJsonToLua(lua_State *L, json_t *json) {
+    if (!json) {
+        lua_pushnil(L);
+    } else if (json_is_object(json) || json_is_array(json)) {
+        pushProxy(L, json);
+    } else {
+        pushScalar(L, json);
+    }
+}
+
+void pushJsonTable(lua_State *L, json_t *json) {
+    if (json_is_object(json)) {
+        lua_createtable(L, 0, (int)json_object_size(json));
+        const char *key;
+        json_t *value;
+        json_object_foreach(json, key, value) {
+            pushJsonTable(L, value);
+            lua_setfield(L, -2, key);
+        }
+    } else if (json_is_array(json)) {
+        lua_createtable(L, (int)json_array_size(json), 0);
+        size_t index;
+        json_t *value;
+        json_array_foreach(json, index, value) {
+            pushJsonTable(L, value);
+            lua_rawseti(L, -2, (lua_Integer)index + 1);
+        }
+    } else if (json) {
+        pushScalar(L, json);
+    } else {
+        lua_pushnil(L);
+    }
+}
+
+// Whether the proxy or any proxy handed out beneath it was assigned to
+static bool proxyIsDirty(lua_State *L, int index) {
+    JsonProxy *proxy = lua_touserdata(L, index);
+    if (proxy->dirty) return true;
+
+    bool dirty = false;
+    if (lua_getiuservalue(L, index, PROXY_CHILDREN) == LUA_TTABLE) {
+        int children = lua_gettop(L);
+        lua_pushnil(L);
+        while (!dirty && lua_next(L, children) != 0) {
+            dirty = proxyIsDirty(L, lua_gettop(L));
+            lua_pop(L, 1);
+        }
+        // Stopping early leaves the key behind
+        if (dirty) lua_pop(L, 1);
+    }
+    lua_pop(L, 1);
+    return dirty;
+}
+
+static json_t* proxyToJson(lua_State *L, int index) {
+    JsonProxy *proxy = lua_touserdata(L, index);
+    if (!proxyIsDirty(L, index)) return json_incref(proxy->json);
+
+    if (json_is_array(proxy->json)) {
+        // Rebuilt, as writes can move the end of the array
+        json_t *array = json_array();
+        lua_Integer length = proxyLength(L, index);
+        for (lua_Integer i = 1; i <= length; i++) {
+            lua_pushinteger(L, i);
+            pushField(L, index, lua_gettop(L));
+            json_array_append_new(array, luaToJson(L, -1));
+            lua_pop(L, 2);
+        }
+        return array;
+    }
+
+    // Shallow copy: fields the script left alone stay shared
+    json_t *object = json_copy(proxy->json);
+    if (!object) return NULL;
+
+    if (lua_getiuservalue(L, index, PROXY_CHILDREN) == LUA_TTABLE) {
+        lua_pushnil(L);
+        while (lua_next(L, -2) != 0) {
+            if (lua_type(L, -2) == LUA_TSTRING && proxyIsDirty(L, lua_gettop(L))) {
+                json_object_set_new(object, lua_tostring(L, -2), proxyToJson(L, lua_gettop(L)));
+            }
+            lua_pop(L, 1);
+        }
+    }
+    lua_pop(L, 1);
+
+    if (lua_getiuservalue(L, index, PROXY_WRITES) == LUA_TTABLE) {
+        lua_pushnil(L);
+        while (lua_next(L, -2) != 0) {
+            // Copy the key, as lua_tostring would convert it in place
+            lua_pushvalue(L, -2);
+            const char *key = lua_tostring(L, -1);
+            if (key && lua_touserdata(L, -2) == &removedField) {
+                json_object_del(object, key);
+            } else if (key) {
+                json_object_set_new(object, key, luaToJson(L, -2));
+            }
+            lua_pop(L, 2);
+        }
+    }
+    lua_pop(L, 1);
+    return object;
+}
+
+bool luaIsTableLike(lua_State *L, int index) {
+    return lua_istable(L, index) || toProxy(L, index) != NULL;
+}
+
+bool luaJsonIsShared(lua_State *L, int index) {
+    index = lua_absindex(L, index);
+    return toProxy(L, index) && !proxyIsDirty(L, index);
+}
+
+json_t* luaToJson(lua_State *L, int index) {
+    index = lua_absindex(L, index);
+
+    switch (lua_type(L, index)) {
+        case LUA_TTABLE: {
+            // First pass: determine if it's an array
+            bool isArray = true;
+            size_t arrayLen = 0;
+
+            lua_pushnil(L);  // First key
+            while (lua_next(L, index) != 0) {
+                if (!lua_isnumber(L, -2) || lua_tointeger(L, -2) != (lua_Integer)(arrayLen + 1)) {
+                    isArray = false;
+                }
+                arrayLen++;
+                lua_pop(L, 1);  // Remove value, keep key for next iteration
+            }
+
+            if (isArray) {
+                // Create JSON array
+                json_t *arr = json_array();
+                for (size_t i = 1; i <= arrayLen; i++) {
+                    lua_rawgeti(L, index, (lua_Integer)i);
+                    json_t *value = luaToJson(L, -1);
+                    if (value) {
+                        json_array_append_new(arr, value);
+                    }
+                    lua_pop(L, 1);
+                }
+                return arr;
+            } else {
+                // Create JSON object
+                json_t *obj = json_object();
+                lua_pushnil(L);  // First key
+                while (lua_next(L, index) != 0) {
+                    // Convert key to string
+                    const char *key;
+                    if (lua_type(L, -2) == LUA_TSTRING) {
+                        key = lua_tostring(L, -2);
+                    } else {
+                        // Convert non-string key to string
+                        lua_pushvalue(L, -2);  // Copy key
+                        key = lua_tostring(L, -1);
+                        lua_pop(L, 1);  // Remove key copy
+                    }
+
+                    if (key) {
+                        json_t *value = luaToJson(L, -1);
+                        if (value) {
+                            json_object_set_new(obj, key, value);
+                        }
+                    }
+                    lua_pop(L, 1);  // Remove value, keep key for next iteration
+                }
+                return obj;
+            }
+        }
+        case LUA_TUSERDATA:
+            if (toProxy(L, index)) {
+                return proxyToJson(L, index);
+            }
+            return json_null();
+        case LUA_TSTRING:
+            return json_string(lua_tostring(L, index));
+        case LUA_TNUMBER:
+            if (lua_isinteger(L, index)) {
+                return json_integer(lua_tointeger(L, index));
+            }
+            return json_real(lua_tonumber(L, index));
+        case LUA_TBOOLEAN:
+            return lua_toboolean(L, index) ? json_true() : json_false();
+        case LUA_TNIL:
+            return json_null();
+        default:
+            return json_null();
+    }
+}
@@ -0,0 +1,34 @@
+#ifndef SERVER_LUA_JSON_H
+#define SERVER_LUA_JSON_H
+
+#include "lua_compat.h"
+#include <stdbool.h>
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wpadded"
+#include <jansson.h>
+#pragma clang diagnostic pop
+
+// Push json as a Lua value. Objects and arrays become proxies over the
+// json_t that only convert the fields a script reads, through __index,
+// __len and __pairs. Writes stay in the proxy, leaving json untouched.
+void pushJsonToLua(lua_State *L, json_t *json);
+
+// Push json as plain Lua tables, converting all of it up front
+void pushJsonTable(lua_State *L, json_t *json);
+
+// Convert a Lua value to JSON, returning a new reference. An untouched proxy
+// gives back the json_t it wraps, and a modified one a shallow copy with the
+// script's writes applied, so unchanged fields are never copied.
+json_t* luaToJson(lua_State *L, int index);
+
+// Make pairs and ipairs work on proxies. Lua 5.4 already does this through
+// __pairs and __index; LuaJIT's versions only take tables.
+void registerJsonFunctions(lua_State *L);
+
+// Whether the value at index is a table or a JSON proxy
+bool luaIsTableLike(lua_State *L, int index);
+
+// Whether luaToJson would return json shared with the proxy's source
+bool luaJsonIsShared(lua_State *L, int index);
+
+#endif // SERVER_LUA_JSON_H
@@ -0,0 +1,185 @@
+#include "lua_shared.h"
+#include "shared_dict.h"
+#include <string.h>
+
+#define SHARED_DICT_META "webdsl.shared.dict"
+#define SHARED_DICT_NAME_MAX 64
+
+typedef struct LuaSharedDict {
+    char name[SHARED_DICT_NAME_MAX];
+} LuaSharedDict;
+
+static const char* checkDictName(lua_State *L) {
+    LuaSharedDict *dict = luaL_checkudata(L, 1, SHARED_DICT_META);
+    return dict->name;
+}
+
+// Integral numbers come back as integers, so counters stay integers in JSON
+static void pushSharedNumber(lua_State *L, double number) {
+    #pragma clang diagnostic push
+    #pragma clang diagnostic ignored "-Wfloat-equal"
+    if (number >= -9007199254740992.0 && number <= 9007199254740992.0 &&
+        (double)(lua_Integer)number == number) {
+        lua_pushinteger(L, (lua_Integer)number);
+    } else {
+        lua_pushnumber(L, number);
+    }
+    #pragma clang diagnostic pop
+}
+
+static int pushStatusError(lua_State *L, SharedDictStatus status) {
+    lua_pushnil(L);
+    switch (status) {
+        case SHARED_DICT_TOO_LARGE:
+            lua_pushstring(L, "key or value too large");
+            break;
+        case SHARED_DICT_NOT_NUMBER:
+            lua_pushstring(L, "not a number");
+            break;
+        case SHARED_DICT_UNAVAILABLE:
+        case SHARED_DICT_OK:
+            lua_pushstring(L, "shared dict unavailable");
+            break;
+    }
+    return 2;
+}
+
+// =============================================================================
+// Dict Methods
+// =============================================================================
+
+// dict:get(key) returns the value, or nil if it's missing or expired
+static int lua_sharedGet(lua_State *L) {
+    const char *name = checkDictName(L);
+    const char *key = luaL_checkstring(L, 2);
+
+    SharedValue value;
+    if (!sharedDictGet(name, key, &value)) {
+        lua_pushnil(L);
+        return 1;
+    }
+
+    switch (value.type) {
+        case SHARED_VALUE_STRING:
+            lua_pushlstring(L, value.string, value.length);
+            break;
+        case SHARED_VALUE_NUMBER:
+            pushSharedNumber(L, value.number);
+            break;
+        case SHARED_VALUE_BOOLEAN:
+            lua_pushboolean(L, value.boolean);
+            break;
+        case SHARED_VALUE_NIL:
+            lua_pushnil(L);
+            break;
+    }
+    return 1;
+}
+
+// dict:set(key, value, ttl) stores a string, number or boolean for ttl
+// seconds (forever if omitted). Setting nil deletes the key.
+static int lua_sharedSet(lua_State *L) {
+    const char *name = checkDictName(L);
+    const char *key = luaL_checkstring(L, 2);
+    double ttl = luaL_optnumber(L, 4, 0);
+    luaL_argcheck(L, ttl >= 0, 4, "ttl must not be negative");
+
+    SharedValue value;
+    value.type = SHARED_VALUE_NIL;
+    value.boolean = false;
+    value.number = 0;
+    value.length = 0;
+
+    switch (lua_type(L, 3)) {
+        case LUA_TNONE:
+        case LUA_TNIL:
+            break;
+        case LUA_TBOOLEAN:
+            value.type = SHARED_VALUE_BOOLEAN;
+            value.boolean = lua_toboolean(L, 3);
+            break;
+        case LUA_TNUMBER:
+            value.type = SHARED_VALUE_NUMBER;
+            value.number = lua_tonumber(L, 3);
+            break;
+        case LUA_TSTRING: {
+            size_t length;
+            const char *string = lua_tolstring(L, 3, &length);
+            if (length > SHARED_DICT_VALUE_MAX) {
+                return pushStatusError(L, SHARED_DICT_TOO_LARGE);
+            }
+            value.type = SHARED_VALUE_STRING;
+            memcpy(value.string, string, length);
+            value.length = length;
+            break;
+        }
+        default:
+            return luaL_argerror(L, 3, "expected a string, number, boolean or nil");
+    }
+
+    SharedDictStatus status = sharedDictSet(name, key, &value, ttl);
+    if (status != SHARED_DICT_OK) return pushStatusError(L, status);
+    lua_pushboolean(L, 1);
+    return 1;
+}
+
+// dict:incr(key, by, init) adds by (default 1) to a number, starting from
+// init (default 0) when the key is missing, and returns the new value
+static int lua_sharedIncr(lua_State *L) {
+    const char *name = checkDictName(L);
+    const char *key = luaL_checkstring(L, 2);
+    double by = luaL_optnumber(L, 3, 1);
+    double init = luaL_optnumber(L, 4, 0);
+
+    double result = 0;
+    SharedDictStatus status = sharedDictIncr(name, key, by, init, &result);
+    if (status != SHARED_DICT_OK) return pushStatusError(L, status);
+    pushSharedNumber(L, result);
+    return 1;
+}
+
+// dict:delete(key)
+static int lua_sharedDelete(lua_State *L) {
+    const char *name = checkDictName(L);
+    sharedDictDelete(name, luaL_checkstring(L, 2));
+    return 0;
+}
+
+// =============================================================================
+// Registration
+// =============================================================================
+
+// shared.dict(name) returns the dictionary called name, creating it on first use
+static int lua_sharedDict(lua_State *L) {
+    size_t length;
+    const char *name = luaL_checklstring(L, 1, &length);
+    luaL_argcheck(L, length > 0 && length < SHARED_DICT_NAME_MAX && strlen(name) == length,
+                  1, "invalid dict name");
+
+    LuaSharedDict *dict = lua_newuserdatauv(L, sizeof(LuaSharedDict), 0);
+    memcpy(dict->name, name, length + 1);
+    luaL_getmetatable(L, SHARED_DICT_META);
+    lua_setmetatable(L, -2);
+    return 1;
+}
+
+void registerSharedFunctions(lua_State *L) {
+    if (luaL_newmetatable(L, SHARED_DICT_META)) {
+        lua_createtable(L, 0, 4);
+        lua_pushcfunction(L, lua_sharedGet);
+        lua_setfield(L, -2, "get");
+        lua_pushcfunction(L, lua_sharedSet);
+        lua_setfield(L, -2, "set");
+        lua_pushcfunction(L, lua_sharedIncr);
+        lua_setfield(L, -2, "incr");
+        lua_pushcfunction(L, lua_sharedDelete);
+        lua_setfield(L, -2, "delete");
+        lua_setfield(L, -2, "__index");
+    }
+    lua_pop(L, 1);
+
+    lua_createtable(L, 0, 1);
+    lua_pushcfunction(L, lua_sharedDict);
+    lua_setfield(L, -2, "dict");
+    lua_setglobal(L, "shared");
+}
@@ -0,0 +1,10 @@
+#ifndef SERVER_LUA_SHARED_H
+#define SERVER_LUA_SHARED_H
+
+#include "lua_compat.h"
+
+// Register shared.dict(name), whose dictionaries outlive the request and
+// are seen by every worker thread and process
+void registerSharedFunctions(lua_State *L);
+
+#endif // SERVER_LUA_SHARED_H
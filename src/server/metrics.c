@@ -0,0 +1,652 @@
+#include "metrics.h"
+#include "db.h"
+#include "logger.h"
+#include "capture.h"
+#include "jq.h"
+#include "session_store.h"
+#include "../stringbuilder.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+
+// Log-linear histogram over nanoseconds: 8 sub-buckets per power of two
+// (~12.5% precision) up to 2^40ns (~18 minutes).
+#define METRICS_SUB_BITS 3
+#define METRICS_SUB_COUNT (1 << METRICS_SUB_BITS)
+#define METRICS_MAX_MSB 40
+#define METRICS_BUCKETS ((METRICS_MAX_MSB - METRICS_SUB_BITS + 2) * METRICS_SUB_COUNT)
+
+#define METRICS_STEP_TYPES 4  // STEP_JQ, STEP_LUA, STEP_SQL, STEP_DYNAMIC_SQL
+
+#define DEFAULT_METRICS_PATH "/metrics"
+
+typedef struct MetricsHistogram {
+    _Atomic uint64_t counts[METRICS_BUCKETS];
+    _Atomic uint64_t sum;
+    _Atomic uint64_t total;
+} MetricsHistogram;
+
+typedef struct HistogramSnapshot {
+    uint64_t counts[METRICS_BUCKETS];
+    uint64_t sum;
+    uint64_t total;
+} HistogramSnapshot;
+
+typedef struct MetricsRouteArena {
+    _Atomic uint64_t allocations;
+    _Atomic uint64_t bytes;
+} MetricsRouteArena;
+
+typedef struct MetricsShard {
+    MetricsHistogram *routes;  // One per route id
+    MetricsRouteArena *routeArenas;  // One per route id
+    MetricsHistogram steps[METRICS_STEP_TYPES];
+    MetricsHistogram poolWait;
+    _Atomic uint64_t poolFailures;
+    _Atomic uint64_t cacheHits[METRICS_CACHE_COUNT];
+    _Atomic uint64_t cacheMisses[METRICS_CACHE_COUNT];
+    _Atomic uint64_t arenaHighWater;
+    struct MetricsShard *next;
+} MetricsShard;
+
+typedef struct MetricsRoute {
+    const void *endpoint;
+    const char *route;
+    const char *method;
+} MetricsRoute;
+
+static ServerContext *ctx = NULL;
+static char metricsPath[256] = DEFAULT_METRICS_PATH;  // Empty when the endpoint is off
+
+static MetricsRoute *routes = NULL;
+static size_t routeCount = 0;
+static int *routeIndex = NULL;       // Open addressing: endpoint pointer -> route id
+static size_t routeIndexMask = 0;
+
+static MetricsShard *shards = NULL;
+static pthread_mutex_t shardsLock = PTHREAD_MUTEX_INITIALIZER;
+
+// Bumped on init and cleanup so threads drop shards from a previous server
+static _Atomic uint64_t generation = 0;
+static _Thread_local MetricsShard *threadShard = NULL;
+static _Thread_local uint64_t threadGeneration = 0;
+
+static const char *stepTypeNames[METRICS_STEP_TYPES] = {"jq", "lua", "sql", "dynamic_sql"};
+static const char *cacheNames[METRICS_CACHE_COUNT] = {"jq", "lua", "stmt", "static", "fetch", "artifact"};
+
+static const double histogramBounds[] = {
+    0.00001, 0.000025, 0.00005, 0.0001, 0.00025, 0.0005, 0.001, 0.0025,
+    0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10
+};
+
+// =============================================================================
+// Histogram Helpers
+// =============================================================================
+
+// Only the owning thread writes a shard, so a relaxed load/store pair is
+// enough and avoids a locked read-modify-write on the hot path.
+static inline void counterAdd(_Atomic uint64_t *counter, uint64_t value) {
+    atomic_store_explicit(counter,
+        atomic_load_explicit(counter, memory_order_relaxed) + value,
+        memory_order_relaxed);
+}
+
+static inline uint32_t bucketIndex(uint64_t value) {
+    if (value < METRICS_SUB_COUNT) {
+        return (uint32_t)value;
+    }
+    uint32_t msb = 63u - (uint32_t)__builtin_clzll(value);
+    if (msb > METRICS_MAX_MSB) {
+        return METRICS_BUCKETS - 1;
+    }
+    uint32_t sub = (uint32_t)(value >> (msb - METRICS_SUB_BITS)) & (METRICS_SUB_COUNT - 1);
+    return (msb - METRICS_SUB_BITS + 1) * METRICS_SUB_COUNT + sub;
+}
+
+static uint64_t bucketLower(uint32_t index) {
+    if (index < METRICS_SUB_COUNT) {
+        return index;
+    }
+    uint32_t msb = index / METRICS_SUB_COUNT + METRICS_SUB_BITS - 1;
+    uint64_t sub = index % METRICS_SUB_COUNT;
+    return (METRICS_SUB_COUNT + sub) << (msb - METRICS_SUB_BITS);
+}
+
+static uint64_t bucketUpper(uint32_t index) {
+    if (index + 1 >= METRICS_BUCKETS) {
+        return UINT64_MAX;
+    }
+    return bucketLower(index + 1);
+}
+
+static inline void histogramRecord(MetricsHistogram *histogram, uint64_t value) {
+    counterAdd(&histogram->counts[bucketIndex(value)], 1);
+    counterAdd(&histogram->sum, value);
+    counterAdd(&histogram->total, 1);
+}
+
+static void histogramAccumulate(HistogramSnapshot *snapshot, MetricsHistogram *histogram) {
+    for (size_t i = 0; i < METRICS_BUCKETS; i++) {
+        snapshot->counts[i] += atomic_load_explicit(&histogram->counts[i], memory_order_relaxed);
+    }
+    snapshot->sum += atomic_load_explicit(&histogram->sum, memory_order_relaxed);
+    snapshot->total += atomic_load_explicit(&histogram->total, memory_order_relaxed);
+}
+
+static double snapshotQuantile(const HistogramSnapshot *snapshot, double quantile) {
+    if (snapshot->total == 0) return 0.0;
+
+    uint64_t rank = (uint64_t)(quantile * (double)snapshot->total);
+    if (rank >= snapshot->total) rank = snapshot->total - 1;
+
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < METRICS_BUCKETS; i++) {
+        seen += snapshot->counts[i];
+        if (seen > rank) {
+            uint64_t lower = bucketLower(i);
+            uint64_t upper = bucketUpper(i);
+            uint64_t mid = upper == UINT64_MAX ? lower : lower + (upper - lower) / 2;
+            return (double)mid / 1e9;
+        }
+    }
+    return 0.0;
+}
+
+// =============================================================================
+// Shards
+// =============================================================================
+
+static MetricsShard* getShard(void) {
+    uint64_t current = atomic_load_explicit(&generation, memory_order_acquire);
+    if (threadShard && threadGeneration == current) {
+        return threadShard;
+    }
+    if (current == 0 || !routes) {
+        return NULL;
+    }
+
+    MetricsShard *shard = calloc(1, sizeof(MetricsShard));
+    if (!shard) return NULL;
+    shard->routes = calloc(routeCount, sizeof(MetricsHistogram));
+    shard->routeArenas = calloc(routeCount, sizeof(MetricsRouteArena));
+    if (!shard->routes || !shard->routeArenas) {
+        free(shard->routes);
+        free(shard->routeArenas);
+        free(shard);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&shardsLock);
+    shard->next = shards;
+    shards = shard;
+    pthread_mutex_unlock(&shardsLock);
+
+    threadShard = shard;
+    threadGeneration = current;
+    return shard;
+}
+
+uint64_t metricsNow(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+void metricsRecordRequest(int routeId, uint64_t durationNs) {
+    MetricsShard *shard = getShard();
+    if (!shard || routeId < 0 || (size_t)routeId >= routeCount) return;
+    histogramRecord(&shard->routes[routeId], durationNs);
+}
+
+void metricsRecordStep(StepType type, uint64_t durationNs) {
+    MetricsShard *shard = getShard();
+    if (!shard || (unsigned)type >= METRICS_STEP_TYPES) return;
+    histogramRecord(&shard->steps[type], durationNs);
+}
+
+void metricsRecordPoolAcquire(uint64_t waitNs, bool acquired) {
+    MetricsShard *shard = getShard();
+    if (!shard) return;
+    histogramRecord(&shard->poolWait, waitNs);
+    if (!acquired) {
+        counterAdd(&shard->poolFailures, 1);
+    }
+}
+
+void metricsRecordArena(int routeId, const Arena *arena) {
+    MetricsShard *shard = getShard();
+    if (!shard) return;
+    if (arena->used > atomic_load_explicit(&shard->arenaHighWater, memory_order_relaxed)) {
+        atomic_store_explicit(&shard->arenaHighWater, arena->used, memory_order_relaxed);
+    }
+    if (routeId >= 0 && (size_t)routeId < routeCount) {
+        counterAdd(&shard->routeArenas[routeId].allocations, arena->allocations);
+        counterAdd(&shard->routeArenas[routeId].bytes, arena->used);
+    }
+}
+
+void metricsCacheHit(MetricsCache cache) {
+    MetricsShard *shard = getShard();
+    if (!shard) return;
+    counterAdd(&shard->cacheHits[cache], 1);
+}
+
+void metricsCacheMiss(MetricsCache cache) {
+    MetricsShard *shard = getShard();
+    if (!shard) return;
+    counterAdd(&shard->cacheMisses[cache], 1);
+}
+
+// =============================================================================
+// Routes
+// =============================================================================
+
+static void addRoute(const void *endpoint, const char *route, const char *method) {
+    MetricsRoute *entry = &routes[routeCount];
+    entry->endpoint = endpoint;
+    entry->route = route;
+    entry->method = method ? method : "GET";
+
+    if (endpoint) {
+        size_t slot = ((uintptr_t)endpoint >> 4) & routeIndexMask;
+        while (routeIndex[slot] >= 0) {
+            slot = (slot + 1) & routeIndexMask;
+        }
+        routeIndex[slot] = (int)routeCount;
+    }
+    routeCount++;
+}
+
+int metricsRouteId(const RouteMatch *match) {
+    const void *endpoint = NULL;
+    if (match->type == ROUTE_TYPE_API) {
+        endpoint = match->endpoint.api;
+    } else if (match->type == ROUTE_TYPE_PAGE) {
+        endpoint = match->endpoint.page;
+    }
+    if (!endpoint || !routeIndex) {
+        return METRICS_ROUTE_UNMATCHED;
+    }
+
+    size_t slot = ((uintptr_t)endpoint >> 4) & routeIndexMask;
+    while (routeIndex[slot] >= 0) {
+        if (routes[routeIndex[slot]].endpoint == endpoint) {
+            return routeIndex[slot];
+        }
+        slot = (slot + 1) & routeIndexMask;
+    }
+    return METRICS_ROUTE_UNMATCHED;
+}
+
+const char* metricsRouteName(int routeId) {
+    if (!routes || routeId < 0 || (size_t)routeId >= routeCount) {
+        return NULL;
+    }
+    return routes[routeId].route;
+}
+
+static void freeShardsLocked(void) {
+    while (shards) {
+        MetricsShard *next = shards->next;
+        free(shards->routes);
+        free(shards->routeArenas);
+        free(shards);
+        shards = next;
+    }
+}
+
+void initMetrics(ServerContext *serverCtx) {
+    ctx = serverCtx;
+
+    const char *path = getenv("WEBDSL_METRICS_PATH");
+    snprintf(metricsPath, sizeof(metricsPath), "%s", path ? path : DEFAULT_METRICS_PATH);
+
+    size_t endpoints = 0;
+    for (PageNode *page = ctx->website->pageHead; page; page = page->next) endpoints++;
+    for (ApiEndpoint *api = ctx->website->apiHead; api; api = api->next) endpoints++;
+
+    size_t indexSize = 16;
+    while (indexSize < endpoints * 2) indexSize <<= 1;
+
+    routes = calloc(endpoints + 3, sizeof(MetricsRoute));
+    routeIndex = malloc(indexSize * sizeof(int));
+    if (!routes || !routeIndex) {
+        fprintf(stderr, "Failed to allocate metrics route table\n");
+        free(routes);
+        free(routeIndex);
+        routes = NULL;
+        routeIndex = NULL;
+        return;
+    }
+    memset(routeIndex, 0xff, indexSize * sizeof(int));
+    routeIndexMask = indexSize - 1;
+    routeCount = 0;
+
+    // Order must match the METRICS_ROUTE_* ids
+    addRoute(NULL, "unmatched", "ANY");
+    addRoute(NULL, "static", "GET");
+    addRoute(NULL, "internal", "ANY");
+
+    for (PageNode *page = ctx->website->pageHead; page; page = page->next) {
+        addRoute(page, page->route, page->method);
+    }
+    for (ApiEndpoint *api = ctx->website->apiHead; api; api = api->next) {
+        addRoute(api, api->route, api->method);
+    }
+
+    atomic_fetch_add(&generation, 1);
+}
+
+void cleanupMetrics(void) {
+    atomic_fetch_add(&generation, 1);
+
+    pthread_mutex_lock(&shardsLock);
+    freeShardsLocked();
+    pthread_mutex_unlock(&shardsLock);
+
+    free(routes);
+    free(routeIndex);
+    routes = NULL;
+    routeIndex = NULL;
+    routeCount = 0;
+    ctx = NULL;
+}
+
+// =============================================================================
+// Exposition
+// =============================================================================
+
+static void appendLabelValue(StringBuilder *sb, const char *value) {
+    for (const char *p = value; *p; p++) {
+        if (*p == '"' || *p == '\\') {
+            StringBuilder_append(sb, "\\%c", *p);
+        } else if (*p == '\n') {
+            StringBuilder_append(sb, "\\n");
+        } else {
+            StringBuilder_append(sb, "%c", *p);
+        }
+    }
+}
+
+static void appendHistogram(StringBuilder *sb, const char *name, const char *labels,
+                            const HistogramSnapshot *snapshot) {
+    const char *sep = labels[0] ? "," : "";
+    uint32_t bucket = 0;
+    uint64_t cumulative = 0;
+
+    for (size_t i = 0; i < sizeof(histogramBounds) / sizeof(histogramBounds[0]); i++) {
+        uint64_t boundNs = (uint64_t)(histogramBounds[i] * 1e9);
+        while (bucket < METRICS_BUCKETS && bucketUpper(bucket) <= boundNs) {
+            cumulative += snapshot->counts[bucket];
+            bucket++;
+        }
+        StringBuilder_append(sb, "%s_bucket{%s%sle=\"%g\"} %llu\n",
+                             name, labels, sep, histogramBounds[i], (unsigned long long)cumulative);
+    }
+    StringBuilder_append(sb, "%s_bucket{%s%sle=\"+Inf\"} %llu\n",
+                         name, labels, sep, (unsigned long long)snapshot->total);
+    StringBuilder_append(sb, "%s_sum{%s} %.9f\n", name, labels, (double)snapshot->sum / 1e9);
+    StringBuilder_append(sb, "%s_count{%s} %llu\n", name, labels, (unsigned long long)snapshot->total);
+}
+
+static void appendQuantiles(StringBuilder *sb, const char *name, const char *labels,
+                            const HistogramSnapshot *snapshot) {
+    static const struct { const char *label; double value; } quantiles[] = {
+        {"0.5", 0.5}, {"0.99", 0.99}, {"0.999", 0.999}
+    };
+    const char *sep = labels[0] ? "," : "";
+    for (size_t i = 0; i < sizeof(quantiles) / sizeof(quantiles[0]); i++) {
+        StringBuilder_append(sb, "%s{%s%squantile=\"%s\"} %.9f\n", name, labels, sep,
+                             quantiles[i].label, snapshotQuantile(snapshot, quantiles[i].value));
+    }
+}
+
+static char* routeLabels(Arena *arena, const MetricsRoute *route) {
+    StringBuilder *sb = StringBuilder_new(arena);
+    StringBuilder_append(sb, "route=\"");
+    appendLabelValue(sb, route->route);
+    StringBuilder_append(sb, "\",method=\"");
+    appendLabelValue(sb, route->method);
+    StringBuilder_append(sb, "\"");
+    return StringBuilder_get(sb);
+}
+
+char* generateMetrics(Arena *arena) {
+    StringBuilder *sb = StringBuilder_new(arena);
+    if (!routes) {
+        return StringBuilder_get(sb);
+    }
+
+    HistogramSnapshot *routeSnapshots = calloc(routeCount, sizeof(HistogramSnapshot));
+    HistogramSnapshot *stepSnapshots = calloc(METRICS_STEP_TYPES, sizeof(HistogramSnapshot));
+    HistogramSnapshot *poolSnapshot = calloc(1, sizeof(HistogramSnapshot));
+    uint64_t *routeAllocations = calloc(routeCount * 2, sizeof(uint64_t));
+    if (!routeSnapshots || !stepSnapshots || !poolSnapshot || !routeAllocations) {
+        free(routeSnapshots);
+        free(stepSnapshots);
+        free(poolSnapshot);
+        free(routeAllocations);
+        return NULL;
+    }
+    uint64_t *routeArenaBytes = routeAllocations + routeCount;
+
+    uint64_t poolFailures = 0;
+    uint64_t arenaHighWater = 0;
+    uint64_t cacheHits[METRICS_CACHE_COUNT] = {0};
+    uint64_t cacheMisses[METRICS_CACHE_COUNT] = {0};
+
+    pthread_mutex_lock(&shardsLock);
+    for (MetricsShard *shard = shards; shard; shard = shard->next) {
+        for (size_t i = 0; i < routeCount; i++) {
+            histogramAccumulate(&routeSnapshots[i], &shard->routes[i]);
+            routeAllocations[i] += atomic_load_explicit(&shard->routeArenas[i].allocations, memory_order_relaxed);
+            routeArenaBytes[i] += atomic_load_explicit(&shard->routeArenas[i].bytes, memory_order_relaxed);
+        }
+        for (size_t i = 0; i < METRICS_STEP_TYPES; i++) {
+            histogramAccumulate(&stepSnapshots[i], &shard->steps[i]);
+        }
+        histogramAccumulate(poolSnapshot, &shard->poolWait);
+        poolFailures += atomic_load_explicit(&shard->poolFailures, memory_order_relaxed);
+        for (size_t i = 0; i < METRICS_CACHE_COUNT; i++) {
+            cacheHits[i] += atomic_load_explicit(&shard->cacheHits[i], memory_order_relaxed);
+            cacheMisses[i] += atomic_load_explicit(&shard->cacheMisses[i], memory_order_relaxed);
+        }
+        uint64_t highWater = atomic_load_explicit(&shard->arenaHighWater, memory_order_relaxed);
+        if (highWater > arenaHighWater) arenaHighWater = highWater;
+    }
+    pthread_mutex_unlock(&shardsLock);
+
+    // Per-route request latency; routes that have not been hit are omitted
+    StringBuilder_append(sb, "# HELP webdsl_request_duration_seconds Request latency per route\n");
+    StringBuilder_append(sb, "# TYPE webdsl_request_duration_seconds histogram\n");
+    for (size_t i = 0; i < routeCount; i++) {
+        if (routeSnapshots[i].total == 0) continue;
+        appendHistogram(sb, "webdsl_request_duration_seconds",
+                        routeLabels(arena, &routes[i]), &routeSnapshots[i]);
+    }
+    StringBuilder_append(sb, "# HELP webdsl_request_duration_quantile_seconds Request latency quantiles per route\n");
+    StringBuilder_append(sb, "# TYPE webdsl_request_duration_quantile_seconds gauge\n");
+    for (size_t i = 0; i < routeCount; i++) {
+        if (routeSnapshots[i].total == 0) continue;
+        appendQuantiles(sb, "webdsl_request_duration_quantile_seconds",
+                        routeLabels(arena, &routes[i]), &routeSnapshots[i]);
+    }
+
+    // Pipeline steps by type
+    StringBuilder_append(sb, "# HELP webdsl_step_duration_seconds Pipeline step latency per step type\n");
+    StringBuilder_append(sb, "# TYPE webdsl_step_duration_seconds histogram\n");
+    for (size_t i = 0; i < METRICS_STEP_TYPES; i++) {
+        char labels[32];
+        snprintf(labels, sizeof(labels), "type=\"%s\"", stepTypeNames[i]);
+        appendHistogram(sb, "webdsl_step_duration_seconds", labels, &stepSnapshots[i]);
+    }
+    StringBuilder_append(sb, "# HELP webdsl_step_duration_quantile_seconds Pipeline step latency quantiles per step type\n");
+    StringBuilder_append(sb, "# TYPE webdsl_step_duration_quantile_seconds gauge\n");
+    for (size_t i = 0; i < METRICS_STEP_TYPES; i++) {
+        char labels[32];
+        snprintf(labels, sizeof(labels), "type=\"%s\"", stepTypeNames[i]);
+        appendQuantiles(sb, "webdsl_step_duration_quantile_seconds", labels, &stepSnapshots[i]);
+    }
+
+    // Database pool
+    StringBuilder_append(sb, "# HELP webdsl_db_pool_acquire_wait_seconds Time spent acquiring a pooled connection\n");
+    StringBuilder_append(sb, "# TYPE webdsl_db_pool_acquire_wait_seconds histogram\n");
+    appendHistogram(sb, "webdsl_db_pool_acquire_wait_seconds", "", poolSnapshot);
+    StringBuilder_append(sb, "# HELP webdsl_db_pool_acquire_failures_total Acquire attempts that found the pool exhausted\n");
+    StringBuilder_append(sb, "# TYPE webdsl_db_pool_acquire_failures_total counter\n");
+    StringBuilder_append(sb, "webdsl_db_pool_acquire_failures_total %llu\n", (unsigned long long)poolFailures);
+
+    if (ctx && ctx->db && ctx->db->pool) {
+        ConnectionPool *pool = ctx->db->pool;
+        int inUse = 0;
+        pthread_mutex_lock(&pool->lock);
+        for (PooledConnection *conn = pool->connections; conn; conn = conn->next) {
+            if (conn->in_use) inUse++;
+        }
+        int size = pool->size;
+        int maxSize = pool->max_size;
+        pthread_mutex_unlock(&pool->lock);
+
+        StringBuilder_append(sb, "# HELP webdsl_db_pool_connections Pooled database connections\n");
+        StringBuilder_append(sb, "# TYPE webdsl_db_pool_connections gauge\n");
+        StringBuilder_append(sb, "webdsl_db_pool_connections{state=\"in_use\"} %d\n", inUse);
+        StringBuilder_append(sb, "webdsl_db_pool_connections{state=\"idle\"} %d\n", size - inUse);
+        StringBuilder_append(sb, "webdsl_db_pool_connections{state=\"max\"} %d\n", maxSize);
+    }
+
+    // Request arenas
+    StringBuilder_append(sb, "# HELP webdsl_arena_high_water_bytes Largest request arena usage observed\n");
+    StringBuilder_append(sb, "# TYPE webdsl_arena_high_water_bytes gauge\n");
+    StringBuilder_append(sb, "webdsl_arena_high_water_bytes %llu\n", (unsigned long long)arenaHighWater);
+
+    StringBuilder_append(sb, "# HELP webdsl_request_arena_allocations_total Request arena allocations per route\n");
+    StringBuilder_append(sb, "# TYPE webdsl_request_arena_allocations_total counter\n");
+    for (size_t i = 0; i < routeCount; i++) {
+        if (routeSnapshots[i].total == 0) continue;
+        StringBuilder_append(sb, "webdsl_request_arena_allocations_total{%s} %llu\n",
+                             routeLabels(arena, &routes[i]), (unsigned long long)routeAllocations[i]);
+    }
+    StringBuilder_append(sb, "# HELP webdsl_request_arena_bytes_total Request arena bytes used per route\n");
+    StringBuilder_append(sb, "# TYPE webdsl_request_arena_bytes_total counter\n");
+    for (size_t i = 0; i < routeCount; i++) {
+        if (routeSnapshots[i].total == 0) continue;
+        StringBuilder_append(sb, "webdsl_request_arena_bytes_total{%s} %llu\n",
+                             routeLabels(arena, &routes[i]), (unsigned long long)routeArenaBytes[i]);
+    }
+
+    StringBuilder_append(sb, "# HELP webdsl_log_dropped_total Log lines dropped because a thread's buffer was full\n");
+    StringBuilder_append(sb, "# TYPE webdsl_log_dropped_total counter\n");
+    StringBuilder_append(sb, "webdsl_log_dropped_total %llu\n", (unsigned long long)loggerDroppedTotal());
+
+    StringBuilder_append(sb, "# HELP webdsl_capture_dropped_total Captured requests dropped because the write queue was full\n");
+    StringBuilder_append(sb, "# TYPE webdsl_capture_dropped_total counter\n");
+    StringBuilder_append(sb, "webdsl_capture_dropped_total %llu\n", (unsigned long long)captureDroppedTotal());
+
+    SessionStoreStats sessionStats;
+    sessionStoreStats(&sessionStats);
+    StringBuilder_append(sb, "# HELP webdsl_session_store_loads_total Session store documents read\n");
+    StringBuilder_append(sb, "# TYPE webdsl_session_store_loads_total counter\n");
+    StringBuilder_append(sb, "webdsl_session_store_loads_total %llu\n", (unsigned long long)sessionStats.loads);
+    StringBuilder_append(sb, "# HELP webdsl_session_store_writes_total Session store patches written\n");
+    StringBuilder_append(sb, "# TYPE webdsl_session_store_writes_total counter\n");
+    StringBuilder_append(sb, "webdsl_session_store_writes_total %llu\n", (unsigned long long)sessionStats.writes);
+
+    // Caches
+    StringBuilder_append(sb, "# HELP webdsl_cache_hits_total Cache lookups that found an entry\n");
+    StringBuilder_append(sb, "# TYPE webdsl_cache_hits_total counter\n");
+    for (size_t i = 0; i < METRICS_CACHE_COUNT; i++) {
+        StringBuilder_append(sb, "webdsl_cache_hits_total{cache=\"%s\"} %llu\n",
+                             cacheNames[i], (unsigned long long)cacheHits[i]);
+    }
+    StringBuilder_append(sb, "# HELP webdsl_cache_misses_total Cache lookups that had to load or compile\n");
+    StringBuilder_append(sb, "# TYPE webdsl_cache_misses_total counter\n");
+    for (size_t i = 0; i < METRICS_CACHE_COUNT; i++) {
+        StringBuilder_append(sb, "webdsl_cache_misses_total{cache=\"%s\"} %llu\n",
+                             cacheNames[i], (unsigned long long)cacheMisses[i]);
+    }
+    StringBuilder_append(sb, "# HELP webdsl_cache_hit_ratio Fraction of cache lookups that hit\n");
+    StringBuilder_append(sb, "# TYPE webdsl_cache_hit_ratio gauge\n");
+    for (size_t i = 0; i < METRICS_CACHE_COUNT; i++) {
+        uint64_t lookups = cacheHits[i] + cacheMisses[i];
+        double ratio = lookups ? (double)cacheHits[i] / (double)lookups : 0.0;
+        StringBuilder_append(sb, "webdsl_cache_hit_ratio{cache=\"%s\"} %.6f\n", cacheNames[i], ratio);
+    }
+
+    // Compiled jq filters, cached per worker thread
+    JqCacheStats jqStats;
+    jqCacheStats(&jqStats);
+    StringBuilder_append(sb, "# HELP webdsl_jq_programs Distinct jq filters compiled at load time\n");
+    StringBuilder_append(sb, "# TYPE webdsl_jq_programs gauge\n");
+    StringBuilder_append(sb, "webdsl_jq_programs %zu\n", jqStats.programs);
+    StringBuilder_append(sb, "# HELP webdsl_jq_compiles_total jq filter compilations\n");
+    StringBuilder_append(sb, "# TYPE webdsl_jq_compiles_total counter\n");
+    StringBuilder_append(sb, "webdsl_jq_compiles_total %llu\n", (unsigned long long)jqStats.compiles);
+    StringBuilder_append(sb, "# HELP webdsl_jq_cache_evictions_total jq states evicted from full per-thread caches\n");
+    StringBuilder_append(sb, "# TYPE webdsl_jq_cache_evictions_total counter\n");
+    StringBuilder_append(sb, "webdsl_jq_cache_evictions_total %llu\n", (unsigned long long)jqStats.evictions);
+    StringBuilder_append(sb, "# HELP webdsl_jq_cached_states Compiled jq states held across all threads\n");
+    StringBuilder_append(sb, "# TYPE webdsl_jq_cached_states gauge\n");
+    StringBuilder_append(sb, "webdsl_jq_cached_states %llu\n", (unsigned long long)jqStats.cachedStates);
+    StringBuilder_append(sb, "# HELP webdsl_jq_cache_bytes Estimated heap held by cached jq states\n");
+    StringBuilder_append(sb, "# TYPE webdsl_jq_cache_bytes gauge\n");
+    StringBuilder_append(sb, "webdsl_jq_cache_bytes %llu\n", (unsigned long long)jqStats.cachedBytes);
+    StringBuilder_append(sb, "# HELP webdsl_jq_native_programs jq steps run by the native evaluator\n");
+    StringBuilder_append(sb, "# TYPE webdsl_jq_native_programs gauge\n");
+    StringBuilder_append(sb, "webdsl_jq_native_programs %zu\n", jqStats.nativePrograms);
+    StringBuilder_append(sb, "# HELP webdsl_jq_native_fallbacks_total Native jq runs handed back to libjq\n");
+    StringBuilder_append(sb, "# TYPE webdsl_jq_native_fallbacks_total counter\n");
+    StringBuilder_append(sb, "webdsl_jq_native_fallbacks_total %llu\n", (unsigned long long)jqStats.nativeFallbacks);
+    StringBuilder_append(sb, "# HELP webdsl_jq_constant_steps jq steps evaluated once at load time\n");
+    StringBuilder_append(sb, "# TYPE webdsl_jq_constant_steps gauge\n");
+    StringBuilder_append(sb, "webdsl_jq_constant_steps %zu\n", jqStats.constantSteps);
+    StringBuilder_append(sb, "# HELP webdsl_jq_fused_steps jq steps folded into a preceding constant step\n");
+    StringBuilder_append(sb, "# TYPE webdsl_jq_fused_steps gauge\n");
+    StringBuilder_append(sb, "webdsl_jq_fused_steps %zu\n", jqStats.fusedSteps);
+    StringBuilder_append(sb, "# HELP webdsl_jq_merged_steps jq steps merged into a fused libjq program\n");
+    StringBuilder_append(sb, "# TYPE webdsl_jq_merged_steps gauge\n");
+    StringBuilder_append(sb, "webdsl_jq_merged_steps %zu\n", jqStats.mergedSteps);
+
+    free(routeSnapshots);
+    free(stepSnapshots);
+    free(poolSnapshot);
+    free(routeAllocations);
+
+    return StringBuilder_get(sb);
+}
+
+bool isMetricsPath(const char *url) {
+    return metricsPath[0] && strcmp(url, metricsPath) == 0;
+}
+
+static enum MHD_Result queueMetricsError(struct MHD_Connection *connection) {
+    static char message[] = "Failed to generate metrics";
+    struct MHD_Response *response = MHD_create_response_from_buffer(strlen(message), message,
+                                                                     MHD_RESPMEM_PERSISTENT);
+    if (!response) {
+        return MHD_NO;
+    }
+    enum MHD_Result ret = MHD_queue_response(connection, MHD_HTTP_INTERNAL_SERVER_ERROR, response);
+    MHD_destroy_response(response);
+    return ret;
+}
+
+enum MHD_Result handleMetricsRequest(struct MHD_Connection *connection, Arena *arena) {
+    char *metrics = generateMetrics(arena);
+    char *metrics_copy = metrics ? strdup(metrics) : NULL;
+    if (!metrics_copy) {
+        return queueMetricsError(connection);
+    }
+    struct MHD_Response *response = MHD_create_response_from_buffer(strlen(metrics_copy), metrics_copy,
+                                                                     MHD_RESPMEM_MUST_FREE);
+    if (!response) {
+        free(metrics_copy);
+        return queueMetricsError(connection);
+    }
+    MHD_add_response_header(response, "Content-Type", "text/plain; version=0.0.4");
+    enum MHD_Result ret = MHD_queue_response(connection, MHD_HTTP_OK, response);
+    MHD_destroy_response(response);
+    return ret;
+}
@@ -0,0 +1,57 @@
+#ifndef SERVER_METRICS_H
+#define SERVER_METRICS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <microhttpd.h>
+#include "../ast.h"
+#include "../arena.h"
+#include "server.h"
+#include "routing.h"
+
+// Route ids reserved for requests that never reach a page or API endpoint
+#define METRICS_ROUTE_UNMATCHED 0
+#define METRICS_ROUTE_STATIC 1
+#define METRICS_ROUTE_INTERNAL 2
+
+typedef enum {
+    METRICS_CACHE_JQ,
+    METRICS_CACHE_LUA,
+    METRICS_CACHE_STMT,
+    METRICS_CACHE_STATIC,
+    METRICS_CACHE_FETCH,
+    METRICS_CACHE_ARTIFACT,
+    METRICS_CACHE_COUNT
+} MetricsCache;
+
+// Initialize metrics for the routes of ctx->website. Counters restart on reload.
+void initMetrics(ServerContext *ctx);
+void cleanupMetrics(void);
+
+// Monotonic clock in nanoseconds
+uint64_t metricsNow(void);
+
+// Map a routing result to a metrics route id
+int metricsRouteId(const RouteMatch *match);
+
+// Route pattern for a metrics route id, e.g. "/api/v1/items" or "static"
+const char* metricsRouteName(int routeId);
+
+// Hot-path recorders. Each writes only to the calling thread's shard.
+void metricsRecordRequest(int routeId, uint64_t durationNs);
+void metricsRecordStep(StepType type, uint64_t durationNs);
+void metricsRecordPoolAcquire(uint64_t waitNs, bool acquired);
+void metricsRecordArena(int routeId, const Arena *arena);
+void metricsCacheHit(MetricsCache cache);
+void metricsCacheMiss(MetricsCache cache);
+
+// Aggregate all shards into Prometheus text exposition format
+char* generateMetrics(Arena *arena);
+
+// Whether url is where metrics are served: WEBDSL_METRICS_PATH, default
+// /metrics, or nowhere when it is set to an empty string
+bool isMetricsPath(const char *url);
+
+enum MHD_Result handleMetricsRequest(struct MHD_Connection *connection, Arena *arena);
+
+#endif // SERVER_METRICS_H
@@ -4,7 +4,10 @@
 #include <string.h>
 #include <jansson.h>
 #include "../deps/mustach/mustach-jansson.h"
-#include "auth.h"
+#include "anonymous_session.h"
+#include "metrics.h"
+#include "trace.h"
+#include "logger.h"
 
 static ServerContext *serverCtx = NULL;
 
@@ -131,7 +134,7 @@ char *generateFullPage(Arena *arena,
     return arena_result;
 }
 
-static char* createAnonymousSessionCookie(struct MHD_Connection *connection, ServerContext *ctx, Arena *arena) {
+static char* createAnonymousSessionCookie(struct MHD_Connection *connection, Arena *arena) {
     // Check for existing anonymous session
     const char *existing_token = MHD_lookup_connection_value(
         connection, 
@@ -139,29 +142,16 @@ static char* createAnonymousSessionCookie(struct MHD_Connection *connection, Ser
         "anonymous_session"
     );
 
-    if (existing_token) {
+    if (verifyAnonymousSession(existing_token)) {
         return NULL;  // Already has anonymous session
     }
 
-    // Generate new token and store in database
-    char *token = generateToken(arena);
+    // Signed token, so nothing is written to the database before responding
+    char *token = createAnonymousSession(arena);
     if (!token) {
         return NULL;
     }
 
-    const char *values[] = {token};
-    PGresult *result = executeParameterizedQuery(
-        ctx->db,
-        "INSERT INTO anonymous_sessions (token) VALUES ($1)",
-        values, 
-        1
-    );
-
-    if (!result) {
-        return NULL;
-    }
-    PQclear(result);
-
     // Create cookie string
     size_t base_cookie_len = strlen("anonymous_session=; Path=/; HttpOnly; SameSite=Strict; Max-Age=86400");
     size_t token_len = token ? strlen(token) : 0;
@@ -189,10 +179,12 @@ enum MHD_Result handlePageRequest(struct MHD_Connection *connection,
                                   PageNode *page, Arena *arena,
                                   json_t *pipelineResult) {
     // Find layout
-    LayoutNode *layout = findLayout(page->layout);
+    LayoutNode *layout = page->resolvedLayout ? page->resolvedLayout : findLayout(page->layout);
 
     // Generate the page with templates
+    uint64_t renderStart = metricsNow();
     char *html = generateFullPage(arena, page, layout, pipelineResult);
+    traceRecordRender(page->identifier, html ? strlen(html) : 0, metricsNow() - renderStart);
 
     if (page->redirect) {
         struct MHD_Response *response =
@@ -211,11 +203,13 @@ enum MHD_Result handlePageRequest(struct MHD_Connection *connection,
     // Check isLoggedIn from pipelineResult
     json_t *isLoggedIn = json_object_get(pipelineResult, "isLoggedIn");
     if (!json_is_true(isLoggedIn)) {
-        char *cookie = createAnonymousSessionCookie(connection, serverCtx, arena);
+        char *cookie = createAnonymousSessionCookie(connection, arena);
         if (cookie) {
             MHD_add_response_header(response, "Set-Cookie", cookie);
         }
     }
+    addServerTimingHeader(response);
+    requestLogAddBytesOut(strlen(html));
 
     enum MHD_Result ret = MHD_queue_response(connection, MHD_HTTP_OK, response);
     MHD_destroy_response(response);
@@ -2,6 +2,8 @@
 #include "db.h"
 #include "jq.h"
 #include "lua.h"
+#include "metrics.h"
+#include "trace.h"
 #include <string.h>
 
 // Function to set up the executor based on step type
@@ -24,6 +26,40 @@ void setupStepExecutor(PipelineStepNode *step) {
   }
 }
 
+// Run one step. jq steps take and return jv values so that consecutive jq
+// steps never round-trip through jansson; other steps see the jansson form.
+static PipelineValue runPipelineStep(PipelineStepNode *step, PipelineValue *input,
+                                     json_t *requestContext, Arena *arena, ServerContext *ctx) {
+    uint64_t start = metricsNow();
+    PipelineValue result;
+    json_t *native = NULL;
+    if (step->type == STEP_JQ) {
+        native = executeNativeJq(step, input->hasJv ? NULL : input->json);
+    }
+
+    if (native) {
+        result = pipelineValueFromJson(native);
+    } else if (step->type == STEP_JQ) {
+        // Hand jq sole ownership so it can update the input in place, unless
+        // the trace still needs to measure it
+        jv value;
+        if (!input->hasJv) {
+            value = janssonToJv(input->json);
+        } else if (traceActive()) {
+            value = jv_copy(input->value);
+        } else {
+            value = pipelineValueTakeJv(input);
+        }
+        result = pipelineValueFromJv(executeJqStepJv(step, value, ctx));
+    } else {
+        result = pipelineValueFromJson(step->execute(step, pipelineValueJson(input), requestContext, arena, ctx));
+    }
+    uint64_t duration = metricsNow() - start;
+    metricsRecordStep(step->type, duration);
+    traceRecordStep(step, input, &result, duration);
+    return result;
+}
+
 json_t* executePipelineStep(PipelineStepNode *step, json_t *input, json_t *requestContext, Arena *arena, ServerContext *ctx) {
     if (!step || !step->execute) {
         return NULL;
@@ -50,36 +86,50 @@ json_t* executePipelineStep(PipelineStepNode *step, json_t *input, json_t *reque
         return json_deep_copy(input);
     }
 
-    return step->execute(step, input, requestContext, arena, ctx);
+    PipelineValue value = pipelineValueFromJson(input);
+    PipelineValue result = runPipelineStep(step, &value, requestContext, arena, ctx);
+    return pipelineValueJson(&result);
 }
 
-json_t* executePipeline(ServerContext *ctx, PipelineStepNode *pipeline, json_t *requestContext, Arena *arena) {
+PipelineValue executePipelineValue(ServerContext *ctx, PipelineStepNode *pipeline, json_t *requestContext, Arena *arena) {
+    PipelineValue current = {0};
     if (!ctx || !pipeline || !arena) {
-        return NULL;
+        return current;
     }
 
-    json_t *current = requestContext;
-    if (!current) {
-        // Create an empty object if requestContext is NULL
-        current = json_object();
-        if (!current) {
-            return NULL;
-        }
+    // Create an empty object if requestContext is NULL
+    current = pipelineValueFromJson(requestContext ? requestContext : json_object());
+    if (pipelineValueIsEmpty(&current)) {
+        return current;
     }
 
-    PipelineStepNode *step = pipeline;
-    
-    while (step) {
-        json_t *result = executePipelineStep(step, current, requestContext, arena, ctx);
-        if (current != requestContext) {
-            json_decref(current);
+    for (PipelineStepNode *step = pipeline; step; step = step->next) {
+        if (!step->execute) {
+            pipelineValueFree(&current);
+            return current;
         }
-        if (!result) {
-            return NULL;
+
+        // An error or redirect skips the remaining steps
+        if (pipelineValueHasKey(&current, "error") || pipelineValueHasKey(&current, "redirect")) {
+            break;
+        }
+
+        PipelineValue result = runPipelineStep(step, &current, requestContext, arena, ctx);
+        pipelineValueFree(&current);
+        if (pipelineValueIsEmpty(&result)) {
+            return result;
         }
         current = result;
-        step = step->next;
     }
-    
+
+    // Callers may modify the result, so never hand back the request context itself
+    if (current.json && current.json == requestContext) {
+        current.json = json_deep_copy(requestContext);
+    }
     return current;
 }
+
+json_t* executePipeline(ServerContext *ctx, PipelineStepNode *pipeline, json_t *requestContext, Arena *arena) {
+    PipelineValue result = executePipelineValue(ctx, pipeline, requestContext, arena);
+    return pipelineValueJson(&result);
+}
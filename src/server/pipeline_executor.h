@@ -4,6 +4,7 @@
 #include "../ast.h"
 #include "../arena.h"
 #include "server.h"
+#include "pipeline_value.h"
 #include <jansson.h>
 
 // Pipeline step executor setup
@@ -18,6 +19,15 @@ json_t* executePipelineStep(
     ServerContext *ctx
 );
 
+// Execute a full pipeline with request context, keeping a final jq result in
+// jv form. The caller releases it with pipelineValueFree.
+PipelineValue executePipelineValue(
+    ServerContext *ctx,
+    PipelineStepNode *pipeline,
+    json_t *requestContext,
+    Arena *arena
+);
+
 // Execute a full pipeline with request context
 json_t* executePipeline(
     ServerContext *ctx,
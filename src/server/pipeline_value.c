@@ -0,0 +1,96 @@
+#include "pipeline_value.h"
+#include "jq.h"
+#include <string.h>
+
+PipelineValue pipelineValueFromJson(json_t *json) {
+    PipelineValue result = {0};
+    result.json = json;
+    return result;
+}
+
+PipelineValue pipelineValueFromJv(jv value) {
+    PipelineValue result = {0};
+    result.value = value;
+    result.hasJv = true;
+    return result;
+}
+
+bool pipelineValueIsEmpty(const PipelineValue *value) {
+    return !value->json && !value->hasJv;
+}
+
+json_t* pipelineValueJson(PipelineValue *value) {
+    if (value->hasJv) {
+        value->json = jvToJansson(value->value);  // Consumes the jv
+        value->hasJv = false;
+    }
+    return value->json;
+}
+
+jv pipelineValueTakeJv(PipelineValue *value) {
+    jv result;
+    if (value->hasJv) {
+        result = value->value;
+    } else if (value->json) {
+        result = janssonToJv(value->json);
+    } else {
+        result = jv_invalid();
+    }
+    value->json = NULL;
+    value->hasJv = false;
+    return result;
+}
+
+bool pipelineValueHasKey(PipelineValue *value, const char *key) {
+    if (value->hasJv) {
+        if (jv_get_kind(value->value) != JV_KIND_OBJECT) return false;
+        return jv_object_has(jv_copy(value->value), jv_string(key));
+    }
+    return json_object_get(value->json, key) != NULL;
+}
+
+char* pipelineValueDump(PipelineValue *value, Arena *arena, size_t *length) {
+    if (!value->hasJv) {
+        // json_dumps allocates from the request arena
+        char *json = value->json ? json_dumps(value->json, 0) : NULL;
+        *length = json ? strlen(json) : 0;
+        return json;
+    }
+
+    jv dumped = jv_dump_string(jv_copy(value->value), 0);
+    const char *text = jv_string_value(dumped);
+    *length = (size_t)jv_string_length_bytes(jv_copy(dumped));
+    char *result = arenaAlloc(arena, *length + 1);
+    if (result) {
+        memcpy(result, text, *length + 1);
+    }
+    jv_free(dumped);
+    return result;
+}
+
+static int countBytes(const char *buffer, size_t size, void *data) {
+    (void)buffer;
+    *(size_t *)data += size;
+    return 0;
+}
+
+size_t pipelineValueSize(PipelineValue *value) {
+    if (value->hasJv) {
+        return (size_t)jv_string_length_bytes(jv_dump_string(jv_copy(value->value), 0));
+    }
+
+    // Count without building the string in the request arena
+    size_t size = 0;
+    if (value->json) {
+        json_dump_callback(value->json, countBytes, &size, JSON_COMPACT | JSON_ENCODE_ANY);
+    }
+    return size;
+}
+
+void pipelineValueFree(PipelineValue *value) {
+    if (value->hasJv) {
+        jv_free(value->value);
+    }
+    value->json = NULL;
+    value->hasJv = false;
+}
@@ -0,0 +1,49 @@
+#ifndef SERVER_PIPELINE_VALUE_H
+#define SERVER_PIPELINE_VALUE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <jq.h>
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wpadded"
+#include <jansson.h>
+#pragma clang diagnostic pop
+#include "../arena.h"
+
+// A value flowing between pipeline steps, held either as jansson or as jq's
+// jv and converted only when the other form is needed. Consecutive jq steps
+// hand jv values straight to each other, and a final jq result is serialized
+// without going through jansson. An empty value (neither set) means the
+// pipeline failed.
+typedef struct PipelineValue {
+    json_t *json;   // Set when held as jansson (request arena)
+    jv value;       // Owned, set when hasJv
+    bool hasJv;
+    uint64_t : 56;
+} PipelineValue;
+
+PipelineValue pipelineValueFromJson(json_t *json);
+
+// Takes ownership of value
+PipelineValue pipelineValueFromJv(jv value);
+
+bool pipelineValueIsEmpty(const PipelineValue *value);
+
+// The jansson form, converting (and releasing the jv) if needed
+json_t* pipelineValueJson(PipelineValue *value);
+
+// Move the value out as a jv the caller owns, leaving value empty
+jv pipelineValueTakeJv(PipelineValue *value);
+
+// True when the value is an object with the given key
+bool pipelineValueHasKey(PipelineValue *value, const char *key);
+
+// Compact JSON text allocated in arena, or NULL for an empty value
+char* pipelineValueDump(PipelineValue *value, Arena *arena, size_t *length);
+
+// Serialized size in bytes, for traces
+size_t pipelineValueSize(PipelineValue *value);
+
+void pipelineValueFree(PipelineValue *value);
+
+#endif // SERVER_PIPELINE_VALUE_H
@@ -1,11 +1,10 @@
 #include "routing.h"
 #include "utils.h"
+#include "metrics.h"
 #include <string.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <jq.h>
-#include <pthread.h>
 
 typedef struct TransformHashEntry {
     const char *name;
@@ -26,44 +25,6 @@ static QueryHashEntry *queryTable[HASH_TABLE_SIZE];
 static TransformHashEntry *transformTable[HASH_TABLE_SIZE];
 static ScriptHashEntry *scriptTable[HASH_TABLE_SIZE];
 static PartialHashEntry *partialTable[HASH_TABLE_SIZE];
-static JQHashEntry *jqTable[HASH_TABLE_SIZE];
-static __thread JQHashEntry **threadJQTable = NULL;
-pthread_key_t jq_key;
-static pthread_once_t jq_key_once = PTHREAD_ONCE_INIT;
-
-void jq_thread_cleanup(void *ptr) {
-    JQHashEntry **table = (JQHashEntry **)ptr;
-    if (!table) return;
-    
-    for (int i = 0; i < HASH_TABLE_SIZE; i++) {
-        JQHashEntry *entry = table[i];
-        while (entry) {
-            JQHashEntry *next = entry->next;
-            if (entry->jq) {
-                jq_teardown(&entry->jq);
-            }
-            entry = next;
-        }
-        table[i] = NULL;
-    }
-    pthread_setspecific(jq_key, NULL);
-}
-
-static void jq_key_create(void) {
-    pthread_key_create(&jq_key, jq_thread_cleanup);
-}
-
-static JQHashEntry** getThreadJQTable(Arena *arena) {
-    pthread_once(&jq_key_once, jq_key_create);
-    
-    JQHashEntry **table = pthread_getspecific(jq_key);
-    if (!table) {
-        table = arenaAlloc(arena, HASH_TABLE_SIZE * sizeof(JQHashEntry*));
-        memset(table, 0, HASH_TABLE_SIZE * sizeof(JQHashEntry*));
-        pthread_setspecific(jq_key, table);
-    }
-    return table;
-}
 
 void buildRouteMaps(WebsiteNode *website, Arena *arena) {
     memset(routeTable, 0, sizeof(routeTable));
@@ -73,7 +34,6 @@ void buildRouteMaps(WebsiteNode *website, Arena *arena) {
     memset(transformTable, 0, sizeof(transformTable));
     memset(scriptTable, 0, sizeof(scriptTable));
     memset(partialTable, 0, sizeof(partialTable));
-    memset(jqTable, 0, sizeof(jqTable));
 
     // Build page routes
     for (PageNode *page = website->pageHead; page; page = page->next) {
@@ -263,80 +223,6 @@ ScriptNode* findScript(const char *name) {
     return NULL;
 }
 
-jq_state* findOrCreateJQ(const char *filter, Arena *arena) {
-    JQHashEntry **table = getThreadJQTable(arena);
-    uint32_t hash = hashString(filter) & HASH_MASK;
-    JQHashEntry *entry = table[hash];
-    
-    // Look for existing entry
-    while (entry) {
-        if (strcmp(entry->filter, filter) == 0) {
-            return entry->jq;
-        }
-        entry = entry->next;
-    }
-    
-    // Create new entry
-    entry = arenaAlloc(arena, sizeof(JQHashEntry));
-    if (!entry) {
-        fprintf(stderr, "Failed to allocate memory for JQ hash entry\n");
-        return NULL;
-    }
-
-    // Duplicate the filter string to ensure we own the memory
-    char *filter_copy = arenaDupString(arena, filter);
-    if (!filter_copy) {
-        fprintf(stderr, "Failed to duplicate filter string\n");
-        return NULL;
-    }
-    entry->filter = filter_copy;
-
-    entry->jq = jq_init();
-    
-    if (!entry->jq) {
-        return NULL;
-    }
-
-    // Compile the filter
-    int compiled = jq_compile(entry->jq, filter);
-    if (!compiled) {
-        jv error = jq_get_error_message(entry->jq);
-        if (jv_is_valid(error)) {
-            const char *error_msg = jv_string_value(error);
-            fprintf(stderr, "JQ compilation error: %s\n", error_msg);
-            jv_free(error);
-        }
-        jq_teardown(&entry->jq);
-        return NULL;
-    }
-
-    // Add to hash table
-    entry->next = table[hash];
-    table[hash] = entry;
-    
-    return entry->jq;
-}
-
-void cleanupJQCache(void) {
-    if (!threadJQTable) {
-        return;
-    }
-
-    for (int i = 0; i < HASH_TABLE_SIZE; i++) {
-        JQHashEntry *entry = threadJQTable[i];
-        while (entry) {
-            JQHashEntry *next = entry->next;
-            
-            if (entry->jq) {
-                jq_teardown(&entry->jq);
-            }
-            
-            entry = next;
-        }
-        threadJQTable[i] = NULL;
-    }
-}
-
 RouteMatch findRoute(const char *url, const char *method, Arena *arena) {
     RouteMatch match = {
         .type = ROUTE_TYPE_NONE,
@@ -41,22 +41,12 @@ typedef struct PageMatch {
     RouteParams params;
 } PageMatch;
 
-typedef struct JQHashEntry {
-    const char *filter;
-    jq_state *jq;
-    struct JQHashEntry *next;
-} JQHashEntry;
-
 typedef struct PartialHashEntry {
     const char *name;
     PartialNode *partial;
     struct PartialHashEntry *next;
 } PartialHashEntry;
 
-// Thread cleanup function for JQ states
-extern pthread_key_t jq_key;
-void jq_thread_cleanup(void *ptr);
-
 void buildRouteMaps(WebsiteNode *website, Arena *arena);
 PageNode* findPage(const char *url, RouteParams *params, Arena *arena);
 PageMatch* findPageWithParams(const char *url, Arena *arena);
@@ -64,8 +54,6 @@ LayoutNode* findLayout(const char *identifier);
 ApiEndpoint* findApi(const char *url, const char *method, RouteParams *params, Arena *arena);
 QueryNode* findQuery(const char *name);
 PartialNode* findPartial(const char *name);
-jq_state* findOrCreateJQ(const char *filter, Arena *arena);
-void cleanupJQCache(void);
 
 // Find a named transform by name
 TransformNode* findTransform(const char *name);
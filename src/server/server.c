@@ -1,7 +1,18 @@
 #include "server.h"
 #include "db.h"
 #include "css.h"
+#include "static.h"
+#include "metrics.h"
+#include "trace.h"
+#include "logger.h"
+#include "capture.h"
+#include "http_client.h"
+#include "anonymous_session.h"
+#include "artifact_cache.h"
+#include "shared_dict.h"
 #include "lua.h"
+#include "jq.h"
+#include "linker.h"
 #include "mustache.h"
 #include "routing.h"
 #include "handler.h"
@@ -34,6 +45,18 @@ static enum MHD_Result handler_adapter(void *cls,
                         upload_data, upload_data_size, con_cls);
 }
 
+// Pool workers accept their own connections, so the first connection on each
+// thread builds its jq states before any request on it is handled
+static void connection_adapter(void *cls,
+                               struct MHD_Connection *connection,
+                               void **socket_context,
+                               enum MHD_ConnectionNotificationCode toe) {
+    (void)cls; (void)connection; (void)socket_context;
+    if (toe == MHD_CONNECTION_NOTIFY_STARTED) {
+        prewarmJqThread();
+    }
+}
+
 ServerContext* startServer(WebsiteNode *website, Arena *arena) {
     // Create server context
     serverCtx = arenaAlloc(arena, sizeof(ServerContext));
@@ -61,9 +84,22 @@ ServerContext* startServer(WebsiteNode *website, Arena *arena) {
     }
 
     // Initialize subsystems
+    initLogger();
     initDb(serverCtx);
     initCss(serverCtx);
     initMustache(serverCtx);
+    initStatic(serverCtx);
+    initMetrics(serverCtx);
+    initTrace();
+    initCapture();
+    initHttpClient();
+    initAnonymousSessions(serverCtx);
+    if (!initSharedDict()) {
+        fprintf(stderr, "Shared dicts are unavailable\n");
+    }
+
+    // Lua chunks and jq filters compiled by an earlier start load from disk
+    initArtifactCache();
 
     // Initialize Lua subsystem
     if (!initLua(serverCtx)) {
@@ -71,6 +107,26 @@ ServerContext* startServer(WebsiteNode *website, Arena *arena) {
         exit(1);
     }
 
+    // Compile jq steps and transforms
+    if (!initJq(serverCtx)) {
+        fprintf(stderr, "Failed to compile jq filters\n");
+        exit(1);
+    }
+
+    // Resolve named queries, transforms, scripts and layouts once
+    if (!linkWebsite(serverCtx)) {
+        fprintf(stderr, "Failed to link website\n");
+        exit(1);
+    }
+
+    if (artifactCacheEnabled()) {
+        ArtifactCacheStats cacheStats;
+        artifactCacheStats(&cacheStats);
+        logInfo("Artifact cache: %llu hits, %llu misses, %llu written, %llu errors",
+                (unsigned long long)cacheStats.hits, (unsigned long long)cacheStats.misses,
+                (unsigned long long)cacheStats.writes, (unsigned long long)cacheStats.errors);
+    }
+
     // Get port number from website definition, default to 8080 if not specified
     uint16_t port = 8080;  // Default port
     if (website->port.type != VALUE_NULL) {
@@ -94,6 +150,7 @@ ServerContext* startServer(WebsiteNode *website, Arena *arena) {
                             MHD_OPTION_CONNECTION_TIMEOUT, 30,
                             MHD_OPTION_THREAD_POOL_SIZE, 8,
                             MHD_OPTION_NOTIFY_COMPLETED, handleRequestCompleted, serverCtx,  // Pass ctx to completion handler
+                            MHD_OPTION_NOTIFY_CONNECTION, connection_adapter, NULL,
                             MHD_OPTION_END);
     
     if (serverCtx->daemon == NULL) {
@@ -115,12 +172,18 @@ void stopServer(void) {
         MHD_stop_daemon(serverCtx->daemon);
     }
 
-    cleanupJQCache();
+    cleanupJq();
     cleanupLua();
+    cleanupStatic();
+    cleanupMetrics();
+    cleanupCapture();
+    cleanupAnonymousSessions();
 
     if (serverCtx->db) {
         closeDatabase(serverCtx->db);
     }
 
+    cleanupLogger();
+
     serverCtx = NULL;
 }
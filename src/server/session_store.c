@@ -0,0 +1,126 @@
+#include "session_store.h"
+#include "logger.h"
+#include <string.h>
+#include <stdatomic.h>
+
+// The store of the request this thread is running, set only for the
+// duration of one handler call
+static _Thread_local SessionStore *current = NULL;
+
+static _Atomic uint64_t loads = 0;
+static _Atomic uint64_t writes = 0;
+
+static void forgetStore(SessionStore *store) {
+    if (store->data) json_decref(store->data);
+    if (store->patch) json_decref(store->patch);
+    store->data = NULL;
+    store->patch = NULL;
+    store->sessionId[0] = '\0';
+}
+
+void beginSessionStore(SessionStore *store, ServerContext *ctx) {
+    memset(store, 0, sizeof(SessionStore));
+    store->ctx = ctx;
+    current = store;
+}
+
+// The current store for sessionId, switching from another session's if needed
+static SessionStore* storeFor(const char *sessionId) {
+    SessionStore *store = current;
+    if (!store || !store->ctx || !store->ctx->db) return NULL;
+    if (strlen(sessionId) >= SESSION_ID_MAX) return NULL;
+
+    if (store->sessionId[0] && strcmp(store->sessionId, sessionId) != 0) {
+        flushSessionStore();
+        forgetStore(store);
+    }
+    if (!store->sessionId[0]) {
+        strcpy(store->sessionId, sessionId);
+    }
+    return store;
+}
+
+static json_t* loadDocument(SessionStore *store) {
+    const char *sql = "SELECT data::text FROM session_store WHERE session_id = $1 LIMIT 1";
+    const char *params[] = {store->sessionId};
+    json_t *result = executeSqlWithParams(store->ctx->db, sql, params, 1);
+    atomic_fetch_add_explicit(&loads, 1, memory_order_relaxed);
+
+    json_t *row = json_array_get(json_object_get(result, "rows"), 0);
+    const char *text = json_string_value(json_object_get(row, "data"));
+    json_t *data = text ? json_loads(text, 0, NULL) : NULL;
+    if (result) json_decref(result);
+
+    if (!json_is_object(data)) {
+        if (data) json_decref(data);
+        data = json_object();
+    }
+    return data;
+}
+
+json_t* sessionStoreGet(const char *sessionId, const char *key) {
+    SessionStore *store = storeFor(sessionId);
+    if (!store) return NULL;
+
+    if (!store->data) {
+        store->data = loadDocument(store);
+        // Writes made before the first read win over what was stored
+        if (store->patch) json_object_update(store->data, store->patch);
+    }
+    return json_object_get(store->data, key);
+}
+
+bool sessionStoreSet(const char *sessionId, const char *key, json_t *value) {
+    SessionStore *store = storeFor(sessionId);
+    if (!store) {
+        json_decref(value);
+        return false;
+    }
+
+    if (!store->patch) store->patch = json_object();
+    json_object_set(store->patch, key, value);
+    if (store->data) json_object_set(store->data, key, value);
+    json_decref(value);
+    return true;
+}
+
+bool flushSessionStore(void) {
+    SessionStore *store = current;
+    if (!store || !store->patch || json_object_size(store->patch) == 0) return true;
+
+    // json_dumps allocates from the request arena
+    char *patch = json_dumps(store->patch, JSON_COMPACT);
+    if (!patch) {
+        logError("Failed to encode session store patch");
+        return false;
+    }
+
+    // Merges the changed top-level keys instead of rewriting the document
+    const char *sql = "INSERT INTO session_store (session_id, data) VALUES ($1, $2::jsonb) "
+                      "ON CONFLICT (session_id) DO UPDATE SET data = session_store.data || $2::jsonb, "
+                      "updated_at = CURRENT_TIMESTAMP";
+    const char *params[] = {store->sessionId, patch};
+    json_t *result = executeSqlWithParams(store->ctx->db, sql, params, 2);
+    atomic_fetch_add_explicit(&writes, 1, memory_order_relaxed);
+
+    if (!result) {
+        logError("Failed to write session store for a request");
+        return false;
+    }
+    json_decref(result);
+    json_object_clear(store->patch);
+    return true;
+}
+
+void endSessionStore(void) {
+    SessionStore *store = current;
+    if (!store) return;
+    flushSessionStore();
+    forgetStore(store);
+    current = NULL;
+}
+
+void sessionStoreStats(SessionStoreStats *stats) {
+    stats->loads = atomic_load_explicit(&loads, memory_order_relaxed);
+    stats->writes = atomic_load_explicit(&writes, memory_order_relaxed);
+}
@@ -0,0 +1,50 @@
+#ifndef SERVER_SESSION_STORE_H
+#define SERVER_SESSION_STORE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wpadded"
+#include <jansson.h>
+#pragma clang diagnostic pop
+#include "server.h"
+
+#define SESSION_ID_MAX 256
+
+// The session_store row of one request's session, read at most once and
+// written back as one patch. It lives on the request's context and is only
+// reachable between beginSessionStore() and endSessionStore(), which the
+// handler calls around the pipeline in the same call.
+typedef struct SessionStore {
+    ServerContext *ctx;
+    json_t *data;              // Stored document with pending writes applied, once loaded
+    json_t *patch;             // Keys set since the last flush
+    char sessionId[SESSION_ID_MAX];
+} SessionStore;
+
+typedef struct SessionStoreStats {
+    uint64_t loads;   // Documents read, at most one per session per request
+    uint64_t writes;  // Patches written
+} SessionStoreStats;
+
+// Make store the one getStore and setStore use on this thread
+void beginSessionStore(SessionStore *store, ServerContext *ctx);
+
+// Value of key in the session's store, or NULL. The reference is borrowed
+// and stays valid until endSessionStore().
+json_t* sessionStoreGet(const char *sessionId, const char *key);
+
+// Set key to value (stealing the reference). Nothing is written until
+// flushSessionStore(). Returns false if there is no database or no store.
+bool sessionStoreSet(const char *sessionId, const char *key, json_t *value);
+
+// Write the keys set so far with a single jsonb || upsert
+bool flushSessionStore(void);
+
+// Flush anything still pending and release the store. Must run while the
+// request's JSON arena is still current.
+void endSessionStore(void);
+
+void sessionStoreStats(SessionStoreStats *stats);
+
+#endif // SERVER_SESSION_STORE_H
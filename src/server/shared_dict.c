@@ -0,0 +1,377 @@
+#include "shared_dict.h"
+#include "metrics.h"
+#include "logger.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#define SHARED_DICT_STRIPES 16     // Should be power of 2
+#define DEFAULT_SHARED_DICT_ENTRIES 8192
+#define MAX_SHARED_DICT_ENTRIES (1u << 20)
+#define NS_PER_SECOND 1e9
+
+// Entries are referred to by index + 1 so that 0 can end a list. The
+// region may be mapped at different addresses, so it holds no pointers.
+typedef struct SharedEntry {
+    uint64_t expiresNs;        // metricsNow() deadline, 0 for none
+    double number;
+    uint32_t hash;
+    uint32_t next;             // Bucket chain, or the free list
+    uint32_t newer;            // LRU order within the stripe
+    uint32_t older;
+    uint16_t keyLength;
+    uint16_t valueLength;
+    uint8_t type;              // SharedValueType, SHARED_VALUE_NIL when free
+    uint8_t boolean;
+    uint8_t _padding[2];
+    char key[SHARED_DICT_KEY_MAX];
+    char value[SHARED_DICT_VALUE_MAX];
+} SharedEntry;
+
+// Each stripe owns perStripe consecutive buckets and entries
+typedef struct SharedStripe {
+    pthread_mutex_t lock;      // Process-shared, and robust on Linux
+    uint32_t freeHead;
+    uint32_t newest;
+    uint32_t oldest;
+    uint32_t : 32;
+} SharedStripe;
+
+typedef struct SharedRegion {
+    uint32_t perStripe;
+    uint32_t : 32;
+    SharedStripe stripes[SHARED_DICT_STRIPES];
+    // Followed by the buckets and then the entries
+} SharedRegion;
+
+static SharedRegion *region = NULL;
+static uint32_t *buckets = NULL;
+static SharedEntry *entries = NULL;
+static size_t regionSize = 0;
+
+// Empty stripe s, chaining all of its entries onto its free list
+static void resetStripe(uint32_t s) {
+    SharedStripe *stripe = &region->stripes[s];
+    uint32_t perStripe = region->perStripe;
+    uint32_t first = s * perStripe;
+
+    memset(&buckets[first], 0, perStripe * sizeof(uint32_t));
+    for (uint32_t i = 0; i < perStripe; i++) {
+        SharedEntry *entry = &entries[first + i];
+        entry->type = SHARED_VALUE_NIL;
+        entry->newer = 0;
+        entry->older = 0;
+        entry->next = i + 1 < perStripe ? first + i + 2 : 0;
+    }
+    stripe->freeHead = first + 1;
+    stripe->newest = 0;
+    stripe->oldest = 0;
+}
+
+bool initSharedDict(void) {
+    if (region) return true;
+
+    size_t capacity = DEFAULT_SHARED_DICT_ENTRIES;
+    const char *setting = getenv("WEBDSL_SHARED_DICT_ENTRIES");
+    if (setting && atol(setting) > 0) {
+        capacity = (size_t)atol(setting);
+        if (capacity > MAX_SHARED_DICT_ENTRIES) capacity = MAX_SHARED_DICT_ENTRIES;
+    }
+    uint32_t perStripe = (uint32_t)((capacity + SHARED_DICT_STRIPES - 1) / SHARED_DICT_STRIPES);
+    size_t total = (size_t)perStripe * SHARED_DICT_STRIPES;
+
+    size_t bucketsOffset = sizeof(SharedRegion);
+    size_t entriesOffset = (bucketsOffset + total * sizeof(uint32_t) + 7) & ~(size_t)7;
+    size_t size = entriesOffset + total * sizeof(SharedEntry);
+
+    void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Failed to map %zu bytes for shared dicts\n", size);
+        return false;
+    }
+
+    // Anonymous mappings start zeroed
+    region = map;
+    region->perStripe = perStripe;
+    regionSize = size;
+    buckets = (uint32_t *)(void *)((char *)map + bucketsOffset);
+    entries = (SharedEntry *)(void *)((char *)map + entriesOffset);
+
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+#ifdef __linux__
+    // A worker that dies holding a stripe must not leave it locked for the others
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+#endif
+    for (uint32_t s = 0; s < SHARED_DICT_STRIPES; s++) {
+        pthread_mutex_init(&region->stripes[s].lock, &attr);
+        resetStripe(s);
+    }
+    pthread_mutexattr_destroy(&attr);
+    return true;
+}
+
+void cleanupSharedDict(void) {
+    if (!region) return;
+
+    for (uint32_t s = 0; s < SHARED_DICT_STRIPES; s++) {
+        pthread_mutex_destroy(&region->stripes[s].lock);
+    }
+    munmap(region, regionSize);
+    region = NULL;
+    buckets = NULL;
+    entries = NULL;
+    regionSize = 0;
+}
+
+// =============================================================================
+// Entries
+// =============================================================================
+
+static SharedEntry* entryAt(uint32_t ref) {
+    return &entries[ref - 1];
+}
+
+static SharedStripe* stripeFor(uint32_t hash) {
+    return &region->stripes[hash & (SHARED_DICT_STRIPES - 1)];
+}
+
+// The owner of a robust lock died inside an operation, which may have left
+// the stripe's chains half updated, so its entries are dropped
+static void lockStripe(SharedStripe *stripe) {
+    int result = pthread_mutex_lock(&stripe->lock);
+#ifdef __linux__
+    if (result == EOWNERDEAD) {
+        uint32_t s = (uint32_t)(stripe - region->stripes);
+        resetStripe(s);
+        pthread_mutex_consistent(&stripe->lock);
+        logError("Shared dict stripe %u was locked by a process that exited, its entries were dropped", s);
+    }
+#else
+    (void)result;
+#endif
+}
+
+static uint32_t* bucketFor(uint32_t hash) {
+    uint32_t stripe = hash & (SHARED_DICT_STRIPES - 1);
+    return &buckets[stripe * region->perStripe + (hash / SHARED_DICT_STRIPES) % region->perStripe];
+}
+
+// "dict\0key", so names and keys can't run into each other
+static size_t composeKey(char *buffer, const char *dict, const char *key) {
+    size_t dictLength = strlen(dict);
+    size_t keyLength = strlen(key);
+    if (dictLength + 1 + keyLength > SHARED_DICT_KEY_MAX) return 0;
+
+    memcpy(buffer, dict, dictLength);
+    buffer[dictLength] = '\0';
+    memcpy(buffer + dictLength + 1, key, keyLength);
+    return dictLength + 1 + keyLength;
+}
+
+// FNV-1a like hashString, which would stop at the NUL between dict and key
+static uint32_t hashKey(const char *key, size_t length) __attribute__((no_sanitize("unsigned-integer-overflow")));
+
+static uint32_t hashKey(const char *key, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (uint8_t)key[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static void unlinkLru(SharedStripe *stripe, uint32_t ref) {
+    SharedEntry *entry = entryAt(ref);
+    if (entry->newer) entryAt(entry->newer)->older = entry->older;
+    else stripe->newest = entry->older;
+    if (entry->older) entryAt(entry->older)->newer = entry->newer;
+    else stripe->oldest = entry->newer;
+    entry->newer = 0;
+    entry->older = 0;
+}
+
+static void pushNewest(SharedStripe *stripe, uint32_t ref) {
+    SharedEntry *entry = entryAt(ref);
+    entry->older = stripe->newest;
+    entry->newer = 0;
+    if (stripe->newest) entryAt(stripe->newest)->newer = ref;
+    stripe->newest = ref;
+    if (!stripe->oldest) stripe->oldest = ref;
+}
+
+static void removeEntry(SharedStripe *stripe, uint32_t ref) {
+    SharedEntry *entry = entryAt(ref);
+    uint32_t *link = bucketFor(entry->hash);
+    while (*link && *link != ref) link = &entryAt(*link)->next;
+    if (*link) *link = entry->next;
+
+    unlinkLru(stripe, ref);
+    entry->type = SHARED_VALUE_NIL;
+    entry->next = stripe->freeHead;
+    stripe->freeHead = ref;
+}
+
+// Find a live entry, dropping it if it has expired
+static uint32_t findEntry(SharedStripe *stripe, uint32_t hash, const char *key, size_t length) {
+    uint32_t ref = *bucketFor(hash);
+    while (ref) {
+        SharedEntry *entry = entryAt(ref);
+        if (entry->hash == hash && entry->keyLength == length && memcmp(entry->key, key, length) == 0) {
+            if (entry->expiresNs && metricsNow() >= entry->expiresNs) {
+                removeEntry(stripe, ref);
+                return 0;
+            }
+            return ref;
+        }
+        ref = entry->next;
+    }
+    return 0;
+}
+
+// A free entry, evicting the stripe's least recently used one if there are none
+static uint32_t insertEntry(SharedStripe *stripe, uint32_t hash, const char *key, size_t length) {
+    if (!stripe->freeHead) removeEntry(stripe, stripe->oldest);
+
+    uint32_t ref = stripe->freeHead;
+    SharedEntry *entry = entryAt(ref);
+    stripe->freeHead = entry->next;
+
+    uint32_t *bucket = bucketFor(hash);
+    entry->hash = hash;
+    entry->keyLength = (uint16_t)length;
+    memcpy(entry->key, key, length);
+    entry->expiresNs = 0;
+    entry->next = *bucket;
+    *bucket = ref;
+    pushNewest(stripe, ref);
+    return ref;
+}
+
+static void storeValue(SharedEntry *entry, const SharedValue *value) {
+    entry->type = (uint8_t)value->type;
+    entry->number = value->number;
+    entry->boolean = value->boolean;
+    entry->valueLength = 0;
+    if (value->type == SHARED_VALUE_STRING) {
+        memcpy(entry->value, value->string, value->length);
+        entry->valueLength = (uint16_t)value->length;
+    }
+}
+
+// =============================================================================
+// Operations
+// =============================================================================
+
+bool sharedDictGet(const char *dict, const char *key, SharedValue *value) {
+    char fullKey[SHARED_DICT_KEY_MAX];
+    size_t length = region ? composeKey(fullKey, dict, key) : 0;
+    if (length == 0) return false;
+
+    uint32_t hash = hashKey(fullKey, length);
+    SharedStripe *stripe = stripeFor(hash);
+    bool found = false;
+
+    lockStripe(stripe);
+    uint32_t ref = findEntry(stripe, hash, fullKey, length);
+    if (ref) {
+        SharedEntry *entry = entryAt(ref);
+        value->type = (SharedValueType)entry->type;
+        value->number = entry->number;
+        value->boolean = entry->boolean;
+        value->length = entry->valueLength;
+        memcpy(value->string, entry->value, entry->valueLength);
+        unlinkLru(stripe, ref);
+        pushNewest(stripe, ref);
+        found = true;
+    }
+    pthread_mutex_unlock(&stripe->lock);
+
+    return found;
+}
+
+SharedDictStatus sharedDictSet(const char *dict, const char *key, const SharedValue *value, double ttl) {
+    if (!region) return SHARED_DICT_UNAVAILABLE;
+    if (value->type == SHARED_VALUE_NIL) {
+        sharedDictDelete(dict, key);
+        return SHARED_DICT_OK;
+    }
+    if (value->type == SHARED_VALUE_STRING && value->length > SHARED_DICT_VALUE_MAX) {
+        return SHARED_DICT_TOO_LARGE;
+    }
+
+    char fullKey[SHARED_DICT_KEY_MAX];
+    size_t length = composeKey(fullKey, dict, key);
+    if (length == 0) return SHARED_DICT_TOO_LARGE;
+
+    uint32_t hash = hashKey(fullKey, length);
+    SharedStripe *stripe = stripeFor(hash);
+    uint64_t expiresNs = ttl > 0 ? metricsNow() + (uint64_t)(ttl * NS_PER_SECOND) : 0;
+
+    lockStripe(stripe);
+    uint32_t ref = findEntry(stripe, hash, fullKey, length);
+    if (ref) {
+        unlinkLru(stripe, ref);
+        pushNewest(stripe, ref);
+    } else {
+        ref = insertEntry(stripe, hash, fullKey, length);
+    }
+    SharedEntry *entry = entryAt(ref);
+    storeValue(entry, value);
+    entry->expiresNs = expiresNs;
+    pthread_mutex_unlock(&stripe->lock);
+
+    return SHARED_DICT_OK;
+}
+
+SharedDictStatus sharedDictIncr(const char *dict, const char *key, double by, double init, double *result) {
+    if (!region) return SHARED_DICT_UNAVAILABLE;
+
+    char fullKey[SHARED_DICT_KEY_MAX];
+    size_t length = composeKey(fullKey, dict, key);
+    if (length == 0) return SHARED_DICT_TOO_LARGE;
+
+    uint32_t hash = hashKey(fullKey, length);
+    SharedStripe *stripe = stripeFor(hash);
+    SharedDictStatus status = SHARED_DICT_OK;
+
+    lockStripe(stripe);
+    uint32_t ref = findEntry(stripe, hash, fullKey, length);
+    if (!ref) {
+        ref = insertEntry(stripe, hash, fullKey, length);
+        SharedEntry *entry = entryAt(ref);
+        entry->type = SHARED_VALUE_NUMBER;
+        entry->valueLength = 0;
+        entry->number = init + by;
+        *result = entry->number;
+    } else if (entryAt(ref)->type == SHARED_VALUE_NUMBER) {
+        SharedEntry *entry = entryAt(ref);
+        entry->number += by;
+        *result = entry->number;
+        unlinkLru(stripe, ref);
+        pushNewest(stripe, ref);
+    } else {
+        status = SHARED_DICT_NOT_NUMBER;
+    }
+    pthread_mutex_unlock(&stripe->lock);
+
+    return status;
+}
+
+void sharedDictDelete(const char *dict, const char *key) {
+    char fullKey[SHARED_DICT_KEY_MAX];
+    size_t length = region ? composeKey(fullKey, dict, key) : 0;
+    if (length == 0) return;
+
+    uint32_t hash = hashKey(fullKey, length);
+    SharedStripe *stripe = stripeFor(hash);
+
+    lockStripe(stripe);
+    uint32_t ref = findEntry(stripe, hash, fullKey, length);
+    if (ref) removeEntry(stripe, ref);
+    pthread_mutex_unlock(&stripe->lock);
+}
@@ -0,0 +1,57 @@
+#ifndef SERVER_SHARED_DICT_H
+#define SERVER_SHARED_DICT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SHARED_DICT_KEY_MAX 128    // Dict name, NUL and key
+#define SHARED_DICT_VALUE_MAX 512
+
+typedef enum {
+    SHARED_VALUE_NIL,
+    SHARED_VALUE_STRING,
+    SHARED_VALUE_NUMBER,
+    SHARED_VALUE_BOOLEAN
+} SharedValueType;
+
+typedef struct SharedValue {
+    SharedValueType type;
+    bool boolean;
+    uint8_t _padding[3];
+    double number;
+    size_t length;
+    char string[SHARED_DICT_VALUE_MAX];
+} SharedValue;
+
+typedef enum {
+    SHARED_DICT_OK,
+    SHARED_DICT_TOO_LARGE,     // Key or value doesn't fit an entry
+    SHARED_DICT_NOT_NUMBER,    // incr on a value that isn't a number
+    SHARED_DICT_UNAVAILABLE    // The region couldn't be mapped
+} SharedDictStatus;
+
+// Map the dictionary region, with room for WEBDSL_SHARED_DICT_ENTRIES
+// entries (default 8192). The mapping is shared memory made once per
+// process and kept across reloads, so worker processes forked after this
+// see the same entries. On Linux a process that dies while holding a
+// stripe's lock costs that stripe its entries; elsewhere the stripe stays
+// locked. Returns false if it couldn't be mapped.
+bool initSharedDict(void);
+
+// Unmap the region. Only tests need this; it otherwise lives as long as the process.
+void cleanupSharedDict(void);
+
+// Copy the value of key in dict into value. Returns false if it's missing or expired.
+bool sharedDictGet(const char *dict, const char *key, SharedValue *value);
+
+// Set key in dict, expiring after ttl seconds unless ttl is 0. A full
+// dictionary evicts its least recently used entries.
+SharedDictStatus sharedDictSet(const char *dict, const char *key, const SharedValue *value, double ttl);
+
+// Atomically add by to a number, starting from init if key is missing
+SharedDictStatus sharedDictIncr(const char *dict, const char *key, double by, double init, double *result);
+
+void sharedDictDelete(const char *dict, const char *key);
+
+#endif // SERVER_SHARED_DICT_H
@@ -0,0 +1,806 @@
+#include "static.h"
+#include "utils.h"
+#include "metrics.h"
+#include "logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+#define STATIC_CACHE_SIZE 64  // Should be power of 2
+#define STATIC_CACHE_MASK (STATIC_CACHE_SIZE - 1)
+#define STATIC_CACHE_MAX_ENTRIES 1024  // Bounds the number of open descriptors
+#define STATIC_CACHE_MAX_MISSES 256    // "Does not exist" entries, kept apart so 404s can't crowd out files
+
+typedef struct StaticMount {
+    const char *route;
+    size_t routeLen;     // Route length without trailing slashes
+    char *root;          // realpath() of the mount directory
+    size_t rootLen;
+    int maxAge;
+    uint64_t : 32;
+} StaticMount;
+
+typedef struct StaticFile {
+    char *key;           // root + "/" + relative path (+ ".br"/".gz")
+    char *watchPath;     // Resolved directory + basename, matched against watcher events
+    int fd;              // -1 for a cached "does not exist" entry
+    uint64_t : 32;
+    off_t size;
+    time_t mtime;
+    ino_t ino;
+    char etag[48];
+    char lastModified[32];
+    struct StaticFile *next;   // Bucket chain
+    struct StaticFile *newer;  // LRU order within its list
+    struct StaticFile *older;
+} StaticFile;
+
+// Open files and cached misses are evicted separately, least recently used first
+typedef struct StaticLru {
+    StaticFile *newest;
+    StaticFile *oldest;
+    size_t count;
+    size_t limit;
+} StaticLru;
+
+typedef struct StaticWatch {
+    int wd;
+    uint64_t : 32;
+    char *dir;
+    struct StaticWatch *next;
+} StaticWatch;
+
+static ServerContext *ctx = NULL;
+static StaticMount *mounts = NULL;
+static size_t mountCount = 0;
+
+static StaticFile *fileCache[STATIC_CACHE_SIZE];
+static StaticLru openFiles = {NULL, NULL, 0, STATIC_CACHE_MAX_ENTRIES};
+static StaticLru missingFiles = {NULL, NULL, 0, STATIC_CACHE_MAX_MISSES};
+static pthread_rwlock_t fileCacheLock = PTHREAD_RWLOCK_INITIALIZER;
+
+// Hits only hold the read lock, so moving an entry to the front of its LRU
+// list takes this as well. Writers hold the write lock and need not.
+static pthread_mutex_t lruLock = PTHREAD_MUTEX_INITIALIZER;
+
+// Without a watcher every cache hit is revalidated with stat()
+static bool watcherActive = false;
+
+#ifdef __linux__
+static int inotifyFd = -1;
+static int wakePipe[2] = {-1, -1};
+static pthread_t watcherThread;
+static StaticWatch *watches = NULL;
+#endif
+
+// =============================================================================
+// Helpers
+// =============================================================================
+
+static const char* mimeTypeForPath(const char *path) {
+    static const struct { const char *ext; const char *type; } types[] = {
+        {"html", "text/html; charset=utf-8"},
+        {"htm", "text/html; charset=utf-8"},
+        {"css", "text/css; charset=utf-8"},
+        {"js", "text/javascript; charset=utf-8"},
+        {"mjs", "text/javascript; charset=utf-8"},
+        {"json", "application/json"},
+        {"map", "application/json"},
+        {"txt", "text/plain; charset=utf-8"},
+        {"xml", "application/xml"},
+        {"svg", "image/svg+xml"},
+        {"png", "image/png"},
+        {"jpg", "image/jpeg"},
+        {"jpeg", "image/jpeg"},
+        {"gif", "image/gif"},
+        {"webp", "image/webp"},
+        {"avif", "image/avif"},
+        {"ico", "image/x-icon"},
+        {"woff", "font/woff"},
+        {"woff2", "font/woff2"},
+        {"ttf", "font/ttf"},
+        {"otf", "font/otf"},
+        {"pdf", "application/pdf"},
+        {"wasm", "application/wasm"},
+        {"mp4", "video/mp4"},
+        {"webm", "video/webm"},
+        {"mp3", "audio/mpeg"},
+    };
+
+    const char *slash = strrchr(path, '/');
+    const char *dot = strrchr(path, '.');
+    if (!dot || (slash && dot < slash)) {
+        return "application/octet-stream";
+    }
+
+    for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); i++) {
+        if (strcasecmp(dot + 1, types[i].ext) == 0) {
+            return types[i].type;
+        }
+    }
+    return "application/octet-stream";
+}
+
+// Reject "..", "." and empty segments before touching the filesystem
+static bool isSafeRelativePath(const char *rel) {
+    if (strchr(rel, '\\')) {
+        return false;
+    }
+
+    const char *segment = rel;
+    while (*segment) {
+        const char *slash = strchr(segment, '/');
+        size_t len = slash ? (size_t)(slash - segment) : strlen(segment);
+
+        if (len == 0 && slash) return false;
+        if (len == 1 && segment[0] == '.') return false;
+        if (len == 2 && segment[0] == '.' && segment[1] == '.') return false;
+
+        if (!slash) break;
+        segment = slash + 1;
+    }
+    return true;
+}
+
+static bool isWithinRoot(const StaticMount *mount, const char *path) {
+    return strncmp(path, mount->root, mount->rootLen) == 0 &&
+           (path[mount->rootLen] == '\0' || path[mount->rootLen] == '/');
+}
+
+// Checks an Accept-Encoding header for a coding that is not disabled with q=0
+static bool acceptsEncoding(const char *header, const char *coding) {
+    size_t codingLen = strlen(coding);
+    const char *p = header;
+
+    while (*p) {
+        while (*p == ' ' || *p == ',') p++;
+        const char *tokenStart = p;
+        while (*p && *p != ',' && *p != ';' && *p != ' ') p++;
+        size_t tokenLen = (size_t)(p - tokenStart);
+
+        const char *params = p;
+        while (*p && *p != ',') p++;
+
+        if (tokenLen == codingLen && strncasecmp(tokenStart, coding, codingLen) == 0) {
+            const char *q = strstr(params, "q=");
+            if (q && q < p && strtod(q + 2, NULL) <= 0.0) {
+                return false;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool etagMatches(const char *header, const char *etag) {
+    if (strcmp(header, "*") == 0) return true;
+    return strstr(header, etag) != NULL;
+}
+
+// Parses a single "bytes=" range. Returns 1 for a usable range, 0 when the
+// header should be ignored and the full body served, -1 when unsatisfiable.
+static int parseRange(const char *header, uint64_t size, uint64_t *start, uint64_t *end) {
+    if (strncmp(header, "bytes=", 6) != 0) return 0;
+    const char *spec = header + 6;
+
+    // Multiple ranges would need multipart/byteranges; serve the full body
+    if (strchr(spec, ',')) return 0;
+
+    char *endptr;
+    if (spec[0] == '-') {
+        if (!isdigit((unsigned char)spec[1])) return 0;
+        uint64_t suffix = strtoull(spec + 1, &endptr, 10);
+        if (*endptr != '\0') return 0;
+        if (suffix == 0 || size == 0) return -1;
+        *start = suffix >= size ? 0 : size - suffix;
+        *end = size - 1;
+        return 1;
+    }
+
+    if (!isdigit((unsigned char)spec[0])) return 0;
+    uint64_t first = strtoull(spec, &endptr, 10);
+    if (*endptr != '-') return 0;
+
+    uint64_t last = size - 1;
+    const char *lastSpec = endptr + 1;
+    if (*lastSpec) {
+        if (!isdigit((unsigned char)*lastSpec)) return 0;
+        last = strtoull(lastSpec, &endptr, 10);
+        if (*endptr != '\0') return 0;
+        if (last < first) return 0;
+    }
+
+    if (first >= size) return -1;
+    if (last >= size) last = size - 1;
+
+    *start = first;
+    *end = last;
+    return 1;
+}
+
+static void formatHttpDate(time_t t, char *buffer, size_t size) {
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    strftime(buffer, size, "%a, %d %b %Y %H:%M:%S GMT", &tm);
+}
+
+// =============================================================================
+// File Cache
+// =============================================================================
+
+static void freeStaticFile(StaticFile *file) {
+    if (file->fd >= 0) close(file->fd);
+    free(file->key);
+    free(file->watchPath);
+    free(file);
+}
+
+static StaticLru* lruFor(const StaticFile *file) {
+    return file->fd >= 0 ? &openFiles : &missingFiles;
+}
+
+static void lruUnlink(StaticLru *lru, StaticFile *file) {
+    if (file->newer) file->newer->older = file->older;
+    else lru->newest = file->older;
+    if (file->older) file->older->newer = file->newer;
+    else lru->oldest = file->newer;
+    file->newer = NULL;
+    file->older = NULL;
+}
+
+static void lruPushNewest(StaticLru *lru, StaticFile *file) {
+    file->newer = NULL;
+    file->older = lru->newest;
+    if (lru->newest) lru->newest->newer = file;
+    lru->newest = file;
+    if (!lru->oldest) lru->oldest = file;
+}
+
+// Unlinks file from its bucket and LRU list and frees it
+static void removeFileLocked(StaticFile *file) {
+    StaticFile **link = &fileCache[hashString(file->key) & STATIC_CACHE_MASK];
+    while (*link && *link != file) {
+        link = &(*link)->next;
+    }
+    if (*link) *link = file->next;
+
+    StaticLru *lru = lruFor(file);
+    lruUnlink(lru, file);
+    lru->count--;
+    freeStaticFile(file);
+}
+
+static void insertFileLocked(uint32_t bucket, StaticFile *file) {
+    StaticLru *lru = lruFor(file);
+    while (lru->count >= lru->limit && lru->oldest) {
+        removeFileLocked(lru->oldest);
+    }
+    file->next = fileCache[bucket];
+    fileCache[bucket] = file;
+    lruPushNewest(lru, file);
+    lru->count++;
+}
+
+static void invalidateAllLocked(void) {
+    for (size_t i = 0; i < STATIC_CACHE_SIZE; i++) {
+        StaticFile *file = fileCache[i];
+        while (file) {
+            StaticFile *next = file->next;
+            freeStaticFile(file);
+            file = next;
+        }
+        fileCache[i] = NULL;
+    }
+    openFiles.newest = openFiles.oldest = NULL;
+    openFiles.count = 0;
+    missingFiles.newest = missingFiles.oldest = NULL;
+    missingFiles.count = 0;
+}
+
+static bool isFresh(const StaticFile *file) {
+    if (watcherActive) return true;
+
+    struct stat st;
+    if (stat(file->watchPath, &st) != 0 || !S_ISREG(st.st_mode)) {
+        return file->fd < 0;
+    }
+    return file->fd >= 0 && st.st_ino == file->ino &&
+           st.st_size == file->size && st.st_mtime == file->mtime;
+}
+
+#ifdef __linux__
+static void invalidatePathLocked(const char *path) {
+    for (size_t i = 0; i < STATIC_CACHE_SIZE; i++) {
+        StaticFile *file = fileCache[i];
+        while (file) {
+            StaticFile *next = file->next;
+            if (strcmp(file->watchPath, path) == 0) {
+                removeFileLocked(file);
+            }
+            file = next;
+        }
+    }
+}
+
+static void addWatchLocked(const char *dir) {
+    if (inotifyFd < 0) return;
+
+    for (StaticWatch *watch = watches; watch; watch = watch->next) {
+        if (strcmp(watch->dir, dir) == 0) return;
+    }
+
+    int wd = inotify_add_watch(inotifyFd, dir,
+                               IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE |
+                               IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+                               IN_DELETE_SELF | IN_MOVE_SELF);
+    if (wd < 0) {
+        // Without a watch this directory can no longer be trusted
+        logError("Failed to watch static directory %s, falling back to stat checks", dir);
+        watcherActive = false;
+        return;
+    }
+
+    StaticWatch *watch = malloc(sizeof(StaticWatch));
+    if (!watch) return;
+    watch->wd = wd;
+    watch->dir = strdup(dir);
+    watch->next = watches;
+    watches = watch;
+}
+
+static void removeWatchLocked(int wd) {
+    StaticWatch **link = &watches;
+    while (*link) {
+        StaticWatch *watch = *link;
+        if (watch->wd == wd) {
+            *link = watch->next;
+            free(watch->dir);
+            free(watch);
+            return;
+        }
+        link = &watch->next;
+    }
+}
+
+static void handleWatchEvent(int wd, uint32_t mask, const char *name) {
+    pthread_rwlock_wrlock(&fileCacheLock);
+
+    if (mask & (IN_Q_OVERFLOW | IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+        invalidateAllLocked();
+        if (mask & IN_IGNORED) removeWatchLocked(wd);
+    } else {
+        for (StaticWatch *watch = watches; watch; watch = watch->next) {
+            if (watch->wd == wd && name[0]) {
+                char path[PATH_MAX];
+                int written = snprintf(path, sizeof(path), "%s/%s", watch->dir, name);
+                if (written > 0 && (size_t)written < sizeof(path)) {
+                    invalidatePathLocked(path);
+                }
+                break;
+            }
+        }
+    }
+
+    pthread_rwlock_unlock(&fileCacheLock);
+}
+
+static void* watcherLoop(void *arg) {
+    (void)arg;
+    char buffer[4096] __attribute__((aligned(8)));
+
+    for (;;) {
+        struct pollfd fds[2] = {
+            { .fd = inotifyFd, .events = POLLIN, .revents = 0 },
+            { .fd = wakePipe[0], .events = POLLIN, .revents = 0 },
+        };
+        if (poll(fds, 2, -1) < 0) continue;
+        if (fds[1].revents) break;
+        if (!(fds[0].revents & POLLIN)) continue;
+
+        ssize_t len = read(inotifyFd, buffer, sizeof(buffer));
+        if (len <= 0) continue;
+
+        size_t offset = 0;
+        while (offset + sizeof(struct inotify_event) <= (size_t)len) {
+            struct inotify_event event;
+            memcpy(&event, buffer + offset, sizeof(event));
+            const char *name = event.len ? buffer + offset + sizeof(event) : "";
+            handleWatchEvent(event.wd, event.mask, name);
+            offset += sizeof(event) + event.len;
+        }
+    }
+
+    return NULL;
+}
+#endif
+
+// Opens and stats a file for the cache. Returns NULL when the entry cannot be
+// cached (missing parent directory or a path escaping the mount root).
+static StaticFile* loadStaticFile(const StaticMount *mount, const char *key) {
+    const char *slash = strrchr(key, '/');
+    if (!slash) return NULL;
+
+    char dir[PATH_MAX];
+    size_t dirLen = (size_t)(slash - key);
+    if (dirLen >= sizeof(dir)) return NULL;
+    memcpy(dir, key, dirLen);
+    dir[dirLen] = '\0';
+
+    char realDir[PATH_MAX];
+    if (!realpath(dir, realDir) || !isWithinRoot(mount, realDir)) {
+        return NULL;
+    }
+
+    char watchPath[PATH_MAX];
+    int written = snprintf(watchPath, sizeof(watchPath), "%s/%s", realDir, slash + 1);
+    if (written < 0 || (size_t)written >= sizeof(watchPath)) {
+        return NULL;
+    }
+
+    StaticFile *file = calloc(1, sizeof(StaticFile));
+    if (!file) return NULL;
+    file->key = strdup(key);
+    file->watchPath = strdup(watchPath);
+    file->fd = -1;
+    if (!file->key || !file->watchPath) {
+        freeStaticFile(file);
+        return NULL;
+    }
+
+    // Symlinks are allowed as long as their target stays inside the mount
+    char realFile[PATH_MAX];
+    if (!realpath(watchPath, realFile) || !isWithinRoot(mount, realFile)) {
+        return file;
+    }
+
+    int fd = open(realFile, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return file;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return file;
+    }
+
+    file->fd = fd;
+    file->size = st.st_size;
+    file->mtime = st.st_mtime;
+    file->ino = st.st_ino;
+    snprintf(file->etag, sizeof(file->etag), "\"%llx-%llx\"",
+             (unsigned long long)st.st_size, (unsigned long long)st.st_mtime);
+    formatHttpDate(st.st_mtime, file->lastModified, sizeof(file->lastModified));
+    return file;
+}
+
+// Copies the cache entry for key into out with a dup()ed descriptor that the
+// response takes ownership of. Returns false if the file does not exist.
+static bool acquireStaticFile(const StaticMount *mount, const char *key, StaticFile *out) {
+    uint32_t bucket = hashString(key) & STATIC_CACHE_MASK;
+
+    pthread_rwlock_rdlock(&fileCacheLock);
+    for (StaticFile *file = fileCache[bucket]; file; file = file->next) {
+        if (strcmp(file->key, key) == 0 && isFresh(file)) {
+            pthread_mutex_lock(&lruLock);
+            StaticLru *lru = lruFor(file);
+            if (lru->newest != file) {
+                lruUnlink(lru, file);
+                lruPushNewest(lru, file);
+            }
+            pthread_mutex_unlock(&lruLock);
+
+            *out = *file;
+            out->key = NULL;
+            out->watchPath = NULL;
+            out->next = out->newer = out->older = NULL;
+            out->fd = file->fd >= 0 ? dup(file->fd) : -1;
+            pthread_rwlock_unlock(&fileCacheLock);
+            metricsCacheHit(METRICS_CACHE_STATIC);
+            return out->fd >= 0;
+        }
+    }
+    pthread_rwlock_unlock(&fileCacheLock);
+    metricsCacheMiss(METRICS_CACHE_STATIC);
+
+    StaticFile *loaded = loadStaticFile(mount, key);
+    if (!loaded) return false;
+
+    pthread_rwlock_wrlock(&fileCacheLock);
+
+    // Drop a stale or concurrently inserted entry for the same key
+    StaticFile *file = fileCache[bucket];
+    while (file) {
+        StaticFile *next = file->next;
+        if (strcmp(file->key, key) == 0) {
+            removeFileLocked(file);
+        }
+        file = next;
+    }
+
+#ifdef __linux__
+    char *slash = strrchr(loaded->watchPath, '/');
+    *slash = '\0';
+    addWatchLocked(loaded->watchPath);
+    *slash = '/';
+#endif
+    insertFileLocked(bucket, loaded);
+
+    *out = *loaded;
+    out->key = NULL;
+    out->watchPath = NULL;
+    out->next = out->newer = out->older = NULL;
+    out->fd = loaded->fd >= 0 ? dup(loaded->fd) : -1;
+
+    pthread_rwlock_unlock(&fileCacheLock);
+    return out->fd >= 0;
+}
+
+// =============================================================================
+// Request Handling
+// =============================================================================
+
+static const StaticMount* findMount(const char *url, const char **rel) {
+    for (size_t i = 0; i < mountCount; i++) {
+        const StaticMount *mount = &mounts[i];
+        if (strncmp(url, mount->route, mount->routeLen) == 0 &&
+            (url[mount->routeLen] == '/' || url[mount->routeLen] == '\0')) {
+            *rel = url + mount->routeLen;
+            return mount;
+        }
+    }
+    return NULL;
+}
+
+// Chooses the representation, then applies the conditional and Range headers
+static void answerFromFile(const StaticMount *mount, const StaticFile *file, const char *path,
+                           const char *encoding, StaticHeaderLookup header, void *source,
+                           StaticResponse *out) {
+    out->maxAge = mount->maxAge;
+    out->size = (uint64_t)file->size;
+    memcpy(out->etag, file->etag, sizeof(out->etag));
+    memcpy(out->lastModified, file->lastModified, sizeof(out->lastModified));
+
+    const char *ifNoneMatch = header(source, MHD_HTTP_HEADER_IF_NONE_MATCH);
+    const char *ifModifiedSince = header(source, MHD_HTTP_HEADER_IF_MODIFIED_SINCE);
+    if ((ifNoneMatch && etagMatches(ifNoneMatch, file->etag)) ||
+        (!ifNoneMatch && ifModifiedSince && strcmp(ifModifiedSince, file->lastModified) == 0)) {
+        close(file->fd);
+        out->status = MHD_HTTP_NOT_MODIFIED;
+        return;
+    }
+
+    uint64_t start = 0;
+    uint64_t end = out->size ? out->size - 1 : 0;
+    int rangeResult = 0;
+
+    const char *range = header(source, MHD_HTTP_HEADER_RANGE);
+    const char *ifRange = header(source, MHD_HTTP_HEADER_IF_RANGE);
+    if (range && (!ifRange || strcmp(ifRange, file->etag) == 0 ||
+                  strcmp(ifRange, file->lastModified) == 0)) {
+        rangeResult = parseRange(range, out->size, &start, &end);
+    }
+
+    if (rangeResult < 0) {
+        close(file->fd);
+        out->status = MHD_HTTP_RANGE_NOT_SATISFIABLE;
+        out->etag[0] = '\0';
+        out->lastModified[0] = '\0';
+        return;
+    }
+
+    out->status = rangeResult > 0 ? MHD_HTTP_PARTIAL_CONTENT : MHD_HTTP_OK;
+    out->fd = file->fd;
+    out->offset = start;
+    out->length = rangeResult > 0 ? end - start + 1 : out->size;
+    out->contentType = mimeTypeForPath(path);
+    out->encoding = encoding;
+}
+
+bool resolveStaticRequest(const char *url, const char *method,
+                          StaticHeaderLookup header, void *source, StaticResponse *out) {
+    memset(out, 0, sizeof(StaticResponse));
+    out->fd = -1;
+
+    if (mountCount == 0) return false;
+    if (strcmp(method, "GET") != 0 && strcmp(method, "HEAD") != 0) return false;
+
+    const char *rel = NULL;
+    const StaticMount *mount = findMount(url, &rel);
+    if (!mount) return false;
+
+    while (*rel == '/') rel++;
+    if (!isSafeRelativePath(rel)) {
+        out->status = MHD_HTTP_NOT_FOUND;
+        return true;
+    }
+
+    // Directory requests map to index.html
+    size_t relLen = strlen(rel);
+    const char *index = (relLen == 0 || rel[relLen - 1] == '/') ? "index.html" : "";
+
+    char path[PATH_MAX];
+    int written = snprintf(path, sizeof(path), "%s/%s%s", mount->root, rel, index);
+    if (written < 0 || (size_t)written + 4 >= sizeof(path)) {
+        out->status = MHD_HTTP_NOT_FOUND;
+        return true;
+    }
+
+    // Prefer precompressed siblings when the client accepts them
+    const char *acceptEncoding = header(source, MHD_HTTP_HEADER_ACCEPT_ENCODING);
+    StaticFile file;
+    const char *encoding = NULL;
+    bool found = false;
+    char variant[PATH_MAX];
+
+    if (acceptEncoding && acceptsEncoding(acceptEncoding, "br")) {
+        snprintf(variant, sizeof(variant), "%s.br", path);
+        if ((found = acquireStaticFile(mount, variant, &file))) encoding = "br";
+    }
+    if (!found && acceptEncoding && acceptsEncoding(acceptEncoding, "gzip")) {
+        snprintf(variant, sizeof(variant), "%s.gz", path);
+        if ((found = acquireStaticFile(mount, variant, &file))) encoding = "gzip";
+    }
+    if (!found && !acquireStaticFile(mount, path, &file)) {
+        return false;
+    }
+
+    answerFromFile(mount, &file, path, encoding, header, source, out);
+    return true;
+}
+
+static const char* connectionHeader(void *source, const char *name) {
+    return MHD_lookup_connection_value(source, MHD_HEADER_KIND, name);
+}
+
+enum MHD_Result handleStaticRequest(struct MHD_Connection *connection,
+                                    const char *url, const char *method) {
+    StaticResponse answer;
+    if (!resolveStaticRequest(url, method, connectionHeader, connection, &answer)) {
+        return MHD_NO;
+    }
+
+    // The response owns the descriptor and sends it with sendfile() where available
+    struct MHD_Response *response = answer.fd >= 0
+        ? MHD_create_response_from_fd_at_offset64(answer.length, answer.fd, answer.offset)
+        : MHD_create_response_from_buffer(0, NULL, MHD_RESPMEM_PERSISTENT);
+    if (!response) {
+        if (answer.fd >= 0) close(answer.fd);
+        return MHD_NO;
+    }
+
+    if (answer.etag[0]) {
+        char cacheControl[64];
+        snprintf(cacheControl, sizeof(cacheControl), "public, max-age=%d", answer.maxAge);
+        MHD_add_response_header(response, MHD_HTTP_HEADER_CACHE_CONTROL, cacheControl);
+        MHD_add_response_header(response, MHD_HTTP_HEADER_ETAG, answer.etag);
+        MHD_add_response_header(response, MHD_HTTP_HEADER_LAST_MODIFIED, answer.lastModified);
+        MHD_add_response_header(response, MHD_HTTP_HEADER_VARY, MHD_HTTP_HEADER_ACCEPT_ENCODING);
+    }
+
+    if (answer.status == MHD_HTTP_RANGE_NOT_SATISFIABLE) {
+        char contentRange[64];
+        snprintf(contentRange, sizeof(contentRange), "bytes */%llu", (unsigned long long)answer.size);
+        MHD_add_response_header(response, MHD_HTTP_HEADER_CONTENT_RANGE, contentRange);
+    }
+
+    if (answer.fd >= 0) {
+        MHD_add_response_header(response, MHD_HTTP_HEADER_CONTENT_TYPE, answer.contentType);
+        MHD_add_response_header(response, MHD_HTTP_HEADER_ACCEPT_RANGES, "bytes");
+        if (answer.encoding) {
+            MHD_add_response_header(response, MHD_HTTP_HEADER_CONTENT_ENCODING, answer.encoding);
+        }
+        if (answer.status == MHD_HTTP_PARTIAL_CONTENT) {
+            char contentRange[96];
+            snprintf(contentRange, sizeof(contentRange), "bytes %llu-%llu/%llu",
+                     (unsigned long long)answer.offset,
+                     (unsigned long long)(answer.offset + answer.length - 1),
+                     (unsigned long long)answer.size);
+            MHD_add_response_header(response, MHD_HTTP_HEADER_CONTENT_RANGE, contentRange);
+        }
+        requestLogAddBytesOut(answer.length);
+    }
+
+    enum MHD_Result ret = MHD_queue_response(connection, answer.status, response);
+    MHD_destroy_response(response);
+    return ret;
+}
+
+// =============================================================================
+// Lifecycle
+// =============================================================================
+
+void initStatic(ServerContext *serverCtx) {
+    ctx = serverCtx;
+    mountCount = 0;
+
+    size_t count = 0;
+    for (StaticNode *node = ctx->website->staticHead; node; node = node->next) {
+        count++;
+    }
+    if (count == 0) return;
+
+    mounts = calloc(count, sizeof(StaticMount));
+    if (!mounts) return;
+
+    for (StaticNode *node = ctx->website->staticHead; node; node = node->next) {
+        char *root = realpath(node->dir, NULL);
+        if (!root) {
+            logError("Static directory not found: %s", node->dir);
+            continue;
+        }
+
+        StaticMount *mount = &mounts[mountCount++];
+        mount->route = node->route;
+        mount->routeLen = strlen(node->route);
+        while (mount->routeLen > 0 && node->route[mount->routeLen - 1] == '/') {
+            mount->routeLen--;
+        }
+        mount->root = root;
+        mount->rootLen = strlen(root);
+        mount->maxAge = node->maxAge;
+    }
+
+#ifdef __linux__
+    if (mountCount > 0) {
+        inotifyFd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+        if (inotifyFd >= 0 && pipe(wakePipe) == 0 &&
+            pthread_create(&watcherThread, NULL, watcherLoop, NULL) == 0) {
+            watcherActive = true;
+        } else {
+            logError("Failed to start static file watcher, falling back to stat checks");
+            if (inotifyFd >= 0) close(inotifyFd);
+            if (wakePipe[0] >= 0) close(wakePipe[0]);
+            if (wakePipe[1] >= 0) close(wakePipe[1]);
+            inotifyFd = -1;
+            wakePipe[0] = wakePipe[1] = -1;
+        }
+    }
+#endif
+}
+
+void cleanupStatic(void) {
+#ifdef __linux__
+    if (inotifyFd >= 0) {
+        if (write(wakePipe[1], "x", 1) == 1) {
+            pthread_join(watcherThread, NULL);
+        }
+        close(wakePipe[0]);
+        close(wakePipe[1]);
+        close(inotifyFd);
+        inotifyFd = -1;
+        wakePipe[0] = wakePipe[1] = -1;
+    }
+    while (watches) {
+        StaticWatch *next = watches->next;
+        free(watches->dir);
+        free(watches);
+        watches = next;
+    }
+#endif
+    watcherActive = false;
+
+    pthread_rwlock_wrlock(&fileCacheLock);
+    invalidateAllLocked();
+    pthread_rwlock_unlock(&fileCacheLock);
+
+    for (size_t i = 0; i < mountCount; i++) {
+        free(mounts[i].root);
+    }
+    free(mounts);
+    mounts = NULL;
+    mountCount = 0;
+    ctx = NULL;
+}
@@ -0,0 +1,44 @@
+#ifndef SERVER_STATIC_H
+#define SERVER_STATIC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <microhttpd.h>
+#include "../ast.h"
+#include "server.h"
+
+// Returns the value of a request header, or NULL
+typedef const char* (*StaticHeaderLookup)(void *source, const char *name);
+
+// How a static request is answered, before it becomes an MHD response
+typedef struct StaticResponse {
+    unsigned int status;
+    int fd;                   // Body descriptor the caller owns, -1 when there is no body
+    uint64_t offset;          // First byte of the body within the file
+    uint64_t length;          // Body bytes
+    uint64_t size;            // Size of the whole file
+    const char *contentType;
+    const char *encoding;     // "br" or "gzip" for a precompressed sibling, else NULL
+    char etag[48];            // Empty when no validators apply
+    char lastModified[32];
+    int maxAge;
+    uint64_t : 32;
+} StaticResponse;
+
+// Initialize static file subsystem (resolves mount dirs, starts watcher)
+void initStatic(ServerContext *ctx);
+
+// Decide the answer to a GET or HEAD for url. Returns false when the URL does
+// not belong to a mount or the file does not exist so routing can continue.
+bool resolveStaticRequest(const char *url, const char *method,
+                          StaticHeaderLookup header, void *source, StaticResponse *out);
+
+// Serve a file from a static mount. Returns MHD_NO when the URL does not
+// belong to a mount or the file does not exist so routing can continue.
+enum MHD_Result handleStaticRequest(struct MHD_Connection *connection,
+                                    const char *url, const char *method);
+
+// Close cached file descriptors and stop the watcher thread
+void cleanupStatic(void);
+
+#endif // SERVER_STATIC_H
@@ -0,0 +1,196 @@
+#include "trace.h"
+#include "metrics.h"
+#include "logger.h"
+#include "../stringbuilder.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DEFAULT_SAMPLE_RATE 0.01
+
+typedef enum {
+    TRACE_MODE_HEADER,   // Trace every request, report via Server-Timing
+    TRACE_MODE_SAMPLE    // Trace a sample of requests, write JSON lines
+} TraceMode;
+
+#ifdef NDEBUG
+static TraceMode traceMode = TRACE_MODE_SAMPLE;
+#else
+static TraceMode traceMode = TRACE_MODE_HEADER;
+#endif
+static double sampleRate = DEFAULT_SAMPLE_RATE;
+
+static _Thread_local RequestTrace *currentTrace = NULL;
+
+static const char *stepTypeNames[] = {"jq", "lua", "sql", "dynamic_sql"};
+
+void initTrace(void) {
+    const char *rate = getenv("WEBDSL_TRACE_SAMPLE_RATE");
+    if (rate) {
+        char *end;
+        double value = strtod(rate, &end);
+        if (end != rate && value >= 0.0 && value <= 1.0) {
+            sampleRate = value;
+        } else {
+            fprintf(stderr, "Invalid WEBDSL_TRACE_SAMPLE_RATE '%s', using %g\n", rate, sampleRate);
+        }
+    }
+}
+
+RequestTrace* beginRequestTrace(Arena *arena, const char *method, const char *url, uint64_t startNs) {
+    currentTrace = NULL;
+    if (traceMode == TRACE_MODE_SAMPLE && !loggerSample(sampleRate)) {
+        return NULL;
+    }
+
+    RequestTrace *trace = arenaAlloc(arena, sizeof(RequestTrace));
+    if (!trace) return NULL;
+    trace->arena = arena;
+    trace->method = arenaDupString(arena, method);
+    trace->url = arenaDupString(arena, url);
+    trace->startNs = startNs;
+    trace->head = NULL;
+    trace->tail = NULL;
+
+    currentTrace = trace;
+    return trace;
+}
+
+static TraceSpan* appendSpan(RequestTrace *trace) {
+    TraceSpan *span = arenaAlloc(trace->arena, sizeof(TraceSpan));
+    if (!span) return NULL;
+    memset(span, 0, sizeof(TraceSpan));
+    span->rows = -1;
+
+    if (trace->tail) {
+        trace->tail->next = span;
+    } else {
+        trace->head = span;
+    }
+    trace->tail = span;
+    return span;
+}
+
+bool traceActive(void) {
+    return currentTrace != NULL;
+}
+
+void traceRecordStep(PipelineStepNode *step, PipelineValue *input, PipelineValue *output, uint64_t durationNs) {
+    RequestTrace *trace = currentTrace;
+    if (!trace) return;
+
+    TraceSpan *span = appendSpan(trace);
+    if (!span) return;
+
+    span->type = (unsigned)step->type < sizeof(stepTypeNames) / sizeof(stepTypeNames[0])
+        ? stepTypeNames[step->type] : "step";
+    span->name = step->name;
+    span->durationNs = durationNs;
+    span->bytesIn = pipelineValueSize(input);
+    span->bytesOut = pipelineValueSize(output);
+
+    // SQL steps append their result set to the data array
+    if (step->type == STEP_SQL || step->type == STEP_DYNAMIC_SQL) {
+        json_t *data = json_object_get(output->json, "data");
+        size_t count = json_array_size(data);
+        if (count > 0) {
+            json_t *rows = json_object_get(json_array_get(data, count - 1), "rows");
+            span->rows = (int64_t)json_array_size(rows);
+        }
+    }
+}
+
+void traceRecordRender(const char *name, size_t bytesOut, uint64_t durationNs) {
+    RequestTrace *trace = currentTrace;
+    if (!trace) return;
+
+    TraceSpan *span = appendSpan(trace);
+    if (!span) return;
+
+    span->type = "render";
+    span->name = name;
+    span->durationNs = durationNs;
+    span->bytesOut = bytesOut;
+}
+
+static void appendEscaped(StringBuilder *sb, const char *value) {
+    for (const char *p = value; *p; p++) {
+        unsigned char c = (unsigned char)*p;
+        if (c == '"' || c == '\\') {
+            StringBuilder_append(sb, "\\%c", c);
+        } else if (c < 0x20) {
+            StringBuilder_append(sb, "\\u%04x", c);
+        } else {
+            StringBuilder_append(sb, "%c", c);
+        }
+    }
+}
+
+void addServerTimingHeader(struct MHD_Response *response) {
+    RequestTrace *trace = currentTrace;
+    if (!trace || traceMode != TRACE_MODE_HEADER || !response) return;
+
+    StringBuilder *sb = StringBuilder_new(trace->arena);
+    if (!sb) return;
+
+    for (TraceSpan *span = trace->head; span; span = span->next) {
+        StringBuilder_append(sb, "%s", span->type);
+        if (span->name) {
+            StringBuilder_append(sb, ";desc=\"");
+            appendEscaped(sb, span->name);
+            StringBuilder_append(sb, "\"");
+        }
+        StringBuilder_append(sb, ";dur=%.3f, ", (double)span->durationNs / 1e6);
+    }
+    StringBuilder_append(sb, "total;dur=%.3f", (double)(metricsNow() - trace->startNs) / 1e6);
+
+    MHD_add_response_header(response, "Server-Timing", StringBuilder_get(sb));
+}
+
+static void writeTrace(RequestTrace *trace) {
+    StringBuilder *sb = StringBuilder_new(trace->arena);
+    if (!sb) return;
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    struct tm tm;
+    gmtime_r(&now.tv_sec, &tm);
+    char timestamp[32];
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%S", &tm);
+
+    StringBuilder_append(sb, "{\"ts\":\"%s.%03ldZ\",\"method\":\"", timestamp, now.tv_nsec / 1000000);
+    appendEscaped(sb, trace->method ? trace->method : "");
+    StringBuilder_append(sb, "\",\"url\":\"");
+    appendEscaped(sb, trace->url ? trace->url : "");
+    StringBuilder_append(sb, "\",\"durationMs\":%.3f,\"steps\":[",
+                         (double)(metricsNow() - trace->startNs) / 1e6);
+
+    for (TraceSpan *span = trace->head; span; span = span->next) {
+        StringBuilder_append(sb, "{\"type\":\"%s\"", span->type);
+        if (span->name) {
+            StringBuilder_append(sb, ",\"name\":\"");
+            appendEscaped(sb, span->name);
+            StringBuilder_append(sb, "\"");
+        }
+        StringBuilder_append(sb, ",\"durationMs\":%.3f", (double)span->durationNs / 1e6);
+        if (span->rows >= 0) {
+            StringBuilder_append(sb, ",\"rows\":%lld", (long long)span->rows);
+        }
+        StringBuilder_append(sb, ",\"bytesIn\":%zu,\"bytesOut\":%zu}%s",
+                             span->bytesIn, span->bytesOut, span->next ? "," : "");
+    }
+    StringBuilder_append(sb, "]}");
+
+    logLine(StringBuilder_get(sb), sb->length);
+}
+
+void endRequestTrace(RequestTrace *trace) {
+    // The thread may have started another connection's trace since
+    if (currentTrace == trace) {
+        currentTrace = NULL;
+    }
+    if (trace && traceMode == TRACE_MODE_SAMPLE) {
+        writeTrace(trace);
+    }
+}
@@ -0,0 +1,51 @@
+#ifndef SERVER_TRACE_H
+#define SERVER_TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <microhttpd.h>
+#include "../ast.h"
+#include "../arena.h"
+#include "pipeline_value.h"
+
+typedef struct TraceSpan {
+    const char *type;     // "jq", "lua", "sql", "dynamic_sql" or "render"
+    const char *name;     // Named query/script/transform or page, may be NULL
+    uint64_t durationNs;
+    int64_t rows;         // Rows returned by SQL steps, -1 otherwise
+    size_t bytesIn;       // Serialized size of the step input
+    size_t bytesOut;      // Serialized size of the step output
+    struct TraceSpan *next;
+} TraceSpan;
+
+typedef struct RequestTrace {
+    Arena *arena;
+    const char *method;
+    const char *url;
+    uint64_t startNs;
+    TraceSpan *head;
+    TraceSpan *tail;
+} RequestTrace;
+
+// Read trace settings. Development builds trace every request and emit a
+// Server-Timing header; NDEBUG builds sample WEBDSL_TRACE_SAMPLE_RATE of
+// requests (default 0.01) and write each as a JSON line.
+void initTrace(void);
+
+// Start tracing the current request on this thread. Returns NULL when the
+// request is not traced.
+RequestTrace* beginRequestTrace(Arena *arena, const char *method, const char *url, uint64_t startNs);
+
+// Write the sampled trace, if any, and detach it from this thread
+void endRequestTrace(RequestTrace *trace);
+
+// Whether the current request on this thread is traced
+bool traceActive(void);
+
+void traceRecordStep(PipelineStepNode *step, PipelineValue *input, PipelineValue *output, uint64_t durationNs);
+void traceRecordRender(const char *name, size_t bytesOut, uint64_t durationNs);
+
+// Add a Server-Timing header for the current trace in development builds
+void addServerTimingHeader(struct MHD_Response *response);
+
+#endif // SERVER_TRACE_H
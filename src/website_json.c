@@ -61,6 +61,7 @@ static json_t* pageNodeToJson(const PageNode* current) {
         if (current->description) json_object_set_new(page, "description", json_string(current->description));
         if (current->method) json_object_set_new(page, "method", json_string(current->method));
         if (current->redirect) json_object_set_new(page, "redirect", json_string(current->redirect));
+        if (current->luaBudget) json_object_set_new(page, "luaBudget", json_integer(current->luaBudget));
         
         json_t* error = responseBlockToJson(current->errorBlock);
         if (error) json_object_set_new(page, "error", error);
@@ -187,6 +188,7 @@ static json_t* apiEndpointsToJson(const ApiEndpoint* endpoints) {
         json_t* endpoint = json_object();
         if (current->route) json_object_set_new(endpoint, "route", json_string(current->route));
         if (current->method) json_object_set_new(endpoint, "method", json_string(current->method));
+        if (current->luaBudget) json_object_set_new(endpoint, "luaBudget", json_integer(current->luaBudget));
         
         json_t* pipeline = pipelineToJson(current->pipeline);
         if (pipeline) json_object_set_new(endpoint, "pipeline", pipeline);
@@ -359,6 +361,25 @@ static json_t* partialsToJson(const PartialNode* partials) {
     return partials_array;
 }
 
+static json_t* staticsToJson(const StaticNode* statics) {
+    if (!statics) return NULL;
+    
+    json_t* statics_array = json_array();
+    const StaticNode* current = statics;
+    
+    while (current) {
+        json_t* staticJson = json_object();
+        if (current->route) json_object_set_new(staticJson, "route", json_string(current->route));
+        if (current->dir) json_object_set_new(staticJson, "dir", json_string(current->dir));
+        json_object_set_new(staticJson, "maxAge", json_integer(current->maxAge));
+        
+        json_array_append_new(statics_array, staticJson);
+        current = current->next;
+    }
+    
+    return statics_array;
+}
+
 char* websiteToJson(Arena *arena, const WebsiteNode* website) {
     if (!website) return NULL;
     
@@ -421,6 +442,9 @@ char* websiteToJson(Arena *arena, const WebsiteNode* website) {
     json_t* partials = partialsToJson(website->partialHead);
     if (partials) json_object_set_new(root, "partials", partials);
     
+    json_t* statics = staticsToJson(website->staticHead);
+    if (statics) json_object_set_new(root, "statics", statics);
+    
     char* json_str = json_dumps(root, JSON_INDENT(2));
     json_decref(root);
     
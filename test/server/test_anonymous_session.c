@@ -0,0 +1,66 @@
+#include "../../src/server/anonymous_session.h"
+#include "../../src/server/hmac.h"
+#include "../unity/unity.h"
+#include "../test_runners.h"
+#include <string.h>
+
+// Function prototype
+int run_server_anonymous_session_tests(void);
+
+static void test_hmac_sha256_rfc4231(void) {
+    // RFC 4231 test case 2
+    const char *key = "Jefe";
+    const char *data = "what do ya want for nothing?";
+    const uint8_t expected[SHA256_DIGEST_SIZE] = {
+        0x5b, 0xdc, 0xc1, 0x46, 0xbf, 0x60, 0x75, 0x4e, 0x6a, 0x04, 0x24, 0x26, 0x08, 0x95, 0x75, 0xc7,
+        0x5a, 0x00, 0x3f, 0x08, 0x9d, 0x27, 0x39, 0x83, 0x9d, 0xec, 0x58, 0xb9, 0x64, 0xec, 0x38, 0x43
+    };
+
+    uint8_t digest[SHA256_DIGEST_SIZE];
+    hmacSha256((const uint8_t *)key, strlen(key), (const uint8_t *)data, strlen(data), digest);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, digest, SHA256_DIGEST_SIZE);
+}
+
+static void test_anonymous_session_verifies_own_tokens(void) {
+    Arena *arena = createArena(1024);
+
+    char *token = createAnonymousSession(arena);
+    TEST_ASSERT_NOT_NULL(token);
+    TEST_ASSERT_EQUAL_size_t(64, strlen(token));
+    TEST_ASSERT_TRUE(verifyAnonymousSession(token));
+
+    char *other = createAnonymousSession(arena);
+    TEST_ASSERT_NOT_NULL(other);
+    TEST_ASSERT_NOT_EQUAL(0, strcmp(token, other));
+
+    freeArena(arena);
+}
+
+static void test_anonymous_session_rejects_forged_tokens(void) {
+    Arena *arena = createArena(1024);
+    char *token = createAnonymousSession(arena);
+    TEST_ASSERT_NOT_NULL(token);
+
+    // Any changed digit breaks the signature, including the expiry's
+    char forged[65];
+    memcpy(forged, token, sizeof(forged));
+    forged[26] = forged[26] == 'f' ? 'e' : 'f';
+    TEST_ASSERT_FALSE(verifyAnonymousSession(forged));
+
+    TEST_ASSERT_FALSE(verifyAnonymousSession(NULL));
+    TEST_ASSERT_FALSE(verifyAnonymousSession(""));
+    TEST_ASSERT_FALSE(verifyAnonymousSession("0123456789abcdef"));
+    // Unsigned tokens issued before signing was added
+    TEST_ASSERT_FALSE(verifyAnonymousSession(
+        "a3f1c2d4e5b6a7980123456789abcdefa3f1c2d4e5b6a7980123456789abcdef"));
+
+    freeArena(arena);
+}
+
+int run_server_anonymous_session_tests(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_hmac_sha256_rfc4231);
+    RUN_TEST(test_anonymous_session_verifies_own_tokens);
+    RUN_TEST(test_anonymous_session_rejects_forged_tokens);
+    return UNITY_END();
+}
@@ -0,0 +1,131 @@
+#include "../../src/server/artifact_cache.h"
+#include "../unity/unity.h"
+#include "../test_runners.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <unistd.h>
+
+// Function prototype
+int run_server_artifact_cache_tests(void);
+
+static char cacheDir[64];
+
+static void useTemporaryCache(void) {
+    snprintf(cacheDir, sizeof(cacheDir), "/tmp/webdsl-artifacts-XXXXXX");
+    TEST_ASSERT_NOT_NULL(mkdtemp(cacheDir));
+    setenv("WEBDSL_CACHE_DIR", cacheDir, 1);
+    initArtifactCache();
+}
+
+// Leave the cache off for the tests that follow, as it is when nothing
+// has called initArtifactCache
+static void disableCacheDir(void) {
+    setenv("WEBDSL_CACHE_DIR", "", 1);
+    initArtifactCache();
+    unsetenv("WEBDSL_CACHE_DIR");
+}
+
+static void removeTemporaryCache(void) {
+    char kindDir[128];
+    snprintf(kindDir, sizeof(kindDir), "%s/lua", cacheDir);
+    DIR *dir = opendir(kindDir);
+    if (dir) {
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != NULL) {
+            if (entry->d_name[0] == '.') continue;
+            char path[512];
+            snprintf(path, sizeof(path), "%s/%s", kindDir, entry->d_name);
+            unlink(path);
+        }
+        closedir(dir);
+        rmdir(kindDir);
+    }
+    rmdir(cacheDir);
+    disableCacheDir();
+}
+
+// Path of the only entry of kind lua
+static bool firstEntry(char *path, size_t size) {
+    char kindDir[128];
+    snprintf(kindDir, sizeof(kindDir), "%s/lua", cacheDir);
+    DIR *dir = opendir(kindDir);
+    if (!dir) return false;
+    struct dirent *entry;
+    bool found = false;
+    while (!found && (entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.') continue;
+        snprintf(path, size, "%s/%s", kindDir, entry->d_name);
+        found = true;
+    }
+    closedir(dir);
+    return found;
+}
+
+static void test_artifact_cache_round_trip(void) {
+    useTemporaryCache();
+    const char *code = "return 1";
+    const char bytecode[] = "\x1bLua compiled";
+
+    Artifact artifact;
+    TEST_ASSERT_FALSE(artifactCacheGet("lua", "5.4", code, strlen(code), &artifact));
+    artifactCachePut("lua", "5.4", code, strlen(code), bytecode, sizeof(bytecode));
+
+    TEST_ASSERT_TRUE(artifactCacheGet("lua", "5.4", code, strlen(code), &artifact));
+    TEST_ASSERT_EQUAL_size_t(sizeof(bytecode), artifact.size);
+    TEST_ASSERT_EQUAL_MEMORY(bytecode, artifact.data, sizeof(bytecode));
+    releaseArtifact(&artifact);
+
+    // Other inputs and other runtime versions have their own entries
+    TEST_ASSERT_FALSE(artifactCacheHas("lua", "5.4", "return 2", 8));
+    TEST_ASSERT_FALSE(artifactCacheHas("lua", "LuaJIT", code, strlen(code)));
+
+    ArtifactCacheStats stats;
+    artifactCacheStats(&stats);
+    TEST_ASSERT_EQUAL_UINT64(1, stats.hits);
+    TEST_ASSERT_EQUAL_UINT64(3, stats.misses);
+    TEST_ASSERT_EQUAL_UINT64(1, stats.writes);
+
+    removeTemporaryCache();
+}
+
+static void test_artifact_cache_drops_damaged_entries(void) {
+    useTemporaryCache();
+    const char *code = "return 1";
+    artifactCachePut("lua", "5.4", code, strlen(code), "bytecode", 8);
+
+    char path[512];
+    TEST_ASSERT_TRUE(firstEntry(path, sizeof(path)));
+    FILE *file = fopen(path, "r+b");
+    TEST_ASSERT_NOT_NULL(file);
+    fseek(file, -1, SEEK_END);
+    fputc('X', file);
+    fclose(file);
+
+    Artifact artifact;
+    TEST_ASSERT_FALSE(artifactCacheGet("lua", "5.4", code, strlen(code), &artifact));
+    TEST_ASSERT_FALSE(firstEntry(path, sizeof(path)));
+
+    ArtifactCacheStats stats;
+    artifactCacheStats(&stats);
+    TEST_ASSERT_EQUAL_UINT64(1, stats.errors);
+
+    removeTemporaryCache();
+}
+
+static void test_artifact_cache_off_with_empty_dir(void) {
+    disableCacheDir();
+    TEST_ASSERT_FALSE(artifactCacheEnabled());
+
+    artifactCachePut("lua", "5.4", "return 1", 8, "bytecode", 8);
+    TEST_ASSERT_FALSE(artifactCacheHas("lua", "5.4", "return 1", 8));
+}
+
+int run_server_artifact_cache_tests(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_artifact_cache_round_trip);
+    RUN_TEST(test_artifact_cache_drops_damaged_entries);
+    RUN_TEST(test_artifact_cache_off_with_empty_dir);
+    return UNITY_END();
+}
@@ -0,0 +1,218 @@
+#include "../../src/server/fetch_cache.h"
+#include "../../src/server/lua_fetch.h"
+#include "../unity/unity.h"
+#include "../test_runners.h"
+#include <microhttpd.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Function prototype
+int run_server_fetch_cache_tests(void);
+
+static void parseHeaders(FetchCacheHeaders *headers, const char **lines) {
+    fetchCacheResetHeaders(headers);
+    for (const char **line = lines; *line; line++) {
+        fetchCacheParseHeader(headers, *line, strlen(*line));
+    }
+}
+
+static void test_fetch_cache_parses_headers(void) {
+    const char *lines[] = {
+        "HTTP/1.1 200 OK\r\n",
+        "cache-control: public, max-age=60\r\n",
+        "ETag: \"v1\"\r\n",
+        "Last-Modified: Tue, 01 Sep 2026 10:00:00 GMT\r\n",
+        "\r\n",
+        NULL
+    };
+    FetchCacheHeaders headers;
+    parseHeaders(&headers, lines);
+
+    TEST_ASSERT_EQUAL_INT(60, headers.maxAge);
+    TEST_ASSERT_FALSE(headers.noStore);
+    TEST_ASSERT_EQUAL_STRING("\"v1\"", headers.etag);
+    TEST_ASSERT_EQUAL_STRING("Tue, 01 Sep 2026 10:00:00 GMT", headers.lastModified);
+
+    const char *noStore[] = { "HTTP/1.1 200 OK\r\n", "Cache-Control: no-store\r\n", NULL };
+    parseHeaders(&headers, noStore);
+    TEST_ASSERT_TRUE(headers.noStore);
+    TEST_ASSERT_EQUAL_INT(-1, headers.maxAge);
+}
+
+static void test_fetch_cache_fresh_and_stale(void) {
+    setenv("WEBDSL_FETCH_CACHE_SIZE", "1048576", 1);
+    initFetchCache();
+
+    FetchCacheHeaders headers;
+    const char *fresh[] = { "Cache-Control: max-age=60\r\n", NULL };
+    parseHeaders(&headers, fresh);
+    fetchCacheStore("https://example.test/config", "{\"a\":1}", 7, &headers, -1);
+
+    char *body = NULL;
+    size_t size = 0;
+    FetchCacheHeaders validators;
+    TEST_ASSERT_EQUAL_INT(FETCH_CACHE_FRESH,
+        fetchCacheLookup("https://example.test/config", &body, &size, &validators));
+    TEST_ASSERT_EQUAL_STRING("{\"a\":1}", body);
+    TEST_ASSERT_EQUAL_size_t(7, size);
+    free(body);
+
+    // Already expired, but revalidatable through its ETag
+    const char *tagged[] = { "Cache-Control: no-cache\r\n", "ETag: W/\"7\"\r\n", NULL };
+    parseHeaders(&headers, tagged);
+    fetchCacheStore("https://example.test/items", "[]", 2, &headers, -1);
+    TEST_ASSERT_EQUAL_INT(FETCH_CACHE_STALE,
+        fetchCacheLookup("https://example.test/items", &body, &size, &validators));
+    TEST_ASSERT_EQUAL_STRING("W/\"7\"", validators.etag);
+
+    const char *notModified[] = { "Cache-Control: max-age=30\r\n", NULL };
+    parseHeaders(&headers, notModified);
+    TEST_ASSERT_TRUE(fetchCacheRevalidated("https://example.test/items", &headers, -1, &body, &size));
+    TEST_ASSERT_EQUAL_STRING("[]", body);
+    free(body);
+    TEST_ASSERT_EQUAL_INT(FETCH_CACHE_FRESH,
+        fetchCacheLookup("https://example.test/items", &body, &size, &validators));
+    free(body);
+
+    // Nothing to revalidate with and no lifetime, so not stored
+    const char *uncacheable[] = { "Cache-Control: no-store\r\n", NULL };
+    parseHeaders(&headers, uncacheable);
+    fetchCacheStore("https://example.test/private", "x", 1, &headers, -1);
+    TEST_ASSERT_EQUAL_INT(FETCH_CACHE_MISS,
+        fetchCacheLookup("https://example.test/private", &body, &size, &validators));
+
+    // Unless the call gives its own ttl
+    fetchCacheStore("https://example.test/private", "x", 1, &headers, 60);
+    TEST_ASSERT_EQUAL_INT(FETCH_CACHE_FRESH,
+        fetchCacheLookup("https://example.test/private", &body, &size, &validators));
+    free(body);
+
+    cleanupFetchCache();
+    unsetenv("WEBDSL_FETCH_CACHE_SIZE");
+}
+
+static void test_fetch_cache_evicts_least_recent(void) {
+    // 16 shards of 4KB each
+    setenv("WEBDSL_FETCH_CACHE_SIZE", "65536", 1);
+    initFetchCache();
+
+    char payload[1024];
+    memset(payload, 'x', sizeof(payload));
+    FetchCacheHeaders headers;
+    fetchCacheResetHeaders(&headers);
+
+    char key[64];
+    for (int i = 0; i < 256; i++) {
+        snprintf(key, sizeof(key), "https://example.test/%d", i);
+        fetchCacheStore(key, payload, sizeof(payload), &headers, 60);
+    }
+
+    // Each shard holds at most a few entries, the most recent ones
+    int cached = 0;
+    char *body = NULL;
+    size_t size = 0;
+    FetchCacheHeaders validators;
+    for (int i = 0; i < 256; i++) {
+        snprintf(key, sizeof(key), "https://example.test/%d", i);
+        if (fetchCacheLookup(key, &body, &size, &validators) == FETCH_CACHE_FRESH) {
+            cached++;
+            free(body);
+        }
+    }
+    TEST_ASSERT_TRUE(cached > 0);
+    TEST_ASSERT_TRUE(cached <= 64);
+    TEST_ASSERT_EQUAL_INT(FETCH_CACHE_FRESH,
+        fetchCacheLookup("https://example.test/255", &body, &size, &validators));
+    free(body);
+
+    cleanupFetchCache();
+    unsetenv("WEBDSL_FETCH_CACHE_SIZE");
+}
+
+// =============================================================================
+// Stand-in Upstream
+// =============================================================================
+
+static _Atomic int unconditionalRequests = 0;
+static _Atomic int conditionalRequests = 0;
+
+// Answers a revalidation with 304 after dropping every cached entry, as if
+// the entry had been evicted while the request was in flight
+static enum MHD_Result evictingHandler(void *cls, struct MHD_Connection *connection,
+                                       const char *url, const char *method,
+                                       const char *version, const char *uploadData,
+                                       size_t *uploadDataSize, void **conCls) {
+    (void)cls; (void)url; (void)method; (void)version;
+    (void)uploadData; (void)uploadDataSize; (void)conCls;
+
+    bool conditional = MHD_lookup_connection_value(connection, MHD_HEADER_KIND,
+                                                   MHD_HTTP_HEADER_IF_NONE_MATCH) != NULL;
+    const char *body = conditional ? "" : (unconditionalRequests == 0 ? "first" : "second");
+    struct MHD_Response *response = MHD_create_response_from_buffer(
+        strlen(body), (void *)body, MHD_RESPMEM_PERSISTENT);
+    MHD_add_response_header(response, MHD_HTTP_HEADER_ETAG, "\"v1\"");
+    MHD_add_response_header(response, MHD_HTTP_HEADER_CACHE_CONTROL, "no-cache");
+
+    unsigned int status = MHD_HTTP_OK;
+    if (conditional) {
+        cleanupFetchCache();
+        initFetchCache();
+        conditionalRequests++;
+        status = MHD_HTTP_NOT_MODIFIED;
+    } else {
+        unconditionalRequests++;
+    }
+    enum MHD_Result ret = MHD_queue_response(connection, status, response);
+    MHD_destroy_response(response);
+    return ret;
+}
+
+static void test_fetch_cache_refetches_evicted_revalidation(void) {
+    setenv("WEBDSL_FETCH_CACHE_SIZE", "1048576", 1);
+    initLuaFetch();
+    struct MHD_Daemon *daemon = MHD_start_daemon(MHD_USE_INTERNAL_POLLING_THREAD, 0, NULL, NULL,
+                                                 evictingHandler, NULL, MHD_OPTION_END);
+    TEST_ASSERT_NOT_NULL(daemon);
+    char url[64];
+    snprintf(url, sizeof(url), "http://127.0.0.1:%u/config",
+             (unsigned)MHD_get_daemon_info(daemon, MHD_DAEMON_INFO_BIND_PORT)->port);
+
+    lua_State *L = luaL_newstate();
+    luaL_openlibs(L);
+    registerHttpFunctions(L);
+    lua_pushstring(L, url);
+    lua_setglobal(L, "url");
+
+    // The first fetch stores an entry that is stale at once; the second
+    // revalidates it, and the 304 arrives after the entry is gone
+    const char *script =
+        "local first = fetch(url)\n"
+        "local second, err = fetch(url)\n"
+        "assert(second, err)\n"
+        "return first.body, second.status, second.ok, second.body";
+    int loaded = luaL_dostring(L, script);
+    TEST_ASSERT_EQUAL_INT_MESSAGE(LUA_OK, loaded, lua_tostring(L, -1));
+
+    TEST_ASSERT_EQUAL_STRING("first", lua_tostring(L, -4));
+    TEST_ASSERT_EQUAL_INT(200, lua_tointeger(L, -3));
+    TEST_ASSERT_TRUE(lua_toboolean(L, -2));
+    TEST_ASSERT_EQUAL_STRING("second", lua_tostring(L, -1));
+    TEST_ASSERT_EQUAL_INT(1, conditionalRequests);
+    TEST_ASSERT_EQUAL_INT(2, unconditionalRequests);
+
+    lua_close(L);
+    MHD_stop_daemon(daemon);
+    cleanupLuaFetch();
+    unsetenv("WEBDSL_FETCH_CACHE_SIZE");
+}
+
+int run_server_fetch_cache_tests(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_fetch_cache_parses_headers);
+    RUN_TEST(test_fetch_cache_fresh_and_stale);
+    RUN_TEST(test_fetch_cache_evicts_least_recent);
+    RUN_TEST(test_fetch_cache_refetches_evicted_revalidation);
+    return UNITY_END();
+}
@@ -0,0 +1,311 @@
+#include "../../src/server/jq.h"
+#include "../../src/server/jq_native.h"
+#include "../../src/server/routing.h"
+#include "../../src/server/pipeline_executor.h"
+#include "../../src/parser.h"
+#include "../../src/ast.h"
+#include "../../src/arena.h"
+#include "../unity/unity.h"
+#include "../test_runners.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Function prototype
+int run_server_jq_tests(void);
+
+static const char *jqWebsite =
+    "website {\n"
+    "  transform {\n"
+    "    name \"pick\"\n"
+    "    jq { { id: .id } }\n"
+    "  }\n"
+    "  api {\n"
+    "    route \"/api/a\"\n"
+    "    method \"GET\"\n"
+    "    pipeline {\n"
+    "      jq { { a: .a } }\n"
+    "      executeTransform \"pick\"\n"
+    "    }\n"
+    "  }\n"
+    "  api {\n"
+    "    route \"/api/b\"\n"
+    "    method \"GET\"\n"
+    "    pipeline {\n"
+    "      jq { { a: .a } }\n"
+    "    }\n"
+    "  }\n"
+    "}";
+
+static const char *invalidJqWebsite =
+    "website {\n"
+    "  api {\n"
+    "    route \"/api/broken\"\n"
+    "    method \"GET\"\n"
+    "    pipeline {\n"
+    "      jq { { a: } }\n"
+    "    }\n"
+    "  }\n"
+    "}";
+
+static const char *constantJqWebsite =
+    "website {\n"
+    "  api {\n"
+    "    route \"/api/title\"\n"
+    "    method \"GET\"\n"
+    "    pipeline {\n"
+    "      jq { { pageTitle: \"HTMX Demo\" } }\n"
+    "      jq { { title: .pageTitle, tags: [\"a\", \"b\"] } }\n"
+    "      jq { .title }\n"
+    "    }\n"
+    "  }\n"
+    "  api {\n"
+    "    route \"/api/echo\"\n"
+    "    method \"GET\"\n"
+    "    pipeline {\n"
+    "      jq { { pageTitle: \"HTMX Demo\" } }\n"
+    "      jq { { title: .pageTitle } | length }\n"
+    "    }\n"
+    "  }\n"
+    "}";
+
+static const char *fusedJqWebsite =
+    "website {\n"
+    "  api {\n"
+    "    route \"/api/check\"\n"
+    "    method \"GET\"\n"
+    "    pipeline {\n"
+    "      jq { if .fail then { error: \"bad input\" } else . end }\n"
+    "      jq { { ran: .fail } }\n"
+    "      jq { { wrapped: .ran } }\n"
+    "    }\n"
+    "  }\n"
+    "}";
+
+static bool loadWebsite(const char *source, Parser *parser, ServerContext *ctx) {
+    initParser(parser, source);
+    WebsiteNode *website = parseProgram(parser);
+    TEST_ASSERT_EQUAL(0, parser->hadError);
+    buildRouteMaps(website, parser->arena);
+    memset(ctx, 0, sizeof(ServerContext));
+    ctx->website = website;
+    ctx->arena = parser->arena;
+    return initJq(ctx);
+}
+
+static void test_jq_compiles_filters_at_load(void) {
+    Parser parser;
+    ServerContext ctx;
+    TEST_ASSERT_TRUE(loadWebsite(jqWebsite, &parser, &ctx));
+
+    // The transform and the repeated step filter are compiled once each
+    JqCacheStats stats;
+    jqCacheStats(&stats);
+    TEST_ASSERT_EQUAL(2, stats.programs);
+
+    prewarmJqThread();
+    jqCacheStats(&stats);
+    TEST_ASSERT_EQUAL(2, stats.cachedStates);
+    uint64_t compiles = stats.compiles;
+
+    // Prewarmed filters are found without compiling again
+    TEST_ASSERT_NOT_NULL(findOrCreateJQ(ctx.website->apiHead->pipeline->code));
+    jqCacheStats(&stats);
+    TEST_ASSERT_EQUAL(compiles, stats.compiles);
+
+    cleanupJq();
+    freeArena(parser.arena);
+
+    TEST_ASSERT_FALSE(loadWebsite(invalidJqWebsite, &parser, &ctx));
+    cleanupJq();
+    freeArena(parser.arena);
+}
+
+static void test_jq_cache_evicts_least_recently_used(void) {
+    setenv("WEBDSL_JQ_CACHE_SIZE", "2", 1);
+    Parser parser;
+    ServerContext ctx;
+    TEST_ASSERT_TRUE(loadWebsite(jqWebsite, &parser, &ctx));
+
+    jq_state *first = findOrCreateJQ(".first");
+    TEST_ASSERT_NOT_NULL(findOrCreateJQ(".second"));
+    TEST_ASSERT_EQUAL_PTR(first, findOrCreateJQ(".first"));
+
+    // .second is now the least recently used
+    JqCacheStats before;
+    jqCacheStats(&before);
+    TEST_ASSERT_NOT_NULL(findOrCreateJQ(".third"));
+    TEST_ASSERT_EQUAL_PTR(first, findOrCreateJQ(".first"));
+
+    JqCacheStats after;
+    jqCacheStats(&after);
+    TEST_ASSERT_EQUAL(before.evictions + 1, after.evictions);
+    TEST_ASSERT_EQUAL(before.cachedStates, after.cachedStates);
+    TEST_ASSERT_EQUAL(before.compiles + 1, after.compiles);
+
+    cleanupJq();
+    freeArena(parser.arena);
+    unsetenv("WEBDSL_JQ_CACHE_SIZE");
+}
+
+static void test_jq_folds_constant_steps(void) {
+    Parser parser;
+    ServerContext ctx;
+    TEST_ASSERT_TRUE(loadWebsite(constantJqWebsite, &parser, &ctx));
+
+    // The constant step absorbs the two native steps after it
+    PipelineStepNode *title = ctx.website->apiHead->pipeline;
+    TEST_ASSERT_NOT_NULL(title->constant);
+    TEST_ASSERT_NULL(title->next);
+    TEST_ASSERT_EQUAL_STRING("HTMX Demo", json_string_value(title->constant));
+
+    // length is outside the native subset, so it still runs through libjq
+    PipelineStepNode *echo = ctx.website->apiHead->next->pipeline;
+    TEST_ASSERT_NOT_NULL(echo->constant);
+    TEST_ASSERT_NOT_NULL(echo->next);
+    TEST_ASSERT_NULL(echo->next->constant);
+
+    JqCacheStats stats;
+    jqCacheStats(&stats);
+    TEST_ASSERT_EQUAL(2, stats.constantSteps);
+    TEST_ASSERT_EQUAL(2, stats.fusedSteps);
+
+    json_t *request = json_object();
+    PipelineValue result = executePipelineValue(&ctx, echo, request, parser.arena);
+    json_t *json = pipelineValueJson(&result);
+    TEST_ASSERT_EQUAL(1, (int)json_number_value(json));
+
+    pipelineValueFree(&result);
+    json_decref(request);
+    cleanupJq();
+    freeArena(parser.arena);
+}
+
+static json_t* runFused(ServerContext *ctx, const char *input) {
+    json_t *request = json_loads(input, 0, NULL);
+    PipelineValue result = executePipelineValue(ctx, ctx->website->apiHead->pipeline, request, ctx->arena);
+    json_t *json = json_deep_copy(pipelineValueJson(&result));
+    pipelineValueFree(&result);
+    json_decref(request);
+    return json;
+}
+
+static void test_jq_fuses_consecutive_steps(void) {
+    Parser parser;
+    ServerContext ctx;
+    TEST_ASSERT_TRUE(loadWebsite(fusedJqWebsite, &parser, &ctx));
+
+    // Three steps become one program
+    TEST_ASSERT_NULL(ctx.website->apiHead->pipeline->next);
+    JqCacheStats stats;
+    jqCacheStats(&stats);
+    TEST_ASSERT_EQUAL(2, stats.mergedSteps);
+    TEST_ASSERT_EQUAL(1, stats.programs);
+
+    json_t *passed = runFused(&ctx, "{\"fail\":false}");
+    TEST_ASSERT_TRUE(json_is_false(json_object_get(passed, "wrapped")));
+
+    // An error still skips the steps after it
+    json_t *failed = runFused(&ctx, "{\"fail\":true}");
+    TEST_ASSERT_EQUAL_STRING("bad input", json_string_value(json_object_get(failed, "error")));
+    TEST_ASSERT_NULL(json_object_get(failed, "wrapped"));
+
+    json_decref(passed);
+    json_decref(failed);
+    cleanupJq();
+    freeArena(parser.arena);
+}
+
+static char* runNative(Arena *arena, const char *filter, const char *input) {
+    NativeJq *program = compileNativeJq(filter, arena);
+    TEST_ASSERT_NOT_NULL_MESSAGE(program, filter);
+    json_t *document = json_loads(input, 0, NULL);
+    json_t *result = evaluateNativeJq(program, document);
+    char *dumped = result ? json_dumps(result, JSON_COMPACT | JSON_SORT_KEYS | JSON_ENCODE_ANY) : NULL;
+    json_decref(result);
+    json_decref(document);
+    return dumped;
+}
+
+static void assertNative(Arena *arena, const char *filter, const char *input, const char *expected) {
+    char *output = runNative(arena, filter, input);
+    TEST_ASSERT_EQUAL_STRING_MESSAGE(expected, output, filter);
+    free(output);
+}
+
+static void test_jq_native_subset(void) {
+    Arena *arena = createArena(64 * 1024);
+    const char *rows = "{\"rows\":[{\"id\":1,\"name\":\"a\",\"active\":true},"
+                       "{\"id\":2,\"name\":\"b\",\"active\":false}]}";
+
+    assertNative(arena, ".rows[0].name", rows, "\"a\"");
+    assertNative(arena, ".rows[-1] | {id, label: .name}", rows, "{\"id\":2,\"label\":\"b\"}");
+    assertNative(arena, "{ data: (.rows | map(select(.active) | {id})) }", rows, "{\"data\":[{\"id\":1}]}");
+    assertNative(arena, "[.rows[] | .id]", rows, "[1,2]");
+    assertNative(arena, "[.rows[] | select(.id >= 2 and (.active | not)) | .name]", rows, "[\"b\"]");
+    assertNative(arena, "[.missing, .rows[5], \"x\\n\", -1.5, null == false]", rows, "[null,null,\"x\\n\",-1.5,false]");
+
+    // Outside the subset: libjq compiles these instead
+    TEST_ASSERT_NULL(compileNativeJq(".rows | length", arena));
+    TEST_ASSERT_NULL(compileNativeJq(".a // \"default\"", arena));
+    TEST_ASSERT_NULL(compileNativeJq(".a as $x | $x", arena));
+    TEST_ASSERT_NULL(compileNativeJq("\"id: \\(.id)\"", arena));
+    TEST_ASSERT_NULL(compileNativeJq(".a?", arena));
+    TEST_ASSERT_NULL(compileNativeJq("..", arena));
+
+    // Errors, no output and several outputs are left to libjq at runtime
+    TEST_ASSERT_NULL(runNative(arena, ".a.b", "{\"a\":5}"));
+    TEST_ASSERT_NULL(runNative(arena, "select(.a)", "{\"a\":false}"));
+    TEST_ASSERT_NULL(runNative(arena, ".a[]", "{\"a\":[1,2]}"));
+    TEST_ASSERT_NULL(runNative(arena, ".a == .b", "{\"a\":[1],\"b\":[1]}"));
+
+    freeArena(arena);
+}
+
+// The filter run by libjq and converted back the way pipeline steps are
+static char* runLibjq(const char *filter, const char *input) {
+    jq_state *jq = jq_init();
+    TEST_ASSERT_TRUE_MESSAGE(jq_compile(jq, filter), filter);
+    json_t *document = json_loads(input, 0, NULL);
+    jq_start(jq, janssonToJv(document), 0);
+    json_t *result = jvToJansson(jq_next(jq));
+    char *dumped = result ? json_dumps(result, JSON_COMPACT | JSON_SORT_KEYS | JSON_ENCODE_ANY) : NULL;
+    json_decref(result);
+    json_decref(document);
+    jq_teardown(&jq);
+    return dumped;
+}
+
+static void assertSameOutput(Arena *arena, const char *filter, const char *input) {
+    char *native = runNative(arena, filter, input);
+    char *libjq = runLibjq(filter, input);
+    TEST_ASSERT_EQUAL_STRING_MESSAGE(libjq, native, filter);
+    free(native);
+    free(libjq);
+}
+
+static void test_jq_native_and_libjq_agree_on_numbers(void) {
+    Arena *arena = createArena(64 * 1024);
+
+    // Whether a step takes the native path must not change its output
+    assertSameOutput(arena, "{ page: 1 }", "{}");
+    assertSameOutput(arena, "{ page: .page, ratio: .ratio }", "{\"page\":2.0,\"ratio\":2.5}");
+    assertSameOutput(arena, ".rows", "{\"rows\":[{\"n\":3.0},{\"n\":-0.5},{\"n\":7}]}");
+    assertSameOutput(arena, "[.a, 1.0, 1e3]", "{\"a\":1e20}");
+
+    char *computed = runLibjq("{ page: (1 + 0) }", "{}");
+    TEST_ASSERT_EQUAL_STRING("{\"page\":1}", computed);
+    free(computed);
+
+    freeArena(arena);
+}
+
+int run_server_jq_tests(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_jq_compiles_filters_at_load);
+    RUN_TEST(test_jq_cache_evicts_least_recently_used);
+    RUN_TEST(test_jq_native_subset);
+    RUN_TEST(test_jq_native_and_libjq_agree_on_numbers);
+    RUN_TEST(test_jq_folds_constant_steps);
+    RUN_TEST(test_jq_fuses_consecutive_steps);
+    return UNITY_END();
+}
@@ -0,0 +1,110 @@
+#include "../../src/server/linker.h"
+#include "../../src/server/jq.h"
+#include "../../src/server/routing.h"
+#include "../../src/parser.h"
+#include "../../src/ast.h"
+#include "../../src/arena.h"
+#include "../unity/unity.h"
+#include "../test_runners.h"
+#include <string.h>
+
+// Function prototype
+int run_server_linker_tests(void);
+
+static const char *linkedWebsite =
+    "website {\n"
+    "  query {\n"
+    "    name \"teams\"\n"
+    "    sql { SELECT * FROM teams }\n"
+    "  }\n"
+    "  transform {\n"
+    "    name \"count\"\n"
+    "    jq { .rows | length }\n"
+    "  }\n"
+    "  layout {\n"
+    "    name \"main\"\n"
+    "    mustache { <main><!-- content --></main> }\n"
+    "  }\n"
+    "  page {\n"
+    "    name \"teams\"\n"
+    "    route \"/teams\"\n"
+    "    layout \"main\"\n"
+    "    pipeline {\n"
+    "      executeQuery \"teams\"\n"
+    "      executeTransform \"count\"\n"
+    "    }\n"
+    "    mustache { <p>{{.}}</p> }\n"
+    "  }\n"
+    "  page {\n"
+    "    name \"bare\"\n"
+    "    route \"/bare\"\n"
+    "    layout \"none\"\n"
+    "    mustache { <p>bare</p> }\n"
+    "  }\n"
+    "}";
+
+static const char *missingQueryWebsite =
+    "website {\n"
+    "  api {\n"
+    "    route \"/api/teams\"\n"
+    "    method \"GET\"\n"
+    "    pipeline {\n"
+    "      executeQuery \"missing\"\n"
+    "    }\n"
+    "  }\n"
+    "}";
+
+static bool linkSource(const char *source, Parser *parser, ServerContext *ctx) {
+    initParser(parser, source);
+    WebsiteNode *website = parseProgram(parser);
+    TEST_ASSERT_EQUAL(0, parser->hadError);
+    buildRouteMaps(website, parser->arena);
+    memset(ctx, 0, sizeof(ServerContext));
+    ctx->website = website;
+    ctx->arena = parser->arena;
+    TEST_ASSERT_TRUE(initJq(ctx));
+    return linkWebsite(ctx);
+}
+
+static void test_linker_resolves_names(void) {
+    Parser parser;
+    ServerContext ctx;
+    TEST_ASSERT_TRUE(linkSource(linkedWebsite, &parser, &ctx));
+
+    PageNode *bare = ctx.website->pageHead;
+    PageNode *teams = bare->next;
+    if (strcmp(teams->route, "/teams") != 0) {
+        PageNode *swap = teams;
+        teams = bare;
+        bare = swap;
+    }
+
+    PipelineStepNode *query = teams->pipeline;
+    TEST_ASSERT_EQUAL_PTR(ctx.website->queryHead->sql, query->resolvedCode);
+
+    PipelineStepNode *transform = query->next;
+    TEST_ASSERT_EQUAL_PTR(ctx.website->transformHead->code, transform->resolvedCode);
+    TEST_ASSERT_NOT_EQUAL(0, transform->jqProgram);
+    TEST_ASSERT_NOT_NULL(jqStateForProgram(transform->jqProgram));
+
+    TEST_ASSERT_EQUAL_PTR(ctx.website->layoutHead, teams->resolvedLayout);
+    TEST_ASSERT_NULL(bare->resolvedLayout);
+
+    cleanupJq();
+    freeArena(parser.arena);
+}
+
+static void test_linker_rejects_missing_names(void) {
+    Parser parser;
+    ServerContext ctx;
+    TEST_ASSERT_FALSE(linkSource(missingQueryWebsite, &parser, &ctx));
+    cleanupJq();
+    freeArena(parser.arena);
+}
+
+int run_server_linker_tests(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_linker_resolves_names);
+    RUN_TEST(test_linker_rejects_missing_names);
+    return UNITY_END();
+}
@@ -0,0 +1,59 @@
+#include "../../src/server/logger.h"
+#include "../unity/unity.h"
+#include "../test_runners.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+// Function prototype
+int run_server_logger_tests(void);
+
+static void test_logger_writes_json_lines(void) {
+    char path[] = "/tmp/webdsl_logger_XXXXXX";
+    int fd = mkstemp(path);
+    TEST_ASSERT_TRUE(fd >= 0);
+
+    // Capture stderr, which the writer thread drains into
+    fflush(stderr);
+    int savedStderr = dup(STDERR_FILENO);
+    dup2(fd, STDERR_FILENO);
+
+    initLogger();
+    logError("Failed to prepare statement: %s\n", "bad \"quote\"");
+    logInfo("ready");
+    cleanupLogger();
+
+    fflush(stderr);
+    dup2(savedStderr, STDERR_FILENO);
+    close(savedStderr);
+
+    char output[4096] = {0};
+    lseek(fd, 0, SEEK_SET);
+    ssize_t length = read(fd, output, sizeof(output) - 1);
+    close(fd);
+    unlink(path);
+
+    TEST_ASSERT_TRUE(length > 0);
+    TEST_ASSERT_NOT_NULL(strstr(output,
+        "\"level\":\"error\",\"msg\":\"Failed to prepare statement: bad \\\"quote\\\"\"}\n"));
+    TEST_ASSERT_NOT_NULL(strstr(output, "\"level\":\"info\",\"msg\":\"ready\"}\n"));
+    TEST_ASSERT_EQUAL(0, loggerDroppedTotal());
+}
+
+static void test_logger_sampling(void) {
+    TEST_ASSERT_FALSE(loggerSample(0.0));
+    TEST_ASSERT_TRUE(loggerSample(1.0));
+
+    int sampled = 0;
+    for (int i = 0; i < 10000; i++) {
+        if (loggerSample(0.5)) sampled++;
+    }
+    TEST_ASSERT_INT_WITHIN(500, 5000, sampled);
+}
+
+int run_server_logger_tests(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_logger_writes_json_lines);
+    RUN_TEST(test_logger_sampling);
+    return UNITY_END();
+}
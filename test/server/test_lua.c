@@ -0,0 +1,131 @@
+#include "../../src/server/lua.h"
+#include "../unity/unity.h"
+#include "../test_runners.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Function prototype
+int run_server_lua_tests(void);
+
+static WebsiteNode website;
+static ServerContext serverCtx;
+static Arena *stepArena = NULL;
+
+// Start the Lua subsystem with a memory limit in bytes, 0 for the default
+static void startLua(size_t memoryLimit) {
+    char limit[32];
+    snprintf(limit, sizeof(limit), "%zu", memoryLimit);
+    if (memoryLimit) setenv("WEBDSL_LUA_MEMORY_LIMIT", limit, 1);
+    memset(&website, 0, sizeof(WebsiteNode));
+    memset(&serverCtx, 0, sizeof(ServerContext));
+    serverCtx.website = &website;
+    stepArena = createArena(64 * 1024);
+    TEST_ASSERT_TRUE(initLua(&serverCtx));
+}
+
+static void stopLua(void) {
+    cleanupLua();
+    freeArena(stepArena);
+    stepArena = NULL;
+    unsetenv("WEBDSL_LUA_MEMORY_LIMIT");
+}
+
+static json_t* runStep(const char *code, uint32_t budget, json_t *input, json_t *requestContext) {
+    PipelineStepNode step;
+    memset(&step, 0, sizeof(PipelineStepNode));
+    step.type = STEP_LUA;
+    step.code = (char *)code;
+    step.luaBudget = budget;
+    TEST_ASSERT_NOT_NULL(compileLuaBytecode(code));
+    return executeLuaStep(&step, input, requestContext, stepArena, &serverCtx);
+}
+
+static void assertStepError(json_t *result, const char *expected) {
+    const char *error = json_string_value(json_object_get(result, "error"));
+    TEST_ASSERT_NOT_NULL_MESSAGE(error, "Expected the step to fail");
+    TEST_ASSERT_NOT_NULL_MESSAGE(strstr(error, expected), error);
+}
+
+static void test_lua_budget_stops_runaway_loop(void) {
+    startLua(0);
+
+    json_t *result = runStep("while true do end", 10000, NULL, NULL);
+    assertStepError(result, "exceeded its budget of 10000 instructions");
+    json_decref(result);
+
+    // A step within its budget is unaffected
+    result = runStep("local n = 0 for i = 1, 100 do n = n + i end return { n = n }", 10000, NULL, NULL);
+    TEST_ASSERT_NULL(json_object_get(result, "error"));
+    TEST_ASSERT_EQUAL_INT(5050, json_integer_value(json_object_get(result, "n")));
+    json_decref(result);
+
+    stopLua();
+}
+
+static void test_lua_memory_limit_fails_the_step(void) {
+    startLua(4 * 1024 * 1024);
+
+    json_t *result = runStep("local s = string.rep('x', 16 * 1024 * 1024) return { n = #s }", 0, NULL, NULL);
+    assertStepError(result, "exceeded its memory limit of 4194304 bytes");
+    json_decref(result);
+
+    // The next step gets a fresh state
+    result = runStep("return { ok = true }", 0, NULL, NULL);
+    TEST_ASSERT_NULL(json_object_get(result, "error"));
+    TEST_ASSERT_TRUE(json_is_true(json_object_get(result, "ok")));
+    json_decref(result);
+
+    stopLua();
+}
+
+static void test_lua_memory_limit_below_setup(void) {
+    // Less than the libraries and globals take, which must fail the step
+    // rather than abort the server from an unprotected allocation
+    startLua(1024);
+
+    json_t *result = runStep("return { ok = true }", 0, NULL, NULL);
+    assertStepError(result, "exceeded its memory limit of 1024 bytes");
+    json_decref(result);
+
+    stopLua();
+}
+
+static void test_lua_globals_come_from_request_context(void) {
+    startLua(0);
+
+    json_t *input = json_pack("{s:s, s:{s:s}}", "step", "previous", "query", "team_id", "stale");
+    json_t *requestContext = json_pack("{s:{s:s}, s:{s:s}, s:{s:s}, s:{s:s}, s:{s:s}, s:{}}",
+        "query", "team_id", "3", "body", "name", "ada", "headers", "Accept", "application/json",
+        "cookies", "theme", "dark", "params", "id", "42", "files");
+
+    json_t *result = runStep(
+        "local fileCount = 0\n"
+        "for _ in pairs(files) do fileCount = fileCount + 1 end\n"
+        "return { previous = request.step, team = query.team_id, name = body.name,\n"
+        "         accept = headers.Accept, theme = cookies.theme, id = params.id,\n"
+        "         files = fileCount }", 0, input, requestContext);
+    TEST_ASSERT_NULL_MESSAGE(json_object_get(result, "error"),
+                             json_string_value(json_object_get(result, "error")));
+    TEST_ASSERT_EQUAL_STRING("previous", json_string_value(json_object_get(result, "previous")));
+    TEST_ASSERT_EQUAL_STRING("3", json_string_value(json_object_get(result, "team")));
+    TEST_ASSERT_EQUAL_STRING("ada", json_string_value(json_object_get(result, "name")));
+    TEST_ASSERT_EQUAL_STRING("application/json", json_string_value(json_object_get(result, "accept")));
+    TEST_ASSERT_EQUAL_STRING("dark", json_string_value(json_object_get(result, "theme")));
+    TEST_ASSERT_EQUAL_STRING("42", json_string_value(json_object_get(result, "id")));
+    TEST_ASSERT_EQUAL_INT(0, json_integer_value(json_object_get(result, "files")));
+
+    json_decref(result);
+    json_decref(requestContext);
+    json_decref(input);
+    stopLua();
+}
+
+int run_server_lua_tests(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_lua_budget_stops_runaway_loop);
+    RUN_TEST(test_lua_memory_limit_fails_the_step);
+    RUN_TEST(test_lua_memory_limit_below_setup);
+    RUN_TEST(test_lua_globals_come_from_request_context);
+    return UNITY_END();
+}
@@ -0,0 +1,173 @@
+#include "../../src/server/lua_fetch.h"
+#include "../../src/server/http_client.h"
+#include "../unity/unity.h"
+#include "../test_runners.h"
+#include <microhttpd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Function prototype
+int run_server_lua_fetch_tests(void);
+
+#define SLOW_RESPONSE_US 1000000
+
+static struct MHD_Daemon *upstream = NULL;
+static char baseUrl[64];
+
+// =============================================================================
+// Stand-in Upstream
+// =============================================================================
+
+// Answers each request with its path as the body, /slow after a second
+static enum MHD_Result echoHandler(void *cls, struct MHD_Connection *connection,
+                                   const char *url, const char *method,
+                                   const char *version, const char *uploadData,
+                                   size_t *uploadDataSize, void **conCls) {
+    (void)cls; (void)method; (void)version;
+    (void)uploadData; (void)uploadDataSize; (void)conCls;
+
+    if (strcmp(url, "/slow") == 0) usleep(SLOW_RESPONSE_US);
+
+    struct MHD_Response *response = MHD_create_response_from_buffer(
+        strlen(url), (void *)url, MHD_RESPMEM_MUST_COPY);
+    enum MHD_Result ret = MHD_queue_response(connection, MHD_HTTP_OK, response);
+    MHD_destroy_response(response);
+    return ret;
+}
+
+static lua_State* startFetch(void) {
+    initLuaFetch();
+    upstream = MHD_start_daemon(MHD_USE_INTERNAL_POLLING_THREAD, 0, NULL, NULL,
+                                echoHandler, NULL, MHD_OPTION_END);
+    TEST_ASSERT_NOT_NULL(upstream);
+    snprintf(baseUrl, sizeof(baseUrl), "http://127.0.0.1:%u",
+             (unsigned)MHD_get_daemon_info(upstream, MHD_DAEMON_INFO_BIND_PORT)->port);
+
+    lua_State *L = luaL_newstate();
+    luaL_openlibs(L);
+    registerHttpFunctions(L);
+    lua_pushstring(L, baseUrl);
+    lua_setglobal(L, "url");
+    return L;
+}
+
+static void stopFetch(lua_State *L) {
+    lua_close(L);
+    MHD_stop_daemon(upstream);
+    upstream = NULL;
+    cleanupLuaFetch();
+}
+
+static void runScript(lua_State *L, const char *script) {
+    int loaded = luaL_dostring(L, script);
+    TEST_ASSERT_EQUAL_INT_MESSAGE(LUA_OK, loaded, lua_tostring(L, -1));
+}
+
+// =============================================================================
+// Tests
+// =============================================================================
+
+static void test_lua_fetch_all_keeps_order(void) {
+    lua_State *L = startFetch();
+
+    runScript(L,
+        "local urls = {}\n"
+        "for i = 1, 20 do urls[i] = url .. '/' .. i end\n"
+        "local responses = fetchAll(urls)\n"
+        "assert(#responses == 20, 'got ' .. #responses .. ' responses')\n"
+        "for i, response in ipairs(responses) do\n"
+        "  assert(response.ok and response.status == 200, 'request ' .. i .. ' failed')\n"
+        "  assert(response.body == '/' .. i, 'request ' .. i .. ' got ' .. response.body)\n"
+        "end\n"
+        "assert(#fetchAll({}) == 0)");
+
+    stopFetch(L);
+}
+
+static void test_lua_fetch_all_failure_placeholder(void) {
+    lua_State *L = startFetch();
+
+    // Nothing listens on port 1, and the second and fourth entries are
+    // rejected before any transfer starts
+    runScript(L,
+        "local responses = fetchAll({ url .. '/first', { method = 'GET' },\n"
+        "                             'http://127.0.0.1:1/', 42, { url = url .. '/last' } })\n"
+        "assert(#responses == 5)\n"
+        "assert(responses[1].ok and responses[1].body == '/first')\n"
+        "for _, i in ipairs({ 2, 3, 4 }) do\n"
+        "  local response = responses[i]\n"
+        "  assert(response.ok == false, 'request ' .. i .. ' is ok')\n"
+        "  assert(response.status == 0, 'request ' .. i .. ' has status ' .. response.status)\n"
+        "  assert(type(response.error) == 'string', 'request ' .. i .. ' has no error')\n"
+        "end\n"
+        "assert(responses[2].error == 'Request has no url', responses[2].error)\n"
+        "assert(responses[4].error == 'Expected a url or options table', responses[4].error)\n"
+        "assert(responses[5].ok and responses[5].body == '/last')");
+
+    stopFetch(L);
+}
+
+static void test_lua_fetch_all_batch_limit(void) {
+    lua_State *L = startFetch();
+
+    // Rejected before anything is fetched, so the urls need not be served
+    runScript(L,
+        "local urls = {}\n"
+        "for i = 1, 257 do urls[i] = 'http://127.0.0.1:1/' .. i end\n"
+        "local ok, err = pcall(fetchAll, urls)\n"
+        "assert(not ok)\n"
+        "assert(string.find(err, 'too many requests', 1, true), err)");
+
+    stopFetch(L);
+}
+
+static void test_lua_fetch_timeout_option(void) {
+    lua_State *L = startFetch();
+
+    runScript(L,
+        "local response, err = fetch(url .. '/slow', { timeout = 50 })\n"
+        "assert(response == nil)\n"
+        "assert(string.find(err, 'Timeout', 1, true), err)\n"
+        "local responses = fetchAll({ { url = url .. '/slow', timeout = 50 } })\n"
+        "assert(responses[1].ok == false and responses[1].status == 0)\n"
+        "assert(string.find(responses[1].error, 'Timeout', 1, true), responses[1].error)");
+
+    stopFetch(L);
+}
+
+static void test_lua_fetch_all_error_releases_handles(void) {
+    lua_State *L = startFetch();
+
+    // The first request takes this handle from the pool
+    CURL *handle = acquireHttpHandle();
+    TEST_ASSERT_NOT_NULL(handle);
+    releaseHttpHandle(handle);
+
+    // Reading the second request's options raises after the first has its
+    // handle, leaving the batch to be collected
+    runScript(L,
+        "local failing = setmetatable({ url = url .. '/2' },\n"
+        "                             { __index = function() error('options failed') end })\n"
+        "local ok, err = pcall(fetchAll, { url .. '/1', failing })\n"
+        "assert(not ok)\n"
+        "assert(string.find(err, 'options failed', 1, true), err)\n"
+        "collectgarbage()");
+
+    CURL *reused = acquireHttpHandle();
+    TEST_ASSERT_TRUE_MESSAGE(reused == handle, "The batch's handle wasn't returned to the pool");
+    releaseHttpHandle(reused);
+
+    stopFetch(L);
+}
+
+int run_server_lua_fetch_tests(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_lua_fetch_all_keeps_order);
+    RUN_TEST(test_lua_fetch_all_failure_placeholder);
+    RUN_TEST(test_lua_fetch_all_batch_limit);
+    RUN_TEST(test_lua_fetch_timeout_option);
+    RUN_TEST(test_lua_fetch_all_error_releases_handles);
+    return UNITY_END();
+}
@@ -0,0 +1,104 @@
+#include "../../src/server/lua_json.h"
+#include "../unity/unity.h"
+#include "../test_runners.h"
+#include <lauxlib.h>
+#include <lualib.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Function prototype
+int run_server_lua_json_tests(void);
+
+// Run script with json as the request global, returning its result as JSON
+static json_t* runScript(json_t *json, const char *script, bool *shared) {
+    lua_State *L = luaL_newstate();
+    luaL_openlibs(L);
+    registerJsonFunctions(L);
+    pushJsonToLua(L, json);
+    lua_setglobal(L, "request");
+
+    json_t *result = NULL;
+    if (luaL_dostring(L, script) == LUA_OK) {
+        result = luaToJson(L, -1);
+        if (shared) *shared = luaJsonIsShared(L, -1);
+    } else {
+        TEST_FAIL_MESSAGE(lua_tostring(L, -1));
+    }
+    lua_close(L);
+    return result;
+}
+
+static void test_lua_json_reads_through_proxy(void) {
+    json_t *request = json_loads("{\"user\":{\"name\":\"ada\",\"tags\":[\"a\",\"b\",\"c\"]},\"n\":3}", 0, NULL);
+
+    json_t *result = runScript(request,
+        "local keys = 0\n"
+        "for _ in pairs(request.user) do keys = keys + 1 end\n"
+        "return { name = request.user.name, count = #request.user.tags,\n"
+        "         second = request.user.tags[2], n = request.n, keys = keys,\n"
+        "         missing = request.user.tags[4] == nil }", NULL);
+
+    TEST_ASSERT_EQUAL_STRING("ada", json_string_value(json_object_get(result, "name")));
+    TEST_ASSERT_EQUAL_INT(3, json_integer_value(json_object_get(result, "count")));
+    TEST_ASSERT_EQUAL_STRING("b", json_string_value(json_object_get(result, "second")));
+    TEST_ASSERT_EQUAL_INT(3, json_integer_value(json_object_get(result, "n")));
+    TEST_ASSERT_EQUAL_INT(2, json_integer_value(json_object_get(result, "keys")));
+    TEST_ASSERT_TRUE(json_is_true(json_object_get(result, "missing")));
+
+    json_decref(result);
+    json_decref(request);
+}
+
+static void test_lua_json_copies_on_write(void) {
+    json_t *request = json_loads("{\"user\":{\"name\":\"ada\"},\"rows\":[1,2],\"drop\":true}", 0, NULL);
+    json_t *rows = json_object_get(request, "rows");
+
+    // Untouched values come back as the original json
+    bool shared = false;
+    json_t *result = runScript(request, "return request", &shared);
+    TEST_ASSERT_TRUE(shared);
+    TEST_ASSERT_EQUAL_PTR(request, result);
+    json_decref(result);
+
+    result = runScript(request,
+        "request.user.role = 'admin'\n"
+        "request.drop = nil\n"
+        "return request", &shared);
+    TEST_ASSERT_FALSE(shared);
+    TEST_ASSERT_NOT_EQUAL(request, result);
+    TEST_ASSERT_EQUAL_STRING("admin", json_string_value(json_object_get(json_object_get(result, "user"), "role")));
+    TEST_ASSERT_NULL(json_object_get(result, "drop"));
+    TEST_ASSERT_EQUAL_PTR(rows, json_object_get(result, "rows"));
+
+    // The source is left as it was
+    TEST_ASSERT_NULL(json_object_get(json_object_get(request, "user"), "role"));
+    TEST_ASSERT_TRUE(json_is_true(json_object_get(request, "drop")));
+
+    json_decref(result);
+    json_decref(request);
+}
+
+static void test_lua_json_array_writes(void) {
+    json_t *request = json_loads("{\"rows\":[1,2,3]}", 0, NULL);
+
+    json_t *result = runScript(request,
+        "local rows = request.rows\n"
+        "rows[#rows + 1] = 4\n"
+        "rows[1] = 0\n"
+        "return rows", NULL);
+
+    char *dumped = json_dumps(result, JSON_COMPACT);
+    TEST_ASSERT_EQUAL_STRING("[0,2,3,4]", dumped);
+    free(dumped);
+
+    json_decref(result);
+    json_decref(request);
+}
+
+int run_server_lua_json_tests(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_lua_json_reads_through_proxy);
+    RUN_TEST(test_lua_json_copies_on_write);
+    RUN_TEST(test_lua_json_array_writes);
+    return UNITY_END();
+}
@@ -0,0 +1,149 @@
+#include "../../src/server/metrics.h"
+#include "../../src/server/routing.h"
+#include "../../src/parser.h"
+#include "../../src/ast.h"
+#include "../../src/arena.h"
+#include "../unity/unity.h"
+#include "../test_runners.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Function prototype
+int run_server_metrics_tests(void);
+
+static const char *metricsWebsite =
+    "website {\n"
+    "  page {\n"
+    "    name \"home\"\n"
+    "    route \"/\"\n"
+    "    html { <p>Home</p> }\n"
+    "  }\n"
+    "  api {\n"
+    "    route \"/api/v1/items\"\n"
+    "    method \"GET\"\n"
+    "    pipeline {\n"
+    "      jq { { items: [] } }\n"
+    "    }\n"
+    "  }\n"
+    "}";
+
+static void test_metrics_route_histograms(void) {
+    Parser parser;
+    initParser(&parser, metricsWebsite);
+    WebsiteNode *website = parseProgram(&parser);
+    TEST_ASSERT_EQUAL(0, parser.hadError);
+
+    ServerContext ctx = {0};
+    ctx.website = website;
+    ctx.arena = parser.arena;
+    initMetrics(&ctx);
+
+    RouteMatch match = {0};
+    match.type = ROUTE_TYPE_API;
+    match.endpoint.api = website->apiHead;
+    int routeId = metricsRouteId(&match);
+    TEST_ASSERT_TRUE(routeId > METRICS_ROUTE_INTERNAL);
+
+    match.type = ROUTE_TYPE_NONE;
+    TEST_ASSERT_EQUAL(METRICS_ROUTE_UNMATCHED, metricsRouteId(&match));
+
+    // 99 fast requests and one slow one
+    for (int i = 0; i < 99; i++) {
+        metricsRecordRequest(routeId, 200000);  // 200us
+    }
+    metricsRecordRequest(routeId, 2000000000);  // 2s
+    metricsRecordStep(STEP_JQ, 5000);
+    metricsCacheHit(METRICS_CACHE_JQ);
+    metricsCacheMiss(METRICS_CACHE_JQ);
+    Arena *requestArena = createArena(8192);
+    arenaAlloc(requestArena, 4000);
+    arenaAlloc(requestArena, 96);
+    metricsRecordArena(routeId, requestArena);
+    freeArena(requestArena);
+
+    Arena *arena = createArena(1024 * 1024);
+    char *text = generateMetrics(arena);
+    TEST_ASSERT_NOT_NULL(text);
+
+    TEST_ASSERT_NOT_NULL(strstr(text,
+        "webdsl_request_duration_seconds_count{route=\"/api/v1/items\",method=\"GET\"} 100"));
+    TEST_ASSERT_NOT_NULL(strstr(text,
+        "webdsl_request_duration_seconds_bucket{route=\"/api/v1/items\",method=\"GET\",le=\"0.00025\"} 99"));
+    TEST_ASSERT_NOT_NULL(strstr(text,
+        "webdsl_request_duration_seconds_bucket{route=\"/api/v1/items\",method=\"GET\",le=\"+Inf\"} 100"));
+    TEST_ASSERT_NOT_NULL(strstr(text, "webdsl_step_duration_seconds_count{type=\"jq\"} 1"));
+    TEST_ASSERT_NOT_NULL(strstr(text, "webdsl_cache_hit_ratio{cache=\"jq\"} 0.500000"));
+    TEST_ASSERT_NOT_NULL(strstr(text, "webdsl_arena_high_water_bytes 4096"));
+    TEST_ASSERT_NOT_NULL(strstr(text,
+        "webdsl_request_arena_allocations_total{route=\"/api/v1/items\",method=\"GET\"} 2"));
+    TEST_ASSERT_NOT_NULL(strstr(text,
+        "webdsl_request_arena_bytes_total{route=\"/api/v1/items\",method=\"GET\"} 4096"));
+
+    // Routes without traffic are omitted
+    TEST_ASSERT_NULL(strstr(text, "route=\"/\""));
+
+    freeArena(arena);
+    cleanupMetrics();
+    freeArena(parser.arena);
+}
+
+static void test_metrics_reset_on_reinit(void) {
+    Parser parser;
+    initParser(&parser, metricsWebsite);
+    WebsiteNode *website = parseProgram(&parser);
+
+    ServerContext ctx = {0};
+    ctx.website = website;
+    initMetrics(&ctx);
+    metricsRecordRequest(METRICS_ROUTE_STATIC, 1000);
+    cleanupMetrics();
+
+    // Recording after cleanup must be a no-op rather than touch freed shards
+    metricsRecordRequest(METRICS_ROUTE_STATIC, 1000);
+
+    initMetrics(&ctx);
+    Arena *arena = createArena(1024 * 1024);
+    char *text = generateMetrics(arena);
+    TEST_ASSERT_NOT_NULL(text);
+    TEST_ASSERT_NULL(strstr(text, "route=\"static\""));
+
+    freeArena(arena);
+    cleanupMetrics();
+    freeArena(parser.arena);
+}
+
+static void test_metrics_path_setting(void) {
+    Parser parser;
+    initParser(&parser, metricsWebsite);
+    WebsiteNode *website = parseProgram(&parser);
+
+    ServerContext ctx = {0};
+    ctx.website = website;
+    initMetrics(&ctx);
+    TEST_ASSERT_TRUE(isMetricsPath("/metrics"));
+    cleanupMetrics();
+
+    setenv("WEBDSL_METRICS_PATH", "/internal/metrics", 1);
+    initMetrics(&ctx);
+    TEST_ASSERT_TRUE(isMetricsPath("/internal/metrics"));
+    TEST_ASSERT_FALSE(isMetricsPath("/metrics"));
+    cleanupMetrics();
+
+    // Empty turns the endpoint off
+    setenv("WEBDSL_METRICS_PATH", "", 1);
+    initMetrics(&ctx);
+    TEST_ASSERT_FALSE(isMetricsPath("/metrics"));
+    TEST_ASSERT_FALSE(isMetricsPath(""));
+    cleanupMetrics();
+
+    unsetenv("WEBDSL_METRICS_PATH");
+    freeArena(parser.arena);
+}
+
+int run_server_metrics_tests(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_metrics_route_histograms);
+    RUN_TEST(test_metrics_reset_on_reinit);
+    RUN_TEST(test_metrics_path_setting);
+    return UNITY_END();
+}
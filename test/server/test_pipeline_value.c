@@ -0,0 +1,79 @@
+#include "../../src/server/pipeline_executor.h"
+#include "../../src/server/pipeline_value.h"
+#include "../../src/server/server.h"
+#include "../../src/server/jq.h"
+#include "../../src/ast.h"
+#include "../../src/arena.h"
+#include "../unity/unity.h"
+#include "../test_runners.h"
+#include <string.h>
+
+// Function prototype
+int run_server_pipeline_value_tests(void);
+
+static PipelineStepNode* jqStep(Arena *arena, const char *code, PipelineStepNode *next) {
+    PipelineStepNode *step = arenaAlloc(arena, sizeof(PipelineStepNode));
+    memset(step, 0, sizeof(PipelineStepNode));
+    step->type = STEP_JQ;
+    step->code = arenaDupString(arena, code);
+    step->next = next;
+    setupStepExecutor(step);
+    return step;
+}
+
+
+static void test_consecutive_jq_steps_stay_jv(void) {
+    Arena *arena = createArena(1024 * 1024);
+    ServerContext ctx = {0};
+    ctx.arena = arena;
+
+    PipelineStepNode *pipeline = jqStep(arena, ".items | map(. * 2)",
+                                        jqStep(arena, "{ doubled: . }", NULL));
+    json_t *request = json_pack("{s:[i,i,i]}", "items", 1, 2, 3);
+
+    PipelineValue result = executePipelineValue(&ctx, pipeline, request, arena);
+    TEST_ASSERT_TRUE(result.hasJv);
+    TEST_ASSERT_NULL(result.json);
+    TEST_ASSERT_FALSE(pipelineValueHasKey(&result, "error"));
+
+    size_t length = 0;
+    char *body = pipelineValueDump(&result, arena, &length);
+    TEST_ASSERT_EQUAL_STRING("{\"doubled\":[2,4,6]}", body);
+    TEST_ASSERT_EQUAL(strlen(body), length);
+
+    // Converting releases the jv
+    json_t *json = pipelineValueJson(&result);
+    TEST_ASSERT_FALSE(result.hasJv);
+    TEST_ASSERT_EQUAL(3, json_array_size(json_object_get(json, "doubled")));
+
+    pipelineValueFree(&result);
+    json_decref(request);
+    releaseJqThread();
+    freeArena(arena);
+}
+
+static void test_jq_error_skips_remaining_steps(void) {
+    Arena *arena = createArena(1024 * 1024);
+    ServerContext ctx = {0};
+    ctx.arena = arena;
+
+    PipelineStepNode *pipeline = jqStep(arena, "{ error: \"bad input\" }",
+                                        jqStep(arena, "{ ran: true }", NULL));
+    json_t *request = json_object();
+
+    PipelineValue result = executePipelineValue(&ctx, pipeline, request, arena);
+    TEST_ASSERT_TRUE(pipelineValueHasKey(&result, "error"));
+    TEST_ASSERT_FALSE(pipelineValueHasKey(&result, "ran"));
+
+    pipelineValueFree(&result);
+    json_decref(request);
+    releaseJqThread();
+    freeArena(arena);
+}
+
+int run_server_pipeline_value_tests(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_consecutive_jq_steps_stay_jv);
+    RUN_TEST(test_jq_error_skips_remaining_steps);
+    return UNITY_END();
+}
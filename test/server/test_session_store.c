@@ -0,0 +1,198 @@
+#include "../../src/server/session_store.h"
+#include "../../src/server/handler.h"
+#include "../unity/unity.h"
+#include "../test_runners.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Function prototype
+int run_server_session_store_tests(void);
+
+#define TEST_DATABASE "postgresql://localhost/express-test?gssencmode=disable"
+
+static Arena *dbArena = NULL;
+static ServerContext serverCtx;
+static Arena *requestArena = NULL;
+static SessionStore store;
+
+static void openDatabase(void) {
+    json_set_alloc_funcs(malloc, free);
+    dbArena = createArena(64 * 1024);
+    memset(&serverCtx, 0, sizeof(ServerContext));
+    serverCtx.db = initDatabase(dbArena, TEST_DATABASE);
+    TEST_ASSERT_NOT_NULL_MESSAGE(serverCtx.db, "Session store tests need " TEST_DATABASE);
+}
+
+static void closeTestDatabase(void) {
+    closeDatabase(serverCtx.db);
+    freeArena(dbArena);
+    dbArena = NULL;
+}
+
+// A session id no earlier run has used
+static void uniqueSessionId(char *id, size_t size, const char *name) {
+    static unsigned counter = 0;
+    snprintf(id, size, "test-session-store-%ld-%u-%s", (long)getpid(), counter++, name);
+}
+
+// What a request handler does around its pipeline
+static void beginRequest(void) {
+    requestArena = createArena(64 * 1024);
+    initRequestJsonArena(requestArena);
+    beginSessionStore(&store, &serverCtx);
+}
+
+static void endRequest(void) {
+    endSessionStore();
+    cleanupRequestJsonArena();
+    json_set_alloc_funcs(malloc, free);
+    freeArena(requestArena);
+    requestArena = NULL;
+}
+
+static json_t* storedDocument(const char *sessionId) {
+    const char *sql = "SELECT data::text FROM session_store WHERE session_id = $1";
+    const char *params[] = {sessionId};
+    json_t *result = executeSqlWithParams(serverCtx.db, sql, params, 1);
+    json_t *row = json_array_get(json_object_get(result, "rows"), 0);
+    const char *text = json_string_value(json_object_get(row, "data"));
+    json_t *data = text ? json_loads(text, 0, NULL) : NULL;
+    if (result) json_decref(result);
+    return data;
+}
+
+static void storeDocument(const char *sessionId, const char *document) {
+    const char *sql = "INSERT INTO session_store (session_id, data) VALUES ($1, $2::jsonb) "
+                      "ON CONFLICT (session_id) DO UPDATE SET data = $2::jsonb";
+    const char *params[] = {sessionId, document};
+    json_t *result = executeSqlWithParams(serverCtx.db, sql, params, 2);
+    TEST_ASSERT_NOT_NULL(result);
+    json_decref(result);
+}
+
+static void removeDocument(const char *sessionId) {
+    const char *sql = "DELETE FROM session_store WHERE session_id = $1";
+    const char *params[] = {sessionId};
+    json_t *result = executeSqlWithParams(serverCtx.db, sql, params, 1);
+    if (result) json_decref(result);
+}
+
+static void test_session_store_reads_its_own_writes(void) {
+    openDatabase();
+    char id[128];
+    uniqueSessionId(id, sizeof(id), "read-after-write");
+    storeDocument(id, "{\"theme\":\"light\",\"visits\":1}");
+
+    beginRequest();
+    // Written before the document is loaded, then read back over it
+    TEST_ASSERT_TRUE(sessionStoreSet(id, "theme", json_string("dark")));
+    TEST_ASSERT_EQUAL_STRING("dark", json_string_value(sessionStoreGet(id, "theme")));
+    TEST_ASSERT_EQUAL_INT(1, json_integer_value(sessionStoreGet(id, "visits")));
+
+    // And written after it is loaded
+    TEST_ASSERT_TRUE(sessionStoreSet(id, "visits", json_integer(2)));
+    TEST_ASSERT_EQUAL_INT(2, json_integer_value(sessionStoreGet(id, "visits")));
+    endRequest();
+
+    json_t *stored = storedDocument(id);
+    TEST_ASSERT_EQUAL_STRING("dark", json_string_value(json_object_get(stored, "theme")));
+    TEST_ASSERT_EQUAL_INT(2, json_integer_value(json_object_get(stored, "visits")));
+    json_decref(stored);
+
+    removeDocument(id);
+    closeTestDatabase();
+}
+
+static void test_session_store_flushes_on_session_switch(void) {
+    openDatabase();
+    char first[128];
+    char second[128];
+    uniqueSessionId(first, sizeof(first), "first");
+    uniqueSessionId(second, sizeof(second), "second");
+
+    beginRequest();
+    TEST_ASSERT_TRUE(sessionStoreSet(first, "step", json_integer(1)));
+    TEST_ASSERT_TRUE(sessionStoreSet(second, "step", json_integer(2)));
+
+    // The first session's patch is written before the second one is used
+    json_t *stored = storedDocument(first);
+    TEST_ASSERT_EQUAL_INT(1, json_integer_value(json_object_get(stored, "step")));
+    json_decref(stored);
+    TEST_ASSERT_NULL(sessionStoreGet(first, "missing"));
+    endRequest();
+
+    stored = storedDocument(second);
+    TEST_ASSERT_EQUAL_INT(2, json_integer_value(json_object_get(stored, "step")));
+    json_decref(stored);
+
+    removeDocument(first);
+    removeDocument(second);
+    closeTestDatabase();
+}
+
+static void test_session_store_batches_a_request(void) {
+    openDatabase();
+    char id[128];
+    uniqueSessionId(id, sizeof(id), "batched");
+
+    SessionStoreStats before;
+    sessionStoreStats(&before);
+
+    beginRequest();
+    const char *keys[] = {"a", "b", "c", "d", "e"};
+    for (size_t i = 0; i < 5; i++) {
+        TEST_ASSERT_NULL(sessionStoreGet(id, keys[i]));
+        TEST_ASSERT_TRUE(sessionStoreSet(id, keys[i], json_integer((json_int_t)i)));
+    }
+    TEST_ASSERT_TRUE(flushSessionStore());
+    // Nothing is left to write when the request ends
+    endRequest();
+
+    SessionStoreStats after;
+    sessionStoreStats(&after);
+    TEST_ASSERT_EQUAL_UINT64(1, after.loads - before.loads);
+    TEST_ASSERT_EQUAL_UINT64(1, after.writes - before.writes);
+
+    json_t *stored = storedDocument(id);
+    TEST_ASSERT_EQUAL_size_t(5, json_object_size(stored));
+    TEST_ASSERT_EQUAL_INT(4, json_integer_value(json_object_get(stored, "e")));
+    json_decref(stored);
+
+    removeDocument(id);
+    closeTestDatabase();
+}
+
+static void test_session_store_reloads_for_each_request(void) {
+    openDatabase();
+    char id[128];
+    uniqueSessionId(id, sizeof(id), "reload");
+    storeDocument(id, "{\"count\":1}");
+
+    beginRequest();
+    TEST_ASSERT_EQUAL_INT(1, json_integer_value(sessionStoreGet(id, "count")));
+    endRequest();
+
+    // Changed by another worker between two requests on this thread
+    storeDocument(id, "{\"count\":2}");
+
+    beginRequest();
+    TEST_ASSERT_EQUAL_INT(2, json_integer_value(sessionStoreGet(id, "count")));
+    endRequest();
+
+    // Without a current request there is no store to read
+    TEST_ASSERT_NULL(sessionStoreGet(id, "count"));
+
+    removeDocument(id);
+    closeTestDatabase();
+}
+
+int run_server_session_store_tests(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_session_store_reads_its_own_writes);
+    RUN_TEST(test_session_store_flushes_on_session_switch);
+    RUN_TEST(test_session_store_batches_a_request);
+    RUN_TEST(test_session_store_reloads_for_each_request);
+    return UNITY_END();
+}
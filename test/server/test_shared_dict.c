@@ -0,0 +1,113 @@
+#include "../../src/server/shared_dict.h"
+#include "../unity/unity.h"
+#include "../test_runners.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+// Function prototype
+int run_server_shared_dict_tests(void);
+
+static SharedValue stringValue(const char *string) {
+    SharedValue value;
+    memset(&value, 0, sizeof(SharedValue));
+    value.type = SHARED_VALUE_STRING;
+    value.length = strlen(string);
+    memcpy(value.string, string, value.length);
+    return value;
+}
+
+static void test_shared_dict_get_set_incr(void) {
+    TEST_ASSERT_TRUE(initSharedDict());
+
+    SharedValue value = stringValue("on");
+    TEST_ASSERT_EQUAL_INT(SHARED_DICT_OK, sharedDictSet("flags", "beta", &value, 0));
+
+    SharedValue read;
+    TEST_ASSERT_TRUE(sharedDictGet("flags", "beta", &read));
+    TEST_ASSERT_EQUAL_INT(SHARED_VALUE_STRING, read.type);
+    TEST_ASSERT_EQUAL_size_t(2, read.length);
+    TEST_ASSERT_EQUAL_MEMORY("on", read.string, 2);
+
+    // Dicts are separate namespaces
+    TEST_ASSERT_FALSE(sharedDictGet("other", "beta", &read));
+
+    double count = 0;
+    TEST_ASSERT_EQUAL_INT(SHARED_DICT_OK, sharedDictIncr("counters", "hits", 1, 10, &count));
+    TEST_ASSERT_EQUAL_INT(11, (int)count);
+    TEST_ASSERT_EQUAL_INT(SHARED_DICT_OK, sharedDictIncr("counters", "hits", 2, 0, &count));
+    TEST_ASSERT_EQUAL_INT(13, (int)count);
+    TEST_ASSERT_EQUAL_INT(SHARED_DICT_NOT_NUMBER, sharedDictIncr("flags", "beta", 1, 0, &count));
+
+    sharedDictDelete("flags", "beta");
+    TEST_ASSERT_FALSE(sharedDictGet("flags", "beta", &read));
+
+    // Already past its ttl when read back
+    TEST_ASSERT_EQUAL_INT(SHARED_DICT_OK, sharedDictSet("flags", "brief", &value, 0.000001));
+    usleep(1000);
+    TEST_ASSERT_FALSE(sharedDictGet("flags", "brief", &read));
+
+    cleanupSharedDict();
+}
+
+static void test_shared_dict_evicts_least_recent(void) {
+    // One entry per stripe
+    setenv("WEBDSL_SHARED_DICT_ENTRIES", "16", 1);
+    TEST_ASSERT_TRUE(initSharedDict());
+
+    char key[32];
+    SharedValue value = stringValue("x");
+    for (int i = 0; i < 200; i++) {
+        snprintf(key, sizeof(key), "key%d", i);
+        TEST_ASSERT_EQUAL_INT(SHARED_DICT_OK, sharedDictSet("lru", key, &value, 0));
+    }
+
+    int live = 0;
+    SharedValue read;
+    for (int i = 0; i < 200; i++) {
+        snprintf(key, sizeof(key), "key%d", i);
+        if (sharedDictGet("lru", key, &read)) live++;
+    }
+    TEST_ASSERT_TRUE(live <= 16);
+    TEST_ASSERT_TRUE(sharedDictGet("lru", "key199", &read));
+
+    cleanupSharedDict();
+    unsetenv("WEBDSL_SHARED_DICT_ENTRIES");
+}
+
+static void test_shared_dict_visible_across_processes(void) {
+    TEST_ASSERT_TRUE(initSharedDict());
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        double count = 0;
+        for (int i = 0; i < 1000; i++) {
+            sharedDictIncr("counters", "forked", 1, 0, &count);
+        }
+        _exit(0);
+    }
+
+    double count = 0;
+    for (int i = 0; i < 1000; i++) {
+        sharedDictIncr("counters", "forked", 1, 0, &count);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    TEST_ASSERT_EQUAL_INT(0, status);
+
+    SharedValue read;
+    TEST_ASSERT_TRUE(sharedDictGet("counters", "forked", &read));
+    TEST_ASSERT_EQUAL_INT(2000, (int)read.number);
+
+    cleanupSharedDict();
+}
+
+int run_server_shared_dict_tests(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_shared_dict_get_set_incr);
+    RUN_TEST(test_shared_dict_evicts_least_recent);
+    RUN_TEST(test_shared_dict_visible_across_processes);
+    return UNITY_END();
+}
@@ -0,0 +1,247 @@
+#include "../../src/server/static.h"
+#include "../unity/unity.h"
+#include "../test_runners.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+// Function prototype
+int run_server_static_tests(void);
+
+static char rootDir[64];
+static char publicDir[128];
+static WebsiteNode website;
+static StaticNode mountNode;
+static ServerContext serverCtx;
+
+// Request headers as name/value pairs, NULL terminated
+static const char **requestHeaders = NULL;
+
+static const char* testHeader(void *source, const char *name) {
+    (void)source;
+    for (const char **header = requestHeaders; header && header[0]; header += 2) {
+        if (strcasecmp(header[0], name) == 0) return header[1];
+    }
+    return NULL;
+}
+
+static void writeFile(const char *dir, const char *name, const char *content) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    FILE *file = fopen(path, "w");
+    TEST_ASSERT_NOT_NULL(file);
+    fputs(content, file);
+    fclose(file);
+}
+
+static void removeFile(const char *dir, const char *name) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    unlink(path);
+}
+
+static bool resolve(const char *url, const char **headers, StaticResponse *out) {
+    requestHeaders = headers;
+    return resolveStaticRequest(url, "GET", testHeader, NULL, out);
+}
+
+static void closeBody(StaticResponse *response) {
+    if (response->fd >= 0) close(response->fd);
+    response->fd = -1;
+}
+
+// <root>/secret.txt sits outside the mount at <root>/public, served under /assets
+static void createSite(void) {
+    snprintf(rootDir, sizeof(rootDir), "/tmp/webdsl-static-XXXXXX");
+    TEST_ASSERT_NOT_NULL(mkdtemp(rootDir));
+    snprintf(publicDir, sizeof(publicDir), "%s/public", rootDir);
+    TEST_ASSERT_EQUAL_INT(0, mkdir(publicDir, 0755));
+
+    writeFile(rootDir, "secret.txt", "secret\n");
+    writeFile(publicDir, "app.js", "console.log('app');\n");
+    writeFile(publicDir, "app.js.br", "brotli");
+    writeFile(publicDir, "app.js.gz", "gzip");
+    writeFile(publicDir, "style.css", "body { margin: 0; }\n");
+    writeFile(publicDir, "style.css.gz", "gzip");
+
+    char link[256];
+    snprintf(link, sizeof(link), "%s/escape.txt", publicDir);
+    TEST_ASSERT_EQUAL_INT(0, symlink("../secret.txt", link));
+    snprintf(link, sizeof(link), "%s/inside.js", publicDir);
+    TEST_ASSERT_EQUAL_INT(0, symlink("app.js", link));
+
+    memset(&website, 0, sizeof(WebsiteNode));
+    memset(&mountNode, 0, sizeof(StaticNode));
+    memset(&serverCtx, 0, sizeof(ServerContext));
+    mountNode.route = "/assets";
+    mountNode.dir = publicDir;
+    mountNode.maxAge = 60;
+    website.staticHead = &mountNode;
+    serverCtx.website = &website;
+    initStatic(&serverCtx);
+}
+
+static void removeSite(void) {
+    cleanupStatic();
+    const char *names[] = {"app.js", "app.js.br", "app.js.gz", "style.css", "style.css.gz",
+                           "escape.txt", "inside.js"};
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        removeFile(publicDir, names[i]);
+    }
+    rmdir(publicDir);
+    removeFile(rootDir, "secret.txt");
+    rmdir(rootDir);
+}
+
+static void test_static_rejects_traversal(void) {
+    createSite();
+    StaticResponse response;
+
+    // MHD hands over decoded paths, so these are what %2e%2e turns into
+    TEST_ASSERT_TRUE(resolve("/assets/../secret.txt", NULL, &response));
+    TEST_ASSERT_EQUAL_UINT(404, response.status);
+    TEST_ASSERT_EQUAL_INT(-1, response.fd);
+    TEST_ASSERT_TRUE(resolve("/assets/css/../../secret.txt", NULL, &response));
+    TEST_ASSERT_EQUAL_UINT(404, response.status);
+    TEST_ASSERT_TRUE(resolve("/assets/..\\secret.txt", NULL, &response));
+    TEST_ASSERT_EQUAL_UINT(404, response.status);
+
+    // Still-encoded segments are just names that don't exist
+    TEST_ASSERT_FALSE(resolve("/assets/%2e%2e/secret.txt", NULL, &response));
+    TEST_ASSERT_FALSE(resolve("/assets/..%2fsecret.txt", NULL, &response));
+
+    // Symlinks may point anywhere inside the mount, but not out of it
+    TEST_ASSERT_FALSE(resolve("/assets/escape.txt", NULL, &response));
+    TEST_ASSERT_TRUE(resolve("/assets/inside.js", NULL, &response));
+    TEST_ASSERT_EQUAL_UINT(200, response.status);
+    closeBody(&response);
+
+    // Other routes are left to the router
+    TEST_ASSERT_FALSE(resolve("/assetsx/app.js", NULL, &response));
+
+    removeSite();
+}
+
+static void test_static_range(void) {
+    createSite();
+    StaticResponse response;
+    uint64_t size = strlen("console.log('app');\n");
+
+    const char *single[] = {"Range", "bytes=2-5", NULL};
+    TEST_ASSERT_TRUE(resolve("/assets/app.js", single, &response));
+    TEST_ASSERT_EQUAL_UINT(206, response.status);
+    TEST_ASSERT_EQUAL_UINT64(2, response.offset);
+    TEST_ASSERT_EQUAL_UINT64(4, response.length);
+    TEST_ASSERT_EQUAL_UINT64(size, response.size);
+    closeBody(&response);
+
+    const char *suffix[] = {"Range", "bytes=-3", NULL};
+    TEST_ASSERT_TRUE(resolve("/assets/app.js", suffix, &response));
+    TEST_ASSERT_EQUAL_UINT(206, response.status);
+    TEST_ASSERT_EQUAL_UINT64(size - 3, response.offset);
+    TEST_ASSERT_EQUAL_UINT64(3, response.length);
+    closeBody(&response);
+
+    const char *pastEnd[] = {"Range", "bytes=1000-", NULL};
+    TEST_ASSERT_TRUE(resolve("/assets/app.js", pastEnd, &response));
+    TEST_ASSERT_EQUAL_UINT(416, response.status);
+    TEST_ASSERT_EQUAL_INT(-1, response.fd);
+
+    // Multiple and malformed ranges get the whole file
+    const char *multiple[] = {"Range", "bytes=0-1,4-5", NULL};
+    TEST_ASSERT_TRUE(resolve("/assets/app.js", multiple, &response));
+    TEST_ASSERT_EQUAL_UINT(200, response.status);
+    TEST_ASSERT_EQUAL_UINT64(size, response.length);
+    closeBody(&response);
+
+    const char *malformed[] = {"Range", "bytes=a-b", NULL};
+    TEST_ASSERT_TRUE(resolve("/assets/app.js", malformed, &response));
+    TEST_ASSERT_EQUAL_UINT(200, response.status);
+    closeBody(&response);
+
+    removeSite();
+}
+
+static void test_static_conditional_requests(void) {
+    createSite();
+    StaticResponse response;
+    TEST_ASSERT_TRUE(resolve("/assets/app.js", NULL, &response));
+    closeBody(&response);
+    char etag[48];
+    char lastModified[32];
+    strcpy(etag, response.etag);
+    strcpy(lastModified, response.lastModified);
+
+    const char *matching[] = {"If-None-Match", etag, NULL};
+    TEST_ASSERT_TRUE(resolve("/assets/app.js", matching, &response));
+    TEST_ASSERT_EQUAL_UINT(304, response.status);
+    TEST_ASSERT_EQUAL_INT(-1, response.fd);
+    TEST_ASSERT_EQUAL_STRING(etag, response.etag);
+
+    const char *modified[] = {"If-Modified-Since", lastModified, NULL};
+    TEST_ASSERT_TRUE(resolve("/assets/app.js", modified, &response));
+    TEST_ASSERT_EQUAL_UINT(304, response.status);
+
+    // If-None-Match wins over If-Modified-Since
+    const char *changed[] = {"If-None-Match", "\"other\"", "If-Modified-Since", lastModified, NULL};
+    TEST_ASSERT_TRUE(resolve("/assets/app.js", changed, &response));
+    TEST_ASSERT_EQUAL_UINT(200, response.status);
+    closeBody(&response);
+
+    // A Range only applies while If-Range still names this version
+    const char *current[] = {"Range", "bytes=0-0", "If-Range", etag, NULL};
+    TEST_ASSERT_TRUE(resolve("/assets/app.js", current, &response));
+    TEST_ASSERT_EQUAL_UINT(206, response.status);
+    closeBody(&response);
+
+    const char *stale[] = {"Range", "bytes=0-0", "If-Range", "\"stale\"", NULL};
+    TEST_ASSERT_TRUE(resolve("/assets/app.js", stale, &response));
+    TEST_ASSERT_EQUAL_UINT(200, response.status);
+    TEST_ASSERT_EQUAL_UINT64(response.size, response.length);
+    closeBody(&response);
+
+    removeSite();
+}
+
+static void test_static_precompressed_siblings(void) {
+    createSite();
+    StaticResponse response;
+
+    const char *both[] = {"Accept-Encoding", "gzip, br", NULL};
+    TEST_ASSERT_TRUE(resolve("/assets/app.js", both, &response));
+    TEST_ASSERT_EQUAL_STRING("br", response.encoding);
+    TEST_ASSERT_EQUAL_UINT64(strlen("brotli"), response.length);
+    TEST_ASSERT_EQUAL_STRING("text/javascript; charset=utf-8", response.contentType);
+    closeBody(&response);
+
+    const char *noBrotli[] = {"Accept-Encoding", "br;q=0, gzip", NULL};
+    TEST_ASSERT_TRUE(resolve("/assets/app.js", noBrotli, &response));
+    TEST_ASSERT_EQUAL_STRING("gzip", response.encoding);
+    closeBody(&response);
+
+    TEST_ASSERT_TRUE(resolve("/assets/app.js", NULL, &response));
+    TEST_ASSERT_NULL(response.encoding);
+    TEST_ASSERT_EQUAL_UINT64(strlen("console.log('app');\n"), response.length);
+    closeBody(&response);
+
+    // Without a .br sibling, a brotli-only client gets the original
+    const char *brotliOnly[] = {"Accept-Encoding", "br", NULL};
+    TEST_ASSERT_TRUE(resolve("/assets/style.css", brotliOnly, &response));
+    TEST_ASSERT_NULL(response.encoding);
+    TEST_ASSERT_EQUAL_STRING("text/css; charset=utf-8", response.contentType);
+    closeBody(&response);
+
+    removeSite();
+}
+
+int run_server_static_tests(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_static_rejects_traversal);
+    RUN_TEST(test_static_range);
+    RUN_TEST(test_static_conditional_requests);
+    RUN_TEST(test_static_precompressed_siblings);
+    return UNITY_END();
+}
@@ -0,0 +1,55 @@
+#include "../../src/server/trace.h"
+#include "../../src/server/metrics.h"
+#include "../../src/ast.h"
+#include "../../src/arena.h"
+#include "../unity/unity.h"
+#include "../test_runners.h"
+#include <string.h>
+
+// Function prototype
+int run_server_trace_tests(void);
+
+static void test_trace_server_timing_header(void) {
+    Arena *arena = createArena(1024 * 1024);
+    RequestTrace *trace = beginRequestTrace(arena, "GET", "/users", metricsNow());
+    TEST_ASSERT_NOT_NULL(trace);
+
+    PipelineStepNode step = {0};
+    step.type = STEP_SQL;
+    step.name = "users";
+    json_t *output = json_pack("{s:[{s:[{},{}]}]}", "data", "rows");
+    PipelineValue input = pipelineValueFromJson(NULL);
+    PipelineValue outputValue = pipelineValueFromJson(output);
+    traceRecordStep(&step, &input, &outputValue, 1500000);
+    traceRecordRender("home", 42, 2000000);
+
+    TEST_ASSERT_EQUAL_STRING("sql", trace->head->type);
+    TEST_ASSERT_EQUAL(2, trace->head->rows);
+    TEST_ASSERT_EQUAL(0, trace->head->bytesIn);
+    TEST_ASSERT_EQUAL(strlen("{\"data\":[{\"rows\":[{},{}]}]}"), trace->head->bytesOut);
+    TEST_ASSERT_EQUAL(42, trace->tail->bytesOut);
+
+    struct MHD_Response *response = MHD_create_response_from_buffer(0, "", MHD_RESPMEM_PERSISTENT);
+    addServerTimingHeader(response);
+    const char *header = MHD_get_response_header(response, "Server-Timing");
+    TEST_ASSERT_NOT_NULL(header);
+    TEST_ASSERT_NOT_NULL(strstr(header, "sql;desc=\"users\";dur=1.500, "));
+    TEST_ASSERT_NOT_NULL(strstr(header, "render;desc=\"home\";dur=2.000, "));
+    TEST_ASSERT_NOT_NULL(strstr(header, "total;dur="));
+
+    MHD_destroy_response(response);
+    json_decref(output);
+    endRequestTrace(trace);
+
+    // Recorders are no-ops once the request has ended
+    traceRecordRender("home", 42, 1000);
+    TEST_ASSERT_EQUAL_PTR(trace->head->next, trace->tail);
+
+    freeArena(arena);
+}
+
+int run_server_trace_tests(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_trace_server_timing_header);
+    return UNITY_END();
+}
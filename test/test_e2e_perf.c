@@ -0,0 +1,434 @@
+#include "../test/unity/unity.h"
+#include "../src/server/server.h"
+#include "../src/server/metrics.h"
+#include "../src/parser.h"
+#include "../src/website.h"
+#include "../src/loadgen.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <jansson.h>
+
+// Function prototypes
+int run_e2e_perf_tests(void);
+
+// Tail-latency regression gate, run by `make test-perf`. Each representative
+// route is driven for a fixed number of iterations over one keep-alive
+// connection; p50/p99 and request-arena allocations per request are written to
+// build/e2e_perf.jsonl. Allocations and bytes per request don't depend on the
+// machine, so they are compared against the committed baseline. Latency is
+// only compared against a baseline recorded locally, under build/.
+
+#define PERF_PORT 3457
+#define PERF_WARMUP 50
+#define PERF_DEFAULT_ITERATIONS 500
+#define PERF_DEFAULT_THRESHOLD 20.0
+#define PERF_DEFAULT_BASELINE "test/e2e_perf_baseline.jsonl"
+#define PERF_DEFAULT_LATENCY_BASELINE "build/e2e_perf_latency_baseline.jsonl"
+#define PERF_RESULTS "build/e2e_perf.jsonl"
+// Latency changes smaller than this are scheduler noise, whatever the ratio
+#define PERF_MIN_LATENCY_DELTA_MS 0.05
+
+static const char *TEST_FILE = "test_perf.webdsl";
+
+static const char *PERF_CONFIG =
+"website {\n"
+"  name \"E2E Perf\"\n"
+"  port 3457\n"
+"  database \"postgresql://localhost/express-test?gssencmode=disable\"\n"
+"\n"
+"  layout {\n"
+"    name \"main\"\n"
+"    html {\n"
+"      <html><body><h1>Perf</h1><!-- content --></body></html>\n"
+"    }\n"
+"  }\n"
+"\n"
+"  page {\n"
+"    name \"home\"\n"
+"    route \"/\"\n"
+"    layout \"main\"\n"
+"    html {\n"
+"      <p>Static page</p>\n"
+"    }\n"
+"  }\n"
+"\n"
+"  api {\n"
+"    route \"/api/perf/sql\"\n"
+"    method \"GET\"\n"
+"    pipeline {\n"
+"      sql {\n"
+"        SELECT n AS id, 'row ' || n AS name FROM generate_series(1, 20) AS n\n"
+"      }\n"
+"      jq {\n"
+"        { items: [.data[0].rows[] | { id, name }] }\n"
+"      }\n"
+"    }\n"
+"  }\n"
+"\n"
+"  api {\n"
+"    route \"/api/perf/lua\"\n"
+"    method \"GET\"\n"
+"    pipeline {\n"
+"      lua {\n"
+"        local items = {}\n"
+"        for i = 1, 20 do\n"
+"          items[i] = { id = i, name = \"item \" .. i }\n"
+"        end\n"
+"        return { items = items }\n"
+"      }\n"
+"    }\n"
+"  }\n"
+"\n"
+"  api {\n"
+"    route \"/api/perf/validate\"\n"
+"    method \"POST\"\n"
+"    fields {\n"
+"      \"name\" {\n"
+"        type \"string\"\n"
+"        required true\n"
+"        length 2..50\n"
+"      }\n"
+"      \"email\" {\n"
+"        type \"string\"\n"
+"        format \"email\"\n"
+"        required true\n"
+"      }\n"
+"    }\n"
+"    pipeline {\n"
+"      jq {\n"
+"        { success: true, name: .body.name }\n"
+"      }\n"
+"    }\n"
+"  }\n"
+"\n"
+"  api {\n"
+"    route \"/api/perf/upload\"\n"
+"    method \"POST\"\n"
+"    pipeline {\n"
+"      lua {\n"
+"        local file = request.files.file\n"
+"        return { filename = file.filename, size = file.size }\n"
+"      }\n"
+"    }\n"
+"  }\n"
+"}\n";
+
+#define PERF_BOUNDARY "----webdslperf"
+
+#define VALIDATE_BODY "{\"name\":\"Perf Test\",\"email\":\"perf@example.com\"}"
+
+#define UPLOAD_BODY \
+    "--" PERF_BOUNDARY "\r\n" \
+    "Content-Disposition: form-data; name=\"file\"; filename=\"perf.txt\"\r\n" \
+    "Content-Type: text/plain\r\n" \
+    "\r\n" \
+    "webdsl perf upload payload\r\n" \
+    "--" PERF_BOUNDARY "--\r\n"
+
+typedef struct PerfRoute {
+    const char *name;
+    const char *method;
+    const char *path;
+    const char *contentType;
+    const char *body;
+} PerfRoute;
+
+static const PerfRoute perfRoutes[] = {
+    { "static-page", "GET", "/", NULL, NULL },
+    { "sql-jq", "GET", "/api/perf/sql", NULL, NULL },
+    { "lua", "GET", "/api/perf/lua", NULL, NULL },
+    { "validate-post", "POST", "/api/perf/validate", "application/json", VALIDATE_BODY },
+    { "multipart-upload", "POST", "/api/perf/upload", "multipart/form-data; boundary=" PERF_BOUNDARY, UPLOAD_BODY },
+};
+
+#define PERF_ROUTE_COUNT (sizeof(perfRoutes) / sizeof(perfRoutes[0]))
+
+typedef struct PerfResult {
+    const char *name;
+    double p50Ms;
+    double p99Ms;
+    double allocations;  // Request arena allocations per request
+    double bytes;        // Request arena bytes per request
+} PerfResult;
+
+static void writeConfig(const char *config) {
+    FILE *f = fopen(TEST_FILE, "w");
+    TEST_ASSERT_NOT_NULL(f);
+    fprintf(f, "%s", config);
+    fclose(f);
+    sync();
+}
+
+static double envDouble(const char *name, double fallback) {
+    const char *value = getenv(name);
+    if (!value || !*value) return fallback;
+    char *end = NULL;
+    double parsed = strtod(value, &end);
+    return (end && *end == '\0' && parsed > 0) ? parsed : fallback;
+}
+
+static char* buildRequest(const PerfRoute *route, size_t *length) {
+    const char *body = route->body;
+    char header[512];
+    int headerLength;
+    if (body) {
+        headerLength = snprintf(header, sizeof(header),
+            "%s %s HTTP/1.1\r\nHost: 127.0.0.1:%d\r\nContent-Type: %s\r\nContent-Length: %zu\r\n\r\n",
+            route->method, route->path, PERF_PORT, route->contentType, strlen(body));
+    } else {
+        headerLength = snprintf(header, sizeof(header),
+            "%s %s HTTP/1.1\r\nHost: 127.0.0.1:%d\r\n\r\n",
+            route->method, route->path, PERF_PORT);
+    }
+
+    size_t bodyLength = body ? strlen(body) : 0;
+    char *request = malloc((size_t)headerLength + bodyLength + 1);
+    TEST_ASSERT_NOT_NULL(request);
+    memcpy(request, header, (size_t)headerLength);
+    if (body) memcpy(request + headerLength, body, bodyLength);
+    request[(size_t)headerLength + bodyLength] = '\0';
+    *length = (size_t)headerLength + bodyLength;
+    return request;
+}
+
+// Value of `name{route="...",method="..."}` in a /metrics response, 0 when absent
+static double metricValue(const char *metrics, const char *name, const PerfRoute *route) {
+    char prefix[256];
+    snprintf(prefix, sizeof(prefix), "%s{route=\"%s\",method=\"%s\"} ", name, route->path, route->method);
+    const char *line = strstr(metrics, prefix);
+    return line ? strtod(line + strlen(prefix), NULL) : 0;
+}
+
+typedef struct RouteCounters {
+    double requests;
+    double allocations;
+    double bytes;
+} RouteCounters;
+
+static RouteCounters readCounters(LoadConnection *conn, const PerfRoute *route) {
+    static const char request[] = "GET /metrics HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n";
+    RouteCounters counters = {0};
+    char *metrics = NULL;
+    size_t length = 0;
+    int status = loadRequest(conn, request, sizeof(request) - 1, &metrics, &length);
+    TEST_ASSERT_EQUAL_INT(200, status);
+
+    counters.requests = metricValue(metrics, "webdsl_request_duration_seconds_count", route);
+    counters.allocations = metricValue(metrics, "webdsl_request_arena_allocations_total", route);
+    counters.bytes = metricValue(metrics, "webdsl_request_arena_bytes_total", route);
+    free(metrics);
+    return counters;
+}
+
+static PerfResult measureRoute(LoadConnection *conn, const PerfRoute *route, int iterations) {
+    size_t length = 0;
+    char *request = buildRequest(route, &length);
+
+    for (int i = 0; i < PERF_WARMUP; i++) {
+        int status = loadRequest(conn, request, length, NULL, NULL);
+        TEST_ASSERT_EQUAL_INT_MESSAGE(200, status, route->name);
+    }
+
+    RouteCounters before = readCounters(conn, route);
+    LatencySamples samples = {0};
+    for (int i = 0; i < iterations; i++) {
+        uint64_t start = metricsNow();
+        int status = loadRequest(conn, request, length, NULL, NULL);
+        latencyAdd(&samples, metricsNow() - start);
+        TEST_ASSERT_EQUAL_INT_MESSAGE(200, status, route->name);
+    }
+    RouteCounters after = readCounters(conn, route);
+
+    latencySort(&samples);
+    PerfResult result = {0};
+    result.name = route->name;
+    result.p50Ms = (double)latencyPercentile(&samples, 0.50) / 1e6;
+    result.p99Ms = (double)latencyPercentile(&samples, 0.99) / 1e6;
+    double requests = after.requests - before.requests;
+    if (requests > 0) {
+        result.allocations = (after.allocations - before.allocations) / requests;
+        result.bytes = (after.bytes - before.bytes) / requests;
+    }
+
+    latencyFree(&samples);
+    free(request);
+    return result;
+}
+
+static void writeResults(const char *path, const PerfResult *results, size_t count, int iterations) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        fprintf(stderr, "Failed to write %s\n", path);
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        fprintf(f, "{\"route\":\"%s\",\"iterations\":%d,\"p50_ms\":%.4f,\"p99_ms\":%.4f,"
+                   "\"allocations\":%.1f,\"bytes\":%.0f}\n",
+                results[i].name, iterations, results[i].p50Ms, results[i].p99Ms,
+                results[i].allocations, results[i].bytes);
+    }
+    fclose(f);
+}
+
+// The committed baseline, with only the metrics that are the same on every machine
+static void writeAllocationBaseline(const char *path, const PerfResult *results, size_t count) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        fprintf(stderr, "Failed to write %s\n", path);
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        fprintf(f, "{\"route\":\"%s\",\"allocations\":%.1f,\"bytes\":%.0f}\n",
+                results[i].name, results[i].allocations, results[i].bytes);
+    }
+    fclose(f);
+}
+
+// The local baseline, with the metrics that only hold on the machine that recorded them
+static void writeLatencyBaseline(const char *path, const PerfResult *results, size_t count, int iterations) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        fprintf(stderr, "Failed to write %s\n", path);
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        fprintf(f, "{\"route\":\"%s\",\"iterations\":%d,\"p50_ms\":%.4f,\"p99_ms\":%.4f}\n",
+                results[i].name, iterations, results[i].p50Ms, results[i].p99Ms);
+    }
+    fclose(f);
+}
+
+static bool regressed(const char *route, const char *metric, double baseline, double current,
+                      double threshold, double minDelta) {
+    if (baseline <= 0) return false;
+    double change = (current - baseline) / baseline * 100.0;
+    if (change <= threshold || current - baseline <= minDelta) return false;
+    fprintf(stderr, "  REGRESSION %-18s %-12s %10.4f -> %10.4f (%+.1f%%)\n",
+            route, metric, baseline, current, change);
+    return true;
+}
+
+// Compares one metric when the baseline entry has it
+static bool metricRegressed(json_t *entry, const char *route, const char *metric, double current,
+                            double threshold, double minDelta) {
+    json_t *baseline = json_object_get(entry, metric);
+    if (!json_is_number(baseline)) return false;
+    return regressed(route, metric, json_number_value(baseline), current, threshold, minDelta);
+}
+
+// Returns the number of regressed metrics. Each baseline entry is compared on
+// the metrics it records. When the baseline is required, a route it doesn't
+// cover counts as a regression, so a new route can't skip the gate.
+static int compareBaseline(const char *path, const PerfResult *results, size_t count, double threshold,
+                           bool required) {
+    FILE *f = fopen(path, "r");
+    if (!f) return 0;
+
+    int regressions = 0;
+    bool covered[PERF_ROUTE_COUNT] = {false};
+    char line[1024];
+    while (fgets(line, sizeof(line), f)) {
+        json_t *entry = json_loads(line, 0, NULL);
+        if (!entry) continue;
+        const char *name = json_string_value(json_object_get(entry, "route"));
+        for (size_t i = 0; name && i < count; i++) {
+            if (strcmp(results[i].name, name) != 0) continue;
+            const PerfResult *r = &results[i];
+            covered[i] = true;
+            regressions += metricRegressed(entry, name, "p50_ms", r->p50Ms, threshold, PERF_MIN_LATENCY_DELTA_MS);
+            regressions += metricRegressed(entry, name, "p99_ms", r->p99Ms, threshold, PERF_MIN_LATENCY_DELTA_MS);
+            regressions += metricRegressed(entry, name, "allocations", r->allocations, threshold, 0);
+            regressions += metricRegressed(entry, name, "bytes", r->bytes, threshold, 0);
+        }
+        json_decref(entry);
+    }
+    fclose(f);
+
+    for (size_t i = 0; i < count; i++) {
+        if (covered[i]) continue;
+        if (required) {
+            fprintf(stderr, "  MISSING    %-18s no entry in %s\n", results[i].name, path);
+            regressions++;
+        } else {
+            printf("No baseline for %s in %s\n", results[i].name, path);
+        }
+    }
+    return regressions;
+}
+
+static void test_tail_latency_regression(void) {
+    if (!getenv("WEBDSL_E2E_PERF")) {
+        TEST_IGNORE_MESSAGE("Set WEBDSL_E2E_PERF=1 (make test-perf) to run");
+    }
+
+    // Client-side JSON parsing must not use the request arena allocator
+    json_set_alloc_funcs(malloc, free);
+
+    int iterations = (int)envDouble("WEBDSL_PERF_ITERATIONS", PERF_DEFAULT_ITERATIONS);
+    double threshold = envDouble("WEBDSL_PERF_THRESHOLD", PERF_DEFAULT_THRESHOLD);
+    const char *baseline = getenv("WEBDSL_PERF_BASELINE");
+    if (!baseline || !*baseline) baseline = PERF_DEFAULT_BASELINE;
+    const char *latencyBaseline = getenv("WEBDSL_PERF_LATENCY_BASELINE");
+    if (!latencyBaseline || !*latencyBaseline) latencyBaseline = PERF_DEFAULT_LATENCY_BASELINE;
+
+    // Keep logging out of the measured path
+    setenv("WEBDSL_ACCESS_LOG_SAMPLE_RATE", "0", 0);
+
+    stopServer();
+    writeConfig(PERF_CONFIG);
+    Parser parser = {0};
+    WebsiteNode *website = reloadWebsite(&parser, NULL, TEST_FILE);
+    TEST_ASSERT_NOT_NULL(website);
+
+    LoadConnection conn = {0};
+    TEST_ASSERT_TRUE(loadConnect(&conn, PERF_PORT));
+
+    PerfResult results[PERF_ROUTE_COUNT];
+    printf("\n%-18s %10s %10s %12s %12s\n", "route", "p50 ms", "p99 ms", "allocs/req", "bytes/req");
+    for (size_t i = 0; i < PERF_ROUTE_COUNT; i++) {
+        results[i] = measureRoute(&conn, &perfRoutes[i], iterations);
+        printf("%-18s %10.4f %10.4f %12.1f %12.0f\n", results[i].name, results[i].p50Ms,
+               results[i].p99Ms, results[i].allocations, results[i].bytes);
+    }
+    loadClose(&conn);
+
+    stopServer();
+    freeArena(parser.arena);
+    remove(TEST_FILE);
+
+    if (getenv("WEBDSL_PERF_UPDATE_BASELINE")) {
+        writeAllocationBaseline(baseline, results, PERF_ROUTE_COUNT);
+        writeLatencyBaseline(latencyBaseline, results, PERF_ROUTE_COUNT, iterations);
+        printf("Wrote perf baselines to %s and %s\n", baseline, latencyBaseline);
+        return;
+    }
+
+    writeResults(PERF_RESULTS, results, PERF_ROUTE_COUNT, iterations);
+    if (access(baseline, R_OK) != 0) {
+        char message[256];
+        snprintf(message, sizeof(message), "No perf baseline at %s; run `make test-perf-baseline` and commit it",
+                 baseline);
+        TEST_FAIL_MESSAGE(message);
+    }
+    int regressions = compareBaseline(baseline, results, PERF_ROUTE_COUNT, threshold, true);
+    // Latency from another machine says nothing about this one
+    if (access(latencyBaseline, R_OK) == 0) {
+        regressions += compareBaseline(latencyBaseline, results, PERF_ROUTE_COUNT, threshold, false);
+    } else {
+        printf("No local latency baseline at %s; latency is only reported\n", latencyBaseline);
+    }
+    if (regressions > 0) {
+        char message[192];
+        snprintf(message, sizeof(message), "%d metric(s) regressed more than %.0f%% or lack a baseline in %s or %s",
+                 regressions, threshold, baseline, latencyBaseline);
+        TEST_FAIL_MESSAGE(message);
+    }
+}
+
+int run_e2e_perf_tests(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_tail_latency_regression);
+    return UNITY_END();
+}
@@ -18,11 +18,27 @@ int main(void) {
     result |= run_arena_tests();
     result |= run_stringbuilder_tests();
     result |= run_website_json_tests();
+    result |= run_replay_tests();
     
     // Run server tests
     result |= run_server_tests();
     result |= run_server_css_tests();
     result |= run_server_validation_tests();
+    result |= run_server_metrics_tests();
+    result |= run_server_trace_tests();
+    result |= run_server_pipeline_value_tests();
+    result |= run_server_jq_tests();
+    result |= run_server_linker_tests();
+    result |= run_server_lua_json_tests();
+    result |= run_server_lua_tests();
+    result |= run_server_fetch_cache_tests();
+    result |= run_server_lua_fetch_tests();
+    result |= run_server_shared_dict_tests();
+    result |= run_server_anonymous_session_tests();
+    result |= run_server_session_store_tests();
+    result |= run_server_artifact_cache_tests();
+    result |= run_server_static_tests();
+    result |= run_server_logger_tests();
     result |= run_route_params_tests();
     
     // Run hotreload tests
@@ -30,6 +46,7 @@ int main(void) {
     
     // Run end-to-end tests
     result |= run_e2e_tests();
+    result |= run_e2e_perf_tests();
     
     return result;
 }
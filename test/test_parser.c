@@ -836,6 +836,94 @@ static void test_parse_website_with_auth(void) {
     freeArena(parser.arena);
 }
 
+static void test_parse_static_block(void) {
+    Parser parser;
+    const char *input = 
+        "website {\n"
+        "  static {\n"
+        "    route \"/assets\"\n"
+        "    dir \"public\"\n"
+        "    maxAge 31536000\n"
+        "  }\n"
+        "}";
+    
+    initParser(&parser, input);
+    WebsiteNode *website = parseProgram(&parser);
+    
+    TEST_ASSERT_NOT_NULL(website);
+    TEST_ASSERT_EQUAL(0, parser.hadError);
+    TEST_ASSERT_NOT_NULL(website->staticHead);
+    TEST_ASSERT_EQUAL_STRING("/assets", website->staticHead->route);
+    TEST_ASSERT_EQUAL_STRING("public", website->staticHead->dir);
+    TEST_ASSERT_EQUAL(31536000, website->staticHead->maxAge);
+    TEST_ASSERT_NULL(website->staticHead->next);
+    
+    freeArena(parser.arena);
+}
+
+static void test_parse_static_block_requires_route_and_dir(void) {
+    Parser parser;
+    const char *input =
+        "website {\n"
+        "  static {\n"
+        "    route \"assets\"\n"
+        "  }\n"
+        "}";
+
+    initParser(&parser, input);
+    parseProgram(&parser);
+    TEST_ASSERT_EQUAL(1, parser.hadError);
+    freeArena(parser.arena);
+
+    const char *twoMounts =
+        "website {\n"
+        "  static {\n"
+        "    route \"/assets\"\n"
+        "    dir \"public\"\n"
+        "  }\n"
+        "  static {\n"
+        "    dir \"uploads\"\n"
+        "    route \"/uploads\"\n"
+        "  }\n"
+        "}";
+
+    initParser(&parser, twoMounts);
+    WebsiteNode *website = parseProgram(&parser);
+    TEST_ASSERT_EQUAL(0, parser.hadError);
+    TEST_ASSERT_NOT_NULL(website->staticHead);
+    TEST_ASSERT_NOT_NULL(website->staticHead->next);
+    TEST_ASSERT_EQUAL(0, website->staticHead->maxAge);
+    freeArena(parser.arena);
+}
+
+static void test_parse_lua_budget(void) {
+    Parser parser;
+    const char *input =
+        "website {\n"
+        "  api {\n"
+        "    route \"/api/report\"\n"
+        "    luaBudget 5000000\n"
+        "    pipeline {\n"
+        "      lua { return {} }\n"
+        "    }\n"
+        "  }\n"
+        "  page {\n"
+        "    route \"/\"\n"
+        "    luaBudget 0\n"
+        "  }\n"
+        "}";
+
+    initParser(&parser, input);
+    WebsiteNode *website = parseProgram(&parser);
+
+    // A budget of zero is rejected
+    TEST_ASSERT_NOT_NULL(website);
+    TEST_ASSERT_EQUAL(1, parser.hadError);
+    TEST_ASSERT_EQUAL_UINT32(5000000, website->apiHead->luaBudget);
+
+    freeArena(parser.arena);
+}
+
 int run_parser_tests(void) {
     UNITY_BEGIN();
     RUN_TEST(test_parser_init);
@@ -862,5 +950,8 @@ int run_parser_tests(void) {
     RUN_TEST(test_parse_website_with_content);
     RUN_TEST(test_parse_layout_with_content);
     RUN_TEST(test_parse_website_with_auth);
+    RUN_TEST(test_parse_static_block);
+    RUN_TEST(test_parse_static_block_requires_route_and_dir);
+    RUN_TEST(test_parse_lua_budget);
     return UNITY_END();
 }
@@ -0,0 +1,63 @@
+#include "../test/unity/unity.h"
+#include "../src/replay.h"
+#include <string.h>
+#include "test_runners.h"
+
+static void test_replay_builds_request(void) {
+    const char *line =
+        "{\"startMs\":1700000000123,\"method\":\"POST\",\"url\":\"/api/v1/notes?draft=1\","
+        "\"headers\":{\"Host\":\"example.com\",\"Content-Type\":\"application/json\","
+        "\"Content-Length\":\"99\",\"Connection\":\"close\",\"X-Request-Id\":\"abc\"},"
+        "\"body\":\"{\\\"title\\\":\\\"hi\\\"}\",\"route\":\"/api/v1/notes\",\"status\":201,\"durationMs\":2.5}";
+
+    ReplayEntry entry;
+    TEST_ASSERT_TRUE(parseReplayEntry(line, 3123, &entry));
+    TEST_ASSERT_EQUAL_STRING("/api/v1/notes", entry.label);
+    TEST_ASSERT_EQUAL_STRING("POST /api/v1/notes?draft=1", entry.target);
+    TEST_ASSERT_EQUAL(201, entry.capturedStatus);
+    TEST_ASSERT_EQUAL_UINT64(2500000, entry.capturedNs);
+
+    // Framing headers are rewritten for the local instance
+    const char *expected =
+        "POST /api/v1/notes?draft=1 HTTP/1.1\r\n"
+        "Host: 127.0.0.1:3123\r\n"
+        "Content-Type: application/json\r\n"
+        "X-Request-Id: abc\r\n"
+        "Content-Length: 14\r\n"
+        "\r\n"
+        "{\"title\":\"hi\"}";
+    TEST_ASSERT_EQUAL_size_t(strlen(expected), entry.requestLength);
+    TEST_ASSERT_EQUAL_MEMORY(expected, entry.request, entry.requestLength);
+    freeReplayEntry(&entry);
+}
+
+static void test_replay_decodes_binary_body(void) {
+    const char *line = "{\"startMs\":1,\"method\":\"PUT\",\"url\":\"/upload\",\"headers\":{},"
+                       "\"bodyBase64\":\"AAH/YWI=\",\"status\":200,\"durationMs\":1}";
+
+    ReplayEntry entry;
+    TEST_ASSERT_TRUE(parseReplayEntry(line, 8080, &entry));
+    TEST_ASSERT_EQUAL_STRING("PUT /upload", entry.label);
+    const char body[] = {0, 1, (char)0xff, 'a', 'b'};
+    TEST_ASSERT_TRUE(entry.requestLength > sizeof(body));
+    TEST_ASSERT_EQUAL_MEMORY(body, entry.request + entry.requestLength - sizeof(body), sizeof(body));
+    TEST_ASSERT_NOT_NULL(strstr(entry.request, "Content-Length: 5\r\n"));
+    freeReplayEntry(&entry);
+}
+
+static void test_replay_skips_unusable_lines(void) {
+    ReplayEntry entry;
+    TEST_ASSERT_FALSE(parseReplayEntry("not json", 8080, &entry));
+    TEST_ASSERT_FALSE(parseReplayEntry("{\"method\":\"GET\"}", 8080, &entry));
+    TEST_ASSERT_FALSE(parseReplayEntry(
+        "{\"method\":\"POST\",\"url\":\"/big\",\"body\":\"x\",\"bodyTruncated\":true,\"status\":200}",
+        8080, &entry));
+}
+
+int run_replay_tests(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_replay_builds_request);
+    RUN_TEST(test_replay_decodes_binary_body);
+    RUN_TEST(test_replay_skips_unusable_lines);
+    return UNITY_END();
+}
@@ -7,12 +7,28 @@ int run_parser_tests(void);
 int run_arena_tests(void);
 int run_stringbuilder_tests(void);
 int run_website_json_tests(void);
+int run_replay_tests(void);
 
 // Server test runners
 int run_server_tests(void);
 int run_server_html_tests(void);
 int run_server_css_tests(void);
 int run_server_validation_tests(void);
+int run_server_metrics_tests(void);
+int run_server_trace_tests(void);
+int run_server_pipeline_value_tests(void);
+int run_server_jq_tests(void);
+int run_server_linker_tests(void);
+int run_server_lua_json_tests(void);
+int run_server_lua_tests(void);
+int run_server_fetch_cache_tests(void);
+int run_server_lua_fetch_tests(void);
+int run_server_shared_dict_tests(void);
+int run_server_anonymous_session_tests(void);
+int run_server_session_store_tests(void);
+int run_server_artifact_cache_tests(void);
+int run_server_static_tests(void);
+int run_server_logger_tests(void);
 int run_route_params_tests(void);
 
 // Hotreload test runners
@@ -20,5 +36,6 @@ int run_website_tests(void);
 
 // End-to-end test runners
 int run_e2e_tests(void);
+int run_e2e_perf_tests(void);
 
 #endif // TEST_RUNNERS_H 
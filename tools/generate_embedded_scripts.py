@@ -1,10 +1,15 @@
 #!/usr/bin/env python3
 
+import argparse
 import os
+import shlex
+import subprocess
 import sys
+import tempfile
 from pathlib import Path
 
 CHUNK_SIZE = 2000  # Safe size for string literals
+BYTES_PER_LINE = 16
 
 HEADER_TEMPLATE = '''/* Generated file - DO NOT EDIT */
 #ifndef GENERATED_SCRIPTS_H
@@ -16,6 +21,8 @@ typedef struct {
     const char* name;
     const char** chunks;
     size_t num_chunks;
+    const unsigned char* bytecode;  /* Precompiled chunk, NULL when generated without luac */
+    size_t bytecode_len;
 } EmbeddedScript;
 
 /* Table of all embedded scripts */
@@ -32,56 +39,134 @@ def chunk_string(s, chunk_size=CHUNK_SIZE):
     """Split a string into chunks of maximum size."""
     return [s[i:i + chunk_size] for i in range(0, len(s), chunk_size)]
 
-def generate_scripts():
+def compile_script(luac, strip, script_path):
+    """Compile a script with luac (or `luajit -b`), returning the bytecode or None."""
+    command = shlex.split(luac)
+    with tempfile.TemporaryDirectory() as tmp:
+        output = os.path.join(tmp, 'out.luac')
+        if Path(command[0]).name.startswith('luajit'):
+            # luajit -b strips debug info unless given -g
+            args = command + ([] if strip else ['-g']) + [str(script_path), output]
+        else:
+            args = command + (['-s'] if strip else []) + ['-o', output, str(script_path)]
+
+        try:
+            result = subprocess.run(args, capture_output=True, text=True)
+        except FileNotFoundError:
+            print(f'{command[0]} not found, embedding {script_path.name} as source only',
+                  file=sys.stderr)
+            return None
+        if result.returncode != 0:
+            print(f'Failed to compile {script_path.name}: {result.stderr.strip()}', file=sys.stderr)
+            sys.exit(1)
+
+        with open(output, 'rb') as f:
+            return f.read()
+
+BYTECODE_HEADER = 'embedded_bytecode.h'
+
+def write_bytes(f, name, data):
+    f.write(f'static const unsigned char {name}[] = {{\n')
+    for i in range(0, len(data), BYTES_PER_LINE):
+        line = ', '.join(f'0x{b:02x}' for b in data[i:i + BYTES_PER_LINE])
+        f.write(f'    {line},\n')
+    f.write('};\n\n')
+
+def write_bytecode_header(path, compiled):
+    """Write the bytecode arrays included by generated_scripts.c, or remove a stale header."""
+    if not compiled:
+        if path.exists():
+            path.unlink()
+        return
+
+    path.parent.mkdir(parents=True, exist_ok=True)
+    with open(path, 'w') as f:
+        f.write('/* Generated file - DO NOT EDIT */\n')
+        f.write('/* Bytecode from the local Lua compiler, included by generated_scripts.c */\n\n')
+        for var_prefix, bytecode in compiled:
+            f.write(f'#define {var_prefix}_HAS_BYTECODE 1\n')
+            write_bytes(f, f'{var_prefix}_BYTECODE', bytecode)
+
+def generate_scripts(luac=None, strip=False, bytecode_dir=None):
     # Get project root directory (two levels up from this script)
     project_root = Path(__file__).parent.parent
     scripts_dir = project_root / 'scripts'
     output_dir = project_root / 'src' / 'server'
-    
+
     # Ensure output directory exists
     output_dir.mkdir(parents=True, exist_ok=True)
-    
+
     # Find all Lua scripts (excluding those in build/ directory)
     script_files = []
-    for script_path in scripts_dir.glob('*.lua'):
+    for script_path in sorted(scripts_dir.glob('*.lua')):
         if 'build' not in script_path.parts:
             script_files.append(script_path)
-    
+
     # Generate header file
     with open(output_dir / 'generated_scripts.h', 'w') as f:
         f.write(HEADER_TEMPLATE)
-    
+
+    # The bytecode depends on the local luac, so it goes to the build
+    # directory and the checked-in source stays the same on every machine
+    compiled = []
+    if luac and bytecode_dir:
+        for script_path in script_files:
+            bytecode = compile_script(luac, strip, script_path)
+            if not bytecode:
+                compiled = []
+                break
+            compiled.append((script_path.stem.upper(), bytecode))
+    if bytecode_dir:
+        write_bytecode_header(Path(bytecode_dir) / BYTECODE_HEADER, compiled)
+
     # Generate source file
     with open(output_dir / 'generated_scripts.c', 'w') as f:
         f.write('/* Generated file - DO NOT EDIT */\n')
         f.write('#include "generated_scripts.h"\n')
         f.write('#include <stddef.h>\n\n')
-        
-        # Generate chunk arrays for each script
+        f.write('/* Written by `make generate-scripts` when a Lua compiler is available */\n')
+        f.write('#ifdef __has_include\n')
+        f.write(f'#if __has_include("{BYTECODE_HEADER}")\n')
+        f.write(f'#include "{BYTECODE_HEADER}"\n')
+        f.write('#endif\n')
+        f.write('#endif\n\n')
+
+        # Generate chunk arrays for each script. The source stays embedded
+        # for builds without bytecode and runtimes that reject it.
+        scripts = []
         for script_path in script_files:
             with open(script_path, 'r') as sf:
-                content = sf.read()
-                chunks = chunk_string(content)
-                var_prefix = script_path.stem.upper()
-                
-                f.write(f'static const char* {var_prefix}_CHUNKS[] = {{\n')
-                for chunk in chunks:
-                    f.write(f'    "{escape_string(chunk)}",\n')
-                f.write('};\n\n')
-        
+                chunks = chunk_string(sf.read())
+            var_prefix = script_path.stem.upper()
+
+            f.write(f'static const char* {var_prefix}_CHUNKS[] = {{\n')
+            for chunk in chunks:
+                f.write(f'    "{escape_string(chunk)}",\n')
+            f.write('};\n\n')
+            scripts.append((script_path.stem, var_prefix, len(chunks)))
+
         # Generate scripts array
         f.write('const EmbeddedScript EMBEDDED_SCRIPTS[] = {\n')
-        for script_path in script_files:
-            var_prefix = script_path.stem.upper()
-            with open(script_path, 'r') as sf:
-                num_chunks = len(chunk_string(sf.read()))
+        for name, var_prefix, num_chunks in scripts:
             f.write('    {\n')
-            f.write(f'        .name = "{script_path.stem}",\n')
+            f.write(f'        .name = "{name}",\n')
             f.write(f'        .chunks = {var_prefix}_CHUNKS,\n')
-            f.write(f'        .num_chunks = {num_chunks}\n')
+            f.write(f'        .num_chunks = {num_chunks},\n')
+            f.write(f'#ifdef {var_prefix}_HAS_BYTECODE\n')
+            f.write(f'        .bytecode = {var_prefix}_BYTECODE,\n')
+            f.write(f'        .bytecode_len = sizeof({var_prefix}_BYTECODE)\n')
+            f.write('#else\n')
+            f.write('        .bytecode = NULL,\n')
+            f.write('        .bytecode_len = 0\n')
+            f.write('#endif\n')
             f.write('    },\n')
-        f.write('    { NULL, NULL, 0 }  /* Terminator */\n')
+        f.write('    { NULL, NULL, 0, NULL, 0 }  /* Terminator */\n')
         f.write('};\n')
 
 if __name__ == '__main__':
-    generate_scripts() 
\ No newline at end of file
+    parser = argparse.ArgumentParser(description='Embed scripts/*.lua into the server')
+    parser.add_argument('--luac', help='Lua compiler to precompile with, e.g. luac5.4 or "luajit -b"')
+    parser.add_argument('--strip', action='store_true', help='Strip debug information from the bytecode')
+    parser.add_argument('--bytecode-dir', help=f'Directory to write {BYTECODE_HEADER} to, e.g. build')
+    args = parser.parse_args()
+    generate_scripts(args.luac, args.strip, args.bytecode_dir)